@@ -0,0 +1,65 @@
+# Extracts the formats of the binary logging (ACTIVATE_BINARY_LOGGING) from the BinaryLogFormats
+# section of the firmware and writes them into a json table that is used by
+# util/binarylog/BinaryLogDecoder.py. The offset of a format in the section is its id.
+# Usage: ExtractBinaryLogFormats.py <firmware.out> <formats.json>
+import json
+import os
+import struct
+import sys
+
+SECTION_NAME = b"BinaryLogFormats"
+FIELD_SEPARATOR = "\x1f"
+
+def read_section(elf_path, section_name):
+    with open(elf_path, "rb") as f:
+        elf = f.read()
+    if elf[0:4] != b"\x7fELF" or elf[4] != 1:
+        raise Exception("Only 32 bit ELF files are supported")
+    endian = "<" if elf[5] == 1 else ">"
+    section_header_offset, = struct.unpack_from(endian + "I", elf, 0x20)
+    section_header_size, section_count, names_index = struct.unpack_from(endian + "HHH", elf, 0x2E)
+
+    def section_header(index):
+        # name, type, flags, addr, offset, size
+        return struct.unpack_from(endian + "IIIIII", elf, section_header_offset + index * section_header_size)
+
+    names_offset = section_header(names_index)[4]
+    for i in range(section_count):
+        name, _, _, _, offset, size = section_header(i)
+        name_start = names_offset + name
+        if elf[name_start:elf.index(b"\0", name_start)] == section_name:
+            return elf[offset:offset + size]
+    return None
+
+def main():
+    elf_path = sys.argv[1]
+    output_path = sys.argv[2]
+
+    section = read_section(elf_path, SECTION_NAME)
+    if section is None:
+        # Binary logging is not active in this featureset, a stale table must not be used
+        if os.path.exists(output_path):
+            os.remove(output_path)
+        return
+
+    formats = {}
+    offset = 0
+    while offset < len(section):
+        end = section.index(b"\0", offset)
+        if end > offset:
+            fields = section[offset:end].decode("utf-8", "replace").split(FIELD_SEPARATOR, 3)
+            if len(fields) == 4:
+                formats[str(offset)] = {
+                    "file": os.path.basename(fields[0].replace("\\", "/")),
+                    "line": int(fields[1]),
+                    "tag": fields[2].strip('"') if fields[2].startswith('"') else None,
+                    "format": fields[3],
+                }
+        offset = end + 1
+
+    with open(output_path, "w") as f:
+        json.dump({"formats": formats}, f, indent=1, sort_keys=True)
+    print("Extracted " + str(len(formats)) + " binary log formats to " + output_path)
+
+if __name__ == "__main__":
+    main()
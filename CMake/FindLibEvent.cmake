@@ -16,8 +16,11 @@ if(NOT libevent_POPULATED)
 endif()
 target_include_directories(cherrySim_tester PRIVATE ${libevent_SOURCE_DIR}/include)
 target_include_directories(cherrySim_runner PRIVATE ${libevent_SOURCE_DIR}/include)
+target_include_directories(cherrySim_bench PRIVATE ${libevent_SOURCE_DIR}/include)
 target_include_directories(cherrySim_tester PRIVATE ${libevent_BINARY_DIR}/include)
 target_include_directories(cherrySim_runner PRIVATE ${libevent_BINARY_DIR}/include)
+target_include_directories(cherrySim_bench PRIVATE ${libevent_BINARY_DIR}/include)
 
 target_link_libraries(cherrySim_tester PRIVATE event_core event_extra)
 target_link_libraries(cherrySim_runner PRIVATE event_core event_extra)
+target_link_libraries(cherrySim_bench PRIVATE event_core event_extra)
@@ -43,6 +43,7 @@
 #include <iostream>
 #include <string>
 #include <functional>
+#include <unordered_map>
 #include <json.hpp>
 #include <fstream>
 
@@ -118,8 +119,8 @@ using json = nlohmann::json;
 // These values may not change while simulating a node.
 //#########################################################################################
 
-CherrySim* cherrySimInstance = nullptr; // Use this to access the simulator from C functions
-NRF_UART_Type* simUartPtr = nullptr;
+thread_local CherrySim* cherrySimInstance = nullptr; // Use this to access the simulator from C functions, each thread can run its own simulator
+SIM_THREAD_LOCAL NRF_UART_Type* simUartPtr = nullptr;
 bool meshGwCommunication = false;
 
 //This is normally populated by the linker script when compiling FruityMesh,
@@ -133,14 +134,38 @@ ConnTypeResolver connTypeResolvers[] = {
 // These functions can start / stop / reset the simulator
 //#########################################################################################
 
+//The flash file starts with this header, padded to a full page. It is followed by an append-only list of batches, each
+//batch is a page with a FlashFileBatchHeader followed by the pages that it lists. Later batches overwrite earlier ones.
 struct FlashFileHeader
 {
     u32 version;
     u32 sizeOfHeader;
     u32 flashSize;
     u32 amountOfNodes;
+    u32 pageSize;
 };
 
+struct FlashFileBatchEntry
+{
+    u32 nodeIndex;
+    u32 pageIndex;
+};
+
+constexpr u32 FLASH_FILE_BATCH_MAGIC_NUMBER = 0xF1A5BA7C;
+constexpr u32 FLASH_FILE_MAX_PAGES_PER_BATCH = (SIM_FLASH_PAGE_SIZE - 2 * sizeof(u32)) / sizeof(FlashFileBatchEntry);
+
+struct FlashFileBatchHeader
+{
+    u32 magicNumber;
+    u32 amountOfPages;
+    FlashFileBatchEntry entries[FLASH_FILE_MAX_PAGES_PER_BATCH];
+};
+static_assert(sizeof(FlashFileBatchHeader) <= SIM_FLASH_PAGE_SIZE, "Batch header must fit into a page");
+
+//The file is rewritten once most of it consists of outdated pages
+constexpr u32 FLASH_FILE_COMPACTION_FACTOR = 2;
+constexpr u32 FLASH_FILE_MIN_PAGES_BEFORE_COMPACTION = 256;
+
 bool CherrySim::ShouldSimIvTrigger(u32 ivMs)
 {
     return (currentNode->state.timeMs % ivMs) == 0;
@@ -160,21 +185,105 @@ void CherrySim::StoreFlashToFile()
 {
     if (simConfig.storeFlashToFile == "") return;
 
-    std::ofstream file(simConfig.storeFlashToFile, std::ios::binary);
-    
-    FlashFileHeader ffh;
-    CheckedMemset(&ffh, 0, sizeof(ffh));
+    //Pages that are still erased and were never stored do not need to be written
+    std::vector<u32> pagesToStore;
+    for (u32 globalPageIndex : sparseFlash.TakeDirtyPages())
+    {
+        if (!flashFileStoredPages[globalPageIndex] && sparseFlash.IsPageErased(globalPageIndex)) continue;
+        pagesToStore.push_back(globalPageIndex);
+    }
 
-    ffh.version = FM_VERSION;
-    ffh.sizeOfHeader = sizeof(ffh);
-    ffh.flashSize = SIM_MAX_FLASH_SIZE;
-    ffh.amountOfNodes = GetTotalNodes();
+    if (!flashFileAppendable
+        || (flashFileSizeInPages > FLASH_FILE_MIN_PAGES_BEFORE_COMPACTION && flashFileSizeInPages > FLASH_FILE_COMPACTION_FACTOR * (amountOfStoredFlashPages + pagesToStore.size())))
+    {
+        RewriteFlashFile(pagesToStore);
+        return;
+    }
 
-    file.write((const char*)&ffh, sizeof(ffh));
+    if (pagesToStore.empty()) return;
 
-    for (u32 i = 0; i < GetTotalNodes(); i++)
+    std::ofstream file(simConfig.storeFlashToFile, std::ios::binary | std::ios::app);
+    AppendFlashFileBatches(file, pagesToStore);
+}
+
+//Writes a new file that contains all pages that are not erased, pages that were already loaded lazily from the old file keep using it
+void CherrySim::RewriteFlashFile(const std::vector<u32>& dirtyPages)
+{
+    std::vector<u32> pagesToStore;
+    std::vector<bool> pagesToStoreSet(sparseFlash.GetAmountOfPages(), false);
+    for (u32 globalPageIndex : dirtyPages) pagesToStoreSet[globalPageIndex] = true;
+    for (u32 globalPageIndex = 0; globalPageIndex < sparseFlash.GetAmountOfPages(); globalPageIndex++)
     {
-        file.write((const char*)this->nodes[i].flash, SIM_MAX_FLASH_SIZE);
+        if ((pagesToStoreSet[globalPageIndex] || flashFileStoredPages[globalPageIndex]) && !sparseFlash.IsPageErased(globalPageIndex))
+        {
+            pagesToStore.push_back(globalPageIndex);
+        }
+    }
+
+    const std::string temporaryPath = simConfig.storeFlashToFile + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        std::vector<u8> headerPage(sparseFlash.GetPageSize(), 0);
+        FlashFileHeader* ffh = (FlashFileHeader*)headerPage.data();
+        ffh->version = FM_VERSION;
+        ffh->sizeOfHeader = sizeof(FlashFileHeader);
+        ffh->flashSize = SIM_MAX_FLASH_SIZE;
+        ffh->amountOfNodes = GetTotalNodes();
+        ffh->pageSize = sparseFlash.GetPageSize();
+        file.write((const char*)headerPage.data(), headerPage.size());
+
+        flashFileStoredPages.assign(sparseFlash.GetAmountOfPages(), false);
+        amountOfStoredFlashPages = 0;
+        flashFileSizeInPages = 1;
+        AppendFlashFileBatches(file, pagesToStore);
+
+        if (!file.good())
+        {
+            SIMEXCEPTION(FileException);
+        }
+    }
+
+    //Replacing the file keeps it intact for anything that still maps the old one
+    std::remove(simConfig.storeFlashToFile.c_str());
+    if (std::rename(temporaryPath.c_str(), simConfig.storeFlashToFile.c_str()) != 0)
+    {
+        SIMEXCEPTION(FileException);
+    }
+    flashFileAppendable = true;
+}
+
+void CherrySim::AppendFlashFileBatches(std::ofstream& file, const std::vector<u32>& pages)
+{
+    const u32 pagesPerFlash = SIM_MAX_FLASH_SIZE / sparseFlash.GetPageSize();
+    std::vector<u8> batchHeaderPage(sparseFlash.GetPageSize());
+
+    for (size_t batchStart = 0; batchStart < pages.size(); batchStart += FLASH_FILE_MAX_PAGES_PER_BATCH)
+    {
+        const u32 amountOfPages = (u32)std::min<size_t>(FLASH_FILE_MAX_PAGES_PER_BATCH, pages.size() - batchStart);
+
+        CheckedMemset(batchHeaderPage.data(), 0, batchHeaderPage.size());
+        FlashFileBatchHeader* batchHeader = (FlashFileBatchHeader*)batchHeaderPage.data();
+        batchHeader->magicNumber = FLASH_FILE_BATCH_MAGIC_NUMBER;
+        batchHeader->amountOfPages = amountOfPages;
+        for (u32 i = 0; i < amountOfPages; i++)
+        {
+            batchHeader->entries[i].nodeIndex = pages[batchStart + i] / pagesPerFlash;
+            batchHeader->entries[i].pageIndex = pages[batchStart + i] % pagesPerFlash;
+        }
+        file.write((const char*)batchHeaderPage.data(), batchHeaderPage.size());
+
+        for (u32 i = 0; i < amountOfPages; i++)
+        {
+            const u32 globalPageIndex = pages[batchStart + i];
+            file.write((const char*)sparseFlash.GetPage(globalPageIndex), sparseFlash.GetPageSize());
+            if (!flashFileStoredPages[globalPageIndex])
+            {
+                flashFileStoredPages[globalPageIndex] = true;
+                amountOfStoredFlashPages++;
+            }
+        }
+        flashFileSizeInPages += 1 + amountOfPages;
     }
 }
 
@@ -182,7 +291,7 @@ void CherrySim::LoadFlashFromFile()
 {
     if (simConfig.storeFlashToFile == "") return;
 
-    std::ifstream infile(simConfig.storeFlashToFile);
+    std::ifstream infile(simConfig.storeFlashToFile, std::ios::binary);
 
     //If file does not exist we just return
     if (!infile.good())
@@ -192,21 +301,23 @@ void CherrySim::LoadFlashFromFile()
     }
 
     infile.seekg(0, std::ios::end);
-    size_t length = infile.tellg();
+    const size_t length = infile.tellg();
     infile.seekg(0, std::ios::beg);
-    char* buffer = new char[length];
-    infile.read(buffer, length);
 
+    const u32 pageSize = sparseFlash.GetPageSize();
     FlashFileHeader ffh;
     CheckedMemset(&ffh, 0, sizeof(ffh));
-    ffh = *(FlashFileHeader*)(buffer);
+    infile.read((char*)&ffh, sizeof(ffh));
 
     if (
         //=> We are not checking against the version as this is set to the FruityMesh version which is allowed to change
-           ffh.sizeOfHeader  != sizeof(ffh)
+           !infile.good()
+        || ffh.sizeOfHeader  != sizeof(ffh)
         || ffh.flashSize     != SIM_MAX_FLASH_SIZE
         || ffh.amountOfNodes != GetTotalNodes()
-        || length            != sizeof(ffh) + SIM_MAX_FLASH_SIZE * GetTotalNodes()
+        || ffh.pageSize      != pageSize
+        || length            <  pageSize
+        || length % pageSize != 0
         )
     {
         //Probably the correct action if this happens is to just remove the flash safe file (see simConfig.storeFlashToFile)
@@ -216,12 +327,62 @@ void CherrySim::LoadFlashFromFile()
         return;
     }
 
+    //Only the batch headers are read, the latest file offset of every page is collected
+    const u32 pagesPerFlash = SIM_MAX_FLASH_SIZE / pageSize;
+    std::vector<u32> fileOffsets(sparseFlash.GetAmountOfPages(), 0);
+    std::vector<u8> batchHeaderPage(pageSize);
+    size_t offset = pageSize;
+    bool complete = true;
+    while (offset < length)
+    {
+        infile.seekg(offset);
+        infile.read((char*)batchHeaderPage.data(), pageSize);
+        const FlashFileBatchHeader* batchHeader = (const FlashFileBatchHeader*)batchHeaderPage.data();
+        if (!infile.good() || batchHeader->magicNumber != FLASH_FILE_BATCH_MAGIC_NUMBER || batchHeader->amountOfPages > FLASH_FILE_MAX_PAGES_PER_BATCH)
+        {
+            SIMEXCEPTION(CorruptOrOutdatedSavefile);
+            return;
+        }
+        //A batch that was not written completely (e.g. the simulator was killed) is ignored
+        if (offset + (size_t)(1 + batchHeader->amountOfPages) * pageSize > length)
+        {
+            complete = false;
+            break;
+        }
+        for (u32 i = 0; i < batchHeader->amountOfPages; i++)
+        {
+            const FlashFileBatchEntry& entry = batchHeader->entries[i];
+            if (entry.nodeIndex >= GetTotalNodes() || entry.pageIndex >= pagesPerFlash)
+            {
+                SIMEXCEPTION(CorruptOrOutdatedSavefile);
+                return;
+            }
+            fileOffsets[entry.nodeIndex * pagesPerFlash + entry.pageIndex] = (u32)(offset + (size_t)(1 + i) * pageSize);
+        }
+        offset += (size_t)(1 + batchHeader->amountOfPages) * pageSize;
+    }
+    infile.close();
+
+    std::vector<std::pair<u32, u32>> pagesToLoad;
+    flashFileStoredPages.assign(sparseFlash.GetAmountOfPages(), false);
+    for (u32 globalPageIndex = 0; globalPageIndex < fileOffsets.size(); globalPageIndex++)
+    {
+        if (fileOffsets[globalPageIndex] == 0) continue;
+        pagesToLoad.emplace_back(globalPageIndex, fileOffsets[globalPageIndex]);
+        flashFileStoredPages[globalPageIndex] = true;
+    }
+    //The file contains all pages that are not erased
     for (u32 i = 0; i < GetTotalNodes(); i++)
     {
-        CheckedMemcpy(this->nodes[i].flash, buffer + SIM_MAX_FLASH_SIZE * i + sizeof(ffh), SIM_MAX_FLASH_SIZE);
+        sparseFlash.EraseFlash(i);
     }
+    sparseFlash.LoadPagesFromFile(simConfig.storeFlashToFile, pagesToLoad);
 
-    delete[] buffer;
+    //The flash now matches the file
+    sparseFlash.TakeDirtyPages();
+    amountOfStoredFlashPages = (u32)pagesToLoad.size();
+    flashFileSizeInPages = (u32)(offset / pageSize);
+    flashFileAppendable = complete;
 }
 
 #define AddSimulatedFeatureSet(featureset) \
@@ -443,10 +604,22 @@ CherrySim::CherrySim(const SimConfiguration &simConfig)
     simState.globalConnHandleCounter = 0;
 }
 
+//Only the thread that forked the process exists in the fork, the complete simulation state is a private copy
+void CherrySim::PrepareForkedProcess()
+{
+    //The threads of the pool are gone and must not be joined, a new pool is created on the next step
+    (void)nodeWorkerPool.release();
+}
+
 CherrySim::~CherrySim()
 {
     StoreFlashToFile();
 
+    //Keep the statistics of the nodes, they are collected over multiple simulator runs
+    for (u32 i = 0; i < GetTotalNodes(); i++) {
+        GetSimStatisticsWithoutNode().Add(nodes[i].statistics);
+    }
+
     //Clean up up all nodes
     for (u32 i = 0; i < GetTotalNodes(); i++) {
         NodeIndexSetter setter(i);
@@ -501,6 +674,14 @@ void CherrySim::Init()
         new (&nodes[i]) NodeEntry;
     }
 
+    globalSentPackets.Clear();
+    globalRoutedPackets.Clear();
+
+    sparseFlash.Reset(GetTotalNodes());
+    flashFileStoredPages.assign(sparseFlash.GetAmountOfPages(), false);
+    amountOfStoredFlashPages = 0;
+    flashFileSizeInPages = 0;
+    flashFileAppendable = false;
     for (u32 i = 0; i < GetTotalNodes(); i++) {
         InitNode(i);
     }
@@ -514,6 +695,9 @@ void CherrySim::Init()
 
     LoadFlashFromFile();
 
+    //All nodes start with mostly the same flash contents
+    sparseFlash.ShareIdenticalPages();
+
     //Either use given positions from json or generate them randomly
     if (simConfig.importFromJson) {
         ImportPositionsFromJson();
@@ -521,7 +705,10 @@ void CherrySim::Init()
         PositionNodesRandomly();
         LoadPresetNodePositions();
     }
+    linkBudgetCache.Reset(GetTotalNodes());
+    RebuildSpatialGrid();
 
+    mapChangeFeed.Reset(GetTotalNodes());
     server = new FruitySimServer();
 }
 
@@ -875,6 +1062,8 @@ void CherrySim::LoadPresetNodePositions()
 //This simulates a time step for all nodes
 void CherrySim::SimulateStepForAllNodes()
 {
+    SimulatorContextSetter contextSetter(this);
+
     //If we are in meshGwCommunication mode, the meshGw needs to boot first.
     //This may take some time. There is no need for us to run already so we
     //wait until we received something. This has the advantage that the replay
@@ -902,6 +1091,19 @@ void CherrySim::SimulateStepForAllNodes()
     //Check if the webserver has some open requests to process
     server->ProcessServerRequests();
 
+    //The spatial grid and the link budget cache depend on the map dimensions which might have been changed
+    if (!spatialGrid.IsValidFor(simConfig.mapWidthInMeters, simConfig.mapHeightInMeters, simConfig.mapElevationInMeters, GetTotalNodes()))
+    {
+        RebuildSpatialGrid();
+    }
+
+    //Jump over all ticks in which no node would do anything
+    if (IsIdleTickSkippingPossible())
+    {
+        const u32 skippableTicks = GetAmountOfSkippableTicks();
+        if (skippableTicks > 0) SkipIdleTicks(skippableTicks);
+    }
+
     int64_t sumOfAllSimulatedFrames = 0;
     for (u32 i = 0; i < GetTotalNodes(); i++) {
         NodeIndexSetter setter(i);
@@ -918,53 +1120,49 @@ void CherrySim::SimulateStepForAllNodes()
     }
 
     //printf("-- %u --" EOL, simState.simTimeMs);
-    for (u32 i = 0; i < GetTotalNodes(); i++) {
+    if (simConfig.numParallelNodeWorkers > 0)
+    {
+        SimulateStepForAllNodesInParallel(avgSimulatedFrames);
+    }
+    else
+    {
+        for (u32 i = 0; i < GetTotalNodes(); i++) {
 #ifdef FM_NATIVE_RENDERER_ENABLED
-        if (bbeRenderer && bbeRenderer->isPaused()) break;
+            if (bbeRenderer && bbeRenderer->isPaused()) break;
 #endif
-        NodeIndexSetter setter(i);
-        bool simulateNode = true;
-        if (simConfig.simulateJittering)
-        {
-            const int64_t frameOffset = currentNode->simulatedFrames - avgSimulatedFrames;
-            // Sigmoid function, flipped on the Y-Axis.
-            const double probability = 1.0 / (1 + std::exp((double)(frameOffset) * 0.1));
-            if (PSRNG(probability * UINT32_MAX))
+            NodeIndexSetter setter(i);
+            if (!IsNodeJittering(avgSimulatedFrames))
             {
-                simulateNode = false;
-            }
-        }
-        if (simulateNode)
-        {
-            StackBaseSetter sbs;
-
-            currentNode->simulatedFrames++;
-            SimulateMovement();
-            QueueInterrupts();
-            SimulateTimer();
-            SimulateTimeouts();
-            SimulateBroadcast();
-            SimulateConnections();
-            SimulateServiceDiscovery();
-            SimulateUartInterrupts();
+                StackBaseSetter sbs;
+
+                currentNode->simulatedFrames++;
+                SimulateMovement();
+                QueueInterrupts();
+                SimulateTimer();
+                SimulateTimeouts();
+                SimulateBroadcast();
+                SimulateConnections();
+                SimulateServiceDiscovery();
+                SimulateUartInterrupts();
 #if IS_ACTIVE(CLC_MODULE)
-            SimulateClcData();
+                SimulateClcData();
 #endif
-            SimulateTimeslot();
-            SimulateConnectionParameterUpdateRequestTimeout();
-            try {
-                FruityHal::EventLooper();
-                SimulateFlashCommit();
-                SimulateBatteryUsage();
-                SimulateWatchDog();
-            }
-            catch (const NodeSystemResetException& e) {
-                //Node broke out of its current simulation and rebootet
-                if (simEventListener) simEventListener->CherrySimEventHandler("NODE_RESET");
+                SimulateTimeslot();
+                SimulateConnectionParameterUpdateRequestTimeout();
+                try {
+                    FruityHal::EventLooper();
+                    SimulateFlashCommit();
+                    SimulateBatteryUsage();
+                    SimulateWatchDog();
+                }
+                catch (const NodeSystemResetException& e) {
+                    //Node broke out of its current simulation and rebootet
+                    if (simEventListener) simEventListener->CherrySimEventHandler("NODE_RESET");
+                }
             }
-        }
 
-        globalBreakCounter++;
+            globalBreakCounter++;
+        }
     }
 
     //Run a check on the current clustering state
@@ -998,6 +1196,306 @@ void CherrySim::SimulateStepForAllNodes()
 #endif
 }
 
+bool CherrySim::IsNodeJittering(int64_t avgSimulatedFrames)
+{
+    if (simConfig.simulateJittering)
+    {
+        const int64_t frameOffset = currentNode->simulatedFrames - avgSimulatedFrames;
+        // Sigmoid function, flipped on the Y-Axis.
+        const double probability = 1.0 / (1 + std::exp((double)(frameOffset) * 0.1));
+        if (PSRNG(probability * UINT32_MAX))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CherrySim::IsIdleTickSkippingPossible() const
+{
+    if (!simConfig.skipIdleTicks) return false;
+    //Without a realTime limitation, there is nothing to wait for
+    if (simConfig.realTime) return false;
+    //Input of the meshGw can arrive at any time
+    if (meshGwCommunication) return false;
+    //Both draw random numbers for every node in every tick
+    if (simConfig.simulateJittering) return false;
+    if (simConfig.connectionTimeoutProbabilityPerSec != 0) return false;
+#ifdef FM_NATIVE_RENDERER_ENABLED
+    //The renderer wants to see every frame and might pause the simulation
+    if (bbeRenderer) return false;
+#endif
+    return true;
+}
+
+SoftDeviceBufferedPacket* getNextPacketToWrite(SoftdeviceConnection* connection);
+
+//Returns how many of the upcoming ticks can be skipped without missing anything that a node would do in them.
+//Events that are checked against the simulation time are handled in the first step that starts at or after
+//their time, events that are checked against the time of a node are handled in the step whose node time
+//reaches them. The step that handles the earliest event is always simulated normally.
+u32 CherrySim::GetAmountOfSkippableTicks()
+{
+    const u32 tickMs = simConfig.simTickDurationMs;
+    u32 skippableTicks = idleSkipLimitSimTimeMs > simState.simTimeMs ? (idleSkipLimitSimTimeMs - simState.simTimeMs) / tickMs : 0;
+
+    auto LimitBySimTime = [&](u32 eventSimTimeMs) {
+        const u32 ticks = eventSimTimeMs > simState.simTimeMs ? (eventSimTimeMs - simState.simTimeMs) / tickMs : 0;
+        skippableTicks = std::min(skippableTicks, ticks);
+    };
+    auto LimitByNodeTime = [&](u32 eventNodeTimeMs) {
+        const u32 nodeTimeMs = currentNode->state.timeMs;
+        const u32 ticks = eventNodeTimeMs > nodeTimeMs ? (eventNodeTimeMs - nodeTimeMs - 1) / tickMs : 0;
+        skippableTicks = std::min(skippableTicks, ticks);
+    };
+    auto LimitByNodeInterval = [&](u32 ivMs) {
+        const u32 nodeTimeMs = currentNode->state.timeMs;
+        LimitByNodeTime((nodeTimeMs + ivMs - 1) / ivMs * ivMs);
+    };
+
+    if (replayRecordEntries.size() > 0) LimitBySimTime(replayRecordEntries.front().time);
+
+    //Advertising only has an effect if some node listens to it
+    bool someNodeIsListening = false;
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        if (nodes[i].state.scanningActive || nodes[i].state.connectingActive) someNodeIsListening = true;
+    }
+
+    for (u32 i = 0; i < GetTotalNodes() && skippableTicks > 0; i++)
+    {
+        NodeIndexSetter setter(i);
+        const SoftdeviceState& state = currentNode->state;
+
+        //Everything that is processed in the very next step
+        if (!currentNode->eventQueue.IsEmpty()
+            || !currentNode->interruptQueue.empty()
+            || state.numWaitingFlashOperations > 0
+            || state.uartReadIndex != state.uartBufferLength
+            || currentNode->timeslotRequested
+            || currentNode->timeslotActive
+            || currentNode->timeslotCloseSessionRequested
+            || currentNode->animation.IsStarted()
+            || (currentNode->lastMovementSimTimeMs != 0 && currentNode->lastMovementSimTimeMs + 2000 > simState.simTimeMs)
+            || GS->numMainContextHandlers > 0
+            || GS->numApplicationInterruptHandlers > 0
+            || GS->passsedTimeSinceLastTimerHandlerDs > 0
+            || GS->terminal.lineToReadAvailable
+#if IS_ACTIVE(STDIO)
+            || !GS->terminal.IsTerminalCommandQueueEmpty()
+#endif
+#if IS_ACTIVE(BUTTONS)
+            || GS->button1HoldTimeDs != 0
+#endif
+            )
+        {
+            return 0;
+        }
+
+        LimitByNodeInterval(100L * MAIN_TIMER_TICK * 10 / ticksPerSecond);
+#if IS_ACTIVE(CLC_MODULE)
+        LimitByNodeInterval(30000);
+#endif
+        if (state.advertisingActive && someNodeIsListening) LimitByNodeInterval(state.advertisingIntervalMs);
+        if (state.connectingActive) LimitBySimTime((u32)state.connectingTimeoutTimestampMs);
+        if (state.discoveryDoneTime != 0) LimitBySimTime(state.discoveryDoneTime + 1);
+        if (simConfig.simulateWatchdog && currentNode->watchdogTimeout != 0) LimitByNodeTime(currentNode->lastWatchdogFeedTime + currentNode->watchdogTimeout + 1);
+
+        for (int k = 0; k < state.configuredTotalConnectionCount; k++)
+        {
+            SoftdeviceConnection* connection = &currentNode->state.connections[k];
+            if (!connection->connectionActive) continue;
+
+            //The timestamps of idle connection events are refreshed in the next simulated connection event
+            if (connection->isCentral && connection->connParamUpdateRequestPending) return 0;
+            if (connection->rssiMeasurementActive) LimitByNodeInterval(5000);
+            LimitBySimTime(connection->lastReceivedPacketTimestampMs + connection->connectionSupervisionTimeoutMs);
+            if (getNextPacketToWrite(connection) != nullptr)
+            {
+                u16 connectionIntervalMs = connection->connectionInterval;
+                if (connectionIntervalMs == (int)7.5f) connectionIntervalMs = 10;
+                LimitByNodeTime(connection->lastConnectionTimestampMs + connectionIntervalMs);
+            }
+        }
+    }
+
+    return skippableTicks;
+}
+
+//Advances the simulation as if the given amount of ticks had been simulated without any node doing something
+void CherrySim::SkipIdleTicks(u32 amountOfTicks)
+{
+    const u32 skippedMs = amountOfTicks * simConfig.simTickDurationMs;
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        NodeIndexSetter setter(i);
+        currentNode->simulatedFrames += amountOfTicks;
+        currentNode->state.timeMs += skippedMs;
+
+        //The battery usage does not change while idling
+        const u32 nanoAmperePerMsBefore = currentNode->nanoAmperePerMsTotal;
+        SimulateBatteryUsage();
+        currentNode->nanoAmperePerMsTotal += (currentNode->nanoAmperePerMsTotal - nanoAmperePerMsBefore) * (amountOfTicks - 1);
+    }
+    simState.simTimeMs += skippedMs;
+}
+
+//Steps all nodes in two phases. The radio phase transports advertisements, packets and connection
+//events between the nodes and is executed sequentially in node order. Afterwards, the firmware of all
+//nodes is executed on the worker pool. Everything that a node does to other nodes or to the simulator
+//during that phase is buffered (see RunOrDefer) and applied in node order once all workers are done.
+//Together with the per node random number streams, this keeps the result independent of the amount
+//of workers and of their scheduling.
+void CherrySim::SimulateStepForAllNodesInParallel(int64_t avgSimulatedFrames)
+{
+    if (nodeWorkerPool == nullptr || nodeWorkerPool->GetAmountOfThreads() != simConfig.numParallelNodeWorkers)
+    {
+        nodeWorkerPool.reset();
+        nodeWorkerPool = std::make_unique<NodeWorkerPool>(simConfig.numParallelNodeWorkers);
+    }
+
+    //#### Radio phase
+    parallelStepNodeIndices.clear();
+    for (u32 i = 0; i < GetTotalNodes(); i++) {
+#ifdef FM_NATIVE_RENDERER_ENABLED
+        if (bbeRenderer && bbeRenderer->isPaused()) break;
+#endif
+        NodeIndexSetter setter(i);
+        if (!IsNodeJittering(avgSimulatedFrames))
+        {
+            StackBaseSetter sbs;
+
+            currentNode->simulatedFrames++;
+            SimulateMovement();
+            SimulateTimeouts();
+            SimulateBroadcast();
+            SimulateConnections();
+            SimulateServiceDiscovery();
+            SimulateUartInterrupts();
+#if IS_ACTIVE(CLC_MODULE)
+            SimulateClcData();
+#endif
+            SimulateTimeslot();
+            SimulateConnectionParameterUpdateRequestTimeout();
+
+            //The firmware of the peripheral can not inspect the central while both are stepped
+            for (int k = 0; k < currentNode->state.configuredTotalConnectionCount; k++)
+            {
+                SoftdeviceConnection& connection = currentNode->state.connections[k];
+                connection.partnerConnParamUpdateRequestPendingAtStepStart =
+                    connection.connectionActive && !connection.isCentral && connection.partnerConnection != nullptr
+                    && connection.partnerConnection->connParamUpdateRequestPending;
+            }
+
+            parallelStepNodeIndices.push_back(i);
+        }
+
+        globalBreakCounter++;
+    }
+
+    //#### Firmware phase
+    //Ids are handed out in stripes, every node uses its index as the offset into the stripe
+    parallelStepEventIdBase = simState.globalEventIdCounter;
+    parallelStepPacketIdBase = simState.globalPacketIdCounter;
+    parallelStepExceptions.assign(parallelStepNodeIndices.size(), nullptr);
+
+    //The exception configuration is thread local, the workers must behave like the calling thread
+    const Exceptions::ThreadConfiguration exceptionConfiguration = Exceptions::GetThreadConfiguration();
+
+    nodeWorkerPool->Run((u32)parallelStepNodeIndices.size(),
+        [&]() {
+            cherrySimInstance = this;
+            nodeWorkerContext = true;
+            Exceptions::SetThreadConfiguration(exceptionConfiguration);
+        },
+        [&](u32 job) {
+            NodeIndexSetter setter(parallelStepNodeIndices[job]);
+            StackBaseSetter sbs;
+
+            currentNode->parallelStepEventIds = 0;
+            currentNode->parallelStepPacketIds = 0;
+            try {
+                try {
+                    QueueInterrupts();
+                    SimulateTimer();
+                    FruityHal::EventLooper();
+                    SimulateFlashCommit();
+                    SimulateBatteryUsage();
+                    SimulateWatchDog();
+                }
+                catch (const NodeSystemResetException& e) {
+                    //Node broke out of its current simulation and rebootet
+                    RunOrDefer([this]() {
+                        if (simEventListener) simEventListener->CherrySimEventHandler("NODE_RESET");
+                    });
+                }
+            }
+            catch (...) {
+                parallelStepExceptions[job] = std::current_exception();
+            }
+        });
+
+    nodeWorkerContext = false;
+
+    u32 maxEventIds = 0;
+    u32 maxPacketIds = 0;
+    for (u32 index : parallelStepNodeIndices)
+    {
+        maxEventIds = std::max(maxEventIds, nodes[index].parallelStepEventIds);
+        maxPacketIds = std::max(maxPacketIds, nodes[index].parallelStepPacketIds);
+    }
+    simState.globalEventIdCounter = parallelStepEventIdBase + maxEventIds * GetTotalNodes();
+    simState.globalPacketIdCounter = parallelStepPacketIdBase + maxPacketIds * GetTotalNodes();
+
+    ApplyDeferredEffects();
+
+    //Exceptions are reported as if the nodes had been stepped one after another
+    for (const std::exception_ptr& e : parallelStepExceptions)
+    {
+        if (e != nullptr) std::rethrow_exception(e);
+    }
+}
+
+void CherrySim::ApplyDeferredEffects()
+{
+    std::vector<std::function<void()>> effects;
+    for (u32 index : parallelStepNodeIndices)
+    {
+        if (nodes[index].deferredEffects.empty()) continue;
+
+        NodeIndexSetter setter(index);
+        effects.swap(currentNode->deferredEffects);
+        for (std::function<void()>& effect : effects)
+        {
+            effect();
+        }
+        effects.clear();
+    }
+}
+
+bool CherrySim::IsInNodeWorkerContext()
+{
+    return nodeWorkerContext;
+}
+
+MersenneTwister& CherrySim::GetRandom()
+{
+    if (nodeWorkerContext) return currentNode->rnd;
+    return simState.rnd;
+}
+
+u32 CherrySim::GenerateGlobalEventId()
+{
+    if (nodeWorkerContext) return parallelStepEventIdBase + (currentNode->parallelStepEventIds++) * GetTotalNodes() + currentNode->index;
+    return simState.globalEventIdCounter++;
+}
+
+u32 CherrySim::GenerateGlobalPacketId()
+{
+    if (nodeWorkerContext) return parallelStepPacketIdBase + (currentNode->parallelStepPacketIds++) * GetTotalNodes() + currentNode->index;
+    return simState.globalPacketIdCounter++;
+}
+
 void CherrySim::QuitSimulation()
 {
     throw CherrySimQuitException();
@@ -1047,6 +1545,13 @@ u32 CherrySim::GetAssetNodes(bool countAgain) const
 //Terminal functions to control the simulator (CherrySim registers its TerminalCommandHandler with FruityMesh)
 TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::vector<std::string>& commandArgs)
 {
+    //Simulator commands modify the whole simulation and can not be executed on a worker
+    if (nodeWorkerContext && commandArgs.size() >= 2 && commandArgs[0] == "sim")
+    {
+        RunOrDefer([this, commandArgs]() { TerminalCommandHandler(commandArgs); });
+        return TerminalCommandHandlerReturnType::SUCCESS;
+    }
+
     if (commandArgs.size() >= 2 && commandArgs[0] == "sim")
     {
         if (commandArgs[1] == "stat") {
@@ -1072,6 +1577,11 @@ TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::ve
 
             return TerminalCommandHandlerReturnType::SUCCESS;
         }
+        else if (commandArgs[1] == "statjson") {
+            sim_print_statistics_json();
+
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
         else if (commandArgs.size() >= 3 && commandArgs[1] == "term") {
             if (commandArgs[2] == "all") {
                 simConfig.terminalId = 0;
@@ -1236,6 +1746,23 @@ TerminalCommandHandlerReturnType CherrySim::TerminalCommandHandler(const std::ve
             PrintPacketStats(nodeId, "ROUTED");
             return TerminalCommandHandlerReturnType::SUCCESS;
         }
+        else if (commandArgs[1] == "profile") {
+            //Print the time spent in the firmware per frame, either for a single node or for all nodes
+            NodeId nodeId = commandArgs.size() >= 3 ? Utility::StringToU16(commandArgs[2].c_str()) : 0;
+            PrintProfile(nodeId);
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs.size() >= 3 && commandArgs[1] == "profile_collapsed") {
+            //Write the profiles of all nodes in the collapsed stack format, e.g. for flamegraph.pl
+            std::ofstream file(commandArgs[2], std::ios::trunc);
+            if (!file) return TerminalCommandHandlerReturnType::WRONG_ARGUMENT;
+            WriteProfileCollapsedStacks(file);
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
+        else if (commandArgs[1] == "profile_clear") {
+            for (u32 i = 0; i < GetTotalNodes(); i++) nodes[i].profile.Clear();
+            return TerminalCommandHandlerReturnType::SUCCESS;
+        }
 
         else if (commandArgs[1] == "animation")
         {
@@ -1567,6 +2094,13 @@ void CherrySim::RegisterTerminalPrintListener(TerminalPrintListener* callback)
 //Called for all terminal output from all nodes
 void CherrySim::TerminalPrintHandler(const char* message)
 {
+    //The listeners are not thread safe, output of workers is forwarded once all nodes are done
+    if (nodeWorkerContext)
+    {
+        RunOrDefer([this, output = std::string(message)]() { TerminalPrintHandler(output.c_str()); });
+        return;
+    }
+
     if (simConfig.useLogAccumulator)
     {
         logAccumulator += std::string(message);
@@ -1748,6 +2282,10 @@ void CherrySim::InitNode(u32 i)
     nodes[i].index = i;
     nodes[i].id = i + 1;
 
+    //Every node gets its own random number stream for parallel stepping. It is derived from the seed
+    //without drawing from simState.rnd so that sequential simulations are not influenced.
+    nodes[i].rnd.SetSeed(simConfig.seed ^ ((i + 1) * 0x9E3779B9UL));
+
     //Initialize FICR memory
     CheckedMemset(&nodes[i].ficr, 0xFF, sizeof(nodes[i].ficr));
 
@@ -1755,7 +2293,8 @@ void CherrySim::InitNode(u32 i)
     CheckedMemset(&nodes[i].uicr, 0xFF, sizeof(nodes[i].uicr));
 
     //Initialize flash memory
-    CheckedMemset(nodes[i].flash, 0xFF, sizeof(nodes[i].flash));
+    nodes[i].flash = sparseFlash.GetFlash(i);
+    sparseFlash.EraseFlash(i);
     //TODO: We could load a softdevice and app image into flash, would that help for something?
 
     //Generate device address based on the id
@@ -1881,6 +2420,7 @@ void CherrySim::FlashNode(u32 i) {
     //Put some data where the bootloader is supposed to be (add a version number)
     //TODO: Having a hardcoded 1024 is not a nice thing to do to give the offset of the bootloader version
     *((u32*)&nodes[i].flash[currentNode->uicr.BOOTLOADERADDR + 1024]) = 123;
+    MarkFlashWritten((u32)&nodes[i].flash[currentNode->uicr.BOOTLOADERADDR + 1024], sizeof(u32));
 
     //TODO: Add app, softdevice, etc,... from .hex files into flash
     //Afterwards, we can use the normal size calculation for addresses without redefining it
@@ -1938,8 +2478,7 @@ void CherrySim::BootCurrentNode()
     CheckedMemset(simGpioPtr, 0x00, sizeof(NRF_GPIO_Type));
 
     //Create a queue for events    if (simGlobalStatePtr != nullptr) {
-    currentNode->eventQueue.~deque();
-    new (&(currentNode->eventQueue)) std::queue<simBleEvent>();
+    currentNode->eventQueue.Clear();
 
     //Set the Ble stack parameters in the node so that we can use them later
     SetBleStack(currentNode);
@@ -1973,11 +2512,12 @@ void CherrySim::BootCurrentNode()
 
 void CherrySim::ErasePage(u32 pageAddress)
 {
-    u32* p = (u32*)pageAddress;
+    sparseFlash.Erase((u8*)pageAddress, FruityHal::GetCodePageSize());
+}
 
-    for (u32 i = 0; i < FruityHal::GetCodePageSize() / sizeof(u32); i++) {
-        p[i] = 0xFFFFFFFF;
-    }
+void CherrySim::MarkFlashWritten(u32 address, u32 size)
+{
+    sparseFlash.MarkWritten((const u8*)address, size);
 }
 
 void CherrySim::WriteRecordToFlash(u16 recordId, u8* data, u16 dataLength) {
@@ -2010,6 +2550,7 @@ void CherrySim::WriteRecordToFlash(u16 recordId, u8* data, u16 dataLength) {
 
     //Put the record and data on the settings page in flash
     CheckedMemcpy(dest, record, recordLength);
+    MarkFlashWritten((u32)Utility::GetSettingsPageBaseAddress(), SIZEOF_RECORD_STORAGE_PAGE_HEADER + recordLength);
 }
 
 void CherrySim::ResetCurrentNode(RebootReason rebootReason, bool throwException) {
@@ -2101,8 +2642,11 @@ void CherrySim::SimulateBroadcast() {
     //Check for other nodes that are scanning and send them the events
     if (currentNode->state.advertisingActive) {
         if (ShouldSimIvTrigger(currentNode->state.advertisingIntervalMs)) {
+            //Only nodes in the surrounding cells of the spatial grid can be in range
+            spatialGrid.FindNodesInRange(currentNode->x, currentNode->y, currentNode->z, GetMaxReceptionRangeInMeters(currentNode), spatialGridQueryResult);
+
             //Distribute the event to all nodes in range
-            for (u32 i = 0; i < GetTotalNodes(); i++) {
+            for (u32 i : spatialGridQueryResult) {
                 if (i != currentNode->index) {
 
                     //If the other node is scanning
@@ -2110,24 +2654,20 @@ void CherrySim::SimulateBroadcast() {
                         //If the random value hits the probability, the event is sent
                         uint32_t probability = CalculateReceptionProbability(currentNode, &nodes[i]);
                         if (PSRNG(probability)) {
-                            simBleEvent s;
-                            s.globalId = simState.globalEventIdCounter++;
-                            s.bleEvent.header.evt_id = BLE_GAP_EVT_ADV_REPORT;
-                            s.bleEvent.header.evt_len = s.globalId;
-                            s.bleEvent.evt.gap_evt.conn_handle = BLE_CONN_HANDLE_INVALID;
-
-                            CheckedMemcpy(&s.bleEvent.evt.gap_evt.params.adv_report.data, &currentNode->state.advertisingData, currentNode->state.advertisingDataLength);
-                            s.bleEvent.evt.gap_evt.params.adv_report.dlen = currentNode->state.advertisingDataLength;
-                            CheckedMemset(&s.bleEvent.evt.gap_evt.params.adv_report.peer_addr, 0, sizeof(s.bleEvent.evt.gap_evt.params.adv_report.peer_addr));
-                            s.bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr_type = (u8)currentNode->address.addr_type;
-                            static_assert(sizeof(s.bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr) == sizeof(currentNode->address.addr), "See next line.");
-                            CheckedMemcpy(&s.bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr, &currentNode->address.addr, sizeof(currentNode->address.addr));
+                            //The event is built in place in the queue of the receiver
+                            ble_evt_t& bleEvent = nodes[i].eventQueue.EmplaceBack(GenerateGlobalEventId());
+                            bleEvent.header.evt_id = BLE_GAP_EVT_ADV_REPORT;
+                            bleEvent.evt.gap_evt.conn_handle = BLE_CONN_HANDLE_INVALID;
+
+                            CheckedMemcpy(&bleEvent.evt.gap_evt.params.adv_report.data, &currentNode->state.advertisingData, currentNode->state.advertisingDataLength);
+                            bleEvent.evt.gap_evt.params.adv_report.dlen = currentNode->state.advertisingDataLength;
+                            bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr_type = (u8)currentNode->address.addr_type;
+                            static_assert(sizeof(bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr) == sizeof(currentNode->address.addr), "See next line.");
+                            CheckedMemcpy(&bleEvent.evt.gap_evt.params.adv_report.peer_addr.addr, &currentNode->address.addr, sizeof(currentNode->address.addr));
                             //TODO: bleEvent.evt.gap_evt.params.adv_report.peer_addr = ...;
-                            s.bleEvent.evt.gap_evt.params.adv_report.rssi = (i8)GetReceptionRssi(currentNode, &nodes[i]);
-                            s.bleEvent.evt.gap_evt.params.adv_report.scan_rsp = 0;
-                            s.bleEvent.evt.gap_evt.params.adv_report.type = (u8)currentNode->state.advertisingType;
-
-                            nodes[i].eventQueue.push_back(s);
+                            bleEvent.evt.gap_evt.params.adv_report.rssi = (i8)GetReceptionRssi(currentNode, &nodes[i]);
+                            bleEvent.evt.gap_evt.params.adv_report.scan_rsp = 0;
+                            bleEvent.evt.gap_evt.params.adv_report.type = (u8)currentNode->state.advertisingType;
                         }
                     }
                     //If the other node is connecting
@@ -2239,7 +2779,7 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     //Generate an event for the current node
     simBleEvent s2;
     CheckedMemset(&s2, 0, sizeof(s2));
-    s2.globalId = simState.globalEventIdCounter++;
+    s2.globalId = GenerateGlobalEventId();
     s2.bleEvent.header.evt_id = BLE_GAP_EVT_CONNECTED;
     s2.bleEvent.header.evt_len = s2.globalId;
     s2.bleEvent.evt.gap_evt.conn_handle = simState.globalConnHandleCounter;
@@ -2249,7 +2789,7 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     s2.bleEvent.evt.gap_evt.params.connected.peer_addr = Convert(&master->address);
     s2.bleEvent.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_PERIPH;
 
-    slave->eventQueue.push_back(s2);
+    slave->eventQueue.PushBack(s2);
 
     //###### Remote node
 
@@ -2297,7 +2837,7 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     //Generate an event for the remote node
     simBleEvent s;
     CheckedMemset(&s, 0, sizeof(s));
-    s.globalId = simState.globalEventIdCounter++;
+    s.globalId = GenerateGlobalEventId();
     s.bleEvent.header.evt_id = BLE_GAP_EVT_CONNECTED;
     s.bleEvent.header.evt_len = s.globalId;
     s.bleEvent.evt.gap_evt.conn_handle = simState.globalConnHandleCounter;
@@ -2307,7 +2847,7 @@ void CherrySim::ConnectMasterToSlave(NodeEntry* master, NodeEntry* slave)
     s.bleEvent.evt.gap_evt.params.connected.peer_addr = Convert(&slave->address);
     s.bleEvent.evt.gap_evt.params.connected.role = BLE_GAP_ROLE_CENTRAL;
 
-    master->eventQueue.push_back(s);
+    master->eventQueue.PushBack(s);
 
     //Disable connecting for the other node because we just got the remote SoftDevice a connection
     master->state.connectingActive = false;
@@ -2343,35 +2883,40 @@ u32 CherrySim::DisconnectSimulatorConnection(SoftdeviceConnection* connection, u
         SIMEXCEPTIONFORCE(IllegalStateException);
     }
 
-    //Clear the transmitbuffers for both nodes
+    //#### Our own node
+    //Clear the transmitbuffers
     CheckedMemset(connection->reliableBuffers, 0x00, sizeof(connection->reliableBuffers));
     CheckedMemset(connection->unreliableBuffers, 0x00, sizeof(connection->unreliableBuffers));
-    CheckedMemset(partnerConnection->reliableBuffers, 0x00, sizeof(connection->reliableBuffers));
-    CheckedMemset(partnerConnection->unreliableBuffers, 0x00, sizeof(connection->unreliableBuffers));
-
-    //#### Our own node
     connection->connectionActive = false;
 
     simBleEvent s1;
     CheckedMemset(&s1, 0, sizeof(s1));
-    s1.globalId = simState.globalEventIdCounter++;
+    s1.globalId = GenerateGlobalEventId();
     s1.bleEvent.header.evt_id = BLE_GAP_EVT_DISCONNECTED;
     s1.bleEvent.header.evt_len = s1.globalId;
     s1.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
     s1.bleEvent.evt.gap_evt.params.disconnected.reason = hciReason;
-    connection->owningNode->eventQueue.push_back(s1);
+    connection->owningNode->eventQueue.PushBack(s1);
 
     //#### Remote node
-    partnerConnection->connectionActive = false;
+    //If the partner terminated the same connection in the meantime, it already knows about it
+    const u16 connectionHandle = connection->connectionHandle;
+    RunOrDefer([this, partnerNode, partnerConnection, connectionHandle, hciReasonPartner]() {
+        if (!partnerConnection->connectionActive || partnerConnection->connectionHandle != connectionHandle) return;
 
-    simBleEvent s2;
-    CheckedMemset(&s2, 0, sizeof(s2));
-    s2.globalId = simState.globalEventIdCounter++;
-    s2.bleEvent.header.evt_id = BLE_GAP_EVT_DISCONNECTED;
-    s2.bleEvent.header.evt_len = s2.globalId;
-    s2.bleEvent.evt.gap_evt.conn_handle = partnerConnection->connectionHandle;
-    s2.bleEvent.evt.gap_evt.params.disconnected.reason = hciReasonPartner;
-    partnerNode->eventQueue.push_back(s2);
+        CheckedMemset(partnerConnection->reliableBuffers, 0x00, sizeof(partnerConnection->reliableBuffers));
+        CheckedMemset(partnerConnection->unreliableBuffers, 0x00, sizeof(partnerConnection->unreliableBuffers));
+        partnerConnection->connectionActive = false;
+
+        simBleEvent s2;
+        CheckedMemset(&s2, 0, sizeof(s2));
+        s2.globalId = GenerateGlobalEventId();
+        s2.bleEvent.header.evt_id = BLE_GAP_EVT_DISCONNECTED;
+        s2.bleEvent.header.evt_len = s2.globalId;
+        s2.bleEvent.evt.gap_evt.conn_handle = partnerConnection->connectionHandle;
+        s2.bleEvent.evt.gap_evt.params.disconnected.reason = hciReasonPartner;
+        partnerNode->eventQueue.PushBack(s2);
+    });
 
     return NRF_SUCCESS;
 }
@@ -2380,15 +2925,10 @@ void CherrySim::SimulateTimeouts() {
     if (currentNode->state.connectingActive && currentNode->state.connectingTimeoutTimestampMs <= (i32)simState.simTimeMs) {
         currentNode->state.connectingActive = false;
 
-        simBleEvent s;
-        CheckedMemset(&s, 0, sizeof(s));
-        s.globalId = simState.globalEventIdCounter++;
-        s.bleEvent.header.evt_id = BLE_GAP_EVT_TIMEOUT;
-        s.bleEvent.header.evt_len = s.globalId;
-        s.bleEvent.evt.gap_evt.conn_handle = BLE_CONN_HANDLE_INVALID;
-        s.bleEvent.evt.gap_evt.params.timeout.src = BLE_GAP_TIMEOUT_SRC_CONN;
-
-        currentNode->eventQueue.push_back(s);
+        ble_evt_t& bleEvent = currentNode->eventQueue.EmplaceBack(GenerateGlobalEventId());
+        bleEvent.header.evt_id = BLE_GAP_EVT_TIMEOUT;
+        bleEvent.evt.gap_evt.conn_handle = BLE_CONN_HANDLE_INVALID;
+        bleEvent.evt.gap_evt.params.timeout.src = BLE_GAP_TIMEOUT_SRC_CONN;
     }
 }
 
@@ -2450,15 +2990,10 @@ SoftDeviceBufferedPacket* getNextPacketToWrite(SoftdeviceConnection* connection)
 void CherrySim::SendUnreliableTxCompleteEvent(NodeEntry* node, int connHandle, u8 packetCount)
 {
     if (packetCount > 0) {
-        simBleEvent s2;
-        CheckedMemset(&s2, 0, sizeof(s2));
-        s2.globalId = simState.globalEventIdCounter++;
-        s2.bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE;
-        s2.bleEvent.header.evt_len = s2.globalId;
-        s2.bleEvent.evt.gattc_evt.conn_handle = connHandle;
-        s2.bleEvent.evt.gattc_evt.params.write_cmd_tx_complete.count = packetCount;
-
-        node->eventQueue.push_back(s2);
+        ble_evt_t& bleEvent = node->eventQueue.EmplaceBack(GenerateGlobalEventId());
+        bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE;
+        bleEvent.evt.gattc_evt.conn_handle = connHandle;
+        bleEvent.evt.gattc_evt.params.write_cmd_tx_complete.count = packetCount;
     }
 }
 
@@ -2567,16 +3102,11 @@ void CherrySim::SimulateConnections() {
 
                         //Generate the event that the write was successful immediately
                         //TODO: Could be postponed a bit to better match the real world
-                        simBleEvent s2;
-                        CheckedMemset(&s2, 0, sizeof(s2));
-                        s2.globalId = simState.globalEventIdCounter++;
-                        s2.bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_RSP;
-                        s2.bleEvent.header.evt_len = s2.globalId;
-                        s2.bleEvent.evt.gattc_evt.conn_handle = connection->connectionHandle;
-                        s2.bleEvent.evt.gattc_evt.gatt_status = (u16)FruityHal::BleGattEror::SUCCESS;
                         //Save the global packet id so that we can track where a packet was generated after we receive it
-                        s2.additionalInfo = packet->globalPacketId;
-                        currentNode->eventQueue.push_back(s2);
+                        ble_evt_t& bleEvent = currentNode->eventQueue.EmplaceBack(GenerateGlobalEventId(), packet->globalPacketId);
+                        bleEvent.header.evt_id = BLE_GATTC_EVT_WRITE_RSP;
+                        bleEvent.evt.gattc_evt.conn_handle = connection->connectionHandle;
+                        bleEvent.evt.gattc_evt.gatt_status = (u16)FruityHal::BleGattEror::SUCCESS;
 
 
 
@@ -2602,15 +3132,10 @@ void CherrySim::SimulateConnections() {
                 NodeEntry* master = i == 0 ? connection->partner : currentNode;
                 NodeEntry* slave = i == 0 ? currentNode : connection->partner;
 
-                simBleEvent s;
-                CheckedMemset(&s, 0, sizeof(s));
-                s.globalId = simState.globalEventIdCounter++;
-                s.bleEvent.header.evt_id = BLE_GAP_EVT_RSSI_CHANGED;
-                s.bleEvent.header.evt_len = s.globalId;
-                s.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
-                s.bleEvent.evt.gap_evt.params.rssi_changed.rssi = (i8)GetReceptionRssi(master, slave);
-
-                currentNode->eventQueue.push_back(s);
+                ble_evt_t& bleEvent = currentNode->eventQueue.EmplaceBack(GenerateGlobalEventId());
+                bleEvent.header.evt_id = BLE_GAP_EVT_RSSI_CHANGED;
+                bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
+                bleEvent.evt.gap_evt.params.rssi_changed.rssi = (i8)GetReceptionRssi(master, slave);
             }
         }
     }
@@ -2651,18 +3176,6 @@ void CherrySim::GenerateWrite(SoftDeviceBufferedPacket* bufferedPacket) {
         printf("%s" EOL, j.dump().c_str());
     }
 
-    //Generate WRITE event at our partners side
-    simBleEvent s;
-    s.globalId = simState.globalEventIdCounter++;
-    s.bleEvent.header.evt_id = BLE_GATTS_EVT_WRITE;
-    s.bleEvent.header.evt_len = s.globalId;
-
-    //Save the global packet id so that we can track where a packet was generated after we receive it
-    s.additionalInfo = bufferedPacket->globalPacketId;
-
-    //Generate write event in partners event queue
-    s.bleEvent.evt.gatts_evt.conn_handle = conn_handle;
-
 #ifdef SIM_ENABLED
     //If we are dealing with a non mesh access connection, we can check if the message type is invalid and throw an error
     BaseConnection *bc = GS->cm.GetRawConnectionFromHandle(conn_handle);
@@ -2681,13 +3194,17 @@ void CherrySim::GenerateWrite(SoftDeviceBufferedPacket* bufferedPacket) {
     }
 #endif
 
-    CheckedMemcpy(&s.bleEvent.evt.gatts_evt.params.write.data, p_write_params.p_value, p_write_params.len);
-    s.bleEvent.evt.gatts_evt.params.write.handle = p_write_params.handle;
-    s.bleEvent.evt.gatts_evt.params.write.len = p_write_params.len;
-    s.bleEvent.evt.gatts_evt.params.write.offset = 0;
-    s.bleEvent.evt.gatts_evt.params.write.op = p_write_params.write_op;
+    //Generate WRITE event in place in our partners event queue
+    //Save the global packet id so that we can track where a packet was generated after we receive it
+    ble_evt_t& bleEvent = receiver->eventQueue.EmplaceBack(GenerateGlobalEventId(), bufferedPacket->globalPacketId, sizeof(ble_evt_t) + p_write_params.len);
+    bleEvent.header.evt_id = BLE_GATTS_EVT_WRITE;
+    bleEvent.evt.gatts_evt.conn_handle = conn_handle;
 
-    receiver->eventQueue.push_back(s);
+    CheckedMemcpy(&bleEvent.evt.gatts_evt.params.write.data, p_write_params.p_value, p_write_params.len);
+    bleEvent.evt.gatts_evt.params.write.handle = p_write_params.handle;
+    bleEvent.evt.gatts_evt.params.write.len = p_write_params.len;
+    bleEvent.evt.gatts_evt.params.write.offset = 0;
+    bleEvent.evt.gatts_evt.params.write.op = p_write_params.write_op;
 }
 
 void CherrySim::GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket) {
@@ -2711,22 +3228,18 @@ void CherrySim::GenerateNotification(SoftDeviceBufferedPacket* bufferedPacket) {
         printf("%s" EOL, j.dump().c_str());
     }
 
-    //Generate HVX event at our partners side
-    simBleEvent s;
-    s.globalId = simState.globalEventIdCounter++;
-    s.bleEvent.header.evt_id = BLE_GATTC_EVT_HVX;
-    s.bleEvent.header.evt_len = s.globalId;
-    s.bleEvent.evt.gattc_evt.conn_handle = conn_handle;
-
+    //Generate HVX event in place at our partners side
     //jstodo check this workaround again.
     // This is a workaround for hvxParams keeping only pointer to len.
-    CheckedMemcpy(&s.bleEvent.evt.gattc_evt.params.hvx.data, hvx_params.p_data, (u32)hvx_params.p_len);
-    s.bleEvent.evt.gattc_evt.params.hvx.handle = hvx_params.handle;
-    // This is a workaround for hvxParams keeping only pointer to len.
-    s.bleEvent.evt.gattc_evt.params.hvx.len = (u16)(u32)hvx_params.p_len;
-    s.bleEvent.evt.gattc_evt.params.hvx.type = hvx_params.type;
+    const u16 len = (u16)(u32)hvx_params.p_len;
+    ble_evt_t& bleEvent = receiver->eventQueue.EmplaceBack(GenerateGlobalEventId(), 0, sizeof(ble_evt_t) + len);
+    bleEvent.header.evt_id = BLE_GATTC_EVT_HVX;
+    bleEvent.evt.gattc_evt.conn_handle = conn_handle;
 
-    receiver->eventQueue.push_back(s);
+    CheckedMemcpy(&bleEvent.evt.gattc_evt.params.hvx.data, hvx_params.p_data, len);
+    bleEvent.evt.gattc_evt.params.hvx.handle = hvx_params.handle;
+    bleEvent.evt.gattc_evt.params.hvx.len = len;
+    bleEvent.evt.gattc_evt.params.hvx.type = hvx_params.type;
 }
 
 void CherrySim::StartServiceDiscovery(u16 connHandle, const ble_uuid_t &p_uuid, int discoveryTimeMs)
@@ -3017,7 +3530,7 @@ void CherrySim::SimulateConnectionParameterUpdateRequestTimeout()
         const auto & peripheralConnection = *connection.partnerConnection;
 
         simBleEvent simEvent = {};
-        simEvent.globalId = cherrySimInstance->simState.globalEventIdCounter++;
+        simEvent.globalId = cherrySimInstance->GenerateGlobalEventId();
 
         auto & bleEvent = simEvent.bleEvent;
         bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE;
@@ -3030,7 +3543,7 @@ void CherrySim::SimulateConnectionParameterUpdateRequestTimeout()
         connParams.slave_latency = Conf::meshPeripheralSlaveLatency;
         connParams.conn_sup_timeout = Conf::meshConnectionSupervisionTimeout;
 
-        peripheral.eventQueue.push_back(simEvent);
+        peripheral.eventQueue.PushBack(simEvent);
     }
 }
 
@@ -3064,7 +3577,7 @@ struct InterruptGuard
 {
     //Protects us against interrupting inside an interrupt using RAII.
 
-    static inline bool currentlyInAnInterrupt = false;
+    static inline thread_local bool currentlyInAnInterrupt = false;
 
     InterruptGuard() {
         currentlyInAnInterrupt = true;
@@ -3244,17 +3757,17 @@ void CherrySim::CheckMeshingConsistency()
     {
         NodeEntry* node = &nodes[i];
 
-        for (u32 k = 0; k < node->eventQueue.size(); k++)
+        for (u32 k = 0; k < node->eventQueue.GetAmountOfEvents(); k++)
         {
-            simBleEvent bleEvent = node->eventQueue[k];
-            if (bleEvent.bleEvent.header.evt_id == BLE_GATTS_EVT_WRITE) {
-                ble_gatts_evt_t* gattsEvt = (ble_gatts_evt_t*)&bleEvent.bleEvent.evt;
+            const ble_evt_t& bleEvent = node->eventQueue.GetEvent(k);
+            if (bleEvent.header.evt_id == BLE_GATTS_EVT_WRITE) {
+                const ble_gatts_evt_t* gattsEvt = &bleEvent.evt.gatts_evt;
 
-                ConnPacketHeader* header = (ConnPacketHeader*)gattsEvt->params.write.data;
+                const ConnPacketHeader* header = (const ConnPacketHeader*)gattsEvt->params.write.data;
 
                 if (header->messageType == MessageType::CLUSTER_INFO_UPDATE)
                 {
-                    ConnPacketClusterInfoUpdate* packet = (ConnPacketClusterInfoUpdate*)header;
+                    const ConnPacketClusterInfoUpdate* packet = (const ConnPacketClusterInfoUpdate*)header;
 
                     BaseConnection* bc = node->gs.cm.GetRawConnectionFromHandle(gattsEvt->conn_handle);
 
@@ -3275,19 +3788,32 @@ void CherrySim::CheckMeshingConsistency()
         }
     }
 
+    //Group the nodes into clusters so that regular clusters can be handled in a single pass instead of
+    //a recursion from each of their nodes, which took quadratic time in the cluster size
+    BuildMeshComponents(numNoneAssetNodes);
+
     //Go through all nodes and its connections and recursively propagate the clusterUpdates
     for (u32 i = 0; i < numNoneAssetNodes; i++)
     {
-        NodeEntry* node = &nodes[i];
-        DetermineClusterSizeAndPropagateClusterUpdates(node, nullptr);
-
+        const u32 root = meshComponents.Find(i);
+        if (!regularMeshComponents[root])
+        {
+            NodeEntry* node = &nodes[i];
+            DetermineClusterSizeAndPropagateClusterUpdates(node, nullptr);
+        }
+        else if (root == i)
+        {
+            PropagateClusterUpdatesAlongTree(i);
+        }
     }
 
     //For each cluster, calculate the totals for each node and check if they match with the clusterSize
     for (u32 i = 0; i < numNoneAssetNodes; i++)
     {
         NodeEntry* node = &nodes[i];
-        ClusterSize realClusterSize = DetermineClusterSizeAndPropagateClusterUpdates(node, nullptr);
+        ClusterSize realClusterSize = regularMeshComponents[meshComponents.Find(i)]
+            ? (ClusterSize)meshComponents.GetComponentSize(i)
+            : DetermineClusterSizeAndPropagateClusterUpdates(node, nullptr);
 
         if (realClusterSize != node->state.validityClusterSize) {
             printf("NODE %d has a real cluster size of %d and predicted size of %d, reported cluster size %d" EOL, node->id, realClusterSize, node->state.validityClusterSize, nodes[i].gs.node.GetClusterSize());
@@ -3333,6 +3859,134 @@ MeshConnectionBond findBond(NodeEntry* startNode, NodeEntry* partnerNode)
     return bond;
 }
 
+//Collects the handshaked MeshConnections of all nodes and unites the nodes along them. A component is
+//regular if its connections form a tree in which every connection has exactly one handshaked counterpart
+//on the partner. For these, the recursive propagation from every node has the same outcome as
+//PropagateClusterUpdatesAlongTree. All other components (e.g. while one side has already dropped its
+//connection) still use DetermineClusterSizeAndPropagateClusterUpdates.
+void CherrySim::BuildMeshComponents(u32 amountOfNodes)
+{
+    std::unordered_map<NodeId, u32> nodeIndices;
+    nodeIndices.reserve(GetTotalNodes());
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        //Same as FindNodeById, the first node with an id wins
+        nodeIndices.emplace(nodes[i].id, i);
+    }
+
+    meshComponents.Reset(amountOfNodes);
+    clusterLinks.resize(amountOfNodes);
+    std::vector<u32> irregularNodes;
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        clusterLinks[i].clear();
+        MeshConnections conns = nodes[i].gs.cm.GetMeshConnections(ConnectionDirection::INVALID);
+        for (int k = 0; k < conns.count; k++)
+        {
+            MeshConnection* conn = conns.handles[k].GetConnection();
+            if (!conn->HandshakeDone()) continue;
+
+            auto entry = nodeIndices.find(conn->partnerId);
+            if (entry == nodeIndices.end() || entry->second >= amountOfNodes || entry->second == i)
+            {
+                irregularNodes.push_back(i);
+                continue;
+            }
+            clusterLinks[i].push_back({ conn, entry->second });
+            meshComponents.Union(i, entry->second);
+        }
+    }
+
+    //Check that each link has a single counterpart on the partner
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        for (size_t k = 0; k < clusterLinks[i].size(); k++)
+        {
+            const u32 partnerIndex = clusterLinks[i][k].partnerIndex;
+            u32 linksToPartner = 0;
+            for (const ClusterLink& link : clusterLinks[i]) if (link.partnerIndex == partnerIndex) linksToPartner++;
+            u32 linksFromPartner = 0;
+            for (const ClusterLink& link : clusterLinks[partnerIndex]) if (link.partnerIndex == i) linksFromPartner++;
+
+            if (linksToPartner != 1 || linksFromPartner != 1)
+            {
+                irregularNodes.push_back(i);
+                break;
+            }
+        }
+    }
+
+    //Each undirected link of a tree is counted once from every side
+    regularMeshComponents.assign(amountOfNodes, false);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        if (meshComponents.Find(i) == i)
+        {
+            regularMeshComponents[i] = meshComponents.GetAmountOfLinks(i) == 2 * (meshComponents.GetComponentSize(i) - 1);
+        }
+    }
+    for (u32 nodeIndex : irregularNodes)
+    {
+        regularMeshComponents[meshComponents.Find(nodeIndex)] = false;
+    }
+}
+
+//Applies the pending cluster updates of a regular component in a single traversal. An update that is
+//pending from node A towards node B ends up at every node that is reached from B without passing A. Rooting
+//the tree at rootIndex, a node therefore receives all updates sent downwards along its path from the root plus
+//all updates sent upwards in the whole component, except for those sent upwards along its own path.
+void CherrySim::PropagateClusterUpdatesAlongTree(u32 rootIndex)
+{
+    clusterUpdatesFromRoot.resize(clusterLinks.size());
+    clusterUpdatesToRoot.resize(clusterLinks.size());
+
+    std::vector<std::pair<u32, u32>> stack; //Node index and index of the parent
+    std::vector<u32> visitedNodes;
+    i32 allUpdatesToRoot = 0;
+
+    clusterUpdatesFromRoot[rootIndex] = 0;
+    clusterUpdatesToRoot[rootIndex] = 0;
+    stack.push_back({ rootIndex, rootIndex });
+    while (!stack.empty())
+    {
+        const u32 nodeIndex = stack.back().first;
+        const u32 parentIndex = stack.back().second;
+        stack.pop_back();
+        visitedNodes.push_back(nodeIndex);
+
+        for (const ClusterLink& link : clusterLinks[nodeIndex])
+        {
+            const u32 childIndex = link.partnerIndex;
+            if (childIndex == parentIndex && nodeIndex != rootIndex) continue;
+
+            MeshConnection* downConnection = link.connection;
+            MeshConnection* upConnection = nullptr;
+            for (const ClusterLink& childLink : clusterLinks[childIndex])
+            {
+                if (childLink.partnerIndex == nodeIndex) upConnection = childLink.connection;
+            }
+
+            const i32 updatesDown = downConnection->validityClusterUpdatesToSend + upConnection->validityClusterUpdatesReceived;
+            const i32 updatesUp = upConnection->validityClusterUpdatesToSend + downConnection->validityClusterUpdatesReceived;
+            downConnection->validityClusterUpdatesToSend = 0;
+            downConnection->validityClusterUpdatesReceived = 0;
+            upConnection->validityClusterUpdatesToSend = 0;
+            upConnection->validityClusterUpdatesReceived = 0;
+
+            clusterUpdatesFromRoot[childIndex] = clusterUpdatesFromRoot[nodeIndex] + updatesDown;
+            clusterUpdatesToRoot[childIndex] = clusterUpdatesToRoot[nodeIndex] + updatesUp;
+            allUpdatesToRoot += updatesUp;
+
+            stack.push_back({ childIndex, nodeIndex });
+        }
+    }
+
+    for (u32 nodeIndex : visitedNodes)
+    {
+        nodes[nodeIndex].state.validityClusterSize += (ClusterSize)(clusterUpdatesFromRoot[nodeIndex] + allUpdatesToRoot - clusterUpdatesToRoot[nodeIndex]);
+    }
+}
+
 //This will recursively go along all connections and add up the nodes in this cluster
 //It will also propagate the cluster size changes along the route
 ClusterSize CherrySim::DetermineClusterSizeAndPropagateClusterUpdates(NodeEntry* node, NodeEntry* startNode)
@@ -3484,14 +4138,16 @@ void CherrySim::SetBleStack(NodeEntry* node)
 bool CherrySim::IsClusteringDone()
 {
     u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
-    std::set<ClusterId> clusterIds;
+    if (numNoneAssetNodes == 0) return false;
+
+    //All nodes must share the clusterId of the first node, so a single pass without any allocation suffices
+    const ClusterId clusterId = nodes[0].gs.node.clusterId;
     for (u32 i = 0; i < numNoneAssetNodes; i++) {
-        clusterIds.insert(nodes[i].gs.node.clusterId);
-        if ((u32)nodes[i].gs.node.GetClusterSize() != numNoneAssetNodes) {
+        if (nodes[i].gs.node.clusterId != clusterId || (u32)nodes[i].gs.node.GetClusterSize() != numNoneAssetNodes) {
             return false;
         }
     }
-    return clusterIds.size() == 1;
+    return true;
 }
 
 struct ClusterNetworkPair {
@@ -3596,6 +4252,18 @@ float CherrySim::GetReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntr
 }
 
 float CherrySim::GetReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver, int8_t senderDbmTx, int8_t senderCalibratedTx) {
+    const i32 senderPower = senderDbmTx + senderCalibratedTx;
+    float rssi = 0;
+    if (linkBudgetCache.TryGet(sender->index, receiver->index, senderPower, rssi))
+    {
+        return rssi;
+    }
+    rssi = CalculateReceptionRssiNoNoise(sender, receiver, senderDbmTx, senderCalibratedTx);
+    linkBudgetCache.Store(sender->index, receiver->index, senderPower, rssi);
+    return rssi;
+}
+
+float CherrySim::CalculateReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver, int8_t senderDbmTx, int8_t senderCalibratedTx) {
     // If either the sender or the receiver has the other marked as as a impossibleConnection, the rssi is set to a unconnectable level.
     if (sender->impossibleConnection.size() > 0
         || receiver->impossibleConnection.size() > 0)
@@ -3618,10 +4286,17 @@ uint32_t CherrySim::CalculateReceptionProbability(const NodeEntry* sendingNode,
          if (rssi > -60) return simConfig.receptionProbabilityVeryClose;
     else if (rssi > -80) return simConfig.receptionProbabilityClose;
     else if (rssi > -85) return simConfig.receptionProbabilityFar;
-    else if (rssi > -90) return simConfig.receptionProbabilityVeryFar;
+    else if (rssi > minReceivableRssi) return simConfig.receptionProbabilityVeryFar;
     else return 0;
 }
 
+//Returns the distance after which CalculateReceptionProbability will always return 0 for packets of this sender
+float CherrySim::GetMaxReceptionRangeInMeters(const NodeEntry* sender) {
+    const int senderPower = sender->gs.boardconf.configuration.calibratedTX + Conf::defaultDBmTX;
+    //Rssi noise only ever lowers the rssi, a small margin is added to be safe against rounding
+    return RssiToDistance((int)minReceivableRssi, senderPower) * 1.01f + 0.01f;
+}
+
 SoftdeviceConnection* CherrySim::FindConnectionByHandle(NodeEntry* node, int connectionHandle) {
     for (u32 i = 0; i < node->state.configuredTotalConnectionCount; i++) {
         if (node->state.connections[i].connectionActive && node->state.connections[i].connectionHandle == connectionHandle) {
@@ -3679,6 +4354,9 @@ void CherrySim::SetPosition(u32 nodeIndex, float x, float y, float z)
         nodes[nodeIndex].y = y;
         nodes[nodeIndex].z = z;
         nodes[nodeIndex].lastMovementSimTimeMs = simState.simTimeMs;
+        spatialGrid.UpdateNode(nodeIndex, x, y, z);
+        linkBudgetCache.InvalidateNode(nodeIndex);
+        NotifyMapStateChanged(nodeIndex);
     }
 }
 
@@ -3690,40 +4368,56 @@ void CherrySim::AddPosition(u32 nodeIndex, float x, float y, float z)
         nodes[nodeIndex].y += y;
         nodes[nodeIndex].z += z;
         nodes[nodeIndex].lastMovementSimTimeMs = simState.simTimeMs;
+        spatialGrid.UpdateNode(nodeIndex, nodes[nodeIndex].x, nodes[nodeIndex].y, nodes[nodeIndex].z);
+        linkBudgetCache.InvalidateNode(nodeIndex);
+        NotifyMapStateChanged(nodeIndex);
     }
 }
 
-
-void CherrySim::AddPacketToStats(PacketStat* statArray, PacketStat* packet)
+void CherrySim::RebuildSpatialGrid()
 {
-    if (!simConfig.enableSimStatistics) return;
-    if (packet->messageType == MessageType::INVALID) return;
+    //Cells are as big as the reception range of a node with default settings so that usually only the neighbouring cells must be checked
+    const float cellSize = RssiToDistance((int)minReceivableRssi, SIMULATOR_NODE_DEFAULT_CALIBRATED_TX + SIMULATOR_NODE_DEFAULT_DBM_TX);
+    spatialGrid.Reset(cellSize, simConfig.mapWidthInMeters, simConfig.mapHeightInMeters, simConfig.mapElevationInMeters, GetTotalNodes());
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        spatialGrid.UpdateNode(i, nodes[i].x, nodes[i].y, nodes[i].z);
+        NotifyMapStateChanged(i);
+    }
+    linkBudgetCache.InvalidateAll();
+}
 
-    //Check if we can add it to a previous entry
-    PacketStat* emptySlot = nullptr;
-    for (u32 i = 0; i < PACKET_STAT_SIZE; i++) {
-        PacketStat* entry = statArray + i;
+void CherrySim::NotifyMapStateChanged(u32 nodeIndex)
+{
+    //Only the first notification until the next publish has to reach the feed
+    if (mapChangeFeed.MarkNodePending(nodeIndex))
+    {
+        RunOrDefer([this, nodeIndex]() {
+            mapChangeFeed.EnqueuePendingNode(nodeIndex);
+        });
+    }
+}
 
-        if (memcmp(packet, entry, packetStatCompareBytes) == 0) {
-            entry->count += packet->count;
-            return;
-        }
+void CherrySim::AddImpossibleConnection(u32 nodeIndex, u32 otherNodeIndex)
+{
+    nodes[nodeIndex].impossibleConnection.push_back(otherNodeIndex);
+    linkBudgetCache.InvalidateNode(nodeIndex);
+    linkBudgetCache.InvalidateNode(otherNodeIndex);
+}
 
-        if (!emptySlot && entry->messageType == MessageType::INVALID) emptySlot = entry;
-    }
 
-    //If we did not yet return, we have not found an empty slot
-    //If we do not have an empty slot for logging, we should increase our PacketStat array size or check if sth. went wrong
-    if (!emptySlot) SIMEXCEPTIONFORCE(PacketStatBufferSizeNotEnough);
+void CherrySim::AddPacketToStats(PacketStatTable& statTable, const PacketStat& packet)
+{
+    if (!simConfig.enableSimStatistics) return;
 
-    *emptySlot = *packet;
+    statTable.Add(packet);
 }
 
 //Allows us to put a packet into the packet statistics. It will count all similar packets in slots depending on the messageType
-//Given stat array has to be of size PACKET_STAT_SIZE
+//The packet is also counted in the given global table that sums up the statistics of all nodes
 //TODO: This must only be called for unencrypted connections that send mesh-compatible packets
 //TODO: Should also be used to check what kind of messages a node generates
-void CherrySim::AddMessageToStats(PacketStat* statArray, u8* message, u16 messageLength)
+void CherrySim::AddMessageToStats(PacketStatTable& statTable, PacketStatTable& globalStatTable, u8* message, u16 messageLength)
 {
     if (!simConfig.enableSimStatistics) return;
 
@@ -3733,6 +4427,19 @@ void CherrySim::AddMessageToStats(PacketStat* statArray, u8* message, u16 messag
 
     PacketStat packet;
 
+    //An aggregated write is counted as each of the messages it carries
+    if (splitHeader->splitMessageType == MessageType::AGGREGATED_WRITE_CMD) {
+        u16 position = SIZEOF_CONN_PACKET_AGGREGATE_HEADER;
+        while (position + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER <= messageLength) {
+            const u8 length = ((ConnPacketAggregateEntryHeader*)(message + position))->messageLength;
+            position += SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER;
+            if (length < SIZEOF_CONN_PACKET_HEADER || position + length > messageLength) return;
+            AddMessageToStats(statTable, globalStatTable, message + position, length);
+            position += length;
+        }
+        return;
+    }
+
     //Check if it is the first part of a split message or not
     if (splitHeader->splitMessageType == MessageType::SPLIT_WRITE_CMD && splitHeader->splitCounter == 0) {
         packet.isSplit = true;
@@ -3760,57 +4467,81 @@ void CherrySim::AddMessageToStats(PacketStat* statArray, u8* message, u16 messag
         packet.requestHandle = moduleHeader->requestHandle;
     }
 
-    //Add the packet to our stat array
-    AddPacketToStats(statArray, &packet);
+    //Add the packet to our stat table, the global table is shared by all nodes
+    AddPacketToStats(statTable, packet);
+    RunOrDefer([this, &globalStatTable, packet]() { AddPacketToStats(globalStatTable, packet); });
 }
 
 void CherrySim::PrintPacketStats(NodeId nodeId, const char* statId)
 {
     if (!simConfig.enableSimStatistics) return;
 
-    PacketStat* stat = nullptr;
-    PacketStat sumStat[PACKET_STAT_SIZE];
-    u32 numNoneAssetNodes = GetTotalNodes() - GetAssetNodes();
-    //We must sum up all stat packets of all nodes to get a stat that covers all nodes
+    const PacketStatTable* stat = nullptr;
+    //The global tables already cover all nodes
     if (nodeId == 0) {
-        stat = sumStat;
-
-        for (u32 i = 0; i < numNoneAssetNodes; i++) {
-            for (u32 j = 0; j < PACKET_STAT_SIZE; j++) {
-                if (strcmp("SENT", statId) == 0) AddPacketToStats(sumStat, nodes[i].sentPackets + j);
-                if (strcmp("ROUTED", statId) == 0) AddPacketToStats(sumStat, nodes[i].routedPackets + j);
-            }
-        }
+        if (strcmp("SENT", statId) == 0) stat = &globalSentPackets;
+        if (strcmp("ROUTED", statId) == 0) stat = &globalRoutedPackets;
     }
     //We simply select the stat from the given nodeId
     else {
         NodeEntry* node = FindNodeById(nodeId);
-        if (strcmp("SENT", statId) == 0) stat = node->sentPackets;
-        if (strcmp("ROUTED", statId) == 0) stat = node->routedPackets;
+        if (strcmp("SENT", statId) == 0) stat = &node->sentPackets;
+        if (strcmp("ROUTED", statId) == 0) stat = &node->routedPackets;
     }
+    if (stat == nullptr) return;
 
     //Print everything
     printf(">----------------------------------------------------<" EOL);
     printf("Message statistics for packets %s on node %u" EOL, statId, nodeId);
     printf("" EOL);
 
-    for (u32 i = 0; i < PACKET_STAT_SIZE; i++)
+    for (const PacketStat& entry : stat->GetEntries())
     {
-        PacketStat* entry = stat + i;
-
-        if (entry->messageType != MessageType::INVALID) {
-            if (entry->messageType >= MessageType::MODULE_CONFIG && entry->messageType <= MessageType::COMPONENT_SENSE) {
-                printf("%u :: mt:%u (mId:%u, at:%u%s)" EOL, entry->count, (u32)entry->messageType, (u32)entry->moduleId, (u32)entry->actionType, entry->isSplit ? ", SPLIT" : "");
-            }
-            else {
-                printf("%u :: mt:%u %s" EOL, entry->count, (u32)entry->messageType, entry->isSplit ? "(SPLIT)" : "");
-            }
+        if (entry.messageType >= MessageType::MODULE_CONFIG && entry.messageType <= MessageType::COMPONENT_SENSE) {
+            printf("%u :: mt:%u (mId:%u, at:%u%s)" EOL, entry.count, (u32)entry.messageType, (u32)entry.moduleId, (u32)entry.actionType, entry.isSplit ? ", SPLIT" : "");
+        }
+        else {
+            printf("%u :: mt:%u %s" EOL, entry.count, (u32)entry.messageType, entry.isSplit ? "(SPLIT)" : "");
         }
     }
 
     printf(">----------------------------------------------------<" EOL);
 }
 
+SimProfile CherrySim::GetProfile(NodeId nodeId)
+{
+    SimProfile profile;
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        if (nodeId == 0 || nodes[i].id == nodeId) profile.Add(nodes[i].profile);
+    }
+    return profile;
+}
+
+void CherrySim::PrintProfile(NodeId nodeId)
+{
+    if (!simConfig.enableProfiler) return;
+
+    printf(">----------------------------------------------------<" EOL);
+    printf("Firmware profile on node %u (calls :: total ms :: self ms)" EOL, nodeId);
+    printf("" EOL);
+
+    for (const auto& entry : GetProfile(nodeId).GetFrameTotals())
+    {
+        printf("%llu :: %.3f :: %.3f :: %s" EOL, (unsigned long long)entry.second.calls, (double)entry.second.totalNs / 1000000, (double)entry.second.selfNs / 1000000, entry.first.c_str());
+    }
+
+    printf(">----------------------------------------------------<" EOL);
+}
+
+void CherrySim::WriteProfileCollapsedStacks(std::ostream& out)
+{
+    for (u32 i = 0; i < GetTotalNodes(); i++)
+    {
+        nodes[i].profile.WriteCollapsedStacks(out, "Node " + std::to_string(nodes[i].id));
+    }
+}
+
 #pragma warning( pop )
 
 #endif
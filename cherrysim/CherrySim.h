@@ -44,7 +44,15 @@ into all files in order to rewrite macros and other calls.
 #include <Terminal.h>
 #include <LedWrapper.h>
 #include <CherrySimTypes.h>
+#include <SpatialGrid.h>
+#include <LinkBudgetCache.h>
+#include <NodeWorkerPool.h>
+#include <SparseFlash.h>
+#include <MeshComponentSet.h>
+#include <SimMapChangeFeed.h>
 #include <map>
+#include <memory>
+#include <exception>
 #include <chrono>
 #include <string>
 
@@ -77,18 +85,22 @@ struct FeaturesetPointers
 
 class CherrySim
 {
+    friend class CherrySimTester; //Also used without CHERRYSIM_TESTER_ENABLED by the benchmark
     friend class NodeIndexSetter;
+    friend class SimulatorContextSetter;
 private:
     std::vector<char> nodeEntryBuffer; // As std::vector calls the copy constructor of it's type and NodeEntry has no copy constructor we have to provide the memory like this.
 public:
     constexpr static float N = 2.5; //Our calibration value for distance calculation
+    constexpr static float minReceivableRssi = -90; //Packets received with this rssi or lower are always dropped
     int globalBreakCounter = 0; //Can be used to increment globally everywhere in sim and break on a specific count
     bool shouldRestartSim = false;
     bool blockConnections = false; //Can be set to true to stop packets from being sent
+    u32 idleSkipLimitSimTimeMs = UINT32_MAX; //Skipping idle ticks never starts a step later than this simulation time, see SimConfiguration::skipIdleTicks
     volatile bool receivedDataFromMeshGw = false;
     SimConfiguration simConfig; //The current configuration for the simulator
     SimulatorState simState; //The current state of the simulator
-    NodeEntry* currentNode = nullptr; //A pointer to the current node under simulation
+    static inline thread_local NodeEntry* currentNode = nullptr; //A pointer to the current node under simulation, each thread that steps nodes has its own
     NodeEntry* nodes = nullptr; //A pointer that points to the memory that holds the complete state of all nodes
     std::string logAccumulator;
 
@@ -98,6 +110,7 @@ public:
     static constexpr int flashToFileWriteInterval = 128; // Will write flash to file every flashToFileWriteInterval's simulation step.
 
     void ErasePage(u32 pageAddress);
+    void MarkFlashWritten(u32 address, u32 size); //Must be called after writing to the flash of a node, marks the pages for StoreFlashToFile
 
     //Can be used to inject a single record configuration into the flash of the current node before booting it
     void WriteRecordToFlash(u16 recordId, u8* data, u16 dataLength);
@@ -124,8 +137,37 @@ TESTER_PUBLIC:
     TerminalPrintListener* terminalPrintListener = nullptr;
     FruitySimServer* server = nullptr;
 
+    //Nodes whose fruitymap state changed, served incrementally by the FruitySimServer
+    SimMapChangeFeed mapChangeFeed;
+
     std::chrono::time_point<std::chrono::steady_clock> lastTick;
 
+    //Spatial index of all node positions, used to find the nodes that might receive a broadcast
+    SpatialGrid spatialGrid;
+    std::vector<u32> spatialGridQueryResult;
+
+    //Caches the rssi between nodes, must be invalidated whenever a node moves or its links change
+    LinkBudgetCache linkBudgetCache;
+
+    //Backs the flash of all nodes, erased and identical pages are shared between the nodes
+    SparseFlash sparseFlash{ SIM_MAX_FLASH_SIZE, SIM_FLASH_PAGE_SIZE };
+
+    //Parallel node stepping, see SimConfiguration::numParallelNodeWorkers
+    static inline thread_local bool nodeWorkerContext = false; //True while the current thread executes the firmware of a node in the parallel phase
+    std::unique_ptr<NodeWorkerPool> nodeWorkerPool;
+    std::vector<u32> parallelStepNodeIndices; //The nodes that take part in the parallel phase of the current step
+    std::vector<std::exception_ptr> parallelStepExceptions;
+    u32 parallelStepEventIdBase = 0;
+    u32 parallelStepPacketIdBase = 0;
+    bool IsNodeJittering(int64_t avgSimulatedFrames);
+    void SimulateStepForAllNodesInParallel(int64_t avgSimulatedFrames);
+    void ApplyDeferredEffects();
+
+    //Idle tick skipping, see SimConfiguration::skipIdleTicks
+    bool IsIdleTickSkippingPossible() const;
+    u32 GetAmountOfSkippableTicks();
+    void SkipIdleTicks(u32 amountOfTicks);
+
     std::map<std::string, MoveAnimation> loadedMoveAnimations;
     bool IsValidMoveAnimationJson(const nlohmann::json &json) const;
     MoveAnimation& AnimationGet(const std::string &name);
@@ -145,8 +187,15 @@ TESTER_PUBLIC:
     bool ShouldSimIvTrigger(u32 ivMs);
     bool ShouldSimConnectionIvTrigger(u32 ivMs, SoftdeviceConnection * connection);
 
+    //Persistence of the flash, only pages that changed are appended to the file, see StoreFlashToFile
+    std::vector<bool> flashFileStoredPages; //Global page indices of the sparseFlash that have contents in the file
+    u32 amountOfStoredFlashPages = 0;
+    u32 flashFileSizeInPages = 0;
+    bool flashFileAppendable = false; //If false, the file is rewritten on the next store
     void StoreFlashToFile();
     void LoadFlashFromFile();
+    void RewriteFlashFile(const std::vector<u32>& dirtyPages);
+    void AppendFlashFileBatches(std::ofstream& file, const std::vector<u32>& pages);
     void PrepareSimulatedFeatureSets();
     void QueueInterrupts();
 
@@ -168,6 +217,7 @@ public:
     void Init(); //Creates and flashes all nodes
     void SimulateStepForAllNodes(); //Simulates on timestep for all nodes
     void QuitSimulation();
+    void PrepareForkedProcess(); //Must be called in a process that was forked from a running simulation before continuing it
 
     //#### Terminal
     #ifdef TERMINAL_ENABLED
@@ -258,17 +308,36 @@ public:
     void SimulateInterrupts();
 
     //Validity Checking
+    struct ClusterLink
+    {
+        MeshConnection* connection; //A handshaked MeshConnection of the node
+        u32 partnerIndex;
+    };
+    MeshComponentSet meshComponents; //Clusters formed by the handshaked MeshConnections, rebuilt for each check
+    std::vector<std::vector<ClusterLink>> clusterLinks; //The handshaked MeshConnections of each node index
+    std::vector<bool> regularMeshComponents; //Indexed by the component root, see BuildMeshComponents
+    std::vector<i32> clusterUpdatesFromRoot; //Scratch space of PropagateClusterUpdatesAlongTree
+    std::vector<i32> clusterUpdatesToRoot;
     void CheckMeshingConsistency();
+    void BuildMeshComponents(u32 amountOfNodes);
+    void PropagateClusterUpdatesAlongTree(u32 rootIndex);
     ClusterSize DetermineClusterSizeAndPropagateClusterUpdates(NodeEntry* node, NodeEntry* startNode);
 
     //Configuration
     void SetBleStack(NodeEntry* node);
 
     //Statistics
-    void AddPacketToStats(PacketStat* statArray, PacketStat* packet);
-    void AddMessageToStats(PacketStat* statArray, u8* message, u16 messageLength);
+    PacketStatTable globalSentPackets; //Sum of the sentPackets of all nodes
+    PacketStatTable globalRoutedPackets; //Sum of the routedPackets of all nodes
+    void AddPacketToStats(PacketStatTable& statTable, const PacketStat& packet);
+    void AddMessageToStats(PacketStatTable& statTable, PacketStatTable& globalStatTable, u8* message, u16 messageLength);
     void PrintPacketStats(NodeId nodeId, const char* statId);
 
+    //Profiling of the firmware, see SimConfiguration::enableProfiler
+    SimProfile GetProfile(NodeId nodeId); //The sum of all nodes if nodeId is 0
+    void PrintProfile(NodeId nodeId);
+    void WriteProfileCollapsedStacks(std::ostream& out);
+
     //#### Helpers
     bool IsClusteringDone();
     bool IsClusteringDoneWithDifferentNetworkIds();    //Checks if each network Id for itself is completly clustered.
@@ -282,7 +351,9 @@ public:
     float GetReceptionRssi(const NodeEntry* sender, const NodeEntry* receiver, int8_t senderDbmTx, int8_t senderCalibratedTx);
     float GetReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver);
     float GetReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver, int8_t senderDbmTx, int8_t senderCalibratedTx);
+    float CalculateReceptionRssiNoNoise(const NodeEntry* sender, const NodeEntry* receiver, int8_t senderDbmTx, int8_t senderCalibratedTx); //Uncached version of GetReceptionRssiNoNoise
     uint32_t CalculateReceptionProbability(const NodeEntry* sendingNode, const NodeEntry* receivingNode);
+    float GetMaxReceptionRangeInMeters(const NodeEntry* sender);
 
     SoftdeviceConnection* FindConnectionByHandle(NodeEntry* node, int connectionHandle);
     NodeEntry* FindNodeById(int id);
@@ -295,6 +366,31 @@ public:
 
     void SetPosition(u32 nodeIndex, float x, float y, float z);
     void AddPosition(u32 nodeIndex, float x, float y, float z);
+    void RebuildSpatialGrid(); //Must be called after node positions were modified without using SetPosition or AddPosition
+    void NotifyMapStateChanged(u32 nodeIndex); //Must be called for everything that changes what the fruitymap shows of a node, see SimMapNodeState
+    void AddImpossibleConnection(u32 nodeIndex, u32 otherNodeIndex);
+
+    //#### Parallel node stepping
+    static bool IsInNodeWorkerContext();
+    MersenneTwister& GetRandom(); //Must be used for all random numbers that are drawn while a node is simulated
+    u32 GenerateGlobalEventId();
+    u32 GenerateGlobalPacketId();
+
+    //Runs the given effect immediately, unless the current node is executed by a worker. In that case,
+    //the effect is kept until all workers are done and is then executed in node order. Must be used for
+    //everything a node does to other nodes or to the simulator while its firmware is running.
+    template<typename T>
+    void RunOrDefer(T&& effect)
+    {
+        if (nodeWorkerContext)
+        {
+            currentNode->deferredEffects.emplace_back(std::forward<T>(effect));
+        }
+        else
+        {
+            effect();
+        }
+    }
 };
 
 //Throw this in the simulator in order to quit from the simulation
@@ -331,5 +427,35 @@ public:
 };
 
 
+//RAII implementation that makes the given simulator the current one of the calling thread. The node under
+//simulation and the worker context are thread local and therefore shared by all simulators of a thread. They
+//are saved and restored so that a simulator that is stepped while another one is current does not leave its
+//node behind for the other one or step the nodes of the other one.
+class SimulatorContextSetter
+{
+private:
+    CherrySim* originalInstance = nullptr;
+    u32 originalIndex = 0xFFFFFFFF;
+
+public:
+    explicit SimulatorContextSetter(CherrySim* sim)
+    {
+        //A simulator must not be stepped from within the firmware of a node
+        if (CherrySim::nodeWorkerContext) SIMEXCEPTION(IllegalStateException);
+
+        originalInstance = cherrySimInstance;
+        if (originalInstance != nullptr && CherrySim::currentNode != nullptr) originalIndex = CherrySim::currentNode->index;
+
+        cherrySimInstance = sim;
+        if (originalInstance != sim) sim->SetNode(0xFFFFFFFF);
+    }
+
+    ~SimulatorContextSetter()
+    {
+        cherrySimInstance = originalInstance;
+        if (originalInstance != nullptr) originalInstance->SetNode(originalIndex);
+    }
+};
+
 #endif
 /** @} */
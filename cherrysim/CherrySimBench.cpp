@@ -0,0 +1,457 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "CherrySimTester.h"
+#include "CherrySim.h"
+#include "DebugModule.h"
+#include "MersenneTwister.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+/**
+The CherrySimBench runs parameterized scenarios of the simulator and the mesh stack and reports
+performance numbers as JSON so that regressions show up in review. A result can be compared
+against a stored baseline:
+
+cherrySim_bench [--suite quick|full] [--scenario <name>]... [--out <file>] [--baseline <file>] [--tolerance <percent>]
+
+If a baseline is given, the exit code is 1 if any metric got worse by more than the tolerance.
+On POSIX systems, every scenario runs in its own process so that the peak memory is measured per scenario.
+*/
+
+#ifdef CHERRYSIM_BENCH_ENABLED
+
+struct BenchScenario
+{
+    std::string name;
+    u32 numNodes;
+    float nodesPer100SquareMeters; //Determines the size of the (square) map
+    bool mixedFeaturesets; //Half of the mesh nodes use the dev featureset instead of the mesh featureset
+    bool perfectConditions; //SetToPerfectConditions or lossy reception and connection timeouts
+};
+
+struct BenchMetric
+{
+    const char* name;
+    bool higherIsBetter;
+};
+
+//All metrics that are compared against a baseline
+static const BenchMetric benchMetrics[] = {
+    { "ticksPerSecond"        , true  },
+    { "clusteringWallMs"      , false },
+    { "clusteringSimMs"       , false },
+    { "peakRssKb"             , false },
+    { "floodPacketsPerSimSec" , true  },
+    { "pingP50Ms"             , false },
+    { "pingP90Ms"             , false },
+    { "pingP99Ms"             , false },
+};
+
+static constexpr u32 FLOOD_PACKETS_PER_10_SEC = 100;
+static constexpr u32 FLOOD_DURATION_SEC = 30;
+static constexpr u32 AMOUNT_OF_PINGS = 30;
+
+static BenchScenario CreateScenario(u32 numNodes, float density, bool mixedFeaturesets, bool perfectConditions)
+{
+    BenchScenario scenario = { "", numNodes, density, mixedFeaturesets, perfectConditions };
+    scenario.name = "n" + std::to_string(numNodes)
+        + (density >= 1.0f ? "_dense" : "_sparse")
+        + (mixedFeaturesets ? "_mixed" : "_mesh")
+        + (perfectConditions ? "_perfect" : "_lossy");
+    return scenario;
+}
+
+static std::vector<BenchScenario> CreateSuite(const std::string& suite)
+{
+    std::vector<BenchScenario> scenarios;
+    const u32 numNodes[] = { 10, 50, 200, 500, 1000, 2000 };
+    for (u32 n : numNodes)
+    {
+        if (suite == "quick" && n > 50) break;
+        scenarios.push_back(CreateScenario(n, 1.0f, false, true));
+    }
+
+    //Variations are measured on a mesh of medium size
+    scenarios.push_back(CreateScenario(50, 0.25f, false, true));
+    scenarios.push_back(CreateScenario(50, 1.0f, true, true));
+    scenarios.push_back(CreateScenario(50, 1.0f, false, false));
+    if (suite == "full")
+    {
+        scenarios.push_back(CreateScenario(500, 1.0f, true, false));
+    }
+    return scenarios;
+}
+
+static u32 GetPeakRssKb()
+{
+#if defined(__unix__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return (u32)usage.ru_maxrss;
+#endif
+    return 0;
+}
+
+static double GetPercentile(std::vector<u32> values, u32 percent)
+{
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    //Nearest rank method
+    const size_t rank = (size_t)std::ceil(values.size() * percent / 100.0);
+    return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static nlohmann::json RunScenario(const BenchScenario& scenario)
+{
+    nlohmann::json result;
+    result["name"] = scenario.name;
+    result["numNodes"] = scenario.numNodes;
+    result["nodesPer100SquareMeters"] = scenario.nodesPer100SquareMeters;
+    result["mixedFeaturesets"] = scenario.mixedFeaturesets;
+    result["perfectConditions"] = scenario.perfectConditions;
+
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    testerConfig.terminalFilter = -1;
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.seed = 1;
+    simConfig.verboseCommands = false;
+    simConfig.terminalId = 0;
+
+    const u32 mapSideInMeters = (u32)std::ceil(std::sqrt(scenario.numNodes * 100.0f / scenario.nodesPer100SquareMeters));
+    simConfig.mapWidthInMeters = mapSideInMeters;
+    simConfig.mapHeightInMeters = mapSideInMeters;
+
+    const int numMeshNodes = (int)scenario.numNodes - 1;
+    simConfig.nodeConfigName.insert({ "github_sink_nrf52", 1 });
+    if (scenario.mixedFeaturesets)
+    {
+        simConfig.nodeConfigName.insert({ "github_mesh_nrf52", numMeshNodes - numMeshNodes / 2 });
+        if (numMeshNodes / 2 > 0) simConfig.nodeConfigName.insert({ "github_dev_nrf52", numMeshNodes / 2 });
+    }
+    else
+    {
+        simConfig.nodeConfigName.insert({ "github_mesh_nrf52", numMeshNodes });
+    }
+
+    if (scenario.perfectConditions)
+    {
+        simConfig.SetToPerfectConditions();
+    }
+    else
+    {
+        simConfig.connectionTimeoutProbabilityPerSec = UINT32_MAX / 1000000; //About one connection loss every ten minutes
+        simConfig.receptionProbabilityVeryClose = UINT32_MAX / 10 * 9;
+        simConfig.receptionProbabilityClose = UINT32_MAX / 10 * 8;
+        simConfig.receptionProbabilityFar = UINT32_MAX / 10 * 6;
+        simConfig.receptionProbabilityVeryFar = UINT32_MAX / 10 * 3;
+    }
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    //Clustering
+    const int clusteringTimeoutMs = (int)std::max<u32>(200 * 1000, scenario.numNodes * 2000);
+    const u32 clusteringStartSimMs = tester.sim->simState.simTimeMs;
+    const auto clusteringStart = std::chrono::steady_clock::now();
+    bool clustered = true;
+    try
+    {
+        tester.SimulateUntilClusteringDone(clusteringTimeoutMs);
+    }
+    catch (const TimeoutException&)
+    {
+        clustered = false;
+    }
+    const double clusteringWallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - clusteringStart).count();
+    const u32 clusteringSimMs = tester.sim->simState.simTimeMs - clusteringStartSimMs;
+    result["clustered"] = clustered;
+    result["clusteringWallMs"] = clusteringWallMs;
+    result["clusteringSimMs"] = clusteringSimMs;
+    result["ticksPerSecond"] = clusteringWallMs > 0 ? (clusteringSimMs / tester.sim->simConfig.simTickDurationMs) * 1000.0 / clusteringWallMs : 0.0;
+
+    if (clustered)
+    {
+        //Flood throughput from the last node to the sink
+        const NodeId floodSource = (NodeId)scenario.numNodes;
+        tester.SendTerminalCommand(1, "action this debug flood %u 3 0", floodSource);
+        tester.SimulateGivenNumberOfSteps(1);
+        tester.SendTerminalCommand(1, "action %u debug flood 1 2 %u %u", floodSource, FLOOD_PACKETS_PER_10_SEC, FLOOD_DURATION_SEC);
+        tester.SimulateForGivenTime((FLOOD_DURATION_SEC + 5) * 1000);
+        u32 floodPacketsIn;
+        {
+            NodeIndexSetter setter(0);
+            floodPacketsIn = static_cast<DebugModule*>(tester.sim->FindNodeById(1)->gs.node.GetModuleById(ModuleId::DEBUG_MODULE))->GetPacketsIn();
+        }
+        result["floodPacketsIn"] = floodPacketsIn;
+        result["floodPacketsPerSimSec"] = (double)floodPacketsIn / FLOOD_DURATION_SEC;
+        result["floodDeliveryRatio"] = (double)floodPacketsIn / (FLOOD_PACKETS_PER_10_SEC * FLOOD_DURATION_SEC / 10);
+        tester.SendTerminalCommand(1, "action this debug flood 0 0 0");
+        tester.SimulateForGivenTime(5 * 1000);
+
+        //Ping latency from the sink to random nodes, as measured by the DebugModule in simulated time
+        MersenneTwister rnd(scenario.numNodes);
+        std::vector<u32> pingLatencies;
+        u32 lostPings = 0;
+        for (u32 i = 0; i < AMOUNT_OF_PINGS; i++)
+        {
+            const NodeId target = (NodeId)rnd.NextU32(2, scenario.numNodes);
+            tester.SendTerminalCommand(1, "action %u debug ping 1 r", target);
+            std::vector<SimulationMessage> messages = { SimulationMessage(1, "p \\d+ ms") };
+            try
+            {
+                tester.SimulateUntilRegexMessagesReceived(10 * 1000, messages);
+            }
+            catch (const TimeoutException&)
+            {
+                lostPings++;
+                continue;
+            }
+            std::smatch match;
+            const std::string& message = messages[0].GetCompleteMessage();
+            if (std::regex_search(message, match, std::regex("p (\\d+) ms"))) pingLatencies.push_back((u32)std::stoul(match[1].str()));
+        }
+        result["pingLost"] = lostPings;
+        result["pingP50Ms"] = GetPercentile(pingLatencies, 50);
+        result["pingP90Ms"] = GetPercentile(pingLatencies, 90);
+        result["pingP99Ms"] = GetPercentile(pingLatencies, 99);
+        result["pingMaxMs"] = GetPercentile(pingLatencies, 100);
+    }
+
+    result["peakRssKb"] = GetPeakRssKb();
+    return result;
+}
+
+//Runs the scenario in a child process so that the peak memory of previous scenarios does not distort the result
+static nlohmann::json RunScenarioIsolated(const BenchScenario& scenario)
+{
+#if defined(__unix__)
+    int fds[2];
+    if (pipe(fds) != 0) return RunScenario(scenario);
+
+    std::cout.flush();
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return RunScenario(scenario);
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        std::string output;
+        try
+        {
+            output = RunScenario(scenario).dump();
+        }
+        catch (const std::exception& e)
+        {
+            output = nlohmann::json{ { "name", scenario.name }, { "error", e.what() } }.dump();
+        }
+        const char* data = output.c_str();
+        size_t remaining = output.size();
+        while (remaining > 0)
+        {
+            const ssize_t written = write(fds[1], data, remaining);
+            if (written <= 0) break;
+            data += written;
+            remaining -= (size_t)written;
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string output;
+    char buffer[4096];
+    ssize_t amountRead;
+    while ((amountRead = read(fds[0], buffer, sizeof(buffer))) > 0) output.append(buffer, (size_t)amountRead);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    nlohmann::json result = nlohmann::json::parse(output, nullptr, false);
+    if (result.is_discarded() || !result.is_object())
+    {
+        result = { { "name", scenario.name }, { "error", "scenario process crashed" } };
+    }
+    return result;
+#else
+    try
+    {
+        return RunScenario(scenario);
+    }
+    catch (const std::exception& e)
+    {
+        return { { "name", scenario.name }, { "error", e.what() } };
+    }
+#endif
+}
+
+//Prints every metric that differs from the baseline and returns the amount of regressions
+static u32 CompareWithBaseline(const nlohmann::json& results, const nlohmann::json& baseline, double tolerancePercent)
+{
+    u32 regressions = 0;
+    for (const nlohmann::json& result : results["scenarios"])
+    {
+        const nlohmann::json* baseResult = nullptr;
+        for (const nlohmann::json& entry : baseline["scenarios"])
+        {
+            if (entry.value("name", "") == result.value("name", "")) baseResult = &entry;
+        }
+        if (baseResult == nullptr)
+        {
+            printf("%-32s not in baseline" EOL, result.value("name", "").c_str());
+            continue;
+        }
+        if (result.contains("error") && !baseResult->contains("error"))
+        {
+            printf("%-32s REGRESSION: %s" EOL, result.value("name", "").c_str(), result["error"].get<std::string>().c_str());
+            regressions++;
+            continue;
+        }
+        if (baseResult->value("clustered", false) && !result.value("clustered", false))
+        {
+            printf("%-32s REGRESSION: clustering timed out" EOL, result.value("name", "").c_str());
+            regressions++;
+        }
+
+        for (const BenchMetric& metric : benchMetrics)
+        {
+            if (!result.contains(metric.name) || !baseResult->contains(metric.name)) continue;
+            const double value = result[metric.name].get<double>();
+            const double baseValue = (*baseResult)[metric.name].get<double>();
+            if (baseValue == 0) continue;
+
+            const double changePercent = (value - baseValue) * 100.0 / baseValue;
+            const bool worse = metric.higherIsBetter ? changePercent < -tolerancePercent : changePercent > tolerancePercent;
+            printf("%-32s %-22s %12.2f -> %12.2f (%+7.1f%%)%s" EOL, result.value("name", "").c_str(), metric.name, baseValue, value, changePercent, worse ? " REGRESSION" : "");
+            if (worse) regressions++;
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    std::string suite = "quick";
+    std::vector<std::string> scenarioNames;
+    std::string outPath = "";
+    std::string baselinePath = "";
+    double tolerancePercent = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--suite" && hasValue) suite = argv[++i];
+        else if (arg == "--scenario" && hasValue) scenarioNames.push_back(argv[++i]);
+        else if (arg == "--out" && hasValue) outPath = argv[++i];
+        else if (arg == "--baseline" && hasValue) baselinePath = argv[++i];
+        else if (arg == "--tolerance" && hasValue) tolerancePercent = std::stod(argv[++i]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--suite quick|full] [--scenario <name>]... [--out <file>] [--baseline <file>] [--tolerance <percent>]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<BenchScenario> scenarios = CreateSuite("full");
+    if (!scenarioNames.empty())
+    {
+        scenarios.erase(std::remove_if(scenarios.begin(), scenarios.end(), [&](const BenchScenario& scenario) {
+            return std::find(scenarioNames.begin(), scenarioNames.end(), scenario.name) == scenarioNames.end();
+        }), scenarios.end());
+    }
+    else
+    {
+        scenarios = CreateSuite(suite);
+    }
+    if (scenarios.empty())
+    {
+        std::cerr << "No matching scenarios" << std::endl;
+        return 2;
+    }
+
+    //The same exceptions as in the runner are handled by FruityMesh itself and must not end a scenario
+    Exceptions::DisableDebugBreakOnException debugBreakDisabler;
+    Exceptions::ExceptionDisabler<ErrorCodeUnknownException> ecue;
+    Exceptions::ExceptionDisabler<CRCMissingException> crcme;
+    Exceptions::ExceptionDisabler<CRCInvalidException> crcie;
+    Exceptions::ExceptionDisabler<CommandNotFoundException> disabler;
+    Exceptions::ExceptionDisabler<ErrorLoggedException> ele;
+
+    nlohmann::json results;
+    results["scenarios"] = nlohmann::json::array();
+    for (const BenchScenario& scenario : scenarios)
+    {
+        std::cerr << "Running " << scenario.name << "..." << std::endl;
+        results["scenarios"].push_back(RunScenarioIsolated(scenario));
+    }
+
+    if (outPath.empty())
+    {
+        std::cout << results.dump(2) << std::endl;
+    }
+    else
+    {
+        std::ofstream out(outPath, std::ios::trunc);
+        out << results.dump(2) << std::endl;
+    }
+
+    if (!baselinePath.empty())
+    {
+        std::ifstream baselineFile(baselinePath);
+        if (!baselineFile)
+        {
+            std::cerr << "Could not open baseline " << baselinePath << std::endl;
+            return 2;
+        }
+        nlohmann::json baseline;
+        baselineFile >> baseline;
+        const u32 regressions = CompareWithBaseline(results, baseline, tolerancePercent);
+        printf("%u regression(s) with a tolerance of %.1f%%" EOL, regressions, tolerancePercent);
+        return regressions > 0 ? 1 : 0;
+    }
+    return 0;
+}
+#endif //CHERRYSIM_BENCH_ENABLED
@@ -38,8 +38,27 @@
 #include <cstdarg>
 #include <chrono>
 #include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
 #include "FruityHal.h"
 #include "Utility.h"
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <fcntl.h>
+extern char** environ;
+#endif
  
 /***
 This class is a wrapper around the simulator and provides methods for injecting data into the simulator
@@ -75,11 +94,335 @@ void operator delete(void * p) throw()
 #endif
 
 #ifdef CHERRYSIM_TESTER_ENABLED
+//Executes the given job for all indices, distributed over the given amount of worker threads
+static void RunJobsOnWorkers(u32 numWorkers, size_t amountOfJobs, const std::function<void(size_t)>& job)
+{
+    std::atomic<size_t> nextJob(0);
+    auto worker = [&]() {
+        for (size_t jobIndex = nextJob++; jobIndex < amountOfJobs; jobIndex = nextJob++)
+        {
+            job(jobIndex);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (u32 i = 0; i < numWorkers; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& t : workers)
+    {
+        t.join();
+    }
+}
+
+static std::string ReadFileContents(const std::string& path)
+{
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+//At most this many failed tests are executed again to record their replay, the rest is only listed in the summary
+static constexpr u32 MAX_REPLAY_RERUNS = 20;
+
+//Executes the given executable as a child process and waits for it to finish. stdout and stderr of the child are
+//written to outputPath. The environment of the child is the environment of this process plus the given variables
+//(in the form NAME=VALUE). On unix, the arguments are passed without a shell so that e.g. the wildcards and colons
+//of a gtest filter reach the child unchanged. Returns the exit code of the child.
+static int RunChildProcess(const std::string& executable, const std::vector<std::string>& arguments, const std::vector<std::string>& environment, const std::string& outputPath)
+{
+#if defined(__unix__)
+    std::vector<std::string> environmentStrings = environment;
+    for (char** variable = environ; *variable != nullptr; variable++)
+    {
+        const std::string existing = *variable;
+        const bool overridden = std::any_of(environment.begin(), environment.end(), [&](const std::string& v) {
+            return existing.compare(0, v.find('=') + 1, v, 0, v.find('=') + 1) == 0;
+        });
+        if (!overridden) environmentStrings.push_back(existing);
+    }
+
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(executable.c_str()));
+    for (const std::string& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+    std::vector<char*> envp;
+    for (const std::string& variable : environmentStrings) envp.push_back(const_cast<char*>(variable.c_str()));
+    envp.push_back(nullptr);
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&fileActions, STDOUT_FILENO, STDERR_FILENO);
+
+    pid_t pid;
+    const int spawnError = posix_spawnp(&pid, executable.c_str(), &fileActions, nullptr, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&fileActions);
+    if (spawnError != 0)
+    {
+        std::ofstream(outputPath) << "Could not start " << executable << ": " << std::strerror(spawnError) << std::endl;
+        return 1;
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+#else
+    //Every argument is quoted for cmd, quotes inside of an argument are escaped for the argument parsing of the child
+    auto quote = [](const std::string& argument) {
+        std::string quoted = "\"";
+        for (const char c : argument)
+        {
+            if (c == '"') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    };
+    std::string command = "\"";
+    for (const std::string& variable : environment)
+    {
+        command += "set " + quote(variable) + " && ";
+    }
+    command += quote(executable);
+    for (const std::string& argument : arguments) command += " " + quote(argument);
+    command += " > " + quote(outputPath) + " 2>&1\"";
+    return std::system(command.c_str());
+#endif
+}
+
+//Google Test can only run one test at a time within a process. For the parallel mode, the tests are therefore
+//split into shards (using the GTEST_TOTAL_SHARDS and GTEST_SHARD_INDEX environment variables) and every
+//shard / seed combination is executed as a job in a child process. A pool of worker threads executes the jobs.
+//As each job runs in its own process with a fixed seed, the result of each test does not depend on the scheduling.
+//Every job reports its tests as a google test json. These are aggregated into a summary per seed that is written
+//to the sweep directory. Failed tests are then executed again on their own with the replay log enabled so that the
+//failure can be reproduced in the CherrySimRunner. The logs of failed jobs and the replays are kept as artifacts.
+//The thread local simulator context is not needed by this mode as each job has its own process. It is used by tests
+//that run several simulations on threads within one test, e.g. TestOther.TestParallelSimulations.
+static int RunTestsInParallel(const std::string& executable, u32 numWorkers, uint32_t seedOffset, uint32_t seedIncrement, uint32_t numRuns, const std::string& sweepDirectory)
+{
+    struct ParallelJob
+    {
+        uint32_t seedOffset;
+        u32 shardIndex;
+        int exitCode;
+        long long durationMs;
+    };
+
+    struct TestResult
+    {
+        uint32_t seedOffset;
+        std::string name;
+        double durationSec;
+        bool failed;
+        bool unfinishedShard; //The name is only a description if the job ended without a report
+    };
+
+    std::error_code directoryError;
+    std::filesystem::create_directories(sweepDirectory, directoryError);
+    if (directoryError)
+    {
+        std::cerr << "Could not create sweep directory " << sweepDirectory << ": " << directoryError.message() << std::endl;
+        return 1;
+    }
+
+    //More shards than workers so that a worker that gets a shard with short tests can pick up another one
+    const u32 numShards = numWorkers * 2;
+    std::vector<ParallelJob> jobs;
+    std::vector<uint32_t> seeds;
+    for (uint32_t i = 0; i < numRuns; i++, seedOffset += seedIncrement)
+    {
+        seeds.push_back(seedOffset);
+        for (u32 shard = 0; shard < numShards; shard++)
+        {
+            jobs.push_back({ seedOffset, shard, 0, 0 });
+        }
+    }
+
+    const std::string filter = ::testing::GTEST_FLAG(filter);
+    const bool catchExceptions = ::testing::GTEST_FLAG(catch_exceptions);
+    auto jobPath = [&](size_t jobIndex, const char* extension) {
+        return sweepDirectory + "/job" + std::to_string(jobIndex) + "_seed" + std::to_string(jobs[jobIndex].seedOffset) + "_shard" + std::to_string(jobs[jobIndex].shardIndex) + extension;
+    };
+
+    std::mutex outputMutex;
+    RunJobsOnWorkers(numWorkers, jobs.size(), [&](size_t jobIndex) {
+        ParallelJob& job = jobs[jobIndex];
+        const std::string logPath = jobPath(jobIndex, ".log");
+        const std::vector<std::string> environment = {
+            "GTEST_TOTAL_SHARDS=" + std::to_string(numShards),
+            "GTEST_SHARD_INDEX=" + std::to_string(job.shardIndex),
+        };
+        const std::vector<std::string> arguments = {
+            "ParallelWorker",
+            "SeedStart=" + std::to_string(job.seedOffset),
+            "--gtest_filter=" + filter,
+            std::string("--gtest_catch_exceptions=") + (catchExceptions ? "1" : "0"),
+            "--gtest_break_on_failure=0",
+            "--gtest_output=json:" + jobPath(jobIndex, ".json"),
+        };
+
+        const auto jobStartTime = std::chrono::steady_clock::now();
+        job.exitCode = RunChildProcess(executable, arguments, environment, logPath);
+        job.durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - jobStartTime).count();
+
+        //Print the complete output of the job at once so that the output of different jobs is not mixed
+        std::lock_guard<std::mutex> guard(outputMutex);
+        std::cout << "######## Job " << jobIndex << " (seed offset " << job.seedOffset << ", shard " << job.shardIndex << "/" << numShards << ") ";
+        std::cout << (job.exitCode == 0 ? "PASSED" : "FAILED") << " in " << (job.durationMs / 1000.0) << " seconds ########" << std::endl;
+        std::cout << ReadFileContents(logPath) << std::endl;
+
+        //The log of a failed job is kept as an artifact
+        if (job.exitCode == 0) std::remove(logPath.c_str());
+    });
+
+    //Collect the results of all tests from the reports of the jobs
+    std::vector<TestResult> testResults;
+    int exitCode = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const std::string reportPath = jobPath(i, ".json");
+        const bool crashed = jobs[i].exitCode != 0;
+        if (crashed) exitCode = 1;
+
+        nlohmann::json report = nlohmann::json::parse(ReadFileContents(reportPath), nullptr, false);
+        std::remove(reportPath.c_str());
+        if (report.is_discarded() || !report.contains("testsuites"))
+        {
+            //The job did not finish, e.g. because of a crash, so the failed test is unknown
+            if (crashed) testResults.push_back({ jobs[i].seedOffset, "<shard " + std::to_string(jobs[i].shardIndex) + " did not finish, see " + jobPath(i, ".log") + ">", jobs[i].durationMs / 1000.0, true, true });
+            continue;
+        }
+
+        for (const nlohmann::json& testSuite : report["testsuites"])
+        {
+            for (const nlohmann::json& test : testSuite["testsuite"])
+            {
+                if (test.value("status", "") != "RUN") continue;
+                const std::string time = test.value("time", "0s");
+                testResults.push_back({
+                    jobs[i].seedOffset,
+                    testSuite.value("name", "") + "." + test.value("name", ""),
+                    std::atof(time.c_str()),
+                    test.contains("failures"),
+                    false
+                });
+            }
+        }
+    }
+
+    //Execute each failed test again on its own to record a replay of it
+    std::vector<std::string> replayPaths(testResults.size());
+    std::vector<size_t> rerunResults;
+    for (size_t i = 0; i < testResults.size() && rerunResults.size() < MAX_REPLAY_RERUNS; i++)
+    {
+        if (testResults[i].failed && !testResults[i].unfinishedShard) rerunResults.push_back(i);
+    }
+    RunJobsOnWorkers(numWorkers, rerunResults.size(), [&](size_t rerunIndex) {
+        const TestResult& result = testResults[rerunResults[rerunIndex]];
+        std::string fileName = "replay_seed" + std::to_string(result.seedOffset) + "_" + result.name + ".log";
+        std::replace(fileName.begin(), fileName.end(), '/', '_'); //Parameterized tests contain slashes
+        const std::string replayPath = sweepDirectory + "/" + fileName;
+        const std::vector<std::string> arguments = {
+            "ParallelWorker",
+            "ReplayRerun",
+            "SeedStart=" + std::to_string(result.seedOffset),
+            "--gtest_filter=" + result.name,
+            std::string("--gtest_catch_exceptions=") + (catchExceptions ? "1" : "0"),
+            "--gtest_break_on_failure=0",
+        };
+
+        const int rerunExitCode = RunChildProcess(executable, arguments, {}, replayPath);
+        replayPaths[rerunResults[rerunIndex]] = replayPath;
+
+        std::lock_guard<std::mutex> guard(outputMutex);
+        std::cout << "Recorded replay of " << result.name << " (seed offset " << result.seedOffset << ") to " << replayPath;
+        std::cout << (rerunExitCode == 0 ? ", the test PASSED when executed on its own" : "") << std::endl;
+    });
+
+    //Write the summary of all seeds
+    nlohmann::json summary;
+    summary["workers"] = numWorkers;
+    summary["shards"] = numShards;
+    summary["filter"] = filter;
+    summary["seeds"] = nlohmann::json::array();
+    summary["failures"] = nlohmann::json::array();
+    for (const uint32_t seed : seeds)
+    {
+        long long jobDurationMs = 0;
+        for (const ParallelJob& job : jobs)
+        {
+            if (job.seedOffset == seed) jobDurationMs += job.durationMs;
+        }
+        u32 amountOfTests = 0;
+        u32 amountOfFailures = 0;
+        double slowestTestSec = 0;
+        std::string slowestTest;
+        for (const TestResult& result : testResults)
+        {
+            if (result.seedOffset != seed) continue;
+            amountOfTests++;
+            if (result.failed) amountOfFailures++;
+            if (result.durationSec >= slowestTestSec)
+            {
+                slowestTestSec = result.durationSec;
+                slowestTest = result.name;
+            }
+        }
+        summary["seeds"].push_back({
+            {"seedOffset", seed},
+            {"jobDurationMs", jobDurationMs},
+            {"tests", amountOfTests},
+            {"failures", amountOfFailures},
+            {"slowestTest", slowestTest},
+            {"slowestTestSec", slowestTestSec}
+        });
+    }
+    for (size_t i = 0; i < testResults.size(); i++)
+    {
+        if (!testResults[i].failed) continue;
+        exitCode = 1;
+        summary["failures"].push_back({
+            {"seedOffset", testResults[i].seedOffset},
+            {"test", testResults[i].name},
+            {"durationSec", testResults[i].durationSec},
+            {"replay", replayPaths[i]}
+        });
+    }
+
+    const std::string summaryPath = sweepDirectory + "/summary.json";
+    std::ofstream summaryFile(summaryPath);
+    summaryFile << summary.dump(4) << std::endl;
+
+    std::cout << "\n######## Summary (" << summaryPath << ") ########" << std::endl;
+    for (const nlohmann::json& seed : summary["seeds"])
+    {
+        std::cout << "Seed offset " << seed["seedOffset"] << ": " << seed["tests"] << " tests, " << seed["failures"] << " failed, ";
+        std::cout << (seed["jobDurationMs"].get<long long>() / 1000.0) << " seconds in jobs, slowest " << seed["slowestTest"].get<std::string>() << std::endl;
+    }
+    for (const nlohmann::json& failure : summary["failures"])
+    {
+        std::cout << "FAILED " << failure["test"].get<std::string>() << " (seed offset " << failure["seedOffset"] << ")";
+        if (!failure["replay"].get<std::string>().empty()) std::cout << ", replay: " << failure["replay"].get<std::string>();
+        std::cout << std::endl;
+    }
+    return exitCode;
+}
+
 int main(int argc, char **argv) {
 
     //A workaround to find out if the Visual Studio Test Explorer is executing us (either on first run through list_tests or the second real run for testing)
     bool runByVisualStudioTestExplorer = argc >= 2 && (std::string(argv[1]).find("gtest_output=xml:") != std::string::npos || (std::string(argv[1]).find("gtest_list_tests") != std::string::npos));
 
+    //If we are executed as a job of the parallel mode, the google test flags are given on the command line by the parent
+    bool runAsParallelWorker = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "ParallelWorker") runAsParallelWorker = true;
+    }
+
     //Initialize google tests
     //WARNING: Will modify the arc and argv and will remove all the GTEST command line parameters
     ::testing::InitGoogleTest(&argc, argv);
@@ -87,7 +430,7 @@ int main(int argc, char **argv) {
     // ###########################
     // Manual testing
     // ###########################
-    if (!runByVisualStudioTestExplorer)
+    if (!runByVisualStudioTestExplorer && !runAsParallelWorker)
     {
         ::testing::GTEST_FLAG(break_on_failure) = true;
 
@@ -113,11 +456,15 @@ int main(int argc, char **argv) {
     std::regex seedStartRegex("SeedStart=(\\w+)");
     std::regex seedIncrementRegex("SeedIncrement=(\\w+)");
     std::regex numRunsRegex("numRuns=(\\w+)");
+    std::regex parallelRegex("parallel=(\\w+)");
+    std::regex sweepDirectoryRegex("sweepDir=(.+)");
     std::smatch matches;
 
     uint32_t seedOffset = 0;
     uint32_t seedIncrement = 0;
     uint32_t numRuns = 1;
+    uint32_t numParallelWorkers = 0;
+    std::string sweepDirectory = "cherrySimSweep";
     bool didError = false;
     for (int i = 0; i < argc; i++)
     {
@@ -145,6 +492,21 @@ int main(int argc, char **argv) {
         {
             numRuns = Utility::StringToU32(matches[1].str().c_str(), &didError);
         }
+        else if (std::regex_search(s, matches, parallelRegex))
+        {
+            //parallel=0 uses one worker per hardware thread
+            numParallelWorkers = Utility::StringToU32(matches[1].str().c_str(), &didError);
+            if (numParallelWorkers == 0) numParallelWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        else if (std::regex_search(s, matches, sweepDirectoryRegex))
+        {
+            sweepDirectory = matches[1].str();
+        }
+        else if (s == "ReplayRerun")
+        {
+            //A failed test of the parallel mode is executed again to record its replay
+            CherrySimTester::recordReplays = true;
+        }
     }
 
     if (didError)
@@ -162,6 +524,15 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (numParallelWorkers > 0 && !runAsParallelWorker)
+    {
+        auto parallelStartTime = std::chrono::high_resolution_clock::now();
+        const int parallelExitCode = RunTestsInParallel(argv[0], numParallelWorkers, seedOffset, seedIncrement, numRuns, sweepDirectory);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - parallelStartTime).count();
+        std::cout << "\n\nTime for all tests with " << numParallelWorkers << " workers: " << (ms / 1000.0) << " seconds." << std::endl;
+        return parallelExitCode;
+    }
+
     auto startTime = std::chrono::high_resolution_clock::now();
 #if MANUAL_LEAK_SEARCH == 1
     openAllocs = 0; //Some allocations happen from global objects or GTEST Code. We don't care about those, so we set the openAllocs to zero.
@@ -172,7 +543,7 @@ int main(int argc, char **argv) {
         std::cout << "Seed offset is now: " << seedOffset << std::endl;
         MersenneTwister::seedOffset = seedOffset;
 
-        if (GitLab) {
+        if (GitLab || runAsParallelWorker) {
             Exceptions::DisableDebugBreakOnException disabler;
             exitCode = RUN_ALL_TESTS();
         }
@@ -257,6 +628,14 @@ CherrySimTester::CherrySimTester(CherrySimTesterConfig testerConfig, SimConfigur
       : config(testerConfig),
       simConfig(simConfig) 
 {
+    if (recordReplays)
+    {
+        //The complete terminal output is needed, it contains the configuration and the executed commands
+        this->config.verbose = true;
+        this->config.terminalFilter = 0;
+        this->simConfig.logReplayCommands = true;
+        simConfig.logReplayCommands = true;
+    }
     sim = new CherrySim(simConfig);
     sim->SetCherrySimEventListener(this);
     sim->Init();
@@ -270,6 +649,7 @@ CherrySimTester::CherrySimTester(CherrySimTester && other)
     useRegex                     (std::move(other.useRegex)),
     awaitedMessagePointer        (std::move(other.awaitedMessagePointer)),
     awaitedMessagesFound         (std::move(other.awaitedMessagesFound)),
+    awaitedMessageMatcher        (std::move(other.awaitedMessageMatcher)),
     awaitedBleEventNodeId        (std::move(other.awaitedBleEventNodeId)),
     awaitedBleEventEventId       (std::move(other.awaitedBleEventEventId)),
     awaitedBleEventDataPart      (std::move(other.awaitedBleEventDataPart)),
@@ -349,8 +729,7 @@ void CherrySimTester::SimulateBroadcastMessage(double x, double y, ble_gap_evt_a
 {
     printf("Simulating broadcast message" EOL);
 
-    sim->currentNode->x = (float)x;
-    sim->currentNode->y = (float)y;
+    sim->SetPosition(sim->currentNode->index, (float)x, (float)y, sim->currentNode->z);
     u32 numNoneAssetNodes = sim->GetTotalNodes() - sim->GetAssetNodes();
     for (u32 i = 0; i < numNoneAssetNodes; i++) {
         //If the other node is scanning
@@ -371,7 +750,7 @@ void CherrySimTester::SimulateBroadcastMessage(double x, double y, ble_gap_evt_a
                 s.bleEvent.evt.gap_evt.params.adv_report.rssi = (i8) sim->GetReceptionRssi(sim->currentNode, &(sim->nodes[i]));
                 s.bleEvent.evt.gap_evt.params.adv_report.scan_rsp = 0;
                 s.bleEvent.evt.gap_evt.params.adv_report.type = (u8)sim->currentNode->state.advertisingType;
-                sim->nodes[i].eventQueue.push_back(s);
+                sim->nodes[i].eventQueue.PushBack(s);
             }
         }
     }
@@ -403,9 +782,95 @@ void CherrySimTester::SimulateForGivenTime(int numMilliseconds)
 {
     int startTimeMs = sim->simState.simTimeMs;
 
+    //Skipping idle ticks must not jump over the end of the given time
+    const int lastStepStartTimeMs = startTimeMs + numMilliseconds - (i32)sim->simConfig.simTickDurationMs;
+    sim->idleSkipLimitSimTimeMs = lastStepStartTimeMs > 0 ? (u32)lastStepStartTimeMs : 0;
+
     while (startTimeMs + numMilliseconds > (i32)sim->simState.simTimeMs) {
         sim->SimulateStepForAllNodes();
     }
+
+    sim->idleSkipLimitSimTimeMs = UINT32_MAX;
+}
+
+bool CherrySimTester::SimulateInFork(std::function<void()> scenario)
+{
+#if defined(__unix__)
+    //The scenario may store the flash of its nodes to the flash file of this simulation. The file is backed up
+    //and restored once the scenario is done, so that the next scenario and this simulation find it unchanged.
+    const std::string flashFilePath = sim->simConfig.storeFlashToFile;
+    const std::string flashFileBackupPath = flashFilePath + ".checkpoint";
+    bool flashFileExisted = false;
+    if (flashFilePath != "")
+    {
+        std::error_code error;
+        flashFileExisted = std::filesystem::copy_file(flashFilePath, flashFileBackupPath, std::filesystem::copy_options::overwrite_existing, error);
+    }
+
+    //Buffered output would otherwise be printed by both processes
+    fflush(stdout);
+    fflush(stderr);
+
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        SIMEXCEPTION(IllegalStateException);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        int exitCode = 0;
+        try
+        {
+            sim->PrepareForkedProcess();
+            scenario();
+#ifdef CHERRYSIM_TESTER_ENABLED
+            if (::testing::Test::HasFailure()) exitCode = 1;
+#endif
+        }
+        catch (const std::exception& e)
+        {
+            printf("Scenario failed with %s" EOL, e.what());
+            exitCode = 1;
+        }
+        catch (...)
+        {
+            exitCode = 1;
+        }
+        fflush(stdout);
+        fflush(stderr);
+        //Nothing that belongs to the original process must be cleaned up by the fork
+        _exit(exitCode);
+    }
+
+    int status = 0;
+    const bool waited = waitpid(pid, &status, 0) == pid;
+
+    if (flashFilePath != "")
+    {
+        //Replacing the file keeps the pages intact that this simulation already loaded from it
+        std::error_code error;
+        if (flashFileExisted) std::filesystem::rename(flashFileBackupPath, flashFilePath, error);
+        else std::filesystem::remove(flashFilePath, error);
+        std::filesystem::remove(flashFilePath + ".tmp", error);
+        if (error)
+        {
+            SIMEXCEPTION(FileException);
+            return false;
+        }
+    }
+
+    if (!waited)
+    {
+        SIMEXCEPTION(IllegalStateException);
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+    SIMEXCEPTION(NotImplementedException);
+    return false;
+#endif
 }
 
 void CherrySimTester::SimulateUntilMessageReceived(int timeoutMs, NodeId nodeId, const char* messagePart, ...)
@@ -441,6 +906,7 @@ void CherrySimTester::SimulateUntilMessagesReceived(int timeoutMs, std::vector<S
     if (timeoutMs == 0) SIMEXCEPTION(ZeroTimeoutNotSupportedException);
     useRegex = false;
     awaitedTerminalOutputs = &messages;
+    awaitedMessageMatcher.Compile(messages, useRegex);
 
     _SimulateUntilMessageReceived(timeoutMs, executePerStep);
 }
@@ -463,6 +929,7 @@ void CherrySimTester::SimulateUntilRegexMessagesReceived(int timeoutMs, std::vec
     if (timeoutMs == 0) SIMEXCEPTION(ZeroTimeoutNotSupportedException);
     useRegex = true;
     awaitedTerminalOutputs = &messages;
+    awaitedMessageMatcher.Compile(messages, useRegex);
 
     _SimulateUntilMessageReceived(timeoutMs);
 }
@@ -611,21 +1078,10 @@ void CherrySimTester::TerminalPrintHandler(NodeEntry* currentNode, const char* m
 
     if (awaitedMessageResult[awaitedMessagePointer - 1] == '\n') {
         awaitedMessageResult[awaitedMessagePointer - 1] = '\0';
-        std::vector<SimulationMessage>& awaited = *this->awaitedTerminalOutputs;
-        for (unsigned int i = 0; i < awaited.size(); i++) {
-            if (!awaited[i].IsFound()) {
-                if (sim->currentNode->id == awaited[i].GetNodeId())
-                {
-                    if (awaited[i].CheckAndSet(awaitedMessageResult.data(), useRegex))
-                    {
-                        break; //A received message should validate only one awaited message.
-                    }
-                }
-            }
-        }
-        
-        awaitedMessagesFound = std::all_of(awaited.begin(), awaited.end(), [](const SimulationMessage& sm) {return sm.IsFound(); });
-        
+        //A received message validates at most one awaited message of its node
+        awaitedMessageMatcher.ProcessLine(currentNode->id, awaitedMessageResult.data());
+        awaitedMessagesFound = awaitedMessageMatcher.AreAllMessagesFound();
+
         awaitedMessagePointer = 0;
     }
 }
@@ -30,6 +30,7 @@
 #pragma once
 
 #include <CherrySim.h>
+#include "TerminalMessageMatcher.h"
 
 constexpr int MAX_TERMINAL_OUTPUT = 1024;
 
@@ -41,6 +42,7 @@ struct CherrySimTesterConfig
 
 class SimulationMessage
 {
+    friend class TerminalMessageMatcher;
 private:
     NodeId      nodeId;
     std::string messagePart;
@@ -69,6 +71,7 @@ public:
     bool useRegex = false;
     u16 awaitedMessagePointer = 0;
     bool awaitedMessagesFound = false;
+    TerminalMessageMatcher awaitedMessageMatcher;
 
     //Used for awaiting specific ble events
     NodeId awaitedBleEventNodeId = 0;
@@ -79,6 +82,9 @@ public:
 
     bool appendCrcToMessages = true;
 
+    //Set by the ReplayRerun argument, all testers then log their replay commands and print the complete terminal output
+    static inline bool recordReplays = false;
+
 private:
     std::array<char, MAX_TERMINAL_OUTPUT> awaitedMessageResult = { '\0' };
     CherrySimTesterConfig config = {};
@@ -124,6 +130,14 @@ public:
     void SimulateBroadcastMessage(double x, double y, ble_gap_evt_adv_report_t& advReport, bool ignoreDropProb);
     void SendTerminalCommand(NodeId nodeId, const char* message, ...);
     void SendButtonPress(NodeId nodeId, u8 buttonId, u32 holdTimeDs);
+
+    //### Checkpoints
+    //Runs the given scenario on a copy of the complete simulation (all nodes including their flash, the SoftDevice
+    //state, event queues and random number generators). The copy is created by forking the process, so the simulation
+    //of this tester is left untouched and many scenarios can branch off the same state, e.g. a clustered mesh.
+    //The flash file of the simulation (see SimConfiguration::storeFlashToFile) is restored once the scenario is done.
+    //Returns false if the scenario threw an exception or a test assertion failed in it. Only supported on POSIX systems.
+    bool SimulateInFork(std::function<void()> scenario);
     
     //### Callbacks
     //Inherited via TerminalPrintListener
@@ -66,8 +66,11 @@ void to_json(nlohmann::json& j, const SimConfiguration & config)
         { "fastLaneToSimTimeMs"               , config.fastLaneToSimTimeMs               },
         { "enableClusteringValidityCheck"     , config.enableClusteringValidityCheck     },
         { "enableSimStatistics"               , config.enableSimStatistics               },
+        { "enableProfiler"                    , config.enableProfiler                    },
         { "storeFlashToFile"                  , config.storeFlashToFile                  },
         { "verboseCommands"                   , config.verboseCommands                   },
+        { "numParallelNodeWorkers"            , config.numParallelNodeWorkers            },
+        { "skipIdleTicks"                     , config.skipIdleTicks                     },
         { "defaultBleStackType"               , config.defaultBleStackType               },
     };
 }
@@ -113,8 +116,11 @@ void from_json(const nlohmann::json & j, SimConfiguration & config)
         else if(it.key() == "fastLaneToSimTimeMs"               ) config.fastLaneToSimTimeMs               = *it;
         else if(it.key() == "enableClusteringValidityCheck"     ) config.enableClusteringValidityCheck     = *it;
         else if(it.key() == "enableSimStatistics"               ) config.enableSimStatistics               = *it;
+        else if(it.key() == "enableProfiler"                    ) config.enableProfiler                    = *it;
         else if(it.key() == "storeFlashToFile"                  ) config.storeFlashToFile                  = *it;
         else if(it.key() == "verboseCommands"                   ) config.verboseCommands                   = *it;
+        else if(it.key() == "numParallelNodeWorkers"            ) config.numParallelNodeWorkers            = *it;
+        else if(it.key() == "skipIdleTicks"                     ) config.skipIdleTicks                     = *it;
         else if(it.key() == "defaultBleStackType"               ) config.defaultBleStackType               = *it;
         else SIMEXCEPTION(UnknownJsonEntryException);
     }
@@ -34,9 +34,15 @@
 #include <map>
 #include <array>
 #include <string>
+#include <vector>
+#include <functional>
 #include "MersenneTwister.h"
 #include "json.hpp"
 #include "MoveAnimation.h"
+#include "PacketStatTable.h"
+#include "SimStatistics.h"
+#include "SimProfiler.h"
+#include "SimBleEventQueue.h"
 #if IS_ACTIVE(CLC_MODULE)
 #include "ClcMock.h"
 #endif //ACTIVATE_CLC_MODULE
@@ -49,7 +55,7 @@ extern "C" {
 
 //Making the instance available to softdevice calls and others
 class CherrySim;
-extern CherrySim* cherrySimInstance;
+extern thread_local CherrySim* cherrySimInstance;
 
 constexpr int SIM_EVT_QUEUE_SIZE = 50;
 constexpr int SIM_MAX_CONNECTION_NUM = 10; //Maximum total num of connections supported by the simulator
@@ -60,26 +66,8 @@ constexpr int SIM_NUM_UNRELIABLE_BUFFERS = 7;
 constexpr int SIM_NUM_SERVICES = 6;
 constexpr int SIM_NUM_CHARS    = 5;
 
-constexpr int PACKET_STAT_SIZE = 10*1024;
-
-#define PSRNG(prob) (cherrySimInstance->simState.rnd.NextPsrng((prob)))
-#define PSRNGINT(min, max) ((u32)cherrySimInstance->simState.rnd.NextU32(min, max)) //Generates random int from min (inclusive) up to max (inclusive)
-
-//A BLE Event that is sent by the Simulator is wrapped
-struct simBleEvent {
-    ble_evt_t bleEvent;
-    // The overflow area for ble_evt_t, as sizeof(ble_evt_t) does not include
-    // the memory used for storing write data. The ble_evt_t is used more like
-    // an event header with additional data written directly after it.
-    // Use the maximum MTU as the size of the overflow area.
-    // IMPORTANT: This must always be the member directly after the ble_evt_t
-    //            member!
-    u8 bleEventOverflowData[NRF_SDH_BLE_GATT_MAX_MTU_SIZE];
-
-    u32 size;
-    u32 globalId;
-    u32 additionalInfo; //Can be used to store a pointer or other information
-};
+#define PSRNG(prob) (cherrySimInstance->GetRandom().NextPsrng((prob)))
+#define PSRNGINT(min, max) ((u32)cherrySimInstance->GetRandom().NextU32(min, max)) //Generates random int from min (inclusive) up to max (inclusive)
 
 
 //A packet that is buffered in the SoftDevice for sending
@@ -100,19 +88,6 @@ struct SoftDeviceBufferedPacket {
 
 };
 
-#pragma pack(push, 1)
-struct PacketStat {
-    MessageType messageType = MessageType::INVALID;
-    ModuleIdWrapper moduleId = INVALID_WRAPPED_MODULE_ID;
-    u8 actionType = 0;
-    u8 isSplit = 0;
-    u8 requestHandle = 0;
-    u32 count = 0;
-};
-constexpr int packetStatCompareBytes = sizeof(PacketStat) - sizeof(u32);
-static_assert(sizeof(PacketStat) == 12);
-#pragma pack(pop)
-
 
 //Simulator ble connection representation
 struct SoftdeviceConnection {
@@ -142,6 +117,8 @@ struct SoftdeviceConnection {
     bool connParamUpdateRequestPending = false;
     u32 connParamUpdateRequestTimeoutDs = 0;
     FruityHal::BleGapConnParams connParamUpdateRequestParameters = {};
+    // Whether the central had a request pending when the nodes were last stepped in parallel (only used when isCentral == false)
+    bool partnerConnParamUpdateRequestPendingAtStepStart = false;
 };
 
 struct CharacteristicDB_t
@@ -250,9 +227,9 @@ struct NodeEntry {
     NRF_UICR_Type uicr;
     NRF_GPIO_Type gpio;
     NRF_RADIO_Type radio;
-    u8 flash[SIM_MAX_FLASH_SIZE];
+    u8* flash = nullptr; //SIM_MAX_FLASH_SIZE bytes, provided by the SparseFlash of the simulator
     SoftdeviceState state;
-    std::deque<simBleEvent> eventQueue;
+    SimBleEventQueue eventQueue;
     simBleEvent currentEvent; //The event currently being processed, as a simBleEvent, this can have some additional data attached to it useful for debugging
     bool led1On = false;
     bool led2On = false;
@@ -266,7 +243,7 @@ struct NodeEntry {
     u32 lastWatchdogFeedTime = 0; //The timestamp at which the watchdog was fed last.
     RebootReason rebootReason = RebootReason::UNKNOWN;
 
-    std::vector<int> impossibleConnection; //The rssi to these nodes is artificially increased to an unconnectable level.
+    std::vector<int> impossibleConnection; //The rssi to these nodes is artificially increased to an unconnectable level. Use CherrySim::AddImpossibleConnection to modify.
 
     std::map<u32, InterruptSettings> gpioInitializedPins; // Map from pin to settings
     std::queue<u32> interruptQueue;
@@ -291,8 +268,10 @@ struct NodeEntry {
     u8 bleStackMaxCentralConnections;
 
     //Statistics
-    PacketStat sentPackets[PACKET_STAT_SIZE];
-    PacketStat routedPackets[PACKET_STAT_SIZE];
+    PacketStatTable sentPackets;
+    PacketStatTable routedPackets;
+    SimStatTable statistics; //Collected with SIMSTATCOUNT and SIMSTATAVG
+    SimProfile profile; //Collected with SIM_PROFILE_SCOPE if enableProfiler is set
 
     MoveAnimation animation;
 
@@ -301,6 +280,12 @@ struct NodeEntry {
     bool timeslotCloseSessionRequested = false;
     bool timeslotRequested = false;
     bool timeslotActive = false;
+
+    // Parallel node stepping, see SimConfiguration::numParallelNodeWorkers
+    MersenneTwister rnd; //Random numbers drawn by this node while its firmware runs on a worker
+    std::vector<std::function<void()>> deferredEffects; //Effects on other nodes or on the simulator, applied in node order once all workers are done
+    u32 parallelStepEventIds = 0; //Amount of event ids generated by this node in the current parallel phase
+    u32 parallelStepPacketIds = 0; //Amount of packet ids generated by this node in the current parallel phase
 };
 
 
@@ -355,10 +340,14 @@ struct SimConfiguration {
 
     bool        enableClusteringValidityCheck      = false; //Enable automatic checking of the clustering after each step
     bool        enableSimStatistics                = false;
+    bool        enableProfiler                     = false; //Measures the time spent in the firmware per node and code path, see SimProfiler.h
     std::string storeFlashToFile                   = "";
 
     bool        verboseCommands                    = false;
 
+    uint32_t    numParallelNodeWorkers             = 0; //0 steps all nodes sequentially, otherwise the firmware of the nodes is executed on this many threads (including the calling one)
+    bool        skipIdleTicks                      = false; //If set, ticks in which no node has anything to do are skipped in non realTime mode. Changes the random sequence compared to stepping every tick.
+
 
     //BLE Stack capabilities
     BleStackType defaultBleStackType          = BleStackType::INVALID;
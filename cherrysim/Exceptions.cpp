@@ -30,8 +30,9 @@
 #include "Exceptions.h"
 #include <map>
 
-static std::map<std::type_index, int> ignoredExceptions;
-static int disableDebugBreakOnExceptionCounter = 0;
+//Thread local, as every thread might run its own simulation
+static thread_local std::map<std::type_index, int> ignoredExceptions;
+static thread_local int disableDebugBreakOnExceptionCounter = 0;
 
 bool Exceptions::GetDebugBreakOnException()
 {
@@ -72,6 +73,20 @@ bool Exceptions::IsExceptionEnabledByIndex(std::type_index index)
     }
 }
 
+Exceptions::ThreadConfiguration Exceptions::GetThreadConfiguration()
+{
+    ThreadConfiguration configuration;
+    configuration.ignoredExceptions = ignoredExceptions;
+    configuration.disableDebugBreakOnExceptionCounter = disableDebugBreakOnExceptionCounter;
+    return configuration;
+}
+
+void Exceptions::SetThreadConfiguration(const ThreadConfiguration& configuration)
+{
+    ignoredExceptions = configuration.ignoredExceptions;
+    disableDebugBreakOnExceptionCounter = configuration.disableDebugBreakOnExceptionCounter;
+}
+
 Exceptions::DisableDebugBreakOnException::DisableDebugBreakOnException()
 {
     disableDebugBreakOnExceptionCounter++;
@@ -31,6 +31,7 @@
 
 
 #include <set>
+#include <map>
 #include <string>
 #include <typeinfo>
 #include <exception>
@@ -133,6 +134,17 @@ namespace Exceptions {
     }
 
     bool GetDebugBreakOnException();
+
+    //The configuration is thread local. Threads that simulate nodes on behalf of
+    //another thread copy its configuration so that they behave identically.
+    struct ThreadConfiguration
+    {
+        std::map<std::type_index, int> ignoredExceptions;
+        int disableDebugBreakOnExceptionCounter = 0;
+    };
+    ThreadConfiguration GetThreadConfiguration();
+    void SetThreadConfiguration(const ThreadConfiguration& configuration);
+
     class DisableDebugBreakOnException {
     public:
         DisableDebugBreakOnException();
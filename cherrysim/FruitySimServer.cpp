@@ -71,8 +71,9 @@ using json = nlohmann::json;
 WSADATA wsaData;
 static bool WSAStartupWasCalled = false;
 #endif //_WIN32
-event_base* eventBase = nullptr;
-std::unique_ptr<evhttp, decltype(&evhttp_free)>* server = nullptr;
+//Each thread that runs a simulation has its own server, only one of them will be able to bind the port
+thread_local event_base* eventBase = nullptr;
+thread_local std::unique_ptr<evhttp, decltype(&evhttp_free)>* server = nullptr;
 
 
 //HACK! WSAStartup has a memory leak when called several times, even then WSACleanup is called the same
@@ -113,7 +114,7 @@ int FruitySimServer::StartServer()
     }
 #endif // _WIN32
     
-    eventBase = event_init();
+    eventBase = event_base_new();
 
     if (!eventBase)
     {
@@ -123,23 +124,37 @@ int FruitySimServer::StartServer()
 
     char const SrvAddress[] = "0.0.0.0";
     std::uint16_t SrvPort = 5555;
-    server = new std::unique_ptr<evhttp, decltype(&evhttp_free)>(evhttp_start(SrvAddress, SrvPort), &evhttp_free);
-    if (!server)
+    server = new std::unique_ptr<evhttp, decltype(&evhttp_free)>(evhttp_new(eventBase), &evhttp_free);
+    if (!server->get())
     {
         std::cerr << "Failed to init http server." << std::endl;
         return -1;
     }
+    if (evhttp_bind_socket(server->get(), SrvAddress, SrvPort) != 0)
+    {
+        //Happens if another simulation (e.g. on another thread) already serves the fruitymap
+        std::cerr << "Failed to bind http server to port " << SrvPort << ", not serving fruitymap." << std::endl;
+    }
 
-    void(*OnReq)(evhttp_request *req, void *) = [](evhttp_request *req, void *)
+    void(*OnReq)(evhttp_request *req, void *) = [](evhttp_request *req, void * arg)
     {
         FILE* file = nullptr;
+        FruitySimServer* simServer = (FruitySimServer*)arg;
     
         auto *OutBuf = evhttp_request_get_output_buffer(req);
         if (!OutBuf)
             return;
 
-        if (strstr(req->uri, "/devices") != nullptr)
+        if (strstr(req->uri, "/changes") != nullptr)
         {
+            //Answered now or later, once something changed
+            simServer->HandleChangeRequest(req);
+            return;
+        }
+        else if (strstr(req->uri, "/devices") != nullptr)
+        {
+            //The full state must match the sequence number that it is sent with
+            simServer->PublishMapChanges(true);
             std::string devices = GenerateDevicesJson();
     
             evbuffer_add_printf(OutBuf, "%s", devices.c_str());
@@ -195,7 +210,7 @@ int FruitySimServer::StartServer()
         evhttp_send_reply(req, HTTP_OK, "OK", OutBuf);
     };
     
-    evhttp_set_gencb(server->get(), OnReq, nullptr);
+    evhttp_set_gencb(server->get(), OnReq, this);
 #endif // SIM_SERVER_PRESENT
     return 0;
 }
@@ -203,9 +218,12 @@ int FruitySimServer::StartServer()
 FruitySimServer::~FruitySimServer()
 {
 #if defined(SIM_SERVER_PRESENT)
+    //Pending requests are freed together with the http server
+    pendingChangeRequests.clear();
     if (server != nullptr) delete server;
     server = nullptr;
-    event_base_free(eventBase);
+    if (eventBase != nullptr) event_base_free(eventBase);
+    eventBase = nullptr;
 #endif // SIM_SERVER_PRESENT
 }
 
@@ -215,10 +233,178 @@ void FruitySimServer::ProcessServerRequests()
 {
     MersenneTwisterDisabler disabler;
 #if defined(SIM_SERVER_PRESENT)
-    event_base_loop(eventBase, EVLOOP_NONBLOCK);
+    if (eventBase != nullptr) event_base_loop(eventBase, EVLOOP_NONBLOCK);
+    if (!pendingChangeRequests.empty()) AnswerPendingChangeRequests();
 #endif // SIM_SERVER_PRESENT
 }
 
+void FruitySimServer::CaptureMapState(u32 nodeIndex, SimMapNodeState& outState)
+{
+    NodeIndexSetter nodeIndexSetter(nodeIndex);
+    NodeEntry* node = &cherrySimInstance->nodes[nodeIndex];
+
+    outState.x = node->x;
+    outState.y = node->y;
+
+    outState.clusterId = node->gs.node.clusterId;
+    outState.clusterSize = node->gs.node.GetClusterSize();
+    outState.nodeId = node->gs.node.configuration.nodeId;
+
+    outState.connections.clear();
+    for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
+        if (node->state.connections[j].connectionActive) {
+            outState.connections.push_back({ (u16)node->state.connections[j].connectionHandle, node->state.connections[j].partner->gs.node.configuration.nodeId });
+        }
+    }
+
+    //Get the only handshaked inConnection
+    //TODO: The inConnection is only used to draw the direction arrow in the fruitymap, but currently
+    //the json only supports communicating 1 inConnection, this should be changed at some point so that
+    //Each connection can report its direction and masterBit
+    auto inConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
+    MeshConnection* inConnection = nullptr;
+    for (int k = 0; k < inConnections.count; k++) {
+        if (inConnections.handles[k] && inConnections.handles[k].IsHandshakeDone()) {
+            inConnection = inConnections.handles[k].GetConnection();
+        }
+    }
+
+    outState.ledOn = node->led1On || node->led2On || node->led3On;
+    outState.freeIn = node->gs.cm.freeMeshInConnections;
+    outState.freeOut = node->gs.cm.freeMeshOutConnections;
+    outState.inConnectionPartner = inConnection == nullptr ? 0 : inConnection->partnerId;
+    outState.inConnectionHasMasterBit = inConnection != nullptr && inConnection->connectionMasterBit == 1;
+    outState.inConnectionPartnerHasMasterBit = false;
+    outState.inConnectionRssi = 0;
+
+    if (inConnection != nullptr) {
+        //We must check if the simulator connection still exists as it might have been cleaned up already
+        //FIXME: This mixes fruitymesh and simulator connections, but should only use simulator data
+        SoftdeviceConnection* foundSoftdeviceConnection = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
+        if (foundSoftdeviceConnection != nullptr) {
+            NodeEntry* partnerNode = foundSoftdeviceConnection->partner;
+            MeshConnections conn = partnerNode->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
+            for (int k = 0; k < conn.count; k++) {
+                if (conn.handles[k] && conn.handles[k].GetConnectionHandle() == inConnection->connectionHandle) {
+                    outState.inConnectionPartnerHasMasterBit = conn.handles[k].GetConnection()->connectionMasterBit;
+                }
+            }
+            outState.inConnectionRssi = (i32)cherrySimInstance->GetReceptionRssiNoNoise(node, partnerNode);
+        }
+    }
+
+    outState.connectionLossCounter = node->gs.node.connectionLossCounter;
+
+    outState.advertisingDataLength = 0;
+    if (node->state.advertisingActive) {
+        outState.advertisingDataLength = (u8)std::min<u32>(node->state.advertisingDataLength, sizeof(outState.advertisingData));
+        CheckedMemcpy(outState.advertisingData, node->state.advertisingData, outState.advertisingDataLength);
+    }
+}
+
+#if defined(SIM_SERVER_PRESENT)
+//Captures are cheap but frequent polls of a busy mesh would still capture the same nodes over and over
+static constexpr std::chrono::milliseconds MAP_PUBLISH_INTERVAL(100);
+//A long poll is answered with an empty change set after this time so that proxies and browsers do not give up on it
+static constexpr std::chrono::seconds CHANGE_REQUEST_TIMEOUT(10);
+
+void FruitySimServer::PublishMapChanges(bool force)
+{
+    MersenneTwisterDisabler disabler;
+    const auto now = std::chrono::steady_clock::now();
+    if (!force && now - lastMapPublishTime < MAP_PUBLISH_INTERVAL) return;
+    lastMapPublishTime = now;
+
+    cherrySimInstance->mapChangeFeed.Publish(&FruitySimServer::CaptureMapState);
+}
+
+bool FruitySimServer::TryAnswerChangeRequest(evhttp_request* request, u32 epoch, u32 sequence, bool timedOut)
+{
+    const bool resync = !cherrySimInstance->mapChangeFeed.CollectChangesSince(epoch, sequence, collectedChanges);
+    if (!resync && collectedChanges.empty() && !timedOut) return false;
+
+    const std::string changes = GenerateChangesJson(collectedChanges, resync);
+    evbuffer* outBuffer = evhttp_request_get_output_buffer(request);
+    evbuffer_add(outBuffer, changes.data(), changes.size());
+    evhttp_add_header(evhttp_request_get_output_headers(request), "Content-Type", "application/json");
+    evhttp_add_header(evhttp_request_get_output_headers(request), "Cache-Control", "no-cache");
+    evhttp_send_reply(request, HTTP_OK, "OK", outBuffer);
+    return true;
+}
+
+//Long poll for the map changes after a sequence number: /simulator/changes?epoch=<epoch>&since=<sequence>
+//Both values are taken from the last /devices or /changes response
+void FruitySimServer::HandleChangeRequest(evhttp_request* request)
+{
+    MersenneTwisterDisabler disabler;
+    u32 epoch = 0;
+    u32 sequence = 0;
+
+    evkeyvalq queryParameters;
+    const char* query = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(request));
+    if (query != nullptr && evhttp_parse_query_str(query, &queryParameters) == 0)
+    {
+        const char* epochParameter = evhttp_find_header(&queryParameters, "epoch");
+        const char* sinceParameter = evhttp_find_header(&queryParameters, "since");
+        if (epochParameter != nullptr) epoch = (u32)strtoul(epochParameter, nullptr, 10);
+        if (sinceParameter != nullptr) sequence = (u32)strtoul(sinceParameter, nullptr, 10);
+        evhttp_clear_headers(&queryParameters);
+    }
+
+    PublishMapChanges(false);
+    if (TryAnswerChangeRequest(request, epoch, sequence, false)) return;
+
+    //The request is freed by libevent if the browser goes away, it must not be answered afterwards
+    evhttp_connection_set_closecb(evhttp_request_get_connection(request), &FruitySimServer::OnConnectionClosed, this);
+
+    PendingChangeRequest pending;
+    pending.request = request;
+    pending.epoch = epoch;
+    pending.sequence = sequence;
+    pending.deadline = std::chrono::steady_clock::now() + CHANGE_REQUEST_TIMEOUT;
+    pendingChangeRequests.push_back(pending);
+}
+
+void FruitySimServer::AnswerPendingChangeRequests()
+{
+    MersenneTwisterDisabler disabler;
+    PublishMapChanges(false);
+
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < pendingChangeRequests.size(); )
+    {
+        const PendingChangeRequest& pending = pendingChangeRequests[i];
+        if (TryAnswerChangeRequest(pending.request, pending.epoch, pending.sequence, now >= pending.deadline))
+        {
+            evhttp_connection_set_closecb(evhttp_request_get_connection(pending.request), nullptr, nullptr);
+            pendingChangeRequests[i] = pendingChangeRequests.back();
+            pendingChangeRequests.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void FruitySimServer::OnConnectionClosed(evhttp_connection* connection, void* server)
+{
+    std::vector<PendingChangeRequest>& pendingRequests = ((FruitySimServer*)server)->pendingChangeRequests;
+    for (size_t i = 0; i < pendingRequests.size(); )
+    {
+        if (evhttp_request_get_connection(pendingRequests[i].request) == connection)
+        {
+            pendingRequests[i] = pendingRequests.back();
+            pendingRequests.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+#endif // SIM_SERVER_PRESENT
+
 #if defined(SIM_SERVER_PRESENT)
 std::string FruitySimServer::GenerateSiteJson()
 {
@@ -235,28 +421,31 @@ std::string FruitySimServer::GenerateSiteJson()
 #endif // SIM_SERVER_PRESENT
 
 #if defined(SIM_SERVER_PRESENT)
+static std::string AdvertisingDataToString(const SimMapNodeState& state)
+{
+    if (state.advertisingDataLength == 0) return "Not advertising";
+
+    char advData[200];
+    Logger::ConvertBufferToHexString(state.advertisingData, state.advertisingDataLength, advData, sizeof(advData));
+    return advData;
+}
+
+//Generates the state of all nodes as it was last published by the map change feed
 std::string FruitySimServer::GenerateDevicesJson()
 {
     MersenneTwisterDisabler disabler;
+    const SimMapChangeFeed& feed = cherrySimInstance->mapChangeFeed;
     json devices;
     devices["status"] = "success";
-    for (unsigned int i = 0; i < cherrySimInstance->GetTotalNodes(); i++) {
+    devices["epoch"] = feed.GetEpoch();
+    devices["sequence"] = feed.GetSequence();
+    devices["result"] = json::array();
+    for (unsigned int i = 0; i < feed.GetAmountOfNodes(); i++) {
         NodeIndexSetter nodeIndexSetter(i);
         NodeEntry* node = &cherrySimInstance->nodes[i];
+        const SimMapNodeState& state = feed.GetPublishedState(i);
         json device;
 
-        //Get the only handshaked inConnection
-        //TODO: The inConnection is only used to draw the direction arrow in the fruitymap, but currently
-        //the json only supports communicating 1 inConnection, this should be changed at some point so that
-        //Each connection can report its direction and masterBit
-        auto inConnections = node->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_IN);
-        MeshConnection* inConnection = nullptr;
-        for (int k = 0; k < inConnections.count; k++) {
-            if (inConnections.handles[k] && inConnections.handles[k].IsHandshakeDone()) {
-                inConnection = inConnections.handles[k].GetConnection();
-            }
-        }
-
         //UUID is generated based on the node index
         char uuid[50];
         sprintf(uuid, "00000000-1111-2222-3333-00000000%04u", node->index);
@@ -264,83 +453,85 @@ std::string FruitySimServer::GenerateDevicesJson()
         device["uuid"] = uuid;
         device["deviceId"] = node->gs.config.GetSerialNumber();
         device["platform"] = "BLENODE";
-        device["ledOn"] = node->led1On || node->led2On || node->led3On;
-        device["inConnectionHasMasterBit"] = false;
-        device["inConnectionPartnerHasMasterBit"] = false;
-
-        //Find out who has the master bit of the inConnection
-        if(inConnection != nullptr) device["inConnectionHasMasterBit"] = inConnection->connectionMasterBit == 1;
-
-        bool partnerHasMB = false;
-
-        if (inConnection != nullptr) {
-            SoftdeviceConnection* foundSoftdeviceConnection = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
-            //We must check if the simulator connection still exists as it might have been cleaned up already
-            if (foundSoftdeviceConnection != nullptr) {
-                NodeEntry* partnerNode = foundSoftdeviceConnection->partner;
-                MeshConnections conn = partnerNode->gs.cm.GetMeshConnections(ConnectionDirection::DIRECTION_OUT);
-                for (int k = 0; k < conn.count; k++) {
-                    if (conn.handles[k] && conn.handles[k].GetConnectionHandle() == inConnection->connectionHandle) {
-                        partnerHasMB = conn.handles[k].GetConnection()->connectionMasterBit;
-                    }
-                }
-            }
-        }
-
-        device["inConnectionPartnerHasMasterBit"] = partnerHasMB;
-
-        device["connectionLossCounter"] = node->gs.node.connectionLossCounter;
-        device["inConnectionPartner"] = inConnection == nullptr ? 0 : inConnection->partnerId;
-
-
-        //FIXME: This mixes fruitymesh and simulator connections, but should only use simulator data
-        if (inConnection != nullptr) {
-            SoftdeviceConnection* sdInConn = cherrySimInstance->FindConnectionByHandle(node, inConnection->connectionHandle);
-            if (sdInConn != nullptr) device["inConnectionRssi"] = (int)cherrySimInstance->GetReceptionRssiNoNoise(node, sdInConn->partner);
-        }
-        else {
-            device["inConnectionRssi"] = 0;
-        }
-
-
-        char advData[200];
-        if (node->state.advertisingActive) {
-            Logger::ConvertBufferToHexString(node->state.advertisingData, node->state.advertisingDataLength, advData, sizeof(advData));
-        }
-        else {
-            sprintf(advData, "Not advertising");
-        }
+        device["ledOn"] = state.ledOn;
+        device["inConnectionHasMasterBit"] = state.inConnectionHasMasterBit;
+        device["inConnectionPartnerHasMasterBit"] = state.inConnectionPartnerHasMasterBit;
+        device["connectionLossCounter"] = state.connectionLossCounter;
+        device["inConnectionPartner"] = state.inConnectionPartner;
+        device["inConnectionRssi"] = state.inConnectionRssi;
 
         device["details"] = {
             {"platform", "BLENODE"},
-            {"clusterId", node->gs.node.clusterId},
-            {"clusterSize", node->gs.node.GetClusterSize()},
-            {"nodeId", node->gs.node.configuration.nodeId},
+            {"clusterId", state.clusterId},
+            {"clusterSize", state.clusterSize},
+            {"nodeId", state.nodeId},
             {"serialNumber", node->gs.config.GetSerialNumber()},
             {"connections", json::array()},
             {"nonConnections", json::array()},
-            {"lastSentAdvertisingMessage", advData},
-            {"freeIn", node->gs.cm.freeMeshInConnections},
-            {"freeOut", node->gs.cm.freeMeshOutConnections}
+            {"lastSentAdvertisingMessage", AdvertisingDataToString(state)},
+            {"freeIn", state.freeIn},
+            {"freeOut", state.freeOut}
         };
-        for (int j = 0; j < node->state.configuredTotalConnectionCount; j++) {
-            if (node->state.connections[j].connectionActive) {
-                json connection;
-                connection["handle"] = node->state.connections[j].connectionHandle;
-                connection["rssi"] = 7;
-                connection["target"] = node->state.connections[j].partner->gs.node.configuration.nodeId;
-
-                device["details"]["connections"].push_back(connection);
-            }
+        for (const SimMapNodeState::Connection& connection : state.connections) {
+            device["details"]["connections"].push_back({
+                {"handle", connection.handle},
+                {"rssi", 7},
+                {"target", connection.target}
+            });
         }
         device["properties"] = {
             {"onMap", "true"},
-            {"x", node->x},
-            {"y", node->y}
+            {"x", state.x},
+            {"y", state.y}
         };
         devices["result"].push_back(device);
     }
 
     return devices.dump(4);
 }
+
+//Generates the compact change set that is applied by the fruitymap to the result of /devices
+//Only the groups of a node that changed are sent: p = position, c = cluster, n = connections, s = state
+std::string FruitySimServer::GenerateChangesJson(const std::vector<SimMapChangeFeed::Change>& changes, bool resync)
+{
+    const SimMapChangeFeed& feed = cherrySimInstance->mapChangeFeed;
+    json result;
+    result["epoch"] = feed.GetEpoch();
+    result["sequence"] = feed.GetSequence();
+    result["resync"] = resync;
+    result["nodes"] = json::array();
+    for (const SimMapChangeFeed::Change& change : changes) {
+        const SimMapNodeState& state = feed.GetPublishedState(change.nodeIndex);
+        json node;
+        node["i"] = change.nodeIndex;
+        if (change.groups & SimMapChangeFeed::GROUP_POSITION) {
+            node["p"] = { state.x, state.y };
+        }
+        if (change.groups & SimMapChangeFeed::GROUP_CLUSTER) {
+            node["c"] = { state.clusterId, state.clusterSize, state.nodeId };
+        }
+        if (change.groups & SimMapChangeFeed::GROUP_CONNECTIONS) {
+            node["n"] = json::array();
+            for (const SimMapNodeState::Connection& connection : state.connections) {
+                node["n"].push_back({ connection.handle, connection.target });
+            }
+        }
+        if (change.groups & SimMapChangeFeed::GROUP_STATE) {
+            node["s"] = {
+                {"led", state.ledOn},
+                {"in", state.freeIn},
+                {"out", state.freeOut},
+                {"partner", state.inConnectionPartner},
+                {"mb", state.inConnectionHasMasterBit},
+                {"partnerMb", state.inConnectionPartnerHasMasterBit},
+                {"rssi", state.inConnectionRssi},
+                {"loss", state.connectionLossCounter},
+                {"adv", AdvertisingDataToString(state)}
+            };
+        }
+        result["nodes"].push_back(node);
+    }
+
+    return result.dump();
+}
 #endif // SIM_SERVER_PRESENT
@@ -30,6 +30,13 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <chrono>
+#include <FmTypes.h>
+#include <SimMapChangeFeed.h>
+
+struct evhttp_request;
+struct evhttp_connection;
 
 class FruitySimServer
 {
@@ -40,10 +47,31 @@ public:
     //Call periodically so that the server can process requests
     void ProcessServerRequests();
 
+    //Fills the fruitymap state of a node, used by the SimMapChangeFeed of the simulator
+    static void CaptureMapState(u32 nodeIndex, SimMapNodeState& outState);
+
 private:
+    //A long poll for map changes that is answered as soon as something changed or once it timed out
+    struct PendingChangeRequest
+    {
+        evhttp_request* request = nullptr;
+        u32 epoch = 0;
+        u32 sequence = 0;
+        std::chrono::steady_clock::time_point deadline;
+    };
+    std::vector<PendingChangeRequest> pendingChangeRequests;
+    std::chrono::steady_clock::time_point lastMapPublishTime;
+    std::vector<SimMapChangeFeed::Change> collectedChanges;
+
     int StartServer();
 
+    void PublishMapChanges(bool force);
+    bool TryAnswerChangeRequest(evhttp_request* request, u32 epoch, u32 sequence, bool timedOut);
+    void HandleChangeRequest(evhttp_request* request);
+    void AnswerPendingChangeRequests();
+    static void OnConnectionClosed(evhttp_connection* connection, void* server);
+
     static std::string GenerateDevicesJson();
     static std::string GenerateSiteJson();
+    static std::string GenerateChangesJson(const std::vector<SimMapChangeFeed::Change>& changes, bool resync);
 };
-
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "LinkBudgetCache.h"
+
+LinkBudgetCache::Entry* LinkBudgetCache::GetEntry(u32 senderIndex, u32 receiverIndex)
+{
+    if (amountOfNodes <= maxNodesForDenseCache)
+    {
+        return &denseEntries[senderIndex * amountOfNodes + receiverIndex];
+    }
+    else
+    {
+        //Generation 0 is never used by a node so that new entries are always invalid
+        return &sparseEntries[((uint64_t)senderIndex << 32) | receiverIndex];
+    }
+}
+
+void LinkBudgetCache::Reset(u32 amountOfNodes)
+{
+    this->amountOfNodes = amountOfNodes;
+    nodeGenerations.assign(amountOfNodes, 1);
+    denseEntries.clear();
+    sparseEntries.clear();
+    if (amountOfNodes <= maxNodesForDenseCache)
+    {
+        denseEntries.resize(amountOfNodes * amountOfNodes);
+    }
+    amountOfHits = 0;
+    amountOfMisses = 0;
+}
+
+void LinkBudgetCache::InvalidateNode(u32 nodeIndex)
+{
+    if (nodeIndex >= amountOfNodes) return;
+
+    nodeGenerations[nodeIndex]++;
+    if (nodeGenerations[nodeIndex] == 0) nodeGenerations[nodeIndex] = 1;
+}
+
+void LinkBudgetCache::InvalidateAll()
+{
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        InvalidateNode(i);
+    }
+}
+
+bool LinkBudgetCache::TryGet(u32 senderIndex, u32 receiverIndex, i32 senderPower, float& outRssi)
+{
+    if (senderIndex >= amountOfNodes || receiverIndex >= amountOfNodes) return false;
+
+    const Entry* entry = GetEntry(senderIndex, receiverIndex);
+    if (entry->senderGeneration == nodeGenerations[senderIndex]
+        && entry->receiverGeneration == nodeGenerations[receiverIndex]
+        && entry->senderPower == senderPower)
+    {
+        outRssi = entry->rssi;
+        amountOfHits++;
+        return true;
+    }
+
+    amountOfMisses++;
+    return false;
+}
+
+void LinkBudgetCache::Store(u32 senderIndex, u32 receiverIndex, i32 senderPower, float rssi)
+{
+    if (senderIndex >= amountOfNodes || receiverIndex >= amountOfNodes) return;
+
+    Entry* entry = GetEntry(senderIndex, receiverIndex);
+    entry->senderGeneration = nodeGenerations[senderIndex];
+    entry->receiverGeneration = nodeGenerations[receiverIndex];
+    entry->senderPower = senderPower;
+    entry->rssi = rssi;
+}
+
+u32 LinkBudgetCache::GetAmountOfHits() const
+{
+    return amountOfHits;
+}
+
+u32 LinkBudgetCache::GetAmountOfMisses() const
+{
+    return amountOfMisses;
+}
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "FmTypes.h"
+
+/*
+ * Caches the rssi (without noise) of the link between two simulated nodes so that the
+ * path loss does not have to be recalculated for every packet. Entries are invalidated
+ * lazily: every node has a generation counter that is incremented whenever something
+ * changes that influences its links, e.g. its position. An entry is only valid if the
+ * generations of both nodes and the transmission power of the sender still match.
+ * Small simulations use a dense matrix, bigger ones only store the links that are used.
+ */
+class LinkBudgetCache
+{
+TESTER_PUBLIC:
+    struct Entry
+    {
+        u32 senderGeneration = 0;
+        u32 receiverGeneration = 0;
+        i32 senderPower = 0;
+        float rssi = 0;
+    };
+
+    //A dense matrix for 512 nodes needs about 4MB, above that only the used links are stored
+    static constexpr u32 maxNodesForDenseCache = 512;
+
+    u32 amountOfNodes = 0;
+    std::vector<u32> nodeGenerations;
+    std::vector<Entry> denseEntries;
+    std::unordered_map<uint64_t, Entry> sparseEntries;
+
+    u32 amountOfHits = 0;
+    u32 amountOfMisses = 0;
+
+    Entry* GetEntry(u32 senderIndex, u32 receiverIndex);
+
+public:
+    void Reset(u32 amountOfNodes);
+    void InvalidateNode(u32 nodeIndex);
+    void InvalidateAll();
+
+    //Returns true and writes the cached rssi if a valid entry exists for the link
+    bool TryGet(u32 senderIndex, u32 receiverIndex, i32 senderPower, float& outRssi);
+    void Store(u32 senderIndex, u32 receiverIndex, i32 senderPower, float rssi);
+
+    u32 GetAmountOfHits() const;
+    u32 GetAmountOfMisses() const;
+};
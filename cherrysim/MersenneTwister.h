@@ -29,7 +29,7 @@
 
 class MersenneTwisterDisabler {
 public:
-    static inline int disableLevel = 0;
+    static inline thread_local int disableLevel = 0;
 
     MersenneTwisterDisabler();
     ~MersenneTwisterDisabler();
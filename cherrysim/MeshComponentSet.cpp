@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "MeshComponentSet.h"
+#include "Exceptions.h"
+
+void MeshComponentSet::Reset(u32 amountOfElements)
+{
+    parents.resize(amountOfElements);
+    sizes.assign(amountOfElements, 1);
+    amountOfLinks.assign(amountOfElements, 0);
+    for (u32 i = 0; i < amountOfElements; i++)
+    {
+        parents[i] = i;
+    }
+    amountOfComponents = amountOfElements;
+}
+
+u32 MeshComponentSet::Find(u32 element)
+{
+    if (element >= parents.size())
+    {
+        SIMEXCEPTIONFORCE(IndexOutOfBoundsException);
+        return element;
+    }
+
+    //Path halving keeps the trees flat without needing a second pass or recursion
+    while (parents[element] != element)
+    {
+        parents[element] = parents[parents[element]];
+        element = parents[element];
+    }
+    return element;
+}
+
+bool MeshComponentSet::Union(u32 a, u32 b)
+{
+    u32 rootA = Find(a);
+    u32 rootB = Find(b);
+
+    if (rootA == rootB)
+    {
+        amountOfLinks[rootA]++;
+        return false;
+    }
+
+    //Union by size, the smaller component is attached to the bigger one
+    if (sizes[rootA] < sizes[rootB])
+    {
+        const u32 tmp = rootA;
+        rootA = rootB;
+        rootB = tmp;
+    }
+    parents[rootB] = rootA;
+    sizes[rootA] += sizes[rootB];
+    amountOfLinks[rootA] += amountOfLinks[rootB] + 1;
+    amountOfComponents--;
+    return true;
+}
+
+u32 MeshComponentSet::GetComponentSize(u32 element)
+{
+    return sizes[Find(element)];
+}
+
+u32 MeshComponentSet::GetAmountOfLinks(u32 element)
+{
+    return amountOfLinks[Find(element)];
+}
+
+u32 MeshComponentSet::GetAmountOfComponents() const
+{
+    return amountOfComponents;
+}
+
+u32 MeshComponentSet::GetAmountOfElements() const
+{
+    return (u32)parents.size();
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+
+#include "FmTypes.h"
+
+/*
+ * A disjoint set (union-find) over node indices that is used to group the simulated nodes
+ * into clusters. Besides the size of each component, it also counts the links that were
+ * added to a component so that callers can tell if a component forms a tree.
+ */
+class MeshComponentSet
+{
+TESTER_PUBLIC:
+    std::vector<u32> parents;
+    std::vector<u32> sizes;        //Only valid for the root of a component
+    std::vector<u32> amountOfLinks; //Only valid for the root of a component
+    u32 amountOfComponents = 0;
+
+public:
+    //Puts each of the given amount of elements into its own component
+    void Reset(u32 amountOfElements);
+
+    //Returns the root element of the component that the element belongs to
+    u32 Find(u32 element);
+
+    //Adds a link between the two elements, returns true if two components were merged
+    bool Union(u32 a, u32 b);
+
+    u32 GetComponentSize(u32 element);
+    u32 GetAmountOfLinks(u32 element);
+    u32 GetAmountOfComponents() const;
+    u32 GetAmountOfElements() const;
+};
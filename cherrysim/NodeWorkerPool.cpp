@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "NodeWorkerPool.h"
+
+NodeWorkerPool::NodeWorkerPool(u32 amountOfThreads)
+{
+    for (u32 i = 1; i < amountOfThreads; i++)
+    {
+        threads.emplace_back(&NodeWorkerPool::WorkerMain, this);
+    }
+}
+
+NodeWorkerPool::~NodeWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shuttingDown = true;
+    }
+    runStarted.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+u32 NodeWorkerPool::GetAmountOfThreads() const
+{
+    return (u32)threads.size() + 1;
+}
+
+void NodeWorkerPool::WorkerMain()
+{
+    u32 lastRun = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            runStarted.wait(lock, [&]() { return shuttingDown || runCounter != lastRun; });
+            if (shuttingDown) return;
+            lastRun = runCounter;
+        }
+
+        ProcessJobs();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            amountOfBusyThreads--;
+            if (amountOfBusyThreads == 0) runFinished.notify_one();
+        }
+    }
+}
+
+void NodeWorkerPool::ProcessJobs()
+{
+    bool setupDone = false;
+    u32 jobIndex;
+    while ((jobIndex = nextJob.fetch_add(1, std::memory_order_relaxed)) < amountOfJobs)
+    {
+        if (!setupDone)
+        {
+            (*threadSetup)();
+            setupDone = true;
+        }
+        (*job)(jobIndex);
+    }
+}
+
+void NodeWorkerPool::Run(u32 amountOfJobs, const std::function<void()>& threadSetup, const std::function<void(u32)>& job)
+{
+    if (amountOfJobs == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->threadSetup = &threadSetup;
+        this->job = &job;
+        this->amountOfJobs = amountOfJobs;
+        nextJob.store(0, std::memory_order_relaxed);
+        amountOfBusyThreads = (u32)threads.size();
+        runCounter++;
+    }
+    runStarted.notify_all();
+
+    ProcessJobs();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    runFinished.wait(lock, [&]() { return amountOfBusyThreads == 0; });
+    this->threadSetup = nullptr;
+    this->job = nullptr;
+    this->amountOfJobs = 0;
+}
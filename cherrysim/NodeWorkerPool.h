@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+#include "FmTypes.h"
+
+/*
+ * A fixed set of threads that is used by the simulator to step the firmware of many
+ * nodes in parallel. The jobs of a run are handed out one by one through a shared
+ * counter, so threads that finish early simply pick up the next node and the load is
+ * balanced without any static partitioning. The calling thread takes part in every run.
+ */
+class NodeWorkerPool
+{
+TESTER_PUBLIC:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable runStarted;
+    std::condition_variable runFinished;
+    u32 runCounter = 0;
+    u32 amountOfBusyThreads = 0;
+    bool shuttingDown = false;
+
+    //Only valid during a run
+    const std::function<void()>* threadSetup = nullptr;
+    const std::function<void(u32)>* job = nullptr;
+    u32 amountOfJobs = 0;
+    std::atomic<u32> nextJob{ 0 };
+
+    void WorkerMain();
+    void ProcessJobs();
+
+public:
+    //amountOfThreads includes the calling thread, so 1 does not spawn any additional thread
+    explicit NodeWorkerPool(u32 amountOfThreads);
+    ~NodeWorkerPool();
+
+    NodeWorkerPool(const NodeWorkerPool& other) = delete;
+    NodeWorkerPool& operator=(const NodeWorkerPool& other) = delete;
+
+    u32 GetAmountOfThreads() const;
+
+    //Calls job for every index in [0, amountOfJobs) and returns once all of them are done. Before
+    //a thread takes its first job of the run, threadSetup is called on it. The job must not throw.
+    void Run(u32 amountOfJobs, const std::function<void()>& threadSetup, const std::function<void(u32)>& job);
+};
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "PacketStatTable.h"
+#include <cstring>
+
+u32 PacketStatTable::Hash(const PacketStat& packet)
+{
+    static_assert(packetStatCompareBytes == sizeof(uint64_t), "The key must fit into a single word");
+    uint64_t key;
+    memcpy(&key, &packet, sizeof(key));
+    //Fibonacci hashing, the upper bits are the best mixed ones
+    return (u32)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+bool PacketStatTable::HasSameKey(const PacketStat& a, const PacketStat& b)
+{
+    return memcmp(&a, &b, packetStatCompareBytes) == 0;
+}
+
+u32 PacketStatTable::FindSlot(const PacketStat& packet) const
+{
+    const u32 mask = (u32)entries.size() - 1;
+    for (u32 i = Hash(packet) & mask; ; i = (i + 1) & mask)
+    {
+        const PacketStat& entry = entries[i];
+        if (entry.messageType == MessageType::INVALID || HasSameKey(entry, packet)) return i;
+    }
+}
+
+void PacketStatTable::Grow()
+{
+    std::vector<PacketStat> oldEntries(entries.empty() ? INITIAL_CAPACITY : entries.size() * 2);
+    oldEntries.swap(entries);
+    for (const PacketStat& entry : oldEntries)
+    {
+        if (entry.messageType != MessageType::INVALID) entries[FindSlot(entry)] = entry;
+    }
+}
+
+void PacketStatTable::Add(const PacketStat& packet)
+{
+    if (packet.messageType == MessageType::INVALID) return;
+
+    //Keeps the load factor below 3/4 so that probe sequences stay short
+    if ((amountOfEntries + 1) * 4 > entries.size() * 3) Grow();
+
+    PacketStat& entry = entries[FindSlot(packet)];
+    if (entry.messageType == MessageType::INVALID)
+    {
+        entry = packet;
+        amountOfEntries++;
+    }
+    else
+    {
+        entry.count += packet.count;
+    }
+}
+
+void PacketStatTable::Add(const PacketStatTable& other)
+{
+    for (const PacketStat& entry : other.entries)
+    {
+        Add(entry);
+    }
+}
+
+u32 PacketStatTable::GetCount(const PacketStat& packet) const
+{
+    if (entries.empty() || packet.messageType == MessageType::INVALID) return 0;
+    const PacketStat& entry = entries[FindSlot(packet)];
+    return entry.messageType == MessageType::INVALID ? 0 : entry.count;
+}
+
+u32 PacketStatTable::GetAmountOfEntries() const
+{
+    return amountOfEntries;
+}
+
+std::vector<PacketStat> PacketStatTable::GetEntries() const
+{
+    std::vector<PacketStat> retVal;
+    retVal.reserve(amountOfEntries);
+    for (const PacketStat& entry : entries)
+    {
+        if (entry.messageType != MessageType::INVALID) retVal.push_back(entry);
+    }
+    return retVal;
+}
+
+void PacketStatTable::Clear()
+{
+    entries.clear();
+    entries.shrink_to_fit();
+    amountOfEntries = 0;
+}
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+
+#include "FmTypes.h"
+
+#pragma pack(push, 1)
+struct PacketStat {
+    MessageType messageType = MessageType::INVALID;
+    ModuleIdWrapper moduleId = INVALID_WRAPPED_MODULE_ID;
+    u8 actionType = 0;
+    u8 isSplit = 0;
+    u8 requestHandle = 0;
+    u32 count = 0;
+};
+constexpr int packetStatCompareBytes = sizeof(PacketStat) - sizeof(u32);
+static_assert(sizeof(PacketStat) == 12);
+#pragma pack(pop)
+
+/*
+ * Counts packets by their type (all fields of PacketStat except the count) in an open addressing
+ * hash table with linear probing. Entries are never removed individually, so an entry with an
+ * INVALID messageType always terminates a probe sequence. An empty table does not allocate memory.
+ */
+class PacketStatTable
+{
+private:
+    static constexpr u32 INITIAL_CAPACITY = 16;
+
+    std::vector<PacketStat> entries; //Capacity is always zero or a power of two
+    u32 amountOfEntries = 0;
+
+    static u32 Hash(const PacketStat& packet);
+    static bool HasSameKey(const PacketStat& a, const PacketStat& b);
+    u32 FindSlot(const PacketStat& packet) const; //Index of the entry with the same key or of the empty entry where it belongs
+    void Grow();
+
+public:
+    //Adds the count of the given packet to the entry with the same key
+    void Add(const PacketStat& packet);
+    void Add(const PacketStatTable& other);
+    //Returns the summed up count of all packets with the same key as the given packet
+    u32 GetCount(const PacketStat& packet) const;
+    u32 GetAmountOfEntries() const;
+    //Returns all entries in no particular order
+    std::vector<PacketStat> GetEntries() const;
+    void Clear();
+};
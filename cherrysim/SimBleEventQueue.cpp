@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimBleEventQueue.h"
+#include "Exceptions.h"
+#include "Utility.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+u32 SimBleEventQueue::GetSizeClass(u32 size)
+{
+    for (u32 i = 0; i < AMOUNT_OF_SIZE_CLASSES; i++)
+    {
+        if (size <= SLOT_SIZES[i]) return i;
+    }
+    SIMEXCEPTION(IllegalArgumentException);
+    return AMOUNT_OF_SIZE_CLASSES - 1;
+}
+
+u8* SimBleEventQueue::AllocateSlot(u32 sizeClass)
+{
+    std::vector<u8*>& slots = freeSlots[sizeClass];
+    if (slots.empty())
+    {
+        const u32 slotSize = SLOT_SIZES[sizeClass];
+        //The slots are aligned like the ble_evt_t that is stored in them
+        const u32 alignedSlotSize = (slotSize + alignof(ble_evt_t) - 1) / alignof(ble_evt_t) * alignof(ble_evt_t);
+        blocks.emplace_back(new u8[alignedSlotSize * SLOTS_PER_BLOCK + alignof(std::max_align_t)]);
+        u8* block = blocks.back().get();
+        block += (alignof(std::max_align_t) - ((uintptr_t)block % alignof(std::max_align_t))) % alignof(std::max_align_t);
+        for (u32 i = 0; i < SLOTS_PER_BLOCK; i++) slots.push_back(block + (SLOTS_PER_BLOCK - 1 - i) * alignedSlotSize);
+    }
+    u8* slot = slots.back();
+    slots.pop_back();
+    return slot;
+}
+
+const SimBleEventQueue::Entry& SimBleEventQueue::GetEntry(u32 index) const
+{
+    if (index >= amountOfEvents) SIMEXCEPTION(IndexOutOfBoundsException);
+    return ring[(head + index) & (ring.size() - 1)];
+}
+
+ble_evt_t& SimBleEventQueue::EmplaceBack(u32 globalId, u32 additionalInfo, u32 maxEventSize)
+{
+    if (amountOfEvents == ring.size())
+    {
+        //Unwrap the ring into a new one with double the capacity
+        std::vector<Entry> newRing(ring.empty() ? 8 : ring.size() * 2);
+        for (u32 i = 0; i < amountOfEvents; i++) newRing[i] = GetEntry(i);
+        ring.swap(newRing);
+        head = 0;
+    }
+
+    Entry& entry = ring[(head + amountOfEvents) & (ring.size() - 1)];
+    entry.sizeClass = (u8)GetSizeClass(maxEventSize);
+    entry.slot = AllocateSlot(entry.sizeClass);
+    entry.globalId = globalId;
+    entry.additionalInfo = additionalInfo;
+    amountOfEvents++;
+
+    CheckedMemset(entry.slot, 0, SLOT_SIZES[entry.sizeClass]);
+    ble_evt_t& event = *(ble_evt_t*)entry.slot;
+    event.header.evt_len = (u16)globalId;
+    return event;
+}
+
+void SimBleEventQueue::PushBack(const simBleEvent& event)
+{
+    const u32 usedSize = GetUsedSize(event.bleEvent);
+    ble_evt_t& queuedEvent = EmplaceBack(event.globalId, event.additionalInfo, usedSize);
+    CheckedMemcpy(&queuedEvent, &event.bleEvent, usedSize);
+}
+
+void SimBleEventQueue::PopFront(simBleEvent& event)
+{
+    const Entry& entry = GetEntry(0);
+    const u32 usedSize = GetFrontSize();
+    CheckedMemcpy(&event.bleEvent, entry.slot, usedSize);
+    event.size = usedSize;
+    event.globalId = entry.globalId;
+    event.additionalInfo = entry.additionalInfo;
+
+    freeSlots[entry.sizeClass].push_back(entry.slot);
+    head = (head + 1) & (ring.size() - 1);
+    amountOfEvents--;
+}
+
+bool SimBleEventQueue::IsEmpty() const
+{
+    return amountOfEvents == 0;
+}
+
+u32 SimBleEventQueue::GetAmountOfEvents() const
+{
+    return amountOfEvents;
+}
+
+const ble_evt_t& SimBleEventQueue::GetEvent(u32 index) const
+{
+    return *(const ble_evt_t*)GetEntry(index).slot;
+}
+
+u32 SimBleEventQueue::GetFrontSize() const
+{
+    const Entry& entry = GetEntry(0);
+    const u32 usedSize = GetUsedSize(*(const ble_evt_t*)entry.slot);
+    //The producer must have requested enough room for the data of the event
+    if (usedSize > SLOT_SIZES[entry.sizeClass]) SIMEXCEPTION(BufferTooSmallException);
+    return usedSize;
+}
+
+void SimBleEventQueue::Clear()
+{
+    while (!IsEmpty())
+    {
+        freeSlots[GetEntry(0).sizeClass].push_back(GetEntry(0).slot);
+        head = (head + 1) & (ring.size() - 1);
+        amountOfEvents--;
+    }
+}
+
+u32 SimBleEventQueue::GetUsedSize(const ble_evt_t& event)
+{
+    u32 dataEnd = 0;
+    switch (event.header.evt_id)
+    {
+    case BLE_GATTS_EVT_WRITE:
+        dataEnd = offsetof(ble_evt_t, evt.gatts_evt.params.write.data) + event.evt.gatts_evt.params.write.len;
+        break;
+    case BLE_GATTC_EVT_HVX:
+        dataEnd = offsetof(ble_evt_t, evt.gattc_evt.params.hvx.data) + event.evt.gattc_evt.params.hvx.len;
+        break;
+    default:
+        break;
+    }
+    return std::max<u32>(sizeof(ble_evt_t), dataEnd);
+}
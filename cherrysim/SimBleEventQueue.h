@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "FmTypes.h"
+#include <ble.h>
+
+//A BLE Event that is sent by the Simulator is wrapped
+struct simBleEvent {
+    ble_evt_t bleEvent;
+    // The overflow area for ble_evt_t, as sizeof(ble_evt_t) does not include
+    // the memory used for storing write data. The ble_evt_t is used more like
+    // an event header with additional data written directly after it.
+    // Use the maximum MTU as the size of the overflow area.
+    // IMPORTANT: This must always be the member directly after the ble_evt_t
+    //            member!
+    u8 bleEventOverflowData[NRF_SDH_BLE_GATT_MAX_MTU_SIZE];
+
+    u32 size; //The amount of bytes of the bleEvent (including the overflow area) that are used
+    u32 globalId;
+    u32 additionalInfo; //Can be used to store a pointer or other information
+};
+
+/*
+ * The BLE events of a node that were not yet pulled by the firmware. The queue is a ring buffer of small
+ * headers that point to slots in a pool with two size classes: events without data after the ble_evt_t
+ * and events that use the overflow area. Only the bytes that an event uses are copied when it is pulled.
+ * Once the queue has grown to the amount of events that wait at the same time, it does not allocate anymore.
+ */
+class SimBleEventQueue
+{
+public:
+    static constexpr u32 MAX_EVENT_SIZE = sizeof(ble_evt_t) + NRF_SDH_BLE_GATT_MAX_MTU_SIZE;
+
+private:
+    static constexpr u32 AMOUNT_OF_SIZE_CLASSES = 2;
+    static constexpr std::array<u32, AMOUNT_OF_SIZE_CLASSES> SLOT_SIZES = { sizeof(ble_evt_t), MAX_EVENT_SIZE };
+    static constexpr u32 SLOTS_PER_BLOCK = 16;
+
+    struct Entry
+    {
+        u8* slot;
+        u8 sizeClass;
+        u32 globalId;
+        u32 additionalInfo;
+    };
+
+    std::vector<Entry> ring; //Capacity is always zero or a power of two
+    u32 head = 0;
+    u32 amountOfEvents = 0;
+
+    std::vector<std::unique_ptr<u8[]>> blocks;
+    std::array<std::vector<u8*>, AMOUNT_OF_SIZE_CLASSES> freeSlots;
+
+    static u32 GetSizeClass(u32 size);
+    u8* AllocateSlot(u32 sizeClass);
+    const Entry& GetEntry(u32 index) const;
+
+public:
+    //Appends a zeroed event that has room for maxEventSize bytes so that it can be filled in place
+    //The global id is also stored in the evt_len of the header, see sd_ble_evt_get
+    ble_evt_t& EmplaceBack(u32 globalId, u32 additionalInfo = 0, u32 maxEventSize = sizeof(ble_evt_t));
+    void PushBack(const simBleEvent& event);
+    //Copies the used bytes of the first event and its ids to the given event and removes it from the queue
+    void PopFront(simBleEvent& event);
+
+    bool IsEmpty() const;
+    u32 GetAmountOfEvents() const;
+    const ble_evt_t& GetEvent(u32 index) const;
+    //Returns the amount of bytes of the first event that the firmware has to receive
+    u32 GetFrontSize() const;
+    void Clear();
+
+    //The amount of bytes that the given event uses, including the data that follows the ble_evt_t
+    static u32 GetUsedSize(const ble_evt_t& event);
+};
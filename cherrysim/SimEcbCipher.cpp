@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimEcbCipher.h"
+
+#include <cstring>
+#include <mutex>
+
+extern "C" {
+#include <aes.h>
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIM_AES_NI_AVAILABLE 1
+#define SIM_AES_NI_TARGET __attribute__((target("aes,sse2")))
+#include <cpuid.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define SIM_AES_NI_AVAILABLE 1
+#define SIM_AES_NI_TARGET
+#include <intrin.h>
+#else
+#define SIM_AES_NI_AVAILABLE 0
+#endif
+
+#if SIM_AES_NI_AVAILABLE
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+SIM_AES_NI_TARGET static __m128i ExpandRoundKey(__m128i previousKey, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, _MM_SHUFFLE(3, 3, 3, 3));
+    previousKey = _mm_xor_si128(previousKey, _mm_slli_si128(previousKey, 4));
+    previousKey = _mm_xor_si128(previousKey, _mm_slli_si128(previousKey, 4));
+    previousKey = _mm_xor_si128(previousKey, _mm_slli_si128(previousKey, 4));
+    return _mm_xor_si128(previousKey, assist);
+}
+
+//The round constant of _mm_aeskeygenassist_si128 must be a compile time constant
+#define SIM_AES_EXPAND_ROUND_KEY(round, rcon) roundKeys[round] = ExpandRoundKey(roundKeys[round - 1], _mm_aeskeygenassist_si128(roundKeys[round - 1], rcon))
+
+SIM_AES_NI_TARGET static void AesNiExpandKey(const u8* key, u8* roundKeyBytes)
+{
+    __m128i* roundKeys = (__m128i*)roundKeyBytes;
+    roundKeys[0] = _mm_loadu_si128((const __m128i*)key);
+    SIM_AES_EXPAND_ROUND_KEY(1, 0x01);
+    SIM_AES_EXPAND_ROUND_KEY(2, 0x02);
+    SIM_AES_EXPAND_ROUND_KEY(3, 0x04);
+    SIM_AES_EXPAND_ROUND_KEY(4, 0x08);
+    SIM_AES_EXPAND_ROUND_KEY(5, 0x10);
+    SIM_AES_EXPAND_ROUND_KEY(6, 0x20);
+    SIM_AES_EXPAND_ROUND_KEY(7, 0x40);
+    SIM_AES_EXPAND_ROUND_KEY(8, 0x80);
+    SIM_AES_EXPAND_ROUND_KEY(9, 0x1B);
+    SIM_AES_EXPAND_ROUND_KEY(10, 0x36);
+}
+
+SIM_AES_NI_TARGET static void AesNiEncryptBlock(const u8* roundKeyBytes, const u8* clearText, u8* cipherText)
+{
+    const __m128i* roundKeys = (const __m128i*)roundKeyBytes;
+    __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i*)clearText), roundKeys[0]);
+    for (u32 round = 1; round < SimEcbCipher::AMOUNT_OF_ROUND_KEYS - 1; round++)
+    {
+        block = _mm_aesenc_si128(block, roundKeys[round]);
+    }
+    block = _mm_aesenclast_si128(block, roundKeys[SimEcbCipher::AMOUNT_OF_ROUND_KEYS - 1]);
+    _mm_storeu_si128((__m128i*)cipherText, block);
+}
+#endif //SIM_AES_NI_AVAILABLE
+
+SimEcbCipher::SimEcbCipher()
+    : useAesNi(IsAesNiSupported())
+{
+}
+
+SimEcbCipher& SimEcbCipher::GetThreadInstance()
+{
+    static thread_local SimEcbCipher instance;
+    return instance;
+}
+
+bool SimEcbCipher::IsAesNiSupported()
+{
+#if SIM_AES_NI_AVAILABLE && defined(__GNUC__)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) return false;
+    return (ecx & bit_AES) != 0;
+#elif SIM_AES_NI_AVAILABLE
+    int info[4] = {};
+    __cpuid(info, 1);
+    return (info[2] & (1 << 25)) != 0;
+#else
+    return false;
+#endif
+}
+
+const SimEcbCipher::CacheEntry& SimEcbCipher::GetCacheEntry(const u8* key)
+{
+    //Most calls use the same key as the call before, e.g. while encrypting a packet
+    if (cache[lastUsedEntry].valid && memcmp(cache[lastUsedEntry].key, key, KEY_LENGTH) == 0)
+    {
+        amountOfHits++;
+        return cache[lastUsedEntry];
+    }
+    for (u32 i = 0; i < CACHE_SIZE; i++)
+    {
+        if (cache[i].valid && memcmp(cache[i].key, key, KEY_LENGTH) == 0)
+        {
+            amountOfHits++;
+            lastUsedEntry = i;
+            return cache[i];
+        }
+    }
+
+    amountOfMisses++;
+    CacheEntry& entry = cache[nextReplacedEntry];
+    lastUsedEntry = nextReplacedEntry;
+    nextReplacedEntry = (nextReplacedEntry + 1) % CACHE_SIZE;
+    memcpy(entry.key, key, KEY_LENGTH);
+#if SIM_AES_NI_AVAILABLE
+    AesNiExpandKey(key, entry.roundKeys);
+#endif
+    entry.valid = true;
+    return entry;
+}
+
+void SimEcbCipher::EncryptBlock(const u8* key, const u8* clearText, u8* cipherText)
+{
+#if SIM_AES_NI_AVAILABLE
+    if (useAesNi)
+    {
+        AesNiEncryptBlock(GetCacheEntry(key).roundKeys, clearText, cipherText);
+        return;
+    }
+#endif
+    //aes.c keeps its state in static variables, so it must not be used by several threads at once
+    static std::mutex portableAesMutex;
+    std::lock_guard<std::mutex> guard(portableAesMutex);
+    AES_ECB_encrypt(clearText, key, cipherText, BLOCK_LENGTH);
+}
+
+void SimEcbCipher::SetAesNiEnabled(bool enabled)
+{
+    useAesNi = enabled && IsAesNiSupported();
+}
+
+bool SimEcbCipher::IsAesNiEnabled() const
+{
+    return useAesNi;
+}
+
+u32 SimEcbCipher::GetAmountOfHits() const
+{
+    return amountOfHits;
+}
+
+u32 SimEcbCipher::GetAmountOfMisses() const
+{
+    return amountOfMisses;
+}
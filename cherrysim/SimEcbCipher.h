@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "FmTypes.h"
+
+/*
+ * Implements the ECB block encryption of the SoftDevice (sd_ecb_block_encrypt) for the simulator.
+ * The portable implementation in aes.c expands the key for every block and keeps its state in
+ * static variables. This cipher keeps the expanded keys of the last used keys in a small cache and
+ * uses the AES-NI instructions if the CPU supports them, otherwise it falls back to aes.c.
+ * The output is the same in both cases. Every thread uses its own instance.
+ */
+class SimEcbCipher
+{
+TESTER_PUBLIC:
+    static constexpr u32 KEY_LENGTH = 16;
+    static constexpr u32 BLOCK_LENGTH = 16;
+    static constexpr u32 AMOUNT_OF_ROUND_KEYS = 11;
+    static constexpr u32 CACHE_SIZE = 8;
+
+    struct CacheEntry
+    {
+        u8 key[KEY_LENGTH] = {};
+        alignas(16) u8 roundKeys[AMOUNT_OF_ROUND_KEYS * BLOCK_LENGTH] = {};
+        bool valid = false;
+    };
+
+    CacheEntry cache[CACHE_SIZE];
+    u32 lastUsedEntry = 0;
+    u32 nextReplacedEntry = 0;
+    u32 amountOfHits = 0;
+    u32 amountOfMisses = 0;
+
+    bool useAesNi = false;
+
+    const CacheEntry& GetCacheEntry(const u8* key);
+
+public:
+    SimEcbCipher();
+
+    static SimEcbCipher& GetThreadInstance();
+    static bool IsAesNiSupported();
+
+    void EncryptBlock(const u8* key, const u8* clearText, u8* cipherText);
+
+    //Can be used to compare both implementations, AES-NI is only used if it is supported
+    void SetAesNiEnabled(bool enabled);
+    bool IsAesNiEnabled() const;
+
+    u32 GetAmountOfHits() const;
+    u32 GetAmountOfMisses() const;
+};
@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimMapChangeFeed.h"
+#include "Exceptions.h"
+
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+
+//Each node can have at most a few entries in the history before older clients have to resync
+static constexpr u32 HISTORY_ENTRIES_PER_NODE = 4;
+static constexpr u32 MIN_HISTORY_CAPACITY = 256;
+
+void SimMapChangeFeed::Reset(u32 amountOfNodes)
+{
+    //Epochs only have to differ between the simulations that a client might have seen
+    static std::atomic<u32> epochCounter{ 0 };
+    epoch = ++epochCounter;
+    sequence = 0;
+
+    publishedStates.assign(amountOfNodes, SimMapNodeState());
+    pendingNodes.assign(amountOfNodes, 1);
+    pendingNodeIndices.resize(amountOfNodes);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        pendingNodeIndices[i] = i;
+    }
+    history.clear();
+    historyCapacity = std::max(MIN_HISTORY_CAPACITY, amountOfNodes * HISTORY_ENTRIES_PER_NODE);
+
+    collectStamps.assign(amountOfNodes, 0);
+    collectPositions.assign(amountOfNodes, 0);
+    collectStamp = 0;
+}
+
+bool SimMapChangeFeed::MarkNodePending(u32 nodeIndex)
+{
+    if (nodeIndex >= pendingNodes.size()) return false;
+    if (pendingNodes[nodeIndex] != 0) return false;
+    pendingNodes[nodeIndex] = 1;
+    return true;
+}
+
+void SimMapChangeFeed::EnqueuePendingNode(u32 nodeIndex)
+{
+    if (nodeIndex >= pendingNodes.size())
+    {
+        SIMEXCEPTIONFORCE(IndexOutOfBoundsException);
+        return;
+    }
+    pendingNodeIndices.push_back(nodeIndex);
+}
+
+bool SimMapChangeFeed::HasPendingNodes() const
+{
+    return !pendingNodeIndices.empty();
+}
+
+void SimMapChangeFeed::Publish(const CaptureFunction& capture)
+{
+    SimMapNodeState state;
+    for (const u32 nodeIndex : pendingNodeIndices)
+    {
+        //A node might have been enqueued twice if it was marked again after a reset
+        if (pendingNodes[nodeIndex] == 0) continue;
+        pendingNodes[nodeIndex] = 0;
+
+        capture(nodeIndex, state);
+        const u8 groups = GetChangedGroups(state, publishedStates[nodeIndex]);
+        if (groups == 0) continue;
+
+        //Swapping keeps the capacity of the connection vectors around for the next capture
+        std::swap(publishedStates[nodeIndex], state);
+
+        sequence++;
+        history.push_back({ sequence, nodeIndex, groups });
+        if (history.size() > historyCapacity) history.pop_front();
+    }
+    pendingNodeIndices.clear();
+}
+
+bool SimMapChangeFeed::CollectChangesSince(u32 clientEpoch, u32 clientSequence, std::vector<Change>& outChanges)
+{
+    outChanges.clear();
+    if (clientEpoch != epoch || clientSequence > sequence) return false;
+    if (clientSequence == sequence) return true;
+
+    //The history has consecutive sequence numbers, so the first entry after the client sequence can be indexed directly
+    if (history.empty() || clientSequence + 1 < history.front().sequence) return false;
+    const u32 firstEntry = clientSequence + 1 - history.front().sequence;
+
+    collectStamp++;
+    if (collectStamp == 0)
+    {
+        collectStamps.assign(collectStamps.size(), 0);
+        collectStamp = 1;
+    }
+
+    for (u32 i = firstEntry; i < history.size(); i++)
+    {
+        const HistoryEntry& entry = history[i];
+        if (collectStamps[entry.nodeIndex] == collectStamp)
+        {
+            outChanges[collectPositions[entry.nodeIndex]].groups |= entry.groups;
+        }
+        else
+        {
+            collectStamps[entry.nodeIndex] = collectStamp;
+            collectPositions[entry.nodeIndex] = (u32)outChanges.size();
+            outChanges.push_back({ entry.nodeIndex, entry.groups });
+        }
+    }
+    return true;
+}
+
+u32 SimMapChangeFeed::GetEpoch() const
+{
+    return epoch;
+}
+
+u32 SimMapChangeFeed::GetSequence() const
+{
+    return sequence;
+}
+
+u32 SimMapChangeFeed::GetAmountOfNodes() const
+{
+    return (u32)publishedStates.size();
+}
+
+const SimMapNodeState& SimMapChangeFeed::GetPublishedState(u32 nodeIndex) const
+{
+    if (nodeIndex >= publishedStates.size())
+    {
+        SIMEXCEPTIONFORCE(IndexOutOfBoundsException);
+    }
+    return publishedStates.at(nodeIndex);
+}
+
+u8 SimMapChangeFeed::GetChangedGroups(const SimMapNodeState& a, const SimMapNodeState& b)
+{
+    u8 groups = 0;
+    if (a.x != b.x || a.y != b.y)
+    {
+        groups |= GROUP_POSITION;
+    }
+    if (a.clusterId != b.clusterId || a.clusterSize != b.clusterSize || a.nodeId != b.nodeId)
+    {
+        groups |= GROUP_CLUSTER;
+    }
+    if (a.connections != b.connections)
+    {
+        groups |= GROUP_CONNECTIONS;
+    }
+    if (a.ledOn != b.ledOn
+        || a.freeIn != b.freeIn
+        || a.freeOut != b.freeOut
+        || a.inConnectionPartner != b.inConnectionPartner
+        || a.inConnectionHasMasterBit != b.inConnectionHasMasterBit
+        || a.inConnectionPartnerHasMasterBit != b.inConnectionPartnerHasMasterBit
+        || a.inConnectionRssi != b.inConnectionRssi
+        || a.connectionLossCounter != b.connectionLossCounter
+        || a.advertisingDataLength != b.advertisingDataLength
+        || memcmp(a.advertisingData, b.advertisingData, a.advertisingDataLength) != 0)
+    {
+        groups |= GROUP_STATE;
+    }
+    return groups;
+}
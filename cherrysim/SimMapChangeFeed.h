@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "FmTypes.h"
+
+//The part of a node that is shown on the fruitymap
+struct SimMapNodeState
+{
+    struct Connection
+    {
+        u16 handle = 0;
+        NodeId target = 0;
+
+        bool operator==(const Connection& other) const { return handle == other.handle && target == other.target; }
+    };
+
+    //SimMapChangeFeed::GROUP_POSITION
+    float x = 0;
+    float y = 0;
+
+    //SimMapChangeFeed::GROUP_CLUSTER
+    ClusterId clusterId = 0;
+    ClusterSize clusterSize = 0;
+    NodeId nodeId = 0;
+
+    //SimMapChangeFeed::GROUP_CONNECTIONS
+    std::vector<Connection> connections;
+
+    //SimMapChangeFeed::GROUP_STATE
+    bool ledOn = false;
+    u8 freeIn = 0;
+    u8 freeOut = 0;
+    NodeId inConnectionPartner = 0;
+    bool inConnectionHasMasterBit = false;
+    bool inConnectionPartnerHasMasterBit = false;
+    i32 inConnectionRssi = 0;
+    u16 connectionLossCounter = 0;
+    u8 advertisingDataLength = 0; //0 if the node is not advertising
+    u8 advertisingData[31] = {};
+};
+
+/*
+ * Keeps track of what changed on the fruitymap so that the FruitySimServer can answer polls with
+ * the changes since the sequence number that the client saw last instead of the full state of all nodes.
+ * The simulator marks nodes whose map state might have changed. Once the feed is published, only these
+ * nodes are captured and compared against their last published state. Every node whose state really
+ * changed gets a new sequence number in a bounded history. A client that fell behind the history or
+ * that uses the feed of a previous simulation (different epoch) has to fetch the full state again.
+ */
+class SimMapChangeFeed
+{
+public:
+    enum Group : u8
+    {
+        GROUP_POSITION    = 1 << 0,
+        GROUP_CLUSTER     = 1 << 1,
+        GROUP_CONNECTIONS = 1 << 2,
+        GROUP_STATE       = 1 << 3,
+        GROUP_ALL         = GROUP_POSITION | GROUP_CLUSTER | GROUP_CONNECTIONS | GROUP_STATE,
+    };
+
+    struct Change
+    {
+        u32 nodeIndex = 0;
+        u8 groups = 0; //Combination of Group
+    };
+
+    using CaptureFunction = std::function<void(u32 nodeIndex, SimMapNodeState& outState)>;
+
+TESTER_PUBLIC:
+    struct HistoryEntry
+    {
+        u32 sequence = 0;
+        u32 nodeIndex = 0;
+        u8 groups = 0;
+    };
+
+    u32 epoch = 0;
+    u32 sequence = 0;
+    std::vector<SimMapNodeState> publishedStates;
+    std::vector<u8> pendingNodes; //Not a vector<bool> so that workers may mark different nodes concurrently
+    std::vector<u32> pendingNodeIndices;
+    std::deque<HistoryEntry> history;
+    u32 historyCapacity = 0;
+
+    //Used to merge the changes of a node without clearing a per node array for each collection
+    std::vector<u32> collectStamps;
+    std::vector<u32> collectPositions;
+    u32 collectStamp = 0;
+
+public:
+    //Starts a new epoch, all nodes are pending so that the first publish captures all of them
+    void Reset(u32 amountOfNodes);
+
+    //Returns true if the node was not pending before, in that case EnqueuePendingNode must be
+    //called for it. Only touches the entry of the given node and may therefore be called by
+    //the worker that simulates this node.
+    bool MarkNodePending(u32 nodeIndex);
+    void EnqueuePendingNode(u32 nodeIndex);
+    bool HasPendingNodes() const;
+
+    //Captures all pending nodes and records those whose state changed
+    void Publish(const CaptureFunction& capture);
+
+    //Writes the changes after the given sequence, merged per node. Returns false if the
+    //client must fetch the full state because the epoch or the sequence is not known anymore.
+    bool CollectChangesSince(u32 clientEpoch, u32 clientSequence, std::vector<Change>& outChanges);
+
+    u32 GetEpoch() const;
+    u32 GetSequence() const;
+    u32 GetAmountOfNodes() const;
+    const SimMapNodeState& GetPublishedState(u32 nodeIndex) const;
+
+    //Returns the groups in which the two states differ
+    static u8 GetChangedGroups(const SimMapNodeState& a, const SimMapNodeState& b);
+};
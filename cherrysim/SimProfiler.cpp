@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimProfiler.h"
+#include "CherrySim.h"
+
+#include <algorithm>
+#include <mutex>
+#include <ostream>
+
+static std::mutex simProfilerFramesMutex;
+static std::vector<std::string> simProfilerFrameNames;
+static std::unordered_map<std::string, u32> simProfilerFrameIds;
+
+thread_local SimProfilerScope* SimProfilerScope::innermostScope = nullptr;
+
+void SimProfileValue::Add(const SimProfileValue& other)
+{
+    calls += other.calls;
+    totalNs += other.totalNs;
+    selfNs += other.selfNs;
+}
+
+SimProfile::SimProfile()
+{
+    Clear();
+}
+
+u32 SimProfile::Push(u32 parentStack, u32 frameId)
+{
+    const uint64_t key = ((uint64_t)parentStack << 32) | frameId;
+    auto it = stackIndices.find(key);
+    if (it != stackIndices.end()) return it->second;
+
+    const u32 index = (u32)stacks.size();
+    stacks.push_back({ parentStack, frameId, {} });
+    stackIndices.emplace(key, index);
+    return index;
+}
+
+void SimProfile::Record(u32 stack, uint64_t totalNs, uint64_t nestedNs)
+{
+    SimProfileValue& value = stacks.at(stack).value;
+    value.calls++;
+    value.totalNs += totalNs;
+    value.selfNs += totalNs > nestedNs ? totalNs - nestedNs : 0;
+}
+
+void SimProfile::Add(const SimProfile& other)
+{
+    //The parent of a stack always has a lower index, so the parents are already mapped
+    std::vector<u32> mappedIndices(other.stacks.size(), ROOT_STACK);
+    for (size_t i = 1; i < other.stacks.size(); i++)
+    {
+        const StackEntry& entry = other.stacks[i];
+        mappedIndices[i] = Push(mappedIndices[entry.parent], entry.frameId);
+        stacks[mappedIndices[i]].value.Add(entry.value);
+    }
+}
+
+bool SimProfile::IsEmpty() const
+{
+    return stacks.size() <= 1;
+}
+
+void SimProfile::Clear()
+{
+    stacks.clear();
+    stackIndices.clear();
+    stacks.push_back({ ROOT_STACK, 0, {} });
+}
+
+std::vector<std::pair<std::string, SimProfileValue>> SimProfile::GetFrameTotals() const
+{
+    std::unordered_map<u32, SimProfileValue> totals;
+    for (size_t i = 1; i < stacks.size(); i++)
+    {
+        const StackEntry& entry = stacks[i];
+        SimProfileValue& total = totals[entry.frameId];
+        total.calls += entry.value.calls;
+        total.selfNs += entry.value.selfNs;
+
+        bool isRecursive = false;
+        for (u32 parent = entry.parent; parent != ROOT_STACK; parent = stacks[parent].parent)
+        {
+            if (stacks[parent].frameId == entry.frameId)
+            {
+                isRecursive = true;
+                break;
+            }
+        }
+        if (!isRecursive) total.totalNs += entry.value.totalNs;
+    }
+
+    std::vector<std::pair<std::string, SimProfileValue>> result;
+    result.reserve(totals.size());
+    for (const auto& total : totals)
+    {
+        result.emplace_back(SimProfiler::GetFrameName(total.first), total.second);
+    }
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        if (a.second.selfNs != b.second.selfNs) return a.second.selfNs > b.second.selfNs;
+        return a.first < b.first;
+    });
+    return result;
+}
+
+void SimProfile::WriteCollapsedStacks(std::ostream& out, const std::string& prefix) const
+{
+    std::vector<u32> frames;
+    for (size_t i = 1; i < stacks.size(); i++)
+    {
+        if (stacks[i].value.selfNs == 0) continue;
+
+        frames.clear();
+        for (u32 stack = (u32)i; stack != ROOT_STACK; stack = stacks[stack].parent)
+        {
+            frames.push_back(stacks[stack].frameId);
+        }
+
+        out << prefix;
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+        {
+            out << ';' << SimProfiler::GetFrameName(*it);
+        }
+        out << ' ' << stacks[i].value.selfNs << '\n';
+    }
+}
+
+u32 SimProfiler::GetFrameId(const char* name)
+{
+    //Frame names are mostly string literals, so looking them up by their address avoids hashing the string
+    static thread_local std::unordered_map<const char*, u32> cachedFrameIds;
+    auto cached = cachedFrameIds.find(name);
+    if (cached != cachedFrameIds.end()) return cached->second;
+
+    std::lock_guard<std::mutex> guard(simProfilerFramesMutex);
+    auto it = simProfilerFrameIds.find(name);
+    u32 id;
+    if (it != simProfilerFrameIds.end())
+    {
+        id = it->second;
+    }
+    else
+    {
+        id = (u32)simProfilerFrameNames.size();
+        simProfilerFrameNames.emplace_back(name);
+        simProfilerFrameIds.emplace(name, id);
+    }
+    cachedFrameIds.emplace(name, id);
+    return id;
+}
+
+std::string SimProfiler::GetFrameName(u32 id)
+{
+    std::lock_guard<std::mutex> guard(simProfilerFramesMutex);
+    return simProfilerFrameNames.at(id);
+}
+
+SimProfile* SimProfiler::GetCurrentProfile()
+{
+    if (cherrySimInstance == nullptr || cherrySimInstance->currentNode == nullptr) return nullptr;
+    if (!cherrySimInstance->simConfig.enableProfiler) return nullptr;
+    return &cherrySimInstance->currentNode->profile;
+}
+
+SimProfilerScope::SimProfilerScope(const char* frameName)
+    : profile(SimProfiler::GetCurrentProfile())
+{
+    if (profile == nullptr) return;
+
+    //A scope of a different node (e.g. while the simulator delivers an event) starts a new stack
+    outerScope = innermostScope;
+    const u32 parentStack = (outerScope != nullptr && outerScope->profile == profile) ? outerScope->stack : SimProfile::ROOT_STACK;
+    stack = profile->Push(parentStack, SimProfiler::GetFrameId(frameName));
+    innermostScope = this;
+    start = std::chrono::steady_clock::now();
+}
+
+SimProfilerScope::~SimProfilerScope()
+{
+    if (profile == nullptr) return;
+
+    const uint64_t totalNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    profile->Record(stack, totalNs, nestedNs);
+    if (outerScope != nullptr) outerScope->nestedNs += totalNs;
+    innermostScope = outerScope;
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PrimitiveTypes.h"
+
+/*
+ * Attributes the host time that the firmware spends in code paths marked with SIM_PROFILE_SCOPE or
+ * SIM_PROFILE_MODULE_SCOPE (see FmTypes.h) to the simulated nodes. Nested scopes form a call stack of
+ * frames. Each node collects into its own SimProfile so that nodes can be profiled while being stepped in
+ * parallel. Profiles can be exported in the collapsed stack format that is understood by flamegraph.pl.
+ */
+struct SimProfileValue
+{
+    uint64_t calls = 0;
+    uint64_t totalNs = 0; //Including the time spent in nested scopes
+    uint64_t selfNs = 0;
+
+    void Add(const SimProfileValue& other);
+};
+
+class SimProfile
+{
+private:
+    struct StackEntry
+    {
+        u32 parent; //Index of the stack without the last frame
+        u32 frameId;
+        SimProfileValue value;
+    };
+    std::vector<StackEntry> stacks; //Index 0 is the empty stack
+    std::unordered_map<uint64_t, u32> stackIndices; //Keyed by the parent index and the frameId
+
+public:
+    static constexpr u32 ROOT_STACK = 0;
+
+    SimProfile();
+
+    //Returns the index of the stack that is created by entering the frame from the given stack
+    u32 Push(u32 parentStack, u32 frameId);
+    void Record(u32 stack, uint64_t totalNs, uint64_t nestedNs);
+    void Add(const SimProfile& other);
+    bool IsEmpty() const;
+    void Clear();
+
+    //Sums up the values of each frame, sorted by the self time. For recursive frames, only the outermost
+    //call contributes to totalNs so that no time is counted twice.
+    std::vector<std::pair<std::string, SimProfileValue>> GetFrameTotals() const;
+
+    //Writes a line "prefix;frame;...;frame selfNs" for each stack that has self time
+    void WriteCollapsedStacks(std::ostream& out, const std::string& prefix) const;
+};
+
+class SimProfiler
+{
+public:
+    //Returns the id of the frame with the given name, adding it if it is unknown. Thread safe, the name
+    //must stay valid as it is cached by its address.
+    static u32 GetFrameId(const char* name);
+    static std::string GetFrameName(u32 id);
+
+    //The profile of the node that is currently simulated or nullptr if profiling is disabled
+    static SimProfile* GetCurrentProfile();
+};
+
+class SimProfilerScope
+{
+private:
+    static thread_local SimProfilerScope* innermostScope;
+
+    SimProfile* profile;
+    SimProfilerScope* outerScope = nullptr;
+    u32 stack = SimProfile::ROOT_STACK;
+    uint64_t nestedNs = 0;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit SimProfilerScope(const char* frameName);
+    ~SimProfilerScope();
+    SimProfilerScope(const SimProfilerScope&) = delete;
+    SimProfilerScope& operator=(const SimProfilerScope&) = delete;
+};
@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SimStatistics.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+static std::mutex simStatKeysMutex;
+static std::unordered_map<std::string, u32> simStatKeyIds;
+static std::vector<std::string> simStatKeyNames;
+
+u32 SimStatKeys::Intern(const char* key)
+{
+    std::lock_guard<std::mutex> guard(simStatKeysMutex);
+    auto it = simStatKeyIds.find(key);
+    if (it != simStatKeyIds.end()) return it->second;
+
+    const u32 id = (u32)simStatKeyNames.size();
+    simStatKeyNames.emplace_back(key);
+    simStatKeyIds.emplace(key, id);
+    return id;
+}
+
+std::string SimStatKeys::GetName(u32 id)
+{
+    std::lock_guard<std::mutex> guard(simStatKeysMutex);
+    return simStatKeyNames.at(id);
+}
+
+u32 SimStatValue::GetHistogramBucket(i32 value)
+{
+    if (value <= 0) return 0;
+    u32 bucket = 1;
+    while (bucket < AMOUNT_OF_HISTOGRAM_BUCKETS - 1 && ((u32)value >> bucket) != 0) bucket++;
+    return bucket;
+}
+
+void SimStatValue::AddSample(i32 value)
+{
+    samples++;
+    total += value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+    histogram[GetHistogramBucket(value)]++;
+}
+
+void SimStatValue::Add(const SimStatValue& other)
+{
+    count += other.count;
+    samples += other.samples;
+    total += other.total;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    for (u32 i = 0; i < AMOUNT_OF_HISTOGRAM_BUCKETS; i++) histogram[i] += other.histogram[i];
+}
+
+i32 SimStatValue::GetAverage() const
+{
+    if (samples == 0) return 0;
+    return (i32)(total / samples);
+}
+
+SimStatValue& SimStatTable::Get(u32 id)
+{
+    if (id >= values.size()) values.resize(id + 1);
+    return values[id];
+}
+
+const SimStatValue* SimStatTable::Find(u32 id) const
+{
+    if (id >= values.size()) return nullptr;
+    const SimStatValue& value = values[id];
+    if (value.count == 0 && value.samples == 0) return nullptr;
+    return &value;
+}
+
+void SimStatTable::Add(const SimStatTable& other)
+{
+    if (other.values.size() > values.size()) values.resize(other.values.size());
+    for (size_t i = 0; i < other.values.size(); i++) values[i].Add(other.values[i]);
+}
+
+bool SimStatTable::IsEmpty() const
+{
+    for (u32 i = 0; i < values.size(); i++)
+    {
+        if (Find(i) != nullptr) return false;
+    }
+    return true;
+}
+
+void SimStatTable::Clear()
+{
+    values.clear();
+}
+
+std::vector<std::pair<std::string, SimStatValue>> SimStatTable::GetEntries() const
+{
+    std::vector<std::pair<std::string, SimStatValue>> entries;
+    for (u32 i = 0; i < values.size(); i++)
+    {
+        if (Find(i) != nullptr) entries.emplace_back(SimStatKeys::GetName(i), values[i]);
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    return entries;
+}
+
+nlohmann::json SimStatTable::ToJson() const
+{
+    nlohmann::json retVal = nlohmann::json::object();
+    for (const auto& entry : GetEntries())
+    {
+        const SimStatValue& value = entry.second;
+        nlohmann::json& j = retVal[entry.first];
+        j["count"] = value.count;
+        if (value.samples > 0)
+        {
+            j["samples"] = value.samples;
+            j["avg"] = value.GetAverage();
+            j["min"] = value.min;
+            j["max"] = value.max;
+            //Only the buckets up to the highest used one are exported
+            u32 amountOfBuckets = SimStatValue::AMOUNT_OF_HISTOGRAM_BUCKETS;
+            while (amountOfBuckets > 0 && value.histogram[amountOfBuckets - 1] == 0) amountOfBuckets--;
+            j["histogram"] = std::vector<u32>(value.histogram.begin(), value.histogram.begin() + amountOfBuckets);
+        }
+    }
+    return retVal;
+}
+
+SimStatTable& GetSimStatisticsWithoutNode()
+{
+    static thread_local SimStatTable table;
+    return table;
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "FmTypes.h"
+#include "json.hpp"
+
+/*
+ * Statistics that are collected by the firmware and by the simulator (see SIMSTATCOUNT and SIMSTATAVG).
+ * Every key is interned once into a process wide id so that collecting a statistic is just an array access.
+ * Each node has its own SimStatTable, which allows the nodes to collect statistics while being stepped in
+ * parallel. A global view is created by adding up the tables of all nodes.
+ */
+class SimStatKeys
+{
+public:
+    //Returns the id of the given key, adding it if it is unknown. Thread safe.
+    static u32 Intern(const char* key);
+    static std::string GetName(u32 id);
+};
+
+struct SimStatValue
+{
+    //Bucket 0 counts values <= 0, bucket i counts values in [2^(i-1), 2^i)
+    static constexpr u32 AMOUNT_OF_HISTOGRAM_BUCKETS = 32;
+
+    u32 count = 0; //Number of SIMSTATCOUNT calls
+    u32 samples = 0; //Number of values given to SIMSTATAVG
+    int64_t total = 0;
+    i32 min = INT32_MAX;
+    i32 max = INT32_MIN;
+    std::array<u32, AMOUNT_OF_HISTOGRAM_BUCKETS> histogram = {};
+
+    void AddSample(i32 value);
+    void Add(const SimStatValue& other);
+    i32 GetAverage() const;
+    static u32 GetHistogramBucket(i32 value);
+};
+
+class SimStatTable
+{
+private:
+    std::vector<SimStatValue> values; //Indexed by the id of the key
+
+public:
+    SimStatValue& Get(u32 id);
+    //Returns nullptr if nothing was collected for the given id
+    const SimStatValue* Find(u32 id) const;
+    void Add(const SimStatTable& other);
+    bool IsEmpty() const;
+    void Clear();
+
+    //Sorted by key name
+    std::vector<std::pair<std::string, SimStatValue>> GetEntries() const;
+    nlohmann::json ToJson() const;
+};
+
+//Statistics that were not collected by a node or that were collected by the nodes of a simulator that
+//does not exist anymore. Each thread has its own as multiple simulators might run on different threads.
+SimStatTable& GetSimStatisticsWithoutNode();
@@ -0,0 +1,397 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SparseFlash.h"
+#include "Exceptions.h"
+#include <cstring>
+#include <string_view>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SPARSE_FLASH_MAPPING_SUPPORTED
+#endif
+
+static bool IsErased(const u8* contents, u32 size)
+{
+    for (u32 i = 0; i < size; i++)
+    {
+        if (contents[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+SparseFlash::SparseFlash(u32 flashSize, u32 pageSize) :
+    flashSize(flashSize),
+    pageSize(pageSize)
+{
+}
+
+SparseFlash::~SparseFlash()
+{
+    Release();
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    if (poolFileDescriptor != -1) close(poolFileDescriptor);
+#endif
+}
+
+bool SparseFlash::CreatePool()
+{
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    if (poolFileDescriptor != -1) return true;
+
+    //Every flash page must be mappable on its own
+    const long systemPageSize = sysconf(_SC_PAGESIZE);
+    if (systemPageSize <= 0 || pageSize % systemPageSize != 0 || flashSize % pageSize != 0) return false;
+
+    const int fd = memfd_create("cherrysim_flash", MFD_CLOEXEC);
+    if (fd == -1) return false;
+
+    const std::vector<u8> erasedImage(flashSize, 0xFF);
+    if (ftruncate(fd, flashSize) != 0 || pwrite(fd, erasedImage.data(), flashSize, 0) != (ssize_t)flashSize)
+    {
+        close(fd);
+        return false;
+    }
+
+    poolFileDescriptor = fd;
+    poolSize = flashSize;
+    poolReadBuffer.resize(pageSize);
+    return true;
+#else
+    return false;
+#endif
+}
+
+u32 SparseFlash::AppendPoolPage(const u8* contents, size_t hash)
+{
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    const u32 poolOffset = poolSize;
+    if (ftruncate(poolFileDescriptor, poolOffset + pageSize) != 0
+        || pwrite(poolFileDescriptor, contents, pageSize, poolOffset) != (ssize_t)pageSize)
+    {
+        SIMEXCEPTION(OutOfMemoryException);
+    }
+    poolSize += pageSize;
+    poolPageOffsetsByHash.emplace(hash, poolOffset);
+    return poolOffset;
+#else
+    SIMEXCEPTION(NotImplementedException);
+    return NOT_SHARED;
+#endif
+}
+
+bool SparseFlash::PoolPageEquals(u32 poolOffset, const u8* contents)
+{
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    if (pread(poolFileDescriptor, poolReadBuffer.data(), pageSize, poolOffset) != (ssize_t)pageSize) return false;
+    return memcmp(poolReadBuffer.data(), contents, pageSize) == 0;
+#else
+    return false;
+#endif
+}
+
+void SparseFlash::MapPage(u32 globalPageIndex, u32 poolOffset)
+{
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    //Replaces the current page, the memory of a private copy is given back
+    void* page = mmap(GetPage(globalPageIndex), pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, poolFileDescriptor, poolOffset);
+    if (page == MAP_FAILED)
+    {
+        SIMEXCEPTION(OutOfMemoryException);
+    }
+    pagePoolOffsets[globalPageIndex] = poolOffset;
+#else
+    SIMEXCEPTION(NotImplementedException);
+#endif
+}
+
+u32 SparseFlash::GetPagesPerFlash() const
+{
+    return flashSize / pageSize;
+}
+
+void SparseFlash::MarkPagesDirty(u32 firstGlobalPageIndex, u32 lastGlobalPageIndex)
+{
+    for (u32 i = firstGlobalPageIndex; i <= lastGlobalPageIndex && i < dirtyPages.size(); i++)
+    {
+        dirtyPages[i] = 1;
+    }
+}
+
+void SparseFlash::Release()
+{
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    if (mapped) munmap(memory, (size_t)amountOfNodes * flashSize);
+#endif
+    mapped = false;
+    memory = nullptr;
+    amountOfNodes = 0;
+    fallbackMemory.clear();
+    fallbackMemory.shrink_to_fit();
+    pagePoolOffsets.clear();
+    dirtyPages.clear();
+}
+
+void SparseFlash::Reset(u32 amountOfNodes)
+{
+    Release();
+    if (amountOfNodes == 0) return;
+
+    this->amountOfNodes = amountOfNodes;
+    const size_t totalSize = (size_t)amountOfNodes * flashSize;
+    dirtyPages.assign(GetAmountOfPages(), 1);
+
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    if (CreatePool())
+    {
+        //Only reserves the address space, the flash of every node is mapped into it afterwards
+        void* reserved = mmap(nullptr, totalSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reserved != MAP_FAILED)
+        {
+            memory = (u8*)reserved;
+            mapped = true;
+            pagePoolOffsets.assign(amountOfNodes * GetPagesPerFlash(), NOT_SHARED);
+            for (u32 i = 0; i < amountOfNodes; i++)
+            {
+                EraseFlash(i);
+            }
+            return;
+        }
+    }
+#endif
+
+    fallbackMemory.assign(totalSize, 0xFF);
+    memory = fallbackMemory.data();
+}
+
+u8* SparseFlash::GetFlash(u32 nodeIndex)
+{
+    if (nodeIndex >= amountOfNodes)
+    {
+        SIMEXCEPTION(IndexOutOfBoundsException);
+    }
+    return memory + (size_t)nodeIndex * flashSize;
+}
+
+void SparseFlash::EraseFlash(u32 nodeIndex)
+{
+    u8* flash = GetFlash(nodeIndex);
+    MarkPagesDirty(nodeIndex * GetPagesPerFlash(), (nodeIndex + 1) * GetPagesPerFlash() - 1);
+    if (!mapped)
+    {
+        memset(flash, 0xFF, flashSize);
+        return;
+    }
+
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    //The whole erased image is mapped at once
+    if (mmap(flash, flashSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, poolFileDescriptor, 0) == MAP_FAILED)
+    {
+        SIMEXCEPTION(OutOfMemoryException);
+    }
+    const u32 firstPage = nodeIndex * GetPagesPerFlash();
+    for (u32 page = 0; page < GetPagesPerFlash(); page++)
+    {
+        pagePoolOffsets[firstPage + page] = page * pageSize;
+    }
+#endif
+}
+
+void SparseFlash::Erase(u8* address, u32 size)
+{
+    MarkWritten(address, size);
+
+    const size_t totalSize = (size_t)amountOfNodes * flashSize;
+    if (!mapped || size != pageSize || address < memory || address >= memory + totalSize || (size_t)(address - memory) % pageSize != 0)
+    {
+        memset(address, 0xFF, size);
+        return;
+    }
+
+    const u32 globalPageIndex = (u32)((size_t)(address - memory) / pageSize);
+    MapPage(globalPageIndex, (globalPageIndex % GetPagesPerFlash()) * pageSize);
+}
+
+u32 SparseFlash::ShareIdenticalPages()
+{
+    if (!mapped) return 0;
+
+    const u32 totalPages = amountOfNodes * GetPagesPerFlash();
+    std::unordered_map<size_t, std::vector<u32>> candidatesByHash;
+
+    for (u32 globalPageIndex = 0; globalPageIndex < totalPages; globalPageIndex++)
+    {
+        const u8* page = GetPage(globalPageIndex);
+
+        //Pages that still have the contents of their pool page are left alone
+        //Pages of a loaded file are only read once they are used and are left alone as well
+        const u32 poolOffset = pagePoolOffsets[globalPageIndex];
+        if (poolOffset == FILE_BACKED) continue;
+        if (poolOffset != NOT_SHARED && PoolPageEquals(poolOffset, page)) continue;
+
+        if (IsErased(page, pageSize))
+        {
+            MapPage(globalPageIndex, (globalPageIndex % GetPagesPerFlash()) * pageSize);
+            continue;
+        }
+
+        pagePoolOffsets[globalPageIndex] = NOT_SHARED;
+
+        const size_t hash = std::hash<std::string_view>()(std::string_view((const char*)page, pageSize));
+        bool foundInPool = false;
+        auto range = poolPageOffsetsByHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (PoolPageEquals(it->second, page))
+            {
+                MapPage(globalPageIndex, it->second);
+                foundInPool = true;
+                break;
+            }
+        }
+        if (!foundInPool) candidatesByHash[hash].push_back(globalPageIndex);
+    }
+
+    //Only pages that exist more than once are moved to the pool
+    for (auto& entry : candidatesByHash)
+    {
+        std::vector<u32>& candidates = entry.second;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            if (pagePoolOffsets[candidates[i]] != NOT_SHARED) continue;
+
+            u32 sharedPoolOffset = NOT_SHARED;
+            for (size_t k = i + 1; k < candidates.size(); k++)
+            {
+                if (pagePoolOffsets[candidates[k]] != NOT_SHARED) continue;
+                if (memcmp(GetPage(candidates[i]), GetPage(candidates[k]), pageSize) != 0) continue;
+
+                if (sharedPoolOffset == NOT_SHARED)
+                {
+                    sharedPoolOffset = AppendPoolPage(GetPage(candidates[i]), entry.first);
+                    MapPage(candidates[i], sharedPoolOffset);
+                }
+                MapPage(candidates[k], sharedPoolOffset);
+            }
+        }
+    }
+
+    u32 amountOfSharedPages = 0;
+    for (u32 poolOffset : pagePoolOffsets)
+    {
+        if (poolOffset != NOT_SHARED) amountOfSharedPages++;
+    }
+    return amountOfSharedPages;
+}
+
+void SparseFlash::MarkWritten(const u8* address, u32 size)
+{
+    const size_t totalSize = (size_t)amountOfNodes * flashSize;
+    if (size == 0 || address < memory || address >= memory + totalSize) return;
+
+    const size_t offset = (size_t)(address - memory);
+    MarkPagesDirty((u32)(offset / pageSize), (u32)((offset + size - 1) / pageSize));
+}
+
+bool SparseFlash::IsSparse() const
+{
+    return mapped;
+}
+
+u32 SparseFlash::GetAmountOfPages() const
+{
+    return amountOfNodes * GetPagesPerFlash();
+}
+
+u32 SparseFlash::GetPageSize() const
+{
+    return pageSize;
+}
+
+u8* SparseFlash::GetPage(u32 globalPageIndex) const
+{
+    return memory + (size_t)globalPageIndex * pageSize;
+}
+
+bool SparseFlash::IsPageErased(u32 globalPageIndex) const
+{
+    return IsErased(GetPage(globalPageIndex), pageSize);
+}
+
+std::vector<u32> SparseFlash::TakeDirtyPages()
+{
+    std::vector<u32> result;
+    for (u32 i = 0; i < dirtyPages.size(); i++)
+    {
+        if (dirtyPages[i] == 0) continue;
+        dirtyPages[i] = 0;
+        result.push_back(i);
+    }
+    return result;
+}
+
+void SparseFlash::LoadPagesFromFile(const std::string& path, const std::vector<std::pair<u32, u32>>& globalPageIndicesAndFileOffsets)
+{
+#ifdef SPARSE_FLASH_MAPPING_SUPPORTED
+    if (mapped)
+    {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            SIMEXCEPTION(FileException);
+        }
+        for (const std::pair<u32, u32>& page : globalPageIndicesAndFileOffsets)
+        {
+            //The mapping keeps the file alive even if it is replaced later on
+            if (mmap(GetPage(page.first), pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, page.second) == MAP_FAILED)
+            {
+                close(fd);
+                SIMEXCEPTION(OutOfMemoryException);
+            }
+            pagePoolOffsets[page.first] = FILE_BACKED;
+        }
+        close(fd);
+        return;
+    }
+#endif
+
+    std::ifstream file(path, std::ios::binary);
+    for (const std::pair<u32, u32>& page : globalPageIndicesAndFileOffsets)
+    {
+        file.seekg(page.second);
+        file.read((char*)GetPage(page.first), pageSize);
+    }
+    if (!file.good())
+    {
+        SIMEXCEPTION(FileException);
+    }
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <string>
+#include <cstdint>
+
+#include "FmTypes.h"
+
+/*
+ * Provides the flash memory of all simulated nodes. Every node gets a contiguous block of memory
+ * so that the firmware can access its flash through pointers, but the pages of these blocks are
+ * mapped copy-on-write from a shared pool: All erased pages share one erased image and pages
+ * with identical contents on several nodes can be shared after calling ShareIdenticalPages.
+ * A page only gets its own memory once it is written to. On platforms without memory mapping
+ * support, all flash is allocated as before.
+ * Pages that were changed through the flash API are tracked as dirty so that only these have to be
+ * persisted. Writes that bypass Erase and MarkWritten are not tracked.
+ */
+class SparseFlash
+{
+TESTER_PUBLIC:
+    static constexpr u32 NOT_SHARED = UINT32_MAX;
+    static constexpr u32 FILE_BACKED = UINT32_MAX - 1;
+
+    u32 flashSize;
+    u32 pageSize;
+    u32 amountOfNodes = 0;
+    u8* memory = nullptr;
+    bool mapped = false; //False if the fallback allocation is used
+    std::vector<u8> fallbackMemory;
+
+    int poolFileDescriptor = -1;
+    u32 poolSize = 0; //The pool starts with an erased image of a whole flash, shared pages are appended
+    std::unordered_multimap<size_t, u32> poolPageOffsetsByHash; //Only contains the appended pages
+    std::vector<u8> poolReadBuffer;
+    std::vector<u32> pagePoolOffsets; //The pool offset that each page of each node was mapped from, NOT_SHARED if unknown
+    std::vector<u8> dirtyPages; //One byte per page so that nodes can mark their pages from different threads
+
+    bool CreatePool();
+    u32 AppendPoolPage(const u8* contents, size_t hash);
+    bool PoolPageEquals(u32 poolOffset, const u8* contents);
+    void MapPage(u32 globalPageIndex, u32 poolOffset);
+    u32 GetPagesPerFlash() const;
+    void MarkPagesDirty(u32 firstGlobalPageIndex, u32 lastGlobalPageIndex);
+    void Release();
+
+public:
+    SparseFlash(u32 flashSize, u32 pageSize);
+    ~SparseFlash();
+    SparseFlash(const SparseFlash& other) = delete;
+    SparseFlash& operator=(const SparseFlash& other) = delete;
+
+    //Provides erased flash for the given amount of nodes, previous contents are discarded
+    void Reset(u32 amountOfNodes);
+
+    u8* GetFlash(u32 nodeIndex);
+    void EraseFlash(u32 nodeIndex);
+
+    //Erases size bytes at the given address. Whole erased pages give their memory back.
+    void Erase(u8* address, u32 size);
+
+    //Must be called after writing to the flash
+    void MarkWritten(const u8* address, u32 size);
+
+    //Searches all nodes for pages with identical contents and lets them share the same memory.
+    //Returns the amount of pages that are shared afterwards.
+    u32 ShareIdenticalPages();
+
+    //Pages are addressed by a global index over the flash of all nodes
+    u32 GetAmountOfPages() const;
+    u32 GetPageSize() const;
+    u8* GetPage(u32 globalPageIndex) const;
+    bool IsPageErased(u32 globalPageIndex) const;
+
+    //Returns the pages that were changed since the last call, in ascending order
+    std::vector<u32> TakeDirtyPages();
+
+    //Replaces the given pages with the page aligned contents at the given offsets of a file. If possible,
+    //the file is mapped so that a page is only read once it is accessed.
+    void LoadPagesFromFile(const std::string& path, const std::vector<std::pair<u32, u32>>& globalPageIndicesAndFileOffsets);
+
+    bool IsSparse() const;
+};
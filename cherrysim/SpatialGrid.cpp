@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+static constexpr uint64_t INVALID_CELL_KEY = UINT64_MAX;
+
+i32 SpatialGrid::ToCellCoordinate(float positionInMeters) const
+{
+    const float cell = std::floor(positionInMeters / cellSizeInMeters);
+    //Also catches NaN and infinity before the conversion to an integer
+    if (!(cell > (float)-cellCoordinateMax)) return -cellCoordinateMax;
+    if (!(cell < (float)cellCoordinateMax)) return cellCoordinateMax;
+    return (i32)cell;
+}
+
+uint64_t SpatialGrid::ToCellKey(i32 cellX, i32 cellY, i32 cellZ)
+{
+    return ((uint64_t)(cellX + cellCoordinateMax) << (2 * cellCoordinateBits))
+         | ((uint64_t)(cellY + cellCoordinateMax) << cellCoordinateBits)
+         |  (uint64_t)(cellZ + cellCoordinateMax);
+}
+
+uint64_t SpatialGrid::ToCellKey(float x, float y, float z) const
+{
+    return ToCellKey(
+        ToCellCoordinate(x * mapWidthInMeters),
+        ToCellCoordinate(y * mapHeightInMeters),
+        ToCellCoordinate(z * mapElevationInMeters));
+}
+
+void SpatialGrid::RemoveFromCell(u32 nodeIndex)
+{
+    const uint64_t key = nodeCellKeys[nodeIndex];
+    if (key == INVALID_CELL_KEY) return;
+
+    auto cell = cells.find(key);
+    if (cell != cells.end())
+    {
+        std::vector<u32>& indices = cell->second;
+        auto it = std::find(indices.begin(), indices.end(), nodeIndex);
+        if (it != indices.end())
+        {
+            *it = indices.back();
+            indices.pop_back();
+        }
+        //Empty cells are removed so that the amount of cells stays proportional to the amount of nodes
+        if (indices.empty()) cells.erase(cell);
+    }
+    nodeCellKeys[nodeIndex] = INVALID_CELL_KEY;
+}
+
+void SpatialGrid::Reset(float cellSizeInMeters, u32 mapWidthInMeters, u32 mapHeightInMeters, u32 mapElevationInMeters, u32 amountOfNodes)
+{
+    //A cell size of 0 would put every node in its own cell, a cell size of 1m is fine grained enough in this case
+    this->cellSizeInMeters = (cellSizeInMeters >= 1.0f && std::isfinite(cellSizeInMeters)) ? cellSizeInMeters : 1.0f;
+    this->mapWidthInMeters = (float)mapWidthInMeters;
+    this->mapHeightInMeters = (float)mapHeightInMeters;
+    this->mapElevationInMeters = (float)mapElevationInMeters;
+
+    cells.clear();
+    nodeCellKeys.assign(amountOfNodes, INVALID_CELL_KEY);
+    initialized = true;
+}
+
+bool SpatialGrid::IsValidFor(u32 mapWidthInMeters, u32 mapHeightInMeters, u32 mapElevationInMeters, u32 amountOfNodes) const
+{
+    return initialized
+        && this->mapWidthInMeters == (float)mapWidthInMeters
+        && this->mapHeightInMeters == (float)mapHeightInMeters
+        && this->mapElevationInMeters == (float)mapElevationInMeters
+        && nodeCellKeys.size() == amountOfNodes;
+}
+
+void SpatialGrid::UpdateNode(u32 nodeIndex, float x, float y, float z)
+{
+    if (nodeIndex >= nodeCellKeys.size()) return;
+
+    const uint64_t key = ToCellKey(x, y, z);
+    if (key == nodeCellKeys[nodeIndex]) return;
+
+    RemoveFromCell(nodeIndex);
+    cells[key].push_back(nodeIndex);
+    nodeCellKeys[nodeIndex] = key;
+}
+
+void SpatialGrid::FindNodesInRange(float x, float y, float z, float rangeInMeters, std::vector<u32>& outNodeIndices) const
+{
+    outNodeIndices.clear();
+
+    const float posX = x * mapWidthInMeters;
+    const float posY = y * mapHeightInMeters;
+    const float posZ = z * mapElevationInMeters;
+
+    const i32 minX = ToCellCoordinate(posX - rangeInMeters);
+    const i32 maxX = ToCellCoordinate(posX + rangeInMeters);
+    const i32 minY = ToCellCoordinate(posY - rangeInMeters);
+    const i32 maxY = ToCellCoordinate(posY + rangeInMeters);
+    const i32 minZ = ToCellCoordinate(posZ - rangeInMeters);
+    const i32 maxZ = ToCellCoordinate(posZ + rangeInMeters);
+
+    const uint64_t amountOfCellsInRange = (uint64_t)(maxX - minX + 1) * (uint64_t)(maxY - minY + 1) * (uint64_t)(maxZ - minZ + 1);
+
+    if (amountOfCellsInRange <= cells.size())
+    {
+        //Visit every cell of the range and look it up
+        for (i32 cellX = minX; cellX <= maxX; cellX++)
+        {
+            for (i32 cellY = minY; cellY <= maxY; cellY++)
+            {
+                for (i32 cellZ = minZ; cellZ <= maxZ; cellZ++)
+                {
+                    auto cell = cells.find(ToCellKey(cellX, cellY, cellZ));
+                    if (cell != cells.end())
+                    {
+                        outNodeIndices.insert(outNodeIndices.end(), cell->second.begin(), cell->second.end());
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        //The range covers more cells than are occupied (e.g. for a huge range), so we rather check all occupied cells
+        constexpr uint64_t coordinateMask = (1ull << cellCoordinateBits) - 1;
+        for (const auto& cell : cells)
+        {
+            const i32 cellX = (i32)((cell.first >> (2 * cellCoordinateBits)) & coordinateMask) - cellCoordinateMax;
+            const i32 cellY = (i32)((cell.first >> cellCoordinateBits) & coordinateMask) - cellCoordinateMax;
+            const i32 cellZ = (i32)(cell.first & coordinateMask) - cellCoordinateMax;
+            if (cellX >= minX && cellX <= maxX
+                && cellY >= minY && cellY <= maxY
+                && cellZ >= minZ && cellZ <= maxZ)
+            {
+                outNodeIndices.insert(outNodeIndices.end(), cell.second.begin(), cell.second.end());
+            }
+        }
+    }
+
+    //The simulation must stay deterministic, so the nodes are visited in the same order as without the grid
+    std::sort(outNodeIndices.begin(), outNodeIndices.end());
+}
+
+float SpatialGrid::GetCellSizeInMeters() const
+{
+    return cellSizeInMeters;
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "FmTypes.h"
+
+/*
+ * A uniform grid over the simulated node positions. It is used to find all nodes that
+ * are potentially in reception range of a sender without iterating over every node
+ * of the simulation. Positions are given in the same normalized coordinates as used
+ * by NodeEntry and are converted to meters using the map dimensions.
+ */
+class SpatialGrid
+{
+TESTER_PUBLIC:
+    //Cell coordinates are packed into a single key, each axis gets 21 bits
+    static constexpr i32 cellCoordinateBits = 21;
+    static constexpr i32 cellCoordinateMax = (1 << (cellCoordinateBits - 1)) - 1;
+
+    float cellSizeInMeters = 0;
+    float mapWidthInMeters = 0;
+    float mapHeightInMeters = 0;
+    float mapElevationInMeters = 0;
+    bool initialized = false;
+
+    std::unordered_map<uint64_t, std::vector<u32>> cells;
+    std::vector<uint64_t> nodeCellKeys; //The key of the cell that each node index is currently stored in
+
+    i32 ToCellCoordinate(float positionInMeters) const;
+    static uint64_t ToCellKey(i32 cellX, i32 cellY, i32 cellZ);
+    uint64_t ToCellKey(float x, float y, float z) const;
+    void RemoveFromCell(u32 nodeIndex);
+
+public:
+    //Removes all nodes and prepares the grid for the given map dimensions and amount of nodes
+    void Reset(float cellSizeInMeters, u32 mapWidthInMeters, u32 mapHeightInMeters, u32 mapElevationInMeters, u32 amountOfNodes);
+    bool IsValidFor(u32 mapWidthInMeters, u32 mapHeightInMeters, u32 mapElevationInMeters, u32 amountOfNodes) const;
+
+    //Must be called whenever the position of a node changes, x/y/z are normalized positions
+    void UpdateNode(u32 nodeIndex, float x, float y, float z);
+
+    //Collects the indices of all nodes in the cells that intersect with a cube of the given range around the position.
+    //The result is sorted ascending and may contain nodes that are out of range, but never misses a node in range.
+    void FindNodesInRange(float x, float y, float z, float rangeInMeters, std::vector<u32>& outNodeIndices) const;
+
+    float GetCellSizeInMeters() const;
+};
@@ -40,6 +40,7 @@
 #include <fstream>
 #include <limits>
 #include <optional>
+#include "SimEcbCipher.h"
 
 extern "C" {
 #include <app_timer.h>
@@ -57,21 +58,22 @@ All calls work in conjunction with helper methods and simulation routines define
 using json = nlohmann::json;
 
 //These variables are normally defined by the linker sections, so we need to define them here
-uint32_t __application_start_address;
-uint32_t __application_end_address;
-uint32_t __application_ram_start_address;
-uint32_t __start_conn_type_resolvers;
-uint32_t __stop_conn_type_resolvers;
+//They depend on the node under simulation and are therefore thread local as well
+SIM_THREAD_LOCAL uint32_t __application_start_address;
+SIM_THREAD_LOCAL uint32_t __application_end_address;
+SIM_THREAD_LOCAL uint32_t __application_ram_start_address;
+SIM_THREAD_LOCAL uint32_t __start_conn_type_resolvers;
+SIM_THREAD_LOCAL uint32_t __stop_conn_type_resolvers;
 
 //Pointer to FruityMesh state
-GlobalState* simGlobalStatePtr;
+SIM_THREAD_LOCAL GlobalState* simGlobalStatePtr;
 
 //nRF hardware abstraction
-NRF_FICR_Type* simFicrPtr;
-NRF_UICR_Type* simUicrPtr;
-NRF_GPIO_Type* simGpioPtr;
-NRF_RADIO_Type* simRadioPtr;
-uint8_t* simFlashPtr;
+SIM_THREAD_LOCAL NRF_FICR_Type* simFicrPtr;
+SIM_THREAD_LOCAL NRF_UICR_Type* simUicrPtr;
+SIM_THREAD_LOCAL NRF_GPIO_Type* simGpioPtr;
+SIM_THREAD_LOCAL NRF_RADIO_Type* simRadioPtr;
+SIM_THREAD_LOCAL uint8_t* simFlashPtr;
 
 
 //########################################### SoftDevice Call Redirection #####################################################
@@ -314,10 +316,10 @@ extern "C"
             //Was not initialized!
             SIMEXCEPTION(IllegalStateException);
         }
-        gyro->x = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        gyro->y = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        gyro->z = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        gyro->sensortime = cherrySimInstance->simState.rnd.NextU32();
+        gyro->x = (uint16_t)cherrySimInstance->GetRandom().NextU32();
+        gyro->y = (uint16_t)cherrySimInstance->GetRandom().NextU32();
+        gyro->z = (uint16_t)cherrySimInstance->GetRandom().NextU32();
+        gyro->sensortime = cherrySimInstance->GetRandom().NextU32();
         return BMG250_OK;
     }
 
@@ -395,10 +397,10 @@ extern "C"
             //Was not initialized!
             SIMEXCEPTION(IllegalStateException);
         }
-        out->x = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        out->y = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        out->z = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
-        out->temp = (uint16_t)cherrySimInstance->simState.rnd.NextU32();
+        out->x = (uint16_t)cherrySimInstance->GetRandom().NextU32();
+        out->y = (uint16_t)cherrySimInstance->GetRandom().NextU32();
+        out->z = (uint16_t)cherrySimInstance->GetRandom().NextU32();
+        out->temp = (uint16_t)cherrySimInstance->GetRandom().NextU32();
         return 0;
     }
 
@@ -416,6 +418,7 @@ extern "C"
 
         CheckedMemcpy(cherrySimInstance->currentNode->state.advertisingData, p_data, dlen);
         cherrySimInstance->currentNode->state.advertisingDataLength = dlen;
+        cherrySimInstance->NotifyMapStateChanged(cherrySimInstance->currentNode->index);
 
         //TODO: could copy scan response data
 
@@ -646,9 +649,9 @@ extern "C"
         axis3bit16_t* buffer = (axis3bit16_t*)buff;
         if (ctx->moving)
         {
-            buffer->i16bit[0] = (i16)cherrySimInstance->simState.rnd.NextU32();
-            buffer->i16bit[1] = (i16)cherrySimInstance->simState.rnd.NextU32();
-            buffer->i16bit[2] = (i16)cherrySimInstance->simState.rnd.NextU32();
+            buffer->i16bit[0] = (i16)cherrySimInstance->GetRandom().NextU32();
+            buffer->i16bit[1] = (i16)cherrySimInstance->GetRandom().NextU32();
+            buffer->i16bit[2] = (i16)cherrySimInstance->GetRandom().NextU32();
         }
         else
         {
@@ -804,7 +807,7 @@ extern "C"
             SIMEXCEPTION(IllegalStateException);
         }
 
-        return cherrySimInstance->simState.rnd.NextU32() % (std::numeric_limits<u16>::max() * 512);
+        return cherrySimInstance->GetRandom().NextU32() % (std::numeric_limits<u16>::max() * 512);
     }
     int32_t bme280_get_temperature()
     {
@@ -814,7 +817,7 @@ extern "C"
             //Not initialized!
             SIMEXCEPTION(IllegalStateException);
         }
-        return ((int32_t)cherrySimInstance->simState.rnd.NextU32()) % std::numeric_limits<i16>::max();
+        return ((int32_t)cherrySimInstance->GetRandom().NextU32()) % std::numeric_limits<i16>::max();
     }
     uint32_t bme280_get_humidity()
     {
@@ -825,7 +828,7 @@ extern "C"
             SIMEXCEPTION(IllegalStateException);
         }
 
-        return cherrySimInstance->simState.rnd.NextU32() % (std::numeric_limits<u8>::max() * 1024);
+        return cherrySimInstance->GetRandom().NextU32() % (std::numeric_limits<u8>::max() * 1024);
     }
 
     uint32_t sd_ble_gap_connect(const ble_gap_addr_t* p_peer_addr, const ble_gap_scan_params_t* p_scan_params, const ble_gap_conn_params_t* p_conn_params, uint32_t)
@@ -917,18 +920,23 @@ extern "C"
         if (!connection->isCentral) SIMEXCEPTION(IllegalStateException); //Peripheral cannot start encryption
 
         //Send an event to the connection partner to request the key information
-        simBleEvent s1;
-        s1.globalId = cherrySimInstance->simState.globalEventIdCounter++;
-        s1.bleEvent.header.evt_id = BLE_GAP_EVT_SEC_INFO_REQUEST;
-        s1.bleEvent.header.evt_len = s1.globalId;
-        s1.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
-        ble_gap_addr_t address = CherrySim::Convert(&cherrySimInstance->currentNode->address);
-        CheckedMemcpy(&s1.bleEvent.evt.gap_evt.params.sec_info_request.peer_addr, &address, sizeof(ble_gap_addr_t));
-        s1.bleEvent.evt.gap_evt.params.sec_info_request.master_id = {}; //TODO: incomplete information
-        s1.bleEvent.evt.gap_evt.params.sec_info_request.enc_info = 0; //TODO: incomplete information
-        s1.bleEvent.evt.gap_evt.params.sec_info_request.id_info = 0; //TODO: incomplete information
-        s1.bleEvent.evt.gap_evt.params.sec_info_request.sign_info = 0; //TODO: incomplete information
-        connection->partner->eventQueue.push_back(s1);
+        cherrySimInstance->RunOrDefer([conn_handle]() {
+            SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, conn_handle);
+            if (connection == nullptr) return;
+
+            simBleEvent s1;
+            s1.globalId = cherrySimInstance->GenerateGlobalEventId();
+            s1.bleEvent.header.evt_id = BLE_GAP_EVT_SEC_INFO_REQUEST;
+            s1.bleEvent.header.evt_len = s1.globalId;
+            s1.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
+            ble_gap_addr_t address = CherrySim::Convert(&cherrySimInstance->currentNode->address);
+            CheckedMemcpy(&s1.bleEvent.evt.gap_evt.params.sec_info_request.peer_addr, &address, sizeof(ble_gap_addr_t));
+            s1.bleEvent.evt.gap_evt.params.sec_info_request.master_id = {}; //TODO: incomplete information
+            s1.bleEvent.evt.gap_evt.params.sec_info_request.enc_info = 0; //TODO: incomplete information
+            s1.bleEvent.evt.gap_evt.params.sec_info_request.id_info = 0; //TODO: incomplete information
+            s1.bleEvent.evt.gap_evt.params.sec_info_request.sign_info = 0; //TODO: incomplete information
+            connection->partner->eventQueue.PushBack(s1);
+        });
 
         //Save the key that should be used for encrypting the connection
         CheckedMemcpy(cherrySimInstance->currentNode->state.currentLtkForEstablishingSecurity, p_enc_info->ltk, 16);
@@ -946,41 +954,48 @@ extern "C"
             return BLE_ERROR_INVALID_CONN_HANDLE;
         }
 
-        //Check if the encryption key matches
-        if (
-            memcmp(connection->partner->state.currentLtkForEstablishingSecurity, p_enc_info->ltk, 16) == 0
-        ) {
-            //Set our own conneciton to encrypted
-            connection->connectionEncrypted = true;
-            simBleEvent s1;
-            CheckedMemset(&s1, 0, sizeof(s1));
-            s1.globalId = cherrySimInstance->simState.globalEventIdCounter++;
-            s1.bleEvent.header.evt_id = BLE_GAP_EVT_CONN_SEC_UPDATE;
-            s1.bleEvent.header.evt_len = s1.globalId;
-            s1.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
-            s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = 16;
-            s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
-            s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 3;
-            cherrySimInstance->currentNode->eventQueue.push_back(s1);
-
-            //Set our own partners connection to encrypted
-            connection->partnerConnection->connectionEncrypted = true;
-            simBleEvent s2;
-            CheckedMemset(&s2, 0, sizeof(s2));
-            s2.globalId = cherrySimInstance->simState.globalEventIdCounter++;
-            s2.bleEvent.header.evt_id = BLE_GAP_EVT_CONN_SEC_UPDATE;
-            s2.bleEvent.header.evt_len = s2.globalId;
-            s2.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
-            s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = 16;
-            s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
-            s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 3;
-            connection->partner->eventQueue.push_back(s2);
-        }
-        //Keys do not match, generate a failure
-        else {
-            //Disconnect the connection with a MIC error
-            cherrySimInstance->DisconnectSimulatorConnection(connection, BLE_HCI_CONN_TERMINATED_DUE_TO_MIC_FAILURE, BLE_HCI_CONNECTION_TIMEOUT);
-        }
+        //The key of the partner can only be checked after the partner is done with its current step
+        const ble_gap_enc_info_t encInfo = *p_enc_info;
+        cherrySimInstance->RunOrDefer([conn_handle, encInfo]() {
+            SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, conn_handle);
+            if (connection == nullptr) return;
+
+            //Check if the encryption key matches
+            if (
+                memcmp(connection->partner->state.currentLtkForEstablishingSecurity, encInfo.ltk, 16) == 0
+            ) {
+                //Set our own conneciton to encrypted
+                connection->connectionEncrypted = true;
+                simBleEvent s1;
+                CheckedMemset(&s1, 0, sizeof(s1));
+                s1.globalId = cherrySimInstance->GenerateGlobalEventId();
+                s1.bleEvent.header.evt_id = BLE_GAP_EVT_CONN_SEC_UPDATE;
+                s1.bleEvent.header.evt_len = s1.globalId;
+                s1.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
+                s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = 16;
+                s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
+                s1.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 3;
+                cherrySimInstance->currentNode->eventQueue.PushBack(s1);
+
+                //Set our own partners connection to encrypted
+                connection->partnerConnection->connectionEncrypted = true;
+                simBleEvent s2;
+                CheckedMemset(&s2, 0, sizeof(s2));
+                s2.globalId = cherrySimInstance->GenerateGlobalEventId();
+                s2.bleEvent.header.evt_id = BLE_GAP_EVT_CONN_SEC_UPDATE;
+                s2.bleEvent.header.evt_len = s2.globalId;
+                s2.bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
+                s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = 16;
+                s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm = 1;
+                s2.bleEvent.evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv = 3;
+                connection->partner->eventQueue.PushBack(s2);
+            }
+            //Keys do not match, generate a failure
+            else {
+                //Disconnect the connection with a MIC error
+                cherrySimInstance->DisconnectSimulatorConnection(connection, BLE_HCI_CONN_TERMINATED_DUE_TO_MIC_FAILURE, BLE_HCI_CONNECTION_TIMEOUT);
+            }
+        });
 
         return NRF_SUCCESS;
     }
@@ -1048,9 +1063,6 @@ extern "C"
                 params = *p_conn_params;
             }
 
-            // Fetch the partner connection.
-            SoftdeviceConnection * peripheralConnection = connection->partnerConnection;
-
             // If new parameters are available, generate events on both, central
             // and peripheral with the new parameters and change the parameters
             // stored in the connection object.
@@ -1059,12 +1071,10 @@ extern "C"
                 // Change the parameters in the connection objects.
                 connection->connectionInterval =
                     UNITS_TO_MSEC(params->min_conn_interval, CONFIG_UNIT_1_25_MS);
-                peripheralConnection->connectionInterval =
-                    UNITS_TO_MSEC(params->min_conn_interval, CONFIG_UNIT_1_25_MS);
 
                 { // central event
                     simBleEvent simEvent = {};
-                    simEvent.globalId = cherrySimInstance->simState.globalEventIdCounter++;
+                    simEvent.globalId = cherrySimInstance->GenerateGlobalEventId();
 
                     auto & bleEvent = simEvent.bleEvent;
                     bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE;
@@ -1072,50 +1082,70 @@ extern "C"
                     bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
                     bleEvent.evt.gap_evt.params.conn_param_update.conn_params = *params;
 
-                    connection->owningNode->eventQueue.push_back(simEvent);
+                    connection->owningNode->eventQueue.PushBack(simEvent);
                 }
 
-                { // peripheral event
+                // The peripheral is changed once it is done with its current step.
+                const ble_gap_conn_params_t newParams = *params;
+                cherrySimInstance->RunOrDefer([conn_handle, newParams]() {
+                    SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, conn_handle);
+                    if (connection == nullptr) return;
+                    SoftdeviceConnection * peripheralConnection = connection->partnerConnection;
+
+                    peripheralConnection->connectionInterval =
+                        UNITS_TO_MSEC(newParams.min_conn_interval, CONFIG_UNIT_1_25_MS);
+
+                    // peripheral event
                     simBleEvent simEvent = {};
-                    simEvent.globalId = cherrySimInstance->simState.globalEventIdCounter++;
+                    simEvent.globalId = cherrySimInstance->GenerateGlobalEventId();
 
                     auto & bleEvent = simEvent.bleEvent;
                     bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE;
                     bleEvent.header.evt_len = simEvent.globalId;
                     bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
-                    bleEvent.evt.gap_evt.params.conn_param_update.conn_params = *params;
+                    bleEvent.evt.gap_evt.params.conn_param_update.conn_params = newParams;
 
-                    peripheralConnection->owningNode->eventQueue.push_back(simEvent);
-                }
+                    peripheralConnection->owningNode->eventQueue.PushBack(simEvent);
+                });
             }
             // If a request was rejected, generate an event on the peripheral.
             else
             {
-                simBleEvent simEvent = {};
-                simEvent.globalId = cherrySimInstance->simState.globalEventIdCounter++;
+                cherrySimInstance->RunOrDefer([conn_handle]() {
+                    SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, conn_handle);
+                    if (connection == nullptr) return;
+                    SoftdeviceConnection * peripheralConnection = connection->partnerConnection;
 
-                auto & bleEvent = simEvent.bleEvent;
-                bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE;
-                bleEvent.header.evt_len = simEvent.globalId;
-                bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
+                    simBleEvent simEvent = {};
+                    simEvent.globalId = cherrySimInstance->GenerateGlobalEventId();
+
+                    auto & bleEvent = simEvent.bleEvent;
+                    bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE;
+                    bleEvent.header.evt_len = simEvent.globalId;
+                    bleEvent.evt.gap_evt.conn_handle = connection->connectionHandle;
 
-                auto & connParams = bleEvent.evt.gap_evt.params.conn_param_update.conn_params;
-                connParams.min_conn_interval = peripheralConnection->connectionInterval;
-                connParams.max_conn_interval = peripheralConnection->connectionInterval;
-                connParams.slave_latency = Conf::meshPeripheralSlaveLatency;
-                connParams.conn_sup_timeout = Conf::meshConnectionSupervisionTimeout;
+                    auto & connParams = bleEvent.evt.gap_evt.params.conn_param_update.conn_params;
+                    connParams.min_conn_interval = peripheralConnection->connectionInterval;
+                    connParams.max_conn_interval = peripheralConnection->connectionInterval;
+                    connParams.slave_latency = Conf::meshPeripheralSlaveLatency;
+                    connParams.conn_sup_timeout = Conf::meshConnectionSupervisionTimeout;
 
-                peripheralConnection->owningNode->eventQueue.push_back(simEvent);
+                    peripheralConnection->owningNode->eventQueue.PushBack(simEvent);
+                });
             }
         }
         // Called on the peripheral.
         else
         {
-            // Fetch the partner connection.
-            SoftdeviceConnection * centralConnection = connection->partnerConnection;
             // Check that no connection parameter update request is already
-            // pending.
-            if (centralConnection->connParamUpdateRequestPending)
+            // pending. The central can not be inspected while the nodes are
+            // stepped in parallel, so its state at the start of the step is
+            // used instead and a request that collides with one of the same
+            // step is dropped once the effect is applied.
+            const bool isRequestPending = CherrySim::IsInNodeWorkerContext()
+                ? connection->partnerConnParamUpdateRequestPendingAtStepStart
+                : connection->partnerConnection->connParamUpdateRequestPending;
+            if (isRequestPending)
             {
                 return NRF_ERROR_BUSY;
             }
@@ -1124,29 +1154,37 @@ extern "C"
             {
                 return NRF_ERROR_INVALID_ADDR;
             }
-            // TODO: Check the constraints of the parameter values and
-            //       return NRF_ERROR_INVALID_PARAM if violated.
-            // Update the requested connection parameters.
-            auto &cpurp = centralConnection->connParamUpdateRequestParameters;
-            cpurp.minConnInterval = p_conn_params->min_conn_interval;
-            cpurp.maxConnInterval = p_conn_params->max_conn_interval;
-            cpurp.slaveLatency = p_conn_params->slave_latency;
-            cpurp.connSupTimeout = p_conn_params->conn_sup_timeout; 
-            // Compute the timeout and set the pending flag.
-            centralConnection->connParamUpdateRequestTimeoutDs =
-                centralConnection->owningNode->gs.appTimerDs + 20;
-            centralConnection->connParamUpdateRequestPending = true;
-            // Create the event on the central.
-            simBleEvent simEvent = {};
-            simEvent.globalId = cherrySimInstance->simState.globalEventIdCounter++;
-            auto & bleEvent = simEvent.bleEvent;
-            bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST;
-            bleEvent.header.evt_len = simEvent.globalId;
-            bleEvent.evt.gap_evt.conn_handle = centralConnection->connectionHandle;
-            bleEvent.evt.gap_evt.params.conn_param_update_request.conn_params =
-                *p_conn_params;
-            // Push the request event into the event queue of the central node.
-            centralConnection->owningNode->eventQueue.push_back(simEvent);
+            const ble_gap_conn_params_t requestedParams = *p_conn_params;
+            cherrySimInstance->RunOrDefer([conn_handle, requestedParams]() {
+                SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, conn_handle);
+                if (connection == nullptr) return;
+                // Fetch the partner connection.
+                SoftdeviceConnection * centralConnection = connection->partnerConnection;
+                if (centralConnection->connParamUpdateRequestPending) return;
+                // TODO: Check the constraints of the parameter values and
+                //       return NRF_ERROR_INVALID_PARAM if violated.
+                // Update the requested connection parameters.
+                auto &cpurp = centralConnection->connParamUpdateRequestParameters;
+                cpurp.minConnInterval = requestedParams.min_conn_interval;
+                cpurp.maxConnInterval = requestedParams.max_conn_interval;
+                cpurp.slaveLatency = requestedParams.slave_latency;
+                cpurp.connSupTimeout = requestedParams.conn_sup_timeout; 
+                // Compute the timeout and set the pending flag.
+                centralConnection->connParamUpdateRequestTimeoutDs =
+                    centralConnection->owningNode->gs.appTimerDs + 20;
+                centralConnection->connParamUpdateRequestPending = true;
+                // Create the event on the central.
+                simBleEvent simEvent = {};
+                simEvent.globalId = cherrySimInstance->GenerateGlobalEventId();
+                auto & bleEvent = simEvent.bleEvent;
+                bleEvent.header.evt_id = BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST;
+                bleEvent.header.evt_len = simEvent.globalId;
+                bleEvent.evt.gap_evt.conn_handle = centralConnection->connectionHandle;
+                bleEvent.evt.gap_evt.params.conn_param_update_request.conn_params =
+                    requestedParams;
+                // Push the request event into the event queue of the central node.
+                centralConnection->owningNode->eventQueue.PushBack(simEvent);
+            });
         }
 
         return NRF_SUCCESS;
@@ -1355,7 +1393,7 @@ extern "C"
         connection->connectionMtu = clientRxMtu - FruityHal::ATT_HEADER_SIZE;
         simBleEvent s1;
         CheckedMemset(&s1, 0, sizeof(s1));
-        s1.globalId = cherrySimInstance->simState.globalEventIdCounter++;
+        s1.globalId = cherrySimInstance->GenerateGlobalEventId();
         s1.bleEvent.header.evt_id = BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST;
         s1.bleEvent.header.evt_len = s1.globalId;
         s1.bleEvent.evt.gattc_evt.conn_handle = connHandle;
@@ -1363,7 +1401,10 @@ extern "C"
         ble_gap_addr_t address = CherrySim::Convert(&cherrySimInstance->currentNode->address);
         CheckedMemcpy(&s1.bleEvent.evt.gap_evt.params.sec_info_request.peer_addr, &address, sizeof(ble_gap_addr_t));
 
-        connection->partner->eventQueue.push_back(s1);
+        cherrySimInstance->RunOrDefer([connHandle, s1]() {
+            SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, connHandle);
+            if (connection != nullptr) connection->partner->eventQueue.PushBack(s1);
+        });
 
 
         return NRF_SUCCESS;
@@ -1405,7 +1446,7 @@ extern "C"
 
         simBleEvent s1;
         CheckedMemset(&s1, 0, sizeof(s1));
-        s1.globalId = cherrySimInstance->simState.globalEventIdCounter++;
+        s1.globalId = cherrySimInstance->GenerateGlobalEventId();
         s1.bleEvent.header.evt_id = BLE_GATTC_EVT_EXCHANGE_MTU_RSP;
         s1.bleEvent.header.evt_len = s1.globalId;
         s1.bleEvent.evt.gattc_evt.conn_handle = connHandle;
@@ -1413,7 +1454,10 @@ extern "C"
         ble_gap_addr_t address = CherrySim::Convert(&cherrySimInstance->currentNode->address);
         CheckedMemcpy(&s1.bleEvent.evt.gap_evt.params.sec_info_request.peer_addr, &address, sizeof(ble_gap_addr_t));
   
-        connection->partner->eventQueue.push_back(s1);
+        cherrySimInstance->RunOrDefer([connHandle, s1]() {
+            SoftdeviceConnection* connection = cherrySimInstance->FindConnectionByHandle(cherrySimInstance->currentNode, connHandle);
+            if (connection != nullptr) connection->partner->eventQueue.PushBack(s1);
+        });
 
 
         return NRF_SUCCESS;
@@ -1493,7 +1537,7 @@ extern "C"
         }
 
         //We save a global id for each packet that is sent, so that we can debug where a packet was generated
-        buffer->globalPacketId = cherrySimInstance->simState.globalPacketIdCounter++;
+        buffer->globalPacketId = cherrySimInstance->GenerateGlobalPacketId();
         buffer->sender = cherrySimInstance->currentNode;
         buffer->receiver = partnerNode;
         buffer->connHandle = conn_handle;
@@ -1504,7 +1548,7 @@ extern "C"
         buffer->isHvx = false;
         
         //Record statistics for every packet queued in the SoftDevice
-        cherrySimInstance->AddMessageToStats(cherrySimInstance->currentNode->routedPackets, buffer->data, buffer->params.writeParams.len);
+        cherrySimInstance->AddMessageToStats(cherrySimInstance->currentNode->routedPackets, cherrySimInstance->globalRoutedPackets, buffer->data, buffer->params.writeParams.len);
 
         //if (cherrySimInstance->currentNode->id == 37 && conn_handle == 680) printf("Q@NODE %u WRITES %s messageType %u" EOL, cherrySimInstance->currentNode->id, p_write_params->write_op == BLE_GATT_OP_WRITE_REQ ? "WRITE_REQ" : "WRITE_CMD", buffer->data[0]);
 
@@ -1521,12 +1565,7 @@ extern "C"
 
         logt("RS", "Erasing Page %u", page_number);
 
-        u32* p = (u32*)(FLASH_REGION_START_ADDRESS + (u32)page_number * FruityHal::GetCodePageSize());
-
-        for (u32 i = 0; i < FruityHal::GetCodePageSize() / 4; i++) {
-            p[i] = 0xFFFFFFFF;
-        }
-
+        cherrySimInstance->ErasePage(FLASH_REGION_START_ADDRESS + (u32)page_number * FruityHal::GetCodePageSize());
 
         if (cherrySimInstance->simConfig.simulateAsyncFlash) {
             cherrySimInstance->currentNode->state.numWaitingFlashOperations++;
@@ -1573,6 +1612,7 @@ extern "C"
         for (u32 i = 0; i < size; i++) {
             p_dst[i] &= p_src[i];
         }
+        cherrySimInstance->MarkFlashWritten((u32)p_dst, size * sizeof(u32));
 
         if (cherrySimInstance->simConfig.simulateAsyncFlash) {
             cherrySimInstance->currentNode->state.numWaitingFlashOperations++;
@@ -1649,19 +1689,18 @@ extern "C"
             return NRF_ERROR_INVALID_ADDR;
         }
 
-        if (cherrySimInstance->currentNode->eventQueue.empty())
+        if (cherrySimInstance->currentNode->eventQueue.IsEmpty())
         {
             // [SD]: No events ready to be pulled.
             return NRF_ERROR_NOT_FOUND;
         }
 
-        auto simBleEvent = cherrySimInstance->currentNode->eventQueue.front();
+        NodeEntry* currentNode = cherrySimInstance->currentNode;
 
-        // Compute the number of bytes to copy from the event to the buffer.
-        // The BLE events can contain more data than the native BLE event
-        // structure, where the data member provides that overflow space.
-        constexpr std::size_t eventSize =
-                sizeof(simBleEvent.bleEvent) + sizeof(simBleEvent.bleEventOverflowData);
+        // The buffer must be able to hold the biggest event. The BLE events can
+        // contain more data than the native BLE event structure, where the data
+        // member provides that overflow space.
+        constexpr std::size_t eventSize = SimBleEventQueue::MAX_EVENT_SIZE;
 
         // TODO: The actual SoftDevice checks that the event actually fits
         //       into the buffer. If you compile this check in, the simulator
@@ -1673,11 +1712,10 @@ extern "C"
         //    // [SD]: Event ready but could not fit into the supplied buffer.
         //    return NRF_ERROR_DATA_SIZE;
         //}
-        // TODO: For now we will use the number of bytes computed above and
-        //       return failure if the buffer was too small. If you arrive
-        //       here during debugging, the buffer you passed in was too small.
-        //       This check (and notice) can be removed after the check above
-        //       works correctly. (BR-1360)
+        // TODO: For now we will use the maximum event size and return failure
+        //       if the buffer was too small. If you arrive here during debugging,
+        //       the buffer you passed in was too small. This check (and notice)
+        //       can be removed after the check above works correctly. (BR-1360)
         if (*p_len < eventSize)
         {
             // [SD]: Event ready but could not fit into the supplied buffer.
@@ -1685,24 +1723,42 @@ extern "C"
         }
 
         // We store the current event so that we can access it during debugging
-        // if we want to get more information.
-        cherrySimInstance->currentNode->currentEvent = simBleEvent;
-        cherrySimInstance->currentNode->eventQueue.pop_front();
+        // if we want to get more information. Only the used bytes are copied.
+        currentNode->eventQueue.PopFront(currentNode->currentEvent);
+        const simBleEvent& simBleEvent = currentNode->currentEvent;
+
+        // Everything but scanning might change the connections or the cluster that the fruitymap shows.
+        if (simBleEvent.bleEvent.header.evt_id != BLE_GAP_EVT_ADV_REPORT)
+        {
+            cherrySimInstance->NotifyMapStateChanged(currentNode->index);
+        }
 
         if (cherrySimInstance->simEventListener != nullptr)
         {
-            cherrySimInstance->simEventListener->CherrySimBleEventHandler(
-                    cherrySimInstance->currentNode,
-                    &simBleEvent, sizeof(simBleEvent));
+            if (CherrySim::IsInNodeWorkerContext())
+            {
+                // The listener is not thread safe, it is notified once all nodes are done.
+                cherrySimInstance->RunOrDefer([event = simBleEvent]() mutable {
+                    cherrySimInstance->simEventListener->CherrySimBleEventHandler(
+                            cherrySimInstance->currentNode,
+                            &event, sizeof(event));
+                });
+            }
+            else
+            {
+                cherrySimInstance->simEventListener->CherrySimBleEventHandler(
+                        currentNode,
+                        &currentNode->currentEvent, sizeof(simBleEvent));
+            }
         }
 
         // [SD]: Update the pointee of p_len with the used number of bytes.
-        *p_len = std::min<std::uint16_t>(*p_len, eventSize);
+        *p_len = std::min<std::uint16_t>(*p_len, simBleEvent.size);
 
         // [SD]: If p_dest is the nullptr, just peek the event length.
         if (p_dest != nullptr)
         {
-            CheckedMemcpy(p_dest, &simBleEvent, *p_len);
+            CheckedMemcpy(p_dest, &simBleEvent.bleEvent, *p_len);
         }
 
         // [SD]: Event pulled and stored into the supplied buffer.
@@ -1896,7 +1952,7 @@ extern "C"
             return NRF_ERROR_RESOURCES;
         }
 
-        buffer->globalPacketId = cherrySimInstance->simState.globalPacketIdCounter++;
+        buffer->globalPacketId = cherrySimInstance->GenerateGlobalPacketId();
         buffer->sender = cherrySimInstance->currentNode;
         buffer->receiver = partnerNode;
         buffer->connHandle = conn_handle;
@@ -1918,7 +1974,7 @@ extern "C"
 
     uint32_t sd_ecb_block_encrypt(nrf_ecb_hal_data_t * p_ecb_data) {
         START_OF_FUNCTION();
-        AES_ECB_encrypt(p_ecb_data->cleartext, p_ecb_data->key, p_ecb_data->ciphertext, 16);
+        SimEcbCipher::GetThreadInstance().EncryptBlock(p_ecb_data->key, p_ecb_data->cleartext, p_ecb_data->ciphertext);
 
         return 0;
     }
@@ -2005,47 +2061,101 @@ const char *__asan_default_options() {
 // These calls can be made within FruityMesh using the macros (e.g. SIMSTATCOUNT)
 //#########################################################################################
 
-std::map<std::string, int> simStatCounts;
+uint32_t sim_get_statistic_key_id(SimStatKeyCache* cache, const char* key)
+{
+    if (cache->key != key)
+    {
+        cache->id = SimStatKeys::Intern(key);
+        cache->key = key;
+    }
+    return cache->id;
+}
+
+//Nodes collect into their own table so that they can be stepped in parallel
+static SimStatTable& GetCurrentStatistics()
+{
+    if (cherrySimInstance != nullptr && cherrySimInstance->currentNode != nullptr) return cherrySimInstance->currentNode->statistics;
+    return GetSimStatisticsWithoutNode();
+}
+
+//The statistics of all nodes of the current simulator summed up
+static SimStatTable GetGlobalStatistics()
+{
+    SimStatTable retVal = GetSimStatisticsWithoutNode();
+    if (cherrySimInstance != nullptr && cherrySimInstance->nodes != nullptr)
+    {
+        for (u32 i = 0; i < cherrySimInstance->GetTotalNodes(); i++) retVal.Add(cherrySimInstance->nodes[i].statistics);
+    }
+    return retVal;
+}
+
+void sim_collect_statistic_count_by_id(uint32_t keyId)
+{
+    GetCurrentStatistics().Get(keyId).count++;
+}
+
+void sim_collect_statistic_avg_by_id(uint32_t keyId, int value)
+{
+    GetCurrentStatistics().Get(keyId).AddSample(value);
+}
+
 void sim_collect_statistic_count(const char* key)
 {
-    simStatCounts[key] += 1;
+    sim_collect_statistic_count_by_id(SimStatKeys::Intern(key));
 }
 
-std::map<std::string, int> simStatAvgCounts;
-std::map<std::string, int> simStatAvgTotal;
 void sim_collect_statistic_avg(const char* key, int value)
 {
-    simStatAvgCounts[key] += 1;
-    simStatAvgTotal[key] += value;
+    sim_collect_statistic_avg_by_id(SimStatKeys::Intern(key), value);
 }
 
 void sim_clear_statistics()
 {
-    simStatCounts.clear();
+    GetSimStatisticsWithoutNode().Clear();
+    if (cherrySimInstance != nullptr && cherrySimInstance->nodes != nullptr)
+    {
+        for (u32 i = 0; i < cherrySimInstance->GetTotalNodes(); i++) cherrySimInstance->nodes[i].statistics.Clear();
+    }
 }
 
 void sim_print_statistics()
 {
+    const std::vector<std::pair<std::string, SimStatValue>> entries = GetGlobalStatistics().GetEntries();
+
     printf("------ COUNTS --------" EOL);
-    std::map<std::string, int>::iterator it;
-    for (it = simStatCounts.begin(); it != simStatCounts.end(); it++) {
-        printf("Key: %s, Count: %d" EOL, it->first.c_str(), it->second);
+    for (const auto& entry : entries) {
+        if (entry.second.count > 0) printf("Key: %s, Count: %u" EOL, entry.first.c_str(), entry.second.count);
     }
 
     printf("------ AVG --------" EOL);
-    std::map<std::string, int>::iterator it2;
-    for (it2 = simStatAvgCounts.begin(); it2 != simStatAvgCounts.end(); it2++) {
-        const char* key = it2->first.c_str();
-        int avg = simStatAvgTotal[key] / simStatAvgCounts[key];
-        printf("Key: %s, Count: %d, Avg: %d" EOL, key, simStatAvgCounts[key], avg);
+    for (const auto& entry : entries) {
+        const SimStatValue& value = entry.second;
+        if (value.samples > 0) printf("Key: %s, Count: %u, Avg: %d, Min: %d, Max: %d" EOL, entry.first.c_str(), value.samples, value.GetAverage(), value.min, value.max);
     }
 
     printf("--------------" EOL);
 }
 
+void sim_print_statistics_json()
+{
+    nlohmann::json json;
+    json["global"] = GetGlobalStatistics().ToJson();
+    json["nodes"] = nlohmann::json::object();
+    if (cherrySimInstance != nullptr && cherrySimInstance->nodes != nullptr)
+    {
+        for (u32 i = 0; i < cherrySimInstance->GetTotalNodes(); i++)
+        {
+            const NodeEntry& node = cherrySimInstance->nodes[i];
+            if (!node.statistics.IsEmpty()) json["nodes"][std::to_string(node.id)] = node.statistics.ToJson();
+        }
+    }
+    printf("%s" EOL, json.dump().c_str());
+}
+
 int sim_get_statistics(const char* key)
 {
-    return simStatCounts[key];
+    const SimStatValue* value = GetGlobalStatistics().Find(SimStatKeys::Intern(key));
+    return value != nullptr ? (int)value->count : 0;
 }
 
 uint32_t sim_get_stack_type()
@@ -107,12 +107,22 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+//All pointers to the state of the node under simulation are thread local so that
+//multiple simulator instances can run in parallel on different threads
+#if defined(__cplusplus)
+#define SIM_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define SIM_THREAD_LOCAL __declspec(thread)
+#else
+#define SIM_THREAD_LOCAL __thread
+#endif
+
 #ifdef __cplusplus
 typedef class Node Node;
 typedef class GlobalState GlobalState;
 
 //We keep a pointer to our GlobalState, this state contains the whole state of a node as known to FruityMesh
-extern GlobalState* simGlobalStatePtr;
+extern SIM_THREAD_LOCAL GlobalState* simGlobalStatePtr;
 #define GS (simGlobalStatePtr)
 #endif //__cplusplus
 
@@ -740,7 +750,8 @@ uint32_t bme280_get_pressure();
 int32_t bme280_get_temperature();
 uint32_t bme280_get_humidity();
 
-#define SIM_MAX_FLASH_SIZE (4096 * 128)
+#define SIM_FLASH_PAGE_SIZE 4096
+#define SIM_MAX_FLASH_SIZE (SIM_FLASH_PAGE_SIZE * 128)
 
 //We need to redefine the macro that calculates the sizes of MasterBootRecord, Softddevice,...
 
@@ -753,12 +764,12 @@ extern int globalBreakCounter;
 //We keep a number of pointers to hardware peripherals so that our FruityMesh implementation
 //does not have to include the simulator. It will access all hardware using these pointers and we can
 //therefore redirect all access
-extern NRF_FICR_Type* simFicrPtr;
-extern NRF_UICR_Type* simUicrPtr;
-extern NRF_GPIO_Type* simGpioPtr;
-extern NRF_UART_Type* simUartPtr;
-extern NRF_RADIO_Type* simRadioPtr;
-extern uint8_t* simFlashPtr;
+extern SIM_THREAD_LOCAL NRF_FICR_Type* simFicrPtr;
+extern SIM_THREAD_LOCAL NRF_UICR_Type* simUicrPtr;
+extern SIM_THREAD_LOCAL NRF_GPIO_Type* simGpioPtr;
+extern SIM_THREAD_LOCAL NRF_UART_Type* simUartPtr;
+extern SIM_THREAD_LOCAL NRF_RADIO_Type* simRadioPtr;
+extern SIM_THREAD_LOCAL uint8_t* simFlashPtr;
 #define NRF_FICR (simFicrPtr)
 #define NRF_UICR (simUicrPtr)
 #define NRF_GPIO (simGpioPtr)
@@ -770,9 +781,10 @@ extern uint8_t* simFlashPtr;
 //The pages however are always counted from the beginning of the flash memory.
 #define FLASH_REGION_START_ADDRESS ((u32)simFlashPtr)
 
-//Used to collect statistic counts in the simulator, a hashmap is used to count all calls to this function under the given key
-#define SIMSTATCOUNT(key) sim_collect_statistic_count(key)
-#define SIMSTATAVG(key, value) sim_collect_statistic_avg(key, value)
+//Used to collect statistics in the simulator, the count or the values are collected per node under the given key.
+//The key is only interned once per call site and must therefore not change, e.g. by being a string literal.
+#define SIMSTATCOUNT(key) do { static SIM_THREAD_LOCAL SimStatKeyCache simStatKeyCache = { NULL, 0 }; sim_collect_statistic_count_by_id(sim_get_statistic_key_id(&simStatKeyCache, key)); } while(0)
+#define SIMSTATAVG(key, value) do { static SIM_THREAD_LOCAL SimStatKeyCache simStatKeyCache = { NULL, 0 }; sim_collect_statistic_avg_by_id(sim_get_statistic_key_id(&simStatKeyCache, key), value); } while(0)
 
 
 uint32_t sd_ble_gap_adv_data_set(uint8_t const *p_data, uint8_t dlen, uint8_t const *p_sr_data, uint8_t srdlen);
@@ -844,10 +856,19 @@ uint32_t sd_radio_session_close();
 uint32_t sd_radio_request(nrf_radio_request_t const * request);
 
 
+typedef struct SimStatKeyCache
+{
+    const char* key;
+    uint32_t id;
+} SimStatKeyCache;
+uint32_t sim_get_statistic_key_id(SimStatKeyCache* cache, const char* key);
+void sim_collect_statistic_count_by_id(uint32_t keyId);
+void sim_collect_statistic_avg_by_id(uint32_t keyId, int value);
 void sim_collect_statistic_count(const char* key);
 void sim_collect_statistic_avg(const char* key, int value);
 void sim_clear_statistics();
 void sim_print_statistics();
+void sim_print_statistics_json();
 int sim_get_statistics(const char* key);
 
 uint32_t sim_get_stack_type();
@@ -0,0 +1,339 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "TerminalMessageMatcher.h"
+#include "CherrySimTester.h"
+
+#include <algorithm>
+#include <cctype>
+#include <queue>
+
+static uint64_t GetBucketKey(u32 literalId, NodeId nodeId)
+{
+    return ((uint64_t)literalId << 16) | nodeId;
+}
+
+void TerminalMessageMatcher::Compile(std::vector<SimulationMessage>& messages, bool useRegex)
+{
+    this->messages = &messages;
+    this->useRegex = useRegex;
+    amountOfFoundMessages = 0;
+
+    states.assign(1, State());
+    literalIds.clear();
+    literalBuckets.clear();
+    unconditionalBuckets.clear();
+    amountOfUnfoundMessagesPerNode.clear();
+    regexIds.clear();
+    regexes.clear();
+    messageRegexIds.assign(messages.size(), NONE);
+
+    for (u32 i = 0; i < messages.size(); i++)
+    {
+        const SimulationMessage& message = messages[i];
+        if (message.IsFound())
+        {
+            amountOfFoundMessages++;
+            continue;
+        }
+        amountOfUnfoundMessagesPerNode[message.GetNodeId()]++;
+
+        std::string literal = message.messagePart;
+        if (useRegex)
+        {
+            auto regexId = regexIds.find(message.messagePart);
+            if (regexId == regexIds.end())
+            {
+                regexId = regexIds.emplace(message.messagePart, (u32)regexes.size()).first;
+                regexes.emplace_back(message.messagePart);
+            }
+            messageRegexIds[i] = regexId->second;
+            literal = ExtractRequiredLiteral(message.messagePart);
+        }
+
+        //Indices are added in ascending order, so every bucket is sorted
+        if (literal.empty())
+        {
+            unconditionalBuckets[message.GetNodeId()].messageIndices.push_back(i);
+        }
+        else
+        {
+            literalBuckets[GetBucketKey(AddLiteral(literal), message.GetNodeId())].messageIndices.push_back(i);
+        }
+    }
+
+    BuildFailureLinks();
+    literalHitStamps.assign(literalIds.size(), 0);
+    literalHitStamp = 0;
+}
+
+u32 TerminalMessageMatcher::AddLiteral(const std::string& literal)
+{
+    auto existing = literalIds.find(literal);
+    if (existing != literalIds.end()) return existing->second;
+
+    u32 state = 0;
+    for (const char c : literal)
+    {
+        u32 next = NONE;
+        for (const auto& transition : states[state].transitions)
+        {
+            if (transition.first == c) next = transition.second;
+        }
+        if (next == NONE)
+        {
+            next = (u32)states.size();
+            states[state].transitions.emplace_back(c, next);
+            states.emplace_back();
+        }
+        state = next;
+    }
+
+    const u32 literalId = (u32)literalIds.size();
+    literalIds.emplace(literal, literalId);
+    states[state].literalId = literalId;
+    return literalId;
+}
+
+void TerminalMessageMatcher::BuildFailureLinks()
+{
+    //Breadth first so that the failure target of a state is always complete before the state itself
+    std::queue<u32> queue;
+    for (const auto& transition : states[0].transitions)
+    {
+        states[transition.second].failure = 0;
+        queue.push(transition.second);
+    }
+    while (!queue.empty())
+    {
+        const u32 state = queue.front();
+        queue.pop();
+
+        const u32 failure = states[state].failure;
+        states[state].outputLink = states[failure].literalId != NONE ? failure : states[failure].outputLink;
+
+        for (const auto& transition : states[state].transitions)
+        {
+            u32 fallback = failure;
+            u32 target = FindTransition(fallback, transition.first);
+            while (target == NONE && fallback != 0)
+            {
+                fallback = states[fallback].failure;
+                target = FindTransition(fallback, transition.first);
+            }
+            states[transition.second].failure = target == NONE ? 0 : target;
+            queue.push(transition.second);
+        }
+    }
+}
+
+u32 TerminalMessageMatcher::FindTransition(u32 state, char c) const
+{
+    for (const auto& transition : states[state].transitions)
+    {
+        if (transition.first == c) return transition.second;
+    }
+    return NONE;
+}
+
+void TerminalMessageMatcher::CollectCandidates(Bucket& bucket)
+{
+    std::vector<SimulationMessage>& awaited = *messages;
+    while (bucket.firstUnfound < bucket.messageIndices.size() && awaited[bucket.messageIndices[bucket.firstUnfound]].IsFound())
+    {
+        bucket.firstUnfound++;
+    }
+    if (bucket.firstUnfound >= bucket.messageIndices.size()) return;
+
+    if (!useRegex)
+    {
+        //All messages of a bucket match the same lines, so only the first one can be found
+        candidates.push_back(bucket.messageIndices[bucket.firstUnfound]);
+        return;
+    }
+    for (u32 i = bucket.firstUnfound; i < bucket.messageIndices.size(); i++)
+    {
+        if (!awaited[bucket.messageIndices[i]].IsFound()) candidates.push_back(bucket.messageIndices[i]);
+    }
+}
+
+bool TerminalMessageMatcher::ProcessLine(NodeId nodeId, const std::string& line)
+{
+    if (messages == nullptr) return false;
+    auto unfound = amountOfUnfoundMessagesPerNode.find(nodeId);
+    if (unfound == amountOfUnfoundMessagesPerNode.end() || unfound->second == 0) return false;
+
+    //Find all literals that occur in the line with a single pass
+    hitLiterals.clear();
+    literalHitStamp++;
+    if (literalHitStamp == 0)
+    {
+        std::fill(literalHitStamps.begin(), literalHitStamps.end(), 0);
+        literalHitStamp = 1;
+    }
+    u32 state = 0;
+    for (const char c : line)
+    {
+        u32 next = FindTransition(state, c);
+        while (next == NONE && state != 0)
+        {
+            state = states[state].failure;
+            next = FindTransition(state, c);
+        }
+        state = next == NONE ? 0 : next;
+
+        for (u32 output = states[state].literalId != NONE ? state : states[state].outputLink; output != NONE; output = states[output].outputLink)
+        {
+            const u32 literalId = states[output].literalId;
+            if (literalHitStamps[literalId] == literalHitStamp) break; //The rest of the chain was already reported as well
+            literalHitStamps[literalId] = literalHitStamp;
+            hitLiterals.push_back(literalId);
+        }
+    }
+
+    candidates.clear();
+    for (const u32 literalId : hitLiterals)
+    {
+        auto bucket = literalBuckets.find(GetBucketKey(literalId, nodeId));
+        if (bucket != literalBuckets.end()) CollectCandidates(bucket->second);
+    }
+    auto unconditionalBucket = unconditionalBuckets.find(nodeId);
+    if (unconditionalBucket != unconditionalBuckets.end()) CollectCandidates(unconditionalBucket->second);
+    if (candidates.empty()) return false;
+
+    std::sort(candidates.begin(), candidates.end());
+    for (const u32 messageIndex : candidates)
+    {
+        if (!useRegex || std::regex_search(line, regexes[messageRegexIds[messageIndex]]))
+        {
+            MarkFound(messageIndex, nodeId, line);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TerminalMessageMatcher::MarkFound(u32 messageIndex, NodeId nodeId, const std::string& line)
+{
+    (*messages)[messageIndex].MakeFound(line);
+    amountOfFoundMessages++;
+    amountOfUnfoundMessagesPerNode[nodeId]--;
+}
+
+bool TerminalMessageMatcher::AreAllMessagesFound() const
+{
+    return messages != nullptr && amountOfFoundMessages == messages->size();
+}
+
+u32 TerminalMessageMatcher::GetAmountOfFoundMessages() const
+{
+    return amountOfFoundMessages;
+}
+
+std::string TerminalMessageMatcher::ExtractRequiredLiteral(const std::string& regex)
+{
+    std::string best;
+    std::string run;
+    u32 groupDepth = 0;
+
+    auto endRun = [&]() {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+    auto appendLiteral = [&](char c) {
+        //Characters inside of groups might be optional or repeated as a whole, they are ignored
+        if (groupDepth == 0) run += c;
+    };
+
+    for (size_t i = 0; i < regex.size(); i++)
+    {
+        const char c = regex[i];
+        if (c == '\\')
+        {
+            if (i + 1 >= regex.size()) return "";
+            const char escaped = regex[i + 1];
+            i++;
+            //Escaped letters and digits are character classes, anchors, back references or character codes
+            if (std::isalnum((unsigned char)escaped)) endRun();
+            else appendLiteral(escaped);
+            //The operands of character codes are not part of the matched text
+            if (escaped == 'x') i += 2;
+            else if (escaped == 'u') i += 4;
+            else if (escaped == 'c') i += 1;
+        }
+        else if (c == '|')
+        {
+            //Only one of the alternatives has to match
+            return "";
+        }
+        else if (c == '(')
+        {
+            endRun();
+            groupDepth++;
+        }
+        else if (c == ')')
+        {
+            endRun();
+            if (groupDepth > 0) groupDepth--;
+        }
+        else if (c == '[')
+        {
+            endRun();
+            //Skip the character class, a closing bracket directly at the start is part of the class
+            i++;
+            if (i < regex.size() && regex[i] == '^') i++;
+            if (i < regex.size() && regex[i] == ']') i++;
+            while (i < regex.size() && regex[i] != ']')
+            {
+                if (regex[i] == '\\') i++;
+                i++;
+            }
+        }
+        else if (c == '*' || c == '?' || c == '{')
+        {
+            //The previous character is optional or its amount is unknown
+            if (!run.empty()) run.pop_back();
+            endRun();
+            if (c == '{')
+            {
+                while (i < regex.size() && regex[i] != '}') i++;
+            }
+        }
+        else if (c == '+' || c == '.' || c == '^' || c == '$')
+        {
+            endRun();
+        }
+        else
+        {
+            appendLiteral(c);
+        }
+    }
+    endRun();
+    return best;
+}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <string>
+#include <regex>
+#include <unordered_map>
+
+#include "FmTypes.h"
+
+class SimulationMessage;
+
+/*
+ * Matches the terminal output of the simulation against the messages that a test awaits.
+ * The messages are compiled once when waiting starts: the literal parts of all messages
+ * (the complete message or the longest text that a regex requires) are put into an
+ * Aho-Corasick automaton so that each line only has to be scanned once, independent of the
+ * amount of awaited messages. Messages are bucketed per node and literal, regexes are compiled
+ * once and only evaluated for messages whose literal occurred in the line.
+ * The result is the same as checking the awaited messages in order: a line marks the first
+ * message of its node that it matches and that was not found before.
+ */
+class TerminalMessageMatcher
+{
+TESTER_PUBLIC:
+    static constexpr u32 NONE = 0xFFFFFFFF;
+
+    struct State
+    {
+        std::vector<std::pair<char, u32>> transitions;
+        u32 failure = 0;
+        u32 outputLink = NONE; //Next state on the failure chain that completes a literal
+        u32 literalId = NONE;  //Literal that ends in this state
+    };
+
+    //Awaited messages of one node, in ascending order. Found messages are skipped lazily.
+    struct Bucket
+    {
+        std::vector<u32> messageIndices;
+        u32 firstUnfound = 0;
+    };
+
+    std::vector<SimulationMessage>* messages = nullptr;
+    bool useRegex = false;
+    u32 amountOfFoundMessages = 0;
+
+    std::vector<State> states;
+    std::unordered_map<std::string, u32> literalIds;
+    std::unordered_map<uint64_t, Bucket> literalBuckets; //Key is literal id and node id
+    std::unordered_map<NodeId, Bucket> unconditionalBuckets; //Messages without a literal
+    std::unordered_map<NodeId, u32> amountOfUnfoundMessagesPerNode;
+
+    std::unordered_map<std::string, u32> regexIds;
+    std::vector<std::regex> regexes;
+    std::vector<u32> messageRegexIds;
+
+    //Scratch memory of ProcessLine
+    std::vector<u32> literalHitStamps;
+    u32 literalHitStamp = 0;
+    std::vector<u32> hitLiterals;
+    std::vector<u32> candidates;
+
+    u32 AddLiteral(const std::string& literal);
+    void BuildFailureLinks();
+    u32 FindTransition(u32 state, char c) const;
+    void CollectCandidates(Bucket& bucket);
+    void MarkFound(u32 messageIndex, NodeId nodeId, const std::string& line);
+
+public:
+    //Must be called again whenever the awaited messages change
+    void Compile(std::vector<SimulationMessage>& messages, bool useRegex);
+
+    //Checks a complete line of terminal output, returns true if it was an awaited message
+    bool ProcessLine(NodeId nodeId, const std::string& line);
+
+    bool AreAllMessagesFound() const;
+    u32 GetAmountOfFoundMessages() const;
+
+    //Returns the longest text that every match of the regex must contain, or an empty string
+    //if no such text can be determined, e.g. because the regex contains an alternative.
+    static std::string ExtractRequiredLiteral(const std::string& regex);
+};
@@ -30,6 +30,7 @@
 #include "gtest/gtest.h"
 #include <CherrySimTester.h>
 #include <CherrySimUtils.h>
+#include "DebugModule.h"
 
 
 TEST(TestBaseConnection, TestSimpleTransmissions) {
@@ -66,4 +67,64 @@ TEST(TestBaseConnection, TestSimpleTransmissions) {
 
     //We wait until they are connected again
     tester.SimulateUntilClusteringDone(10 * 1000);
-}
\ No newline at end of file
+}
+
+TEST(TestBaseConnection, TestMessageAggregation) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+
+    simConfig.SetToPerfectConditions();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+
+    tester.Start();
+    tester.SimulateUntilClusteringDone(10 * 1000);
+
+    DebugModule* senderMod = nullptr;
+    MeshConnection* senderConn = nullptr;
+    {
+        NodeIndexSetter setter(1);
+        senderMod = (DebugModule*)GS->node.GetModuleById(ModuleId::DEBUG_MODULE);
+        MeshConnections connections = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+        ASSERT_EQ(connections.count, 1);
+        ASSERT_TRUE(connections.handles[0].GetConnection()->CanAggregateMessages());
+        senderConn = connections.handles[0].GetConnection();
+    }
+    DebugModule* receiverMod = nullptr;
+    {
+        NodeIndexSetter setter(0);
+        receiverMod = (DebugModule*)GS->node.GetModuleById(ModuleId::DEBUG_MODULE);
+    }
+
+    //Bursts of small messages must be packed into shared writes and must still all be delivered
+    constexpr u32 burstSize = 20;
+    for (u32 burst = 0; burst < 10; burst++)
+    {
+        const u32 receivedBefore = receiverMod->GetQueueFloodCounterMedium();
+        {
+            NodeIndexSetter setter(1);
+            for (u32 i = 0; i < burstSize; i++) senderMod->SendQueueFloodMessage(DeliveryPriority::MEDIUM);
+        }
+        tester.SimulateForGivenTime(2 * 1000);
+        ASSERT_EQ(receiverMod->GetQueueFloodCounterMedium(), receivedBefore + burstSize);
+    }
+    ASSERT_GT(senderConn->aggregatedMessages, 0);
+
+    //Without aggregation, every message is sent in its own write
+    {
+        NodeIndexSetter setter(1);
+        GS->config.enableMessageAggregation = false;
+        ASSERT_FALSE(senderConn->CanAggregateMessages());
+    }
+    const u16 aggregatedBefore = senderConn->aggregatedMessages;
+    const u32 receivedBefore = receiverMod->GetQueueFloodCounterMedium();
+    {
+        NodeIndexSetter setter(1);
+        for (u32 i = 0; i < burstSize; i++) senderMod->SendQueueFloodMessage(DeliveryPriority::MEDIUM);
+    }
+    tester.SimulateForGivenTime(2 * 1000);
+    ASSERT_EQ(receiverMod->GetQueueFloodCounterMedium(), receivedBefore + burstSize);
+    ASSERT_EQ(senderConn->aggregatedMessages, aggregatedBefore);
+}
@@ -29,11 +29,37 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "gtest/gtest.h"
 #include <vector>
+#include <chrono>
 #include <CherrySimTester.h>
 #include <CherrySimUtils.h>
 #include "ConnectionQueueMemoryAllocator.h"
 #include "MersenneTwister.h"
 
+// Two nodes that cluster with each other, so that the sink has exactly one mesh connection.
+static SimConfiguration CreateTwoNodeSimConfiguration()
+{
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    return simConfig;
+}
+
+// As in TestSimpleAllocations, we only care about the queue of the sink's connection and won't simulate another step.
+static ChunkedPacketQueue* ClusterAndGetResetQueue(CherrySimTester& tester, DeliveryPriority priority)
+{
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    NodeIndexSetter setter(0);
+    MeshConnections connections = GS->cm.GetMeshConnections(ConnectionDirection::INVALID);
+    if (connections.count != 1) return nullptr;
+
+    ChunkedPacketQueue* queue = connections.handles[0].GetConnection()->queue.GetQueueByPriority(priority);
+    queue->SimReset();
+    return queue;
+}
+
 TEST(TestChunkedPacketQueue, TestSimpleAllocations)
 {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -225,3 +251,301 @@ TEST(TestChunkedPacketQueue, TestSimpleAllocations)
         }
     }
 }
+
+TEST(TestChunkedPacketQueue, TestOpenSplitMessages)
+{
+    CherrySimTester tester = CherrySimTester(CherrySimTester::CreateDefaultTesterConfiguration(), CreateTwoNodeSimConfiguration());
+    ChunkedPacketQueue* clusteredQueue = ClusterAndGetResetQueue(tester, DeliveryPriority::HIGH);
+    ASSERT_NE(clusteredQueue, nullptr);
+    NodeIndexSetter setter(0);
+    ChunkedPacketQueue& queue = *clusteredQueue;
+
+    std::array<u8, 32> arr;
+    for (size_t i = 0; i < arr.size(); i++)
+    {
+        arr[i] = i;
+    }
+    u8 readBuffer[1024];
+
+    // Without an open message, pieces are refused.
+    ASSERT_FALSE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+
+    // While the next piece did not arrive yet, the queue waits in the split state instead of failing.
+    queue.OpenSplitMessage();
+    ASSERT_TRUE(queue.HasOpenSplitMessage());
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+    ASSERT_EQ(20, queue.PeekLookAhead(readBuffer, sizeof(readBuffer)));
+    queue.IncrementLookAhead();
+    ASSERT_FALSE(queue.HasMoreToLookAhead());
+    ASSERT_TRUE(queue.IsCurrentlySendingSplitMessage());
+
+    // The last piece ends the open message and the split.
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 10, true));
+    ASSERT_FALSE(queue.HasOpenSplitMessage());
+    ASSERT_EQ(10, queue.PeekLookAhead(readBuffer, sizeof(readBuffer)));
+    queue.IncrementLookAhead();
+    ASSERT_FALSE(queue.IsCurrentlySendingSplitMessage());
+    queue.PopPacket();
+    queue.PopPacket();
+    ASSERT_FALSE(queue.HasPackets());
+
+    // Another message in between the pieces would be interleaved, so the open message can't be continued.
+    queue.OpenSplitMessage();
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+    u32 messageHandle;
+    ASSERT_TRUE(queue.AddMessage(arr.data(), 10, &messageHandle));
+    ASSERT_FALSE(queue.AddOpenSplitMessagePiece(arr.data(), 10, true));
+    queue.IncrementLookAhead();
+    queue.IncrementLookAhead();
+    queue.AbandonOpenSplitMessage();
+    ASSERT_FALSE(queue.HasOpenSplitMessage());
+    ASSERT_FALSE(queue.IsCurrentlySendingSplitMessage());
+
+    // Abandoning an open message after its last sent piece leaves the split state.
+    queue.PopPacket();
+    queue.PopPacket();
+    queue.OpenSplitMessage();
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+    queue.IncrementLookAhead();
+    ASSERT_TRUE(queue.IsCurrentlySendingSplitMessage());
+    queue.AbandonOpenSplitMessage();
+    ASSERT_FALSE(queue.IsCurrentlySendingSplitMessage());
+    queue.PopPacket();
+    ASSERT_FALSE(queue.HasPackets());
+
+    // Abandoning an open message while some of its pieces are still queued must not leave the queue
+    // waiting for a split end that never comes once these pieces are sent.
+    queue.OpenSplitMessage();
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+    ASSERT_TRUE(queue.AddOpenSplitMessagePiece(arr.data(), 20, false));
+    queue.IncrementLookAhead();
+    ASSERT_TRUE(queue.IsCurrentlySendingSplitMessage());
+    queue.AbandonOpenSplitMessage();
+    ASSERT_FALSE(queue.HasOpenSplitMessage());
+    ASSERT_TRUE(queue.IsCurrentlySendingSplitMessage());
+    while (queue.HasMoreToLookAhead())
+    {
+        ASSERT_EQ(20, queue.PeekLookAhead(readBuffer, sizeof(readBuffer)));
+        queue.IncrementLookAhead();
+    }
+    ASSERT_FALSE(queue.IsCurrentlySendingSplitMessage());
+    queue.PopPacket();
+    queue.PopPacket();
+    queue.PopPacket();
+    ASSERT_FALSE(queue.HasPackets());
+
+    // The queue is usable as usual afterwards.
+    ASSERT_TRUE(queue.AddMessage(arr.data(), 10, &messageHandle));
+    queue.IncrementLookAhead();
+    ASSERT_FALSE(queue.IsCurrentlySendingSplitMessage());
+    queue.PopPacket();
+    ASSERT_FALSE(queue.HasPackets());
+}
+
+TEST(TestChunkedPacketQueue, TestPeekLookAheadWithOffset)
+{
+    CherrySimTester tester = CherrySimTester(CherrySimTester::CreateDefaultTesterConfiguration(), CreateTwoNodeSimConfiguration());
+    ChunkedPacketQueue* clusteredQueue = ClusterAndGetResetQueue(tester, DeliveryPriority::HIGH);
+    ASSERT_NE(clusteredQueue, nullptr);
+    NodeIndexSetter setter(0);
+    ChunkedPacketQueue& queue = *clusteredQueue;
+
+    std::array<u8, 64> arr;
+    for (size_t i = 0; i < arr.size(); i++)
+    {
+        arr[i] = i;
+    }
+    u8 readBuffer[1024];
+
+    // Enough messages of different sizes to span several chunks.
+    constexpr u32 amountOfMessages = 60;
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        u32 messageHandle;
+        ASSERT_TRUE(queue.AddMessage(arr.data() + (i % 8), 10 + (i % 8), &messageHandle));
+    }
+
+    for (u32 lookAhead = 0; lookAhead < amountOfMessages; lookAhead++)
+    {
+        for (u32 offset = 0; lookAhead + offset < amountOfMessages; offset += 7)
+        {
+            const u32 index = lookAhead + offset;
+            ASSERT_EQ(10 + (index % 8), queue.PeekLookAhead(readBuffer, sizeof(readBuffer), offset));
+            ASSERT_EQ(readBuffer[0], index % 8);
+        }
+        // Peeking past the last message returns nothing.
+        ASSERT_EQ(0, queue.PeekLookAhead(readBuffer, sizeof(readBuffer), amountOfMessages - lookAhead));
+        queue.IncrementLookAhead();
+    }
+    ASSERT_FALSE(queue.HasMoreToLookAhead());
+
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        queue.PopPacket();
+    }
+    ASSERT_FALSE(queue.HasPackets());
+}
+
+TEST(TestChunkedPacketQueue, TestPeekLookAheadInPlace)
+{
+    CherrySimTester tester = CherrySimTester(CherrySimTester::CreateDefaultTesterConfiguration(), CreateTwoNodeSimConfiguration());
+    ChunkedPacketQueue* clusteredQueue = ClusterAndGetResetQueue(tester, DeliveryPriority::HIGH);
+    ASSERT_NE(clusteredQueue, nullptr);
+    NodeIndexSetter setter(0);
+    ChunkedPacketQueue& queue = *clusteredQueue;
+
+    std::array<u8, MAX_MESH_PACKET_SIZE> arr;
+    for (size_t i = 0; i < arr.size(); i++)
+    {
+        arr[i] = i;
+    }
+    u8 readBuffer[1024];
+
+    // Sizes that do not divide the chunk size evenly, so that entries regularly hit the end of a chunk.
+    const std::vector<u16> sizes = { 1, 37, 120, 63, MAX_MESH_PACKET_SIZE, 5, 90 };
+    for (u32 repeats = 0; repeats < 3; repeats++)
+    {
+        for (u16 size : sizes)
+        {
+            u32 messageHandle;
+            ASSERT_TRUE(queue.AddMessage(arr.data(), size, &messageHandle));
+        }
+
+        // The in place view must always contain the whole packet, even if it was added at the end of a chunk.
+        for (u16 size : sizes)
+        {
+            u8* view = nullptr;
+            ASSERT_EQ(size, queue.PeekLookAheadInPlace(&view, sizeof(readBuffer)));
+            ASSERT_TRUE(view != nullptr);
+            ASSERT_EQ(size, queue.PeekLookAhead(readBuffer, sizeof(readBuffer)));
+            ASSERT_EQ(0, memcmp(view, readBuffer, size));
+            ASSERT_EQ(0, memcmp(view, arr.data(), size));
+            queue.IncrementLookAhead();
+        }
+        ASSERT_FALSE(queue.HasMoreToLookAhead());
+
+        // After a rollback, the same packets are viewed again.
+        queue.RollbackLookAhead();
+        u8* view = nullptr;
+        ASSERT_EQ(sizes[0], queue.PeekLookAheadInPlace(&view, sizeof(readBuffer)));
+        ASSERT_EQ(sizes[2], queue.PeekLookAheadInPlace(&view, sizeof(readBuffer), 2));
+        ASSERT_EQ(0, memcmp(view, arr.data(), sizes[2]));
+
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            queue.PopPacket();
+        }
+        ASSERT_FALSE(queue.HasPackets());
+    }
+}
+
+TEST(TestChunkedPacketQueue, TestPacketIndex)
+{
+    CherrySimTester tester = CherrySimTester(CherrySimTester::CreateDefaultTesterConfiguration(), CreateTwoNodeSimConfiguration());
+    ChunkedPacketQueue* clusteredQueue = ClusterAndGetResetQueue(tester, DeliveryPriority::VITAL);
+    ASSERT_NE(clusteredQueue, nullptr);
+    NodeIndexSetter setter(0);
+    ChunkedPacketQueue& queue = *clusteredQueue;
+
+    // Small split entries, so that more packets are queued than the index can hold.
+    constexpr u32 amountOfMessages = CHUNKED_PACKET_QUEUE_INDEX_SIZE + 44;
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        u8 data[4] = { (u8)i, (u8)(i >> 8), 0, 0 };
+        ASSERT_TRUE(queue.AddMessage(data, sizeof(data), nullptr, true));
+    }
+    ASSERT_EQ(queue.GetAmountOfPackets(), amountOfMessages);
+
+    u8 readBuffer[1024];
+    auto peekedNumber = [&](u16 index) {
+        if (queue.RandomAccessPeek(readBuffer, sizeof(readBuffer), index) != 4) return (u32)UINT32_MAX;
+        return (u32)readBuffer[0] | ((u32)readBuffer[1] << 8);
+    };
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        ASSERT_EQ(peekedNumber(i), i);
+    }
+
+    // The lookAhead is tracked by the amount of looked ahead packets.
+    for (u32 i = 0; i < 100; i++)
+    {
+        queue.IncrementLookAhead();
+    }
+    ASSERT_TRUE(queue.IsRandomAccessIndexLookedAhead(99));
+    ASSERT_FALSE(queue.IsRandomAccessIndexLookedAhead(100));
+    ASSERT_EQ(4, queue.PeekLookAhead(readBuffer, sizeof(readBuffer), 5));
+    ASSERT_EQ(readBuffer[0], 105);
+    queue.RollbackLookAhead();
+    ASSERT_FALSE(queue.IsRandomAccessIndexLookedAhead(0));
+    ASSERT_EQ(4, queue.PeekLookAhead(readBuffer, sizeof(readBuffer)));
+    ASSERT_EQ(readBuffer[0], 0);
+
+    // Popping moves packets that were behind the index into it.
+    queue.IncrementLookAhead();
+    for (u32 i = 0; i < 50; i++)
+    {
+        queue.PopPacket();
+    }
+    ASSERT_FALSE(queue.IsRandomAccessIndexLookedAhead(0));
+    for (u32 i = 0; i < amountOfMessages - 50; i++)
+    {
+        ASSERT_EQ(peekedNumber(i), i + 50);
+    }
+    ASSERT_EQ(4, queue.PeekLookAhead(readBuffer, sizeof(readBuffer), 3));
+    ASSERT_EQ(readBuffer[0], 53);
+
+    while (queue.HasPackets())
+    {
+        queue.PopPacket();
+    }
+    ASSERT_EQ(queue.GetAmountOfPackets(), 0);
+}
+
+// A micro benchmark: a random access to an indexed packet takes the same time wherever the packet is,
+// packets behind the index are found by walking through the chunks from the last indexed packet.
+TEST(TestChunkedPacketQueue, TestPacketIndexRandomAccessSpeed_long)
+{
+    CherrySimTester tester = CherrySimTester(CherrySimTester::CreateDefaultTesterConfiguration(), CreateTwoNodeSimConfiguration());
+    ChunkedPacketQueue* clusteredQueue = ClusterAndGetResetQueue(tester, DeliveryPriority::VITAL);
+    ASSERT_NE(clusteredQueue, nullptr);
+    NodeIndexSetter setter(0);
+    ChunkedPacketQueue& queue = *clusteredQueue;
+
+    constexpr u32 amountOfMessages = CHUNKED_PACKET_QUEUE_INDEX_SIZE + 44;
+    for (u32 i = 0; i < amountOfMessages; i++)
+    {
+        u8 data[4] = { (u8)i, (u8)(i >> 8), 0, 0 };
+        ASSERT_TRUE(queue.AddMessage(data, sizeof(data), nullptr, true));
+    }
+
+    u8 readBuffer[1024];
+    auto measureAccessNs = [&](u16 index) {
+        constexpr u32 repetitions = 10000;
+        u32 checksum = 0;
+        auto startTime = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < repetitions; i++)
+        {
+            checksum += queue.RandomAccessPeek(readBuffer, sizeof(readBuffer), index);
+        }
+        auto endTime = std::chrono::steady_clock::now();
+        if (checksum != 4 * repetitions) SIMEXCEPTION(IllegalStateException);
+
+        const double nanoseconds = std::chrono::duration<double, std::nano>(endTime - startTime).count() / repetitions;
+        printf("Random access to packet %u of %u: %.1f ns" EOL, index, queue.GetAmountOfPackets(), nanoseconds);
+        return nanoseconds;
+    };
+
+    const double firstIndexedNs = measureAccessNs(0);
+    const double lastIndexedNs = measureAccessNs(CHUNKED_PACKET_QUEUE_INDEX_SIZE - 1);
+    const double walkedNs = measureAccessNs(amountOfMessages - 1);
+
+    // Generous bounds so that the scheduling of the machine does not make the test fail.
+    ASSERT_LT(lastIndexedNs, firstIndexedNs * 3 + 50);
+    ASSERT_LT(lastIndexedNs, walkedNs);
+
+    while (queue.HasPackets())
+    {
+        queue.PopPacket();
+    }
+}
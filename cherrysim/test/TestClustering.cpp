@@ -295,13 +295,22 @@ TEST_P(MultiStackFixture, TestBasicClusteringWithNodeReset) {
 
             auto nodeIdsToReset = CherrySimUtils::GenerateRandomNumbers(1, tester.sim->GetTotalNodes(), numNodesToReset);
 
-            for (auto const nodeId : nodeIdsToReset) {
-                tester.SendTerminalCommand(nodeId, "reset");
-            }
+            auto resetScenario = [&]() {
+                for (auto const nodeId : nodeIdsToReset) {
+                    tester.SendTerminalCommand(nodeId, "reset");
+                }
 
-            //We simulate for some time so that the reset command is processed before waiting for clustering
-            tester.SimulateForGivenTime(1 * 1000);
-            tester.SimulateUntilClusteringDone(maxClusteringTimeMs);
+                //We simulate for some time so that the reset command is processed before waiting for clustering
+                tester.SimulateForGivenTime(1 * 1000);
+                tester.SimulateUntilClusteringDone(maxClusteringTimeMs);
+            };
+
+#if defined(__unix__)
+            //Every reset scenario branches off the same clustered mesh instead of clustering it again
+            ASSERT_TRUE(tester.SimulateInFork(resetScenario));
+#else
+            resetScenario();
+#endif
         }
     }
 }
@@ -458,6 +467,68 @@ TEST(TestClustering, TestBasicClusteringWithNodeResetAndConnectionTimeouts_sched
     }
 }
 
+//Skipping idle ticks changes the random sequence, but a mesh must still end up in the same state as without skipping
+TEST(TestClustering, TestClusteringWithIdleTickSkipping_scheduled) {
+    struct SimulationOutcome {
+        bool clusteringDone = false;
+        std::vector<ClusterSize> clusterSizes;
+        std::vector<u32> nodeTimesMs;
+        u32 idleSteps = 0;
+    };
+
+    auto simulate = [](u32 seed, u32 numNodes, bool skipIdleTicks) {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.seed = seed;
+        simConfig.skipIdleTicks = skipIdleTicks;
+        simConfig.enableClusteringValidityCheck = true;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", numNodes - 1 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        //Both runs simulate the same amount of time so that the time of the nodes can be compared
+        tester.SimulateForGivenTime(200 * 1000);
+
+        //Most of the ticks of a clustered mesh are idle
+        SimulationOutcome outcome;
+        const u32 idleEndTimeMs = tester.sim->simState.simTimeMs + 5 * 60 * 1000;
+        tester.sim->idleSkipLimitSimTimeMs = idleEndTimeMs - simConfig.simTickDurationMs;
+        while (tester.sim->simState.simTimeMs < idleEndTimeMs)
+        {
+            tester.sim->SimulateStepForAllNodes();
+            outcome.idleSteps++;
+        }
+        tester.sim->idleSkipLimitSimTimeMs = UINT32_MAX;
+
+        outcome.clusteringDone = tester.sim->IsClusteringDone();
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            outcome.clusterSizes.push_back(tester.sim->nodes[i].gs.node.GetClusterSize());
+            outcome.nodeTimesMs.push_back(tester.sim->nodes[i].state.timeMs);
+        }
+        return outcome;
+    };
+
+    u32 seed = (u32)time(NULL);
+    for (u32 i = 0; i < 10; i++) {
+        seed++;
+        const u32 numNodes = seed % 30 + 2;
+        printf("%u: Comparing clustering with and without idle tick skipping with %u nodes, seed %u" EOL, i, numNodes, seed);
+
+        const SimulationOutcome steppedOutcome = simulate(seed, numNodes, false);
+        const SimulationOutcome skippedOutcome = simulate(seed, numNodes, true);
+
+        ASSERT_TRUE(steppedOutcome.clusteringDone);
+        ASSERT_TRUE(skippedOutcome.clusteringDone);
+        ASSERT_EQ(steppedOutcome.clusterSizes, skippedOutcome.clusterSizes);
+        ASSERT_EQ(steppedOutcome.nodeTimesMs, skippedOutcome.nodeTimesMs);
+
+        //Otherwise, the new path was not covered
+        ASSERT_LT(skippedOutcome.idleSteps, steppedOutcome.idleSteps);
+    }
+}
+
 //Test if meshing works if we put load on the network
 TEST(TestClustering, TestMeshingUnderLoad) {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -720,7 +791,7 @@ TEST(TestClustering, TestEmergencyDisconnect) {
     {
         for (u32 k = 1; k < numNodes; k++)
         {
-            tester.sim->nodes[i].impossibleConnection.push_back(k);
+            tester.sim->AddImpossibleConnection(i, k);
         }
     }
 
@@ -71,7 +71,7 @@ TEST(TestDebugModule, TestCommands) {
     tester.SimulateUntilMessageReceived(10 * 1000, 2, "Resetting connection loss counter");
 
     tester.SendTerminalCommand(1, "action 2 debug get_stats");
-    tester.SimulateUntilRegexMessageReceived(10 * 1000, 1, "\\{\"nodeId\":2,\"type\":\"debug_stats\", \"conLoss\":0,\"dropped\":\\d+,\"sentRel\":\\d+,\"sentUnr\":\\d+\\}");
+    tester.SimulateUntilRegexMessageReceived(10 * 1000, 1, "\\{\"nodeId\":2,\"type\":\"debug_stats\", \"conLoss\":0,\"dropped\":\\d+,\"sentRel\":\\d+,\"sentUnr\":\\d+,\"routeHits\":\\d+,\"routeMisses\":\\d+\\}");
 
     {
         Exceptions::DisableDebugBreakOnException disable;
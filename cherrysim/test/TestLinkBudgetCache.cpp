@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include "LinkBudgetCache.h"
+#include "CherrySimTester.h"
+
+TEST(TestLinkBudgetCache, TestInvalidation) {
+    for (u32 amountOfNodes : { 4u, LinkBudgetCache::maxNodesForDenseCache + 1 })
+    {
+        LinkBudgetCache cache;
+        cache.Reset(amountOfNodes);
+
+        float rssi = 0;
+        ASSERT_FALSE(cache.TryGet(0, 1, -55, rssi));
+        cache.Store(0, 1, -55, -70.5f);
+        cache.Store(2, 3, -55, -80.5f);
+        ASSERT_TRUE(cache.TryGet(0, 1, -55, rssi));
+        ASSERT_EQ(rssi, -70.5f);
+
+        //The link is directional and depends on the transmission power of the sender
+        ASSERT_FALSE(cache.TryGet(1, 0, -55, rssi));
+        ASSERT_FALSE(cache.TryGet(0, 1, -50, rssi));
+
+        //Only the links of the invalidated node are affected
+        cache.InvalidateNode(1);
+        ASSERT_FALSE(cache.TryGet(0, 1, -55, rssi));
+        ASSERT_TRUE(cache.TryGet(2, 3, -55, rssi));
+        ASSERT_EQ(rssi, -80.5f);
+
+        cache.InvalidateAll();
+        ASSERT_FALSE(cache.TryGet(2, 3, -55, rssi));
+
+        //Out of range indices are never cached
+        cache.Store(amountOfNodes, 0, -55, -70.0f);
+        ASSERT_FALSE(cache.TryGet(amountOfNodes, 0, -55, rssi));
+    }
+}
+
+TEST(TestLinkBudgetCache, TestCachedRssiMatchesCalculation) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    auto checkAllLinks = [&]() {
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            for (u32 k = 0; k < tester.sim->GetTotalNodes(); k++)
+            {
+                if (i == k) continue;
+                const NodeEntry* sender = &tester.sim->nodes[i];
+                const NodeEntry* receiver = &tester.sim->nodes[k];
+                //Asking twice makes sure that the second result comes from the cache
+                tester.sim->GetReceptionRssiNoNoise(sender, receiver);
+                ASSERT_EQ(
+                    tester.sim->GetReceptionRssiNoNoise(sender, receiver),
+                    tester.sim->CalculateReceptionRssiNoNoise(sender, receiver, sender->gs.boardconf.configuration.calibratedTX, Conf::defaultDBmTX));
+            }
+        }
+    };
+
+    checkAllLinks();
+    tester.SimulateGivenNumberOfSteps(10);
+    checkAllLinks();
+
+    tester.sim->SetPosition(3, 0.1f, 0.2f, 0.0f);
+    tester.sim->AddPosition(4, 0.05f, 0.0f, 0.0f);
+    checkAllLinks();
+
+    tester.sim->AddImpossibleConnection(5, 6);
+    ASSERT_EQ(tester.sim->GetReceptionRssiNoNoise(&tester.sim->nodes[5], &tester.sim->nodes[6]), -10000);
+    ASSERT_EQ(tester.sim->GetReceptionRssiNoNoise(&tester.sim->nodes[6], &tester.sim->nodes[5]), -10000);
+    checkAllLinks();
+}
+
+TEST(TestLinkBudgetCache, TestStaticSiteDoesNotRecalculateLinks) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //All links that are used have been calculated by now, so every further lookup must be a cache hit
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        for (u32 k = 0; k < tester.sim->GetTotalNodes(); k++)
+        {
+            if (i != k) tester.sim->GetReceptionRssiNoNoise(&tester.sim->nodes[i], &tester.sim->nodes[k]);
+        }
+    }
+    const u32 missesBefore = tester.sim->linkBudgetCache.GetAmountOfMisses();
+    const u32 hitsBefore = tester.sim->linkBudgetCache.GetAmountOfHits();
+    tester.SimulateForGivenTime(10 * 1000);
+    ASSERT_EQ(tester.sim->linkBudgetCache.GetAmountOfMisses(), missesBefore);
+    ASSERT_GT(tester.sim->linkBudgetCache.GetAmountOfHits(), hitsBefore);
+}
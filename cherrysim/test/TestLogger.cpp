@@ -32,7 +32,9 @@
 #include "CherrySimTester.h"
 #include "CherrySimUtils.h"
 #include "Logger.h"
+#include "BinaryLog.h"
 #include <string>
+#include <vector>
 
 TEST(TestLogger, TestTags) {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
@@ -56,6 +58,102 @@ TEST(TestLogger, TestTags) {
     ASSERT_FALSE(Logger::GetInstance().IsTagEnabled(tag));
 }
 
+TEST(TestLogger, TestTagIds) {
+    static_assert(GetLogTagId("ERROR") == LOG_TAG_ID_ERROR, "Tag ids must be usable at compile time");
+    ASSERT_NE(GetLogTagId("CONN"), GetLogTagId("conn"));
+
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert( { "prod_mesh_nrf52", 2 } );
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    NodeIndexSetter setter(0);
+    Logger& logger = Logger::GetInstance();
+    logger.DisableAll();
+    ASSERT_TRUE(logger.IsTagIdEnabled(LOG_TAG_ID_ERROR));
+    ASSERT_TRUE(logger.IsTagIdEnabled(LOG_TAG_ID_WARNING));
+
+    //Find three tags that share the same bit of the filter
+    std::vector<std::string> tags;
+    const u32 filterBit = GetLogTagId("T0") % LOG_TAG_FILTER_BITS;
+    for (u32 i = 0; tags.size() < 3; i++)
+    {
+        const std::string tag = "T" + std::to_string(i);
+        if (GetLogTagId(tag.c_str()) % LOG_TAG_FILTER_BITS == filterBit) tags.push_back(tag);
+    }
+
+    //A set bit must not enable other tags with the same bit
+    logger.EnableTag(tags[0].c_str());
+    ASSERT_TRUE(logger.IsTagEnabled(tags[0].c_str()));
+    ASSERT_FALSE(logger.IsTagEnabled(tags[1].c_str()));
+
+    //Disabling a tag must keep other tags with the same bit enabled
+    logger.EnableTag(tags[1].c_str());
+    logger.DisableTag(tags[0].c_str());
+    ASSERT_FALSE(logger.IsTagEnabled(tags[0].c_str()));
+    ASSERT_TRUE(logger.IsTagEnabled(tags[1].c_str()));
+    ASSERT_FALSE(logger.IsTagEnabled(tags[2].c_str()));
+
+    //The debug command enables tags by name regardless of their case
+    tester.SendTerminalCommand(1, "debug testtag");
+    tester.SimulateForGivenTime(100);
+    ASSERT_TRUE(logger.IsTagIdEnabled(GetLogTagId("TESTTAG")));
+    ASSERT_EQ(logger.GetAmountOfEnabledTags(), 2);
+
+    logger.DisableAll();
+    ASSERT_FALSE(logger.IsTagEnabled(tags[1].c_str()));
+    ASSERT_FALSE(logger.IsTagEnabled("TESTTAG"));
+}
+
+TEST(TestLogger, TestBinaryLogFrames) {
+    BinaryLogRecord record(0x12345678, GetLogTagId("CONN"));
+    char name[] = "node";
+    record.AppendArguments(5u, name, -3, 1.5, (uint64_t)0x1122334455ULL);
+
+    BinaryLogBuffer<64> buffer;
+    buffer.Push(record);
+    u8 frame[64];
+    const u32 frameSize = buffer.Read(frame, sizeof(frame));
+    ASSERT_EQ(frameSize, record.GetFrameSize());
+    ASSERT_TRUE(buffer.IsEmpty());
+
+    const u8 expected[] = {
+        BINARY_LOG_FRAME_START, 36,
+        0x78, 0x56, 0x34, 0x12,                                 //formatId
+        0x3F, 0x72, 0x92, 0x11,                                 //tagId of CONN
+        5, 0x8C, 0x01,                                          //Amount of arguments and their types
+        5, 0, 0, 0,
+        'n', 'o', 'd', 'e', '\0',
+        0xFD, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0xC0, 0x3F,                                 //1.5f
+        0x55, 0x44, 0x33, 0x22, 0x11, 0x00, 0x00, 0x00,
+    };
+    ASSERT_EQ(frameSize, sizeof(expected) + 1);
+    ASSERT_EQ(GetLogTagId("CONN"), 0x1192723FUL);
+    u8 checksum = 0;
+    for (u32 i = 0; i < sizeof(expected); i++)
+    {
+        ASSERT_EQ(frame[i], expected[i]);
+        if (i >= 2) checksum += frame[i];
+    }
+    ASSERT_EQ(frame[sizeof(expected)], checksum);
+
+    //Records that do not fit are dropped and reported with the next record that fits
+    buffer.Push(record);
+    buffer.Push(record);
+    ASSERT_EQ(buffer.GetAmountOfDroppedRecords(), 1);
+    ASSERT_EQ(buffer.Read(frame, sizeof(frame)), frameSize);
+    BinaryLogRecord small(1, 0);
+    buffer.Push(small);
+    ASSERT_EQ(buffer.GetAmountOfDroppedRecords(), 0);
+    ASSERT_EQ(buffer.Read(frame, sizeof(frame)), 3 + 9 + 1 + 4 + 3 + 9);
+    ASSERT_EQ(frame[2], 0xFF); //Dropped records frame
+    ASSERT_EQ(frame[10], 1); //Amount of arguments
+    ASSERT_EQ(frame[12], 1); //Amount of dropped records
+}
+
 TEST(TestLogger, TestParseHexStringToBuffer) 
 {
     {
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <vector>
+#include <algorithm>
+#include "MeshComponentSet.h"
+#include "MersenneTwister.h"
+#include "CherrySimTester.h"
+#include "MeshConnection.h"
+
+TEST(TestMeshComponentSet, TestComponentsMatchNaiveLabeling) {
+    constexpr u32 amountOfElements = 200;
+
+    MersenneTwister rnd(42);
+    MeshComponentSet set;
+    set.Reset(amountOfElements);
+    ASSERT_EQ(set.GetAmountOfComponents(), amountOfElements);
+
+    //Each element is labeled with its component, merging relabels all elements of one component
+    std::vector<u32> labels(amountOfElements);
+    for (u32 i = 0; i < amountOfElements; i++) labels[i] = i;
+    u32 amountOfUnions = 0;
+
+    for (u32 step = 0; step < 150; step++)
+    {
+        const u32 a = rnd.NextU32(0, amountOfElements - 1);
+        const u32 b = rnd.NextU32(0, amountOfElements - 1);
+        const bool merged = set.Union(a, b);
+        amountOfUnions++;
+        ASSERT_EQ(merged, labels[a] != labels[b]);
+
+        if (labels[a] != labels[b])
+        {
+            const u32 oldLabel = labels[b];
+            for (u32& label : labels) if (label == oldLabel) label = labels[a];
+        }
+    }
+
+    u32 totalLinks = 0;
+    std::vector<bool> countedRoots(amountOfElements, false);
+    for (u32 i = 0; i < amountOfElements; i++)
+    {
+        u32 expectedSize = 0;
+        for (u32 k = 0; k < amountOfElements; k++)
+        {
+            if (labels[k] == labels[i]) expectedSize++;
+            ASSERT_EQ(set.Find(i) == set.Find(k), labels[i] == labels[k]);
+        }
+        ASSERT_EQ(set.GetComponentSize(i), expectedSize);
+
+        if (!countedRoots[set.Find(i)])
+        {
+            countedRoots[set.Find(i)] = true;
+            totalLinks += set.GetAmountOfLinks(i);
+        }
+    }
+    ASSERT_EQ(totalLinks, amountOfUnions);
+
+    std::vector<u32> distinctLabels(labels);
+    std::sort(distinctLabels.begin(), distinctLabels.end());
+    distinctLabels.erase(std::unique(distinctLabels.begin(), distinctLabels.end()), distinctLabels.end());
+    ASSERT_EQ(set.GetAmountOfComponents(), distinctLabels.size());
+}
+
+//The single pass over a regular cluster must give the same predicted sizes as the recursion from every node
+TEST(TestMeshComponentSet, TestTreePropagationMatchesRecursion) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    CherrySim* sim = tester.sim;
+    const u32 amountOfNodes = sim->GetTotalNodes();
+
+    //Put some pending cluster updates on all handshaked connections
+    MersenneTwister rnd(7);
+    std::vector<MeshConnection*> connections;
+    std::vector<std::pair<i16, i16>> updates;
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        MeshConnections conns = sim->nodes[i].gs.cm.GetMeshConnections(ConnectionDirection::INVALID);
+        for (int k = 0; k < conns.count; k++)
+        {
+            MeshConnection* conn = conns.handles[k].GetConnection();
+            if (!conn->HandshakeDone()) continue;
+            connections.push_back(conn);
+            updates.push_back({ (i16)rnd.NextU32(0, 10) - 5, (i16)rnd.NextU32(0, 10) - 5 });
+        }
+    }
+    ASSERT_EQ(connections.size(), 2 * (amountOfNodes - 1));
+
+    auto applyUpdates = [&]() {
+        for (u32 i = 0; i < amountOfNodes; i++) sim->nodes[i].state.validityClusterSize = 0;
+        for (size_t i = 0; i < connections.size(); i++)
+        {
+            connections[i]->validityClusterUpdatesToSend = updates[i].first;
+            connections[i]->validityClusterUpdatesReceived = updates[i].second;
+        }
+    };
+
+    applyUpdates();
+    std::vector<ClusterSize> expectedSizes(amountOfNodes);
+    for (u32 i = 0; i < amountOfNodes; i++) sim->DetermineClusterSizeAndPropagateClusterUpdates(&sim->nodes[i], nullptr);
+    for (u32 i = 0; i < amountOfNodes; i++) expectedSizes[i] = sim->nodes[i].state.validityClusterSize;
+
+    applyUpdates();
+    sim->BuildMeshComponents(amountOfNodes);
+    ASSERT_EQ(sim->meshComponents.GetAmountOfComponents(), 1);
+    ASSERT_TRUE(sim->regularMeshComponents[sim->meshComponents.Find(0)]);
+    ASSERT_EQ(sim->meshComponents.GetComponentSize(0), amountOfNodes);
+    sim->PropagateClusterUpdatesAlongTree(sim->meshComponents.Find(0));
+
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        ASSERT_EQ(sim->nodes[i].state.validityClusterSize, expectedSizes[i]);
+        ASSERT_EQ(sim->DetermineClusterSizeAndPropagateClusterUpdates(&sim->nodes[i], nullptr), (ClusterSize)amountOfNodes);
+    }
+    for (MeshConnection* conn : connections)
+    {
+        ASSERT_EQ(conn->validityClusterUpdatesToSend, 0);
+        ASSERT_EQ(conn->validityClusterUpdatesReceived, 0);
+    }
+}
@@ -40,6 +40,7 @@
 #include "json.hpp"
 #include "SimpleQueue.h"
 #include "DebugModule.h"
+#include <thread>
 
 
 extern "C"{
@@ -125,6 +126,18 @@ TEST(TestOther, TestSimpleQueue)
     ASSERT_EQ(queue.Peek(), 3);
     ASSERT_EQ(queue.Pop(), true);
     ASSERT_EQ(queue.Pop(), false);
+
+    //The elements are accessed in order, even if they wrap around the end of the buffer
+    ASSERT_TRUE(queue.Push(1));
+    ASSERT_TRUE(queue.Push(2));
+    ASSERT_TRUE(queue.Push(3));
+    ASSERT_EQ(queue.PeekAt(0), 1);
+    ASSERT_EQ(queue.PeekAt(1), 2);
+    ASSERT_EQ(queue.PeekAt(2), 3);
+    {
+        Exceptions::DisableDebugBreakOnException disable;
+        ASSERT_THROW(queue.PeekAt(3), IllegalArgumentException);
+    }
 }
 
 TEST(TestOther, TestSimpleQueueRandomness)
@@ -270,6 +283,171 @@ TEST(TestOther, TestMersenneTwister)
     ASSERT_EQ(mt.NextU32(), 2388923659);
 }
 
+static u32 SimulateClusteringForParallelTest(u32 seed)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.seed = seed;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    return tester.sim->simState.simTimeMs;
+}
+
+//Each thread has its own simulator context, so simulations on different threads must not influence each other
+TEST(TestOther, TestParallelSimulations)
+{
+    constexpr u32 numSimulations = 4;
+    u32 sequentialResults[numSimulations] = {};
+    u32 parallelResults[numSimulations] = {};
+    bool parallelFailed[numSimulations] = {};
+
+    for (u32 i = 0; i < numSimulations; i++)
+    {
+        sequentialResults[i] = SimulateClusteringForParallelTest(i + 1);
+    }
+
+    {
+        //The simulator context of this thread must not be changed by the other threads
+        CherrySim* const originalInstance = cherrySimInstance;
+
+        std::vector<std::thread> threads;
+        for (u32 i = 0; i < numSimulations; i++)
+        {
+            threads.emplace_back([&, i]() {
+                Exceptions::DisableDebugBreakOnException disabler;
+                try
+                {
+                    parallelResults[i] = SimulateClusteringForParallelTest(i + 1);
+                }
+                catch (...)
+                {
+                    parallelFailed[i] = true;
+                }
+            });
+        }
+        for (std::thread& t : threads)
+        {
+            t.join();
+        }
+
+        ASSERT_EQ(cherrySimInstance, originalInstance);
+    }
+
+    for (u32 i = 0; i < numSimulations; i++)
+    {
+        ASSERT_FALSE(parallelFailed[i]);
+        ASSERT_EQ(sequentialResults[i], parallelResults[i]);
+    }
+}
+
+//The node under simulation is thread local, so simulators that are stepped alternately on one thread must not
+//influence each other
+TEST(TestOther, TestInterleavedSimulations)
+{
+    const u32 expectedFirst = SimulateClusteringForParallelTest(1);
+    const u32 expectedSecond = SimulateClusteringForParallelTest(2);
+
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    simConfig.seed = 1;
+    CherrySimTester first = CherrySimTester(testerConfig, simConfig);
+    first.Start();
+    simConfig.seed = 2;
+    CherrySimTester second = CherrySimTester(testerConfig, simConfig);
+    second.Start();
+
+    u32 firstResult = 0;
+    u32 secondResult = 0;
+    while (firstResult == 0 || secondResult == 0)
+    {
+        if (firstResult == 0) first.sim->SimulateStepForAllNodes();
+        if (secondResult == 0) second.sim->SimulateStepForAllNodes();
+        if (firstResult == 0 && first.sim->IsClusteringDone()) firstResult = first.sim->simState.simTimeMs;
+        if (secondResult == 0 && second.sim->IsClusteringDone()) secondResult = second.sim->simState.simTimeMs;
+        ASSERT_LT(first.sim->simState.simTimeMs, 100 * 1000);
+        ASSERT_LT(second.sim->simState.simTimeMs, 100 * 1000);
+    }
+
+    ASSERT_EQ(firstResult, expectedFirst);
+    ASSERT_EQ(secondResult, expectedSecond);
+}
+
+static std::string SimulateClusteringWithParallelNodeWorkers(u32 numParallelNodeWorkers)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.numParallelNodeWorkers = numParallelNodeWorkers;
+    simConfig.terminalId = 0;
+    simConfig.useLogAccumulator = true;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 19 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    tester.SimulateForGivenTime(10 * 1000);
+    return std::to_string(tester.sim->simState.simTimeMs) + tester.sim->logAccumulator;
+}
+
+//The firmware of the nodes is executed by several threads, the result must not depend on the amount of threads
+TEST(TestOther, TestParallelNodeStepping)
+{
+    const std::string singleWorkerResult = SimulateClusteringWithParallelNodeWorkers(1);
+    ASSERT_EQ(singleWorkerResult, SimulateClusteringWithParallelNodeWorkers(4));
+    ASSERT_EQ(singleWorkerResult, SimulateClusteringWithParallelNodeWorkers(4));
+}
+
+//Ticks in which no node has anything to do are skipped, the mesh must still work and the time must still add up
+TEST(TestOther, TestSkipIdleTicks)
+{
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.skipIdleTicks = true;
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 9 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Once the mesh is stable, most of the ticks are idle
+    const u32 startTimeMs = tester.sim->simState.simTimeMs;
+    const u32 startNodeTimeMs = tester.sim->nodes[0].state.timeMs;
+    const int64_t startFrames = tester.sim->nodes[0].simulatedFrames;
+    const u32 startAppTimerDs = tester.sim->nodes[0].gs.appTimerDs;
+    u32 amountOfSteps = 0;
+    while (tester.sim->simState.simTimeMs < startTimeMs + 60 * 1000)
+    {
+        tester.sim->SimulateStepForAllNodes();
+        amountOfSteps++;
+    }
+    const u32 passedTimeMs = tester.sim->simState.simTimeMs - startTimeMs;
+    ASSERT_LT(amountOfSteps * simConfig.simTickDurationMs, passedTimeMs);
+
+    //The skipped ticks still count for the nodes
+    ASSERT_EQ(tester.sim->nodes[0].state.timeMs - startNodeTimeMs, passedTimeMs);
+    ASSERT_EQ(tester.sim->nodes[0].simulatedFrames - startFrames, passedTimeMs / simConfig.simTickDurationMs);
+
+    //The modules still get the skipped time through their timer, up to one app timer interval may still be pending
+    const u32 passedAppTimerMs = (tester.sim->nodes[0].gs.appTimerDs - startAppTimerDs) * 100;
+    ASSERT_LE(passedAppTimerMs, passedTimeMs + 200);
+    ASSERT_GE(passedAppTimerMs + 200, passedTimeMs);
+
+    //Skipping must not overshoot the time that should be simulated
+    const u32 beforeGivenTimeMs = tester.sim->simState.simTimeMs;
+    tester.SimulateForGivenTime(10 * 1000);
+    ASSERT_EQ(tester.sim->simState.simTimeMs, beforeGivenTimeMs + 10 * 1000);
+
+    //Terminal commands wake the nodes up again
+    tester.SendTerminalCommand(1, "action 10 status get_device_info");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":10,\"type\":\"device_info\"");
+}
+
 //This test should check if two different configurations can be applied to two nodes using the simulator
 TEST(TestOther, ConfigurationTest)
 {
@@ -350,9 +528,12 @@ TEST(TestOther, TestJsonConfigSerialization)
     simConfig->fastLaneToSimTimeMs = 123;
     simConfig->enableClusteringValidityCheck = true;
     simConfig->enableSimStatistics = true;
+    simConfig->enableProfiler = true;
     new (&simConfig->storeFlashToFile) std::string;
     simConfig->storeFlashToFile = "eee";
     simConfig->verboseCommands = true;
+    simConfig->numParallelNodeWorkers = 17;
+    simConfig->skipIdleTicks = true;
     simConfig->defaultBleStackType = BleStackType::NRF_SD_132_ANY;
 
     for (size_t i = 0; i < sizeof(memoryArea) / sizeof(*memoryArea); i++)
@@ -416,8 +597,11 @@ TEST(TestOther, TestJsonConfigSerialization)
     ASSERT_EQ(simConfig->fastLaneToSimTimeMs, 123);
     ASSERT_EQ(copy.enableClusteringValidityCheck, true);
     ASSERT_EQ(copy.enableSimStatistics, true);
+    ASSERT_EQ(copy.enableProfiler, true);
     ASSERT_EQ(copy.storeFlashToFile, "eee");
     ASSERT_EQ(copy.verboseCommands, true);
+    ASSERT_EQ(copy.numParallelNodeWorkers, 17);
+    ASSERT_EQ(copy.skipIdleTicks, true);
     ASSERT_EQ(copy.defaultBleStackType, BleStackType::NRF_SD_132_ANY);
 
     simConfig->storeFlashToFile.~basic_string();
@@ -741,7 +925,7 @@ TEST(TestOther, TestGattcEvtTimeoutReporting) {
     s.bleEvent.evt.gattc_evt.conn_handle = conn->connectionHandle;
     //s.bleEvent.evt.gattc_evt.gatt_status = ?
     s.bleEvent.evt.gattc_evt.params.timeout.src = BLE_GATT_TIMEOUT_SRC_PROTOCOL;
-    tester.sim->nodes[0].eventQueue.push_back(s);
+    tester.sim->nodes[0].eventQueue.PushBack(s);
 
     //Wait until the live report about the mesh disconnect with the proper disconnect reason is received
     tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"type\":\"live_report\",\"nodeId\":1,\"module\":3,\"code\":51,\"extra\":2,\"extra2\":31}");
@@ -876,6 +1060,7 @@ TEST(TestOther, TestTimeSyncDuration_long) {
     //testerConfig.verbose = true;
     SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
     simConfig.terminalId = 0;
+    simConfig.skipIdleTicks = true;
     simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
     simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 49});
     CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
@@ -1436,6 +1621,84 @@ TEST(TestOther, TestSimulatorFlashToFileStorage) {
 
 }
 
+#if defined(__unix__)
+TEST(TestOther, TestSimulateInFork) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    const u32 clusteredTimeMs = tester.sim->simState.simTimeMs;
+    const ClusterId clusterId = tester.sim->nodes[0].gs.node.clusterId;
+
+    //Every scenario starts from the clustered mesh
+    for (int i = 0; i < 2; i++)
+    {
+        ASSERT_TRUE(tester.SimulateInFork([&]() {
+            ASSERT_EQ(tester.sim->simState.simTimeMs, clusteredTimeMs);
+            ASSERT_EQ(tester.sim->nodes[0].gs.node.clusterId, clusterId);
+            tester.SendTerminalCommand(2, "reset");
+            tester.SimulateForGivenTime(10 * 1000);
+            tester.SimulateUntilClusteringDone(100 * 1000);
+        }));
+    }
+
+    //Failing scenarios are reported
+    ASSERT_FALSE(tester.SimulateInFork([&]() {
+        Exceptions::DisableDebugBreakOnException disable;
+        SIMEXCEPTIONFORCE(IllegalStateException);
+    }));
+
+    //The original simulation was not modified by the scenarios
+    ASSERT_EQ(tester.sim->simState.simTimeMs, clusteredTimeMs);
+    tester.SimulateForGivenTime(10 * 1000);
+    ASSERT_TRUE(tester.sim->IsClusteringDone());
+}
+
+static std::string ReadFlashFileForForkTest(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(TestOther, TestSimulateInForkRestoresFlashFile) {
+    const char* testFilePath = "TestForkFlashStorageFile.bin";
+    remove(testFilePath);
+
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.storeFlashToFile = testFilePath;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 1 });
+    simConfig.SetToPerfectConditions();
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateGivenNumberOfSteps(256);
+
+    const std::string flashFileAtCheckpoint = ReadFlashFileForForkTest(testFilePath);
+    ASSERT_FALSE(flashFileAtCheckpoint.empty());
+
+    //The scenario stores a record, which is written to the flash file of the fork
+    ASSERT_TRUE(tester.SimulateInFork([&]() {
+        tester.SendTerminalCommand(1, "saverec 1337 AA:BB:CC:DD:EE:FF");
+        tester.SimulateGivenNumberOfSteps(256);
+        ASSERT_NE(ReadFlashFileForForkTest(testFilePath), flashFileAtCheckpoint);
+    }));
+
+    //The flash file of the original simulation is restored once the scenario is done
+    ASSERT_EQ(ReadFlashFileForForkTest(testFilePath), flashFileAtCheckpoint);
+    tester.SendTerminalCommand(1, "getrec 1337");
+    tester.SimulateUntilMessageReceived(10 * 1000, 1, "Record not found");
+
+    remove(testFilePath);
+}
+#endif //__unix__
+
 TEST(TestOther, TestConnectionSupervisionTimeoutWillDisconnect) {
     CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
     // testerConfig.verbose = true;
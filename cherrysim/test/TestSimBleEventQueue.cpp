@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <cstring>
+#include "SimBleEventQueue.h"
+
+TEST(TestSimBleEventQueue, TestOrderAndUsedSize) {
+    SimBleEventQueue queue;
+    ASSERT_TRUE(queue.IsEmpty());
+
+    //Enough events to wrap around and grow the ring several times
+    u32 nextPushedId = 1;
+    u32 nextPoppedId = 1;
+    for (u32 round = 0; round < 20; round++)
+    {
+        for (u32 i = 0; i < round; i++)
+        {
+            const u16 len = (u16)(nextPushedId % NRF_SDH_BLE_GATT_MAX_MTU_SIZE);
+            ble_evt_t& event = queue.EmplaceBack(nextPushedId, nextPushedId * 2, sizeof(ble_evt_t) + len);
+            event.header.evt_id = BLE_GATTS_EVT_WRITE;
+            event.evt.gatts_evt.params.write.len = len;
+            memset(event.evt.gatts_evt.params.write.data, (u8)nextPushedId, len);
+            nextPushedId++;
+        }
+        for (u32 i = 0; i < round / 2; i++)
+        {
+            ASSERT_EQ(queue.GetEvent(0).header.evt_len, (u16)nextPoppedId);
+
+            simBleEvent event;
+            queue.PopFront(event);
+            const u16 len = (u16)(nextPoppedId % NRF_SDH_BLE_GATT_MAX_MTU_SIZE);
+            ASSERT_EQ(event.globalId, nextPoppedId);
+            ASSERT_EQ(event.additionalInfo, nextPoppedId * 2);
+            ASSERT_EQ(event.size, SimBleEventQueue::GetUsedSize(event.bleEvent));
+            ASSERT_GE(event.size, sizeof(ble_evt_t));
+            ASSERT_EQ(event.bleEvent.evt.gatts_evt.params.write.len, len);
+            for (u32 k = 0; k < len; k++) ASSERT_EQ(event.bleEvent.evt.gatts_evt.params.write.data[k], (u8)nextPoppedId);
+            nextPoppedId++;
+        }
+    }
+    ASSERT_EQ(queue.GetAmountOfEvents(), nextPushedId - nextPoppedId);
+
+    //Events that are pushed as a copy only keep the used bytes
+    simBleEvent advEvent;
+    memset(&advEvent, 0xAB, sizeof(advEvent));
+    advEvent.bleEvent.header.evt_id = BLE_GAP_EVT_ADV_REPORT;
+    advEvent.globalId = 1234;
+    queue.PushBack(advEvent);
+    const ble_evt_t& lastEvent = queue.GetEvent(queue.GetAmountOfEvents() - 1);
+    ASSERT_EQ(memcmp(&lastEvent, &advEvent.bleEvent, sizeof(ble_evt_t)), 0);
+
+    queue.Clear();
+    ASSERT_TRUE(queue.IsEmpty());
+    ASSERT_EQ(queue.GetAmountOfEvents(), 0);
+}
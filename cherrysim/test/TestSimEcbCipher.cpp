@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <random>
+#include "SimEcbCipher.h"
+
+extern "C" {
+#include <aes.h>
+}
+
+static void ExpectFipsTestVector(SimEcbCipher& cipher)
+{
+    //FIPS-197, Appendix C.1
+    const u8 key[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    const u8 clearText[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    const u8 expected[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+    u8 cipherText[16] = {};
+    cipher.EncryptBlock(key, clearText, cipherText);
+    for (u32 i = 0; i < sizeof(expected); i++) ASSERT_EQ(cipherText[i], expected[i]);
+}
+
+TEST(TestSimEcbCipher, TestFipsTestVector) {
+    SimEcbCipher cipher;
+    ExpectFipsTestVector(cipher);
+    cipher.SetAesNiEnabled(false);
+    ExpectFipsTestVector(cipher);
+}
+
+TEST(TestSimEcbCipher, TestSameOutputAsPortableImplementation) {
+    if (!SimEcbCipher::IsAesNiSupported())
+    {
+        GTEST_SKIP() << "AES-NI is not supported by this CPU";
+    }
+    std::mt19937 rng(1234);
+    SimEcbCipher cipher;
+    ASSERT_TRUE(cipher.IsAesNiEnabled());
+
+    //More keys than fit into the cache, every key is used for several blocks
+    u8 keys[20][16];
+    for (u32 i = 0; i < 20; i++)
+    {
+        for (u32 k = 0; k < 16; k++) keys[i][k] = (u8)rng();
+    }
+    for (u32 i = 0; i < 2000; i++)
+    {
+        const u8* key = keys[(i / 3) % 20];
+        u8 clearText[16];
+        for (u32 k = 0; k < 16; k++) clearText[k] = (u8)rng();
+
+        u8 expected[16];
+        u8 actual[16];
+        AES_ECB_encrypt(clearText, key, expected, 16);
+        cipher.EncryptBlock(key, clearText, actual);
+        for (u32 k = 0; k < 16; k++) ASSERT_EQ(actual[k], expected[k]);
+    }
+    ASSERT_GT(cipher.GetAmountOfHits(), 0);
+    ASSERT_GT(cipher.GetAmountOfMisses(), 0);
+}
@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <vector>
+#include "SimMapChangeFeed.h"
+#include "FruitySimServer.h"
+#include "CherrySimTester.h"
+
+TEST(TestSimMapChangeFeed, TestOnlyChangedNodesArePublished) {
+    constexpr u32 amountOfNodes = 10;
+    std::vector<SimMapNodeState> states(amountOfNodes);
+    for (u32 i = 0; i < amountOfNodes; i++) states[i].x = (float)i + 1;
+    u32 amountOfCaptures = 0;
+    auto capture = [&](u32 nodeIndex, SimMapNodeState& outState) {
+        amountOfCaptures++;
+        outState = states[nodeIndex];
+    };
+
+    SimMapChangeFeed feed;
+    feed.Reset(amountOfNodes);
+    const u32 epoch = feed.GetEpoch();
+
+    //The first publish captures all nodes
+    feed.Publish(capture);
+    ASSERT_EQ(amountOfCaptures, amountOfNodes);
+    ASSERT_EQ(feed.GetSequence(), amountOfNodes);
+    ASSERT_FALSE(feed.HasPendingNodes());
+
+    std::vector<SimMapChangeFeed::Change> changes;
+    ASSERT_TRUE(feed.CollectChangesSince(epoch, amountOfNodes, changes));
+    ASSERT_TRUE(changes.empty());
+
+    //Only marked nodes are captured and only real changes get a new sequence number
+    amountOfCaptures = 0;
+    states[3].clusterId = 1234;
+    states[7].connections.push_back({ 5, 2 });
+    for (u32 nodeIndex : { 3u, 5u, 7u, 3u })
+    {
+        if (feed.MarkNodePending(nodeIndex)) feed.EnqueuePendingNode(nodeIndex);
+    }
+    feed.Publish(capture);
+    ASSERT_EQ(amountOfCaptures, 3u);
+    ASSERT_EQ(feed.GetSequence(), amountOfNodes + 2);
+
+    ASSERT_TRUE(feed.CollectChangesSince(epoch, amountOfNodes, changes));
+    ASSERT_EQ(changes.size(), 2u);
+    ASSERT_EQ(changes[0].nodeIndex, 3u);
+    ASSERT_EQ(changes[0].groups, SimMapChangeFeed::GROUP_CLUSTER);
+    ASSERT_EQ(changes[1].nodeIndex, 7u);
+    ASSERT_EQ(changes[1].groups, SimMapChangeFeed::GROUP_CONNECTIONS);
+    ASSERT_EQ(feed.GetPublishedState(3).clusterId, 1234u);
+
+    //Multiple changes of a node are merged
+    states[3].x = 100;
+    states[3].ledOn = true;
+    if (feed.MarkNodePending(3)) feed.EnqueuePendingNode(3);
+    feed.Publish(capture);
+    ASSERT_TRUE(feed.CollectChangesSince(epoch, amountOfNodes, changes));
+    ASSERT_EQ(changes.size(), 2u);
+    ASSERT_EQ(changes[0].nodeIndex, 3u);
+    ASSERT_EQ(changes[0].groups, SimMapChangeFeed::GROUP_CLUSTER | SimMapChangeFeed::GROUP_POSITION | SimMapChangeFeed::GROUP_STATE);
+
+    //Unknown epochs and sequences require a resync
+    ASSERT_FALSE(feed.CollectChangesSince(epoch + 1, amountOfNodes, changes));
+    ASSERT_FALSE(feed.CollectChangesSince(epoch, feed.GetSequence() + 1, changes));
+    ASSERT_TRUE(feed.CollectChangesSince(epoch, 0, changes));
+    ASSERT_EQ(changes.size(), amountOfNodes);
+}
+
+TEST(TestSimMapChangeFeed, TestClientsBehindTheHistoryMustResync) {
+    SimMapChangeFeed feed;
+    feed.Reset(1);
+    const u32 epoch = feed.GetEpoch();
+
+    float x = 0;
+    auto capture = [&](u32 nodeIndex, SimMapNodeState& outState) {
+        outState.x = x;
+    };
+
+    std::vector<SimMapChangeFeed::Change> changes;
+    for (u32 i = 0; i < 1000; i++)
+    {
+        x += 1;
+        if (feed.MarkNodePending(0)) feed.EnqueuePendingNode(0);
+        feed.Publish(capture);
+    }
+    ASSERT_EQ(feed.GetSequence(), 1000u);
+    ASSERT_FALSE(feed.CollectChangesSince(epoch, 0, changes));
+    ASSERT_TRUE(feed.CollectChangesSince(epoch, 990, changes));
+    ASSERT_EQ(changes.size(), 1u);
+    ASSERT_EQ(feed.GetPublishedState(0).x, 1000);
+
+    //A new simulation starts a new epoch
+    feed.Reset(1);
+    ASSERT_NE(feed.GetEpoch(), epoch);
+    ASSERT_FALSE(feed.CollectChangesSince(epoch, 990, changes));
+}
+
+TEST(TestSimMapChangeFeed, TestPublishedStateFollowsTheMesh) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    SimMapChangeFeed& feed = tester.sim->mapChangeFeed;
+    feed.Publish(&FruitySimServer::CaptureMapState);
+    const u32 sequenceBeforeClustering = feed.GetSequence();
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+    tester.SimulateForGivenTime(10 * 1000);
+
+    //The nodes notified the feed about their connections and cluster changes
+    ASSERT_TRUE(feed.HasPendingNodes());
+    feed.Publish(&FruitySimServer::CaptureMapState);
+    ASSERT_GT(feed.GetSequence(), sequenceBeforeClustering);
+
+    std::vector<SimMapChangeFeed::Change> changes;
+    ASSERT_TRUE(feed.CollectChangesSince(feed.GetEpoch(), sequenceBeforeClustering, changes));
+    ASSERT_EQ(changes.size(), tester.sim->GetTotalNodes());
+
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        const SimMapNodeState& state = feed.GetPublishedState(i);
+        ASSERT_EQ(state.clusterId, tester.sim->nodes[0].gs.node.clusterId);
+        ASSERT_EQ(state.clusterSize, (ClusterSize)tester.sim->GetTotalNodes());
+        ASSERT_FALSE(state.connections.empty());
+    }
+
+    //Moving a node is published as a position change only
+    const u32 sequenceBeforeMove = feed.GetSequence();
+    tester.sim->SetPosition(2, 0.25f, 0.75f, tester.sim->nodes[2].z);
+    feed.Publish(&FruitySimServer::CaptureMapState);
+    ASSERT_TRUE(feed.CollectChangesSince(feed.GetEpoch(), sequenceBeforeMove, changes));
+    ASSERT_EQ(changes.size(), 1u);
+    ASSERT_EQ(changes[0].nodeIndex, 2u);
+    ASSERT_TRUE((changes[0].groups & SimMapChangeFeed::GROUP_POSITION) != 0);
+    ASSERT_EQ(feed.GetPublishedState(2).x, 0.25f);
+}
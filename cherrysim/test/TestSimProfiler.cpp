@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <sstream>
+#include <string>
+#include "SimProfiler.h"
+#include "CherrySimTester.h"
+
+namespace
+{
+    const SimProfileValue* FindFrame(const std::vector<std::pair<std::string, SimProfileValue>>& totals, const std::string& name)
+    {
+        for (const auto& entry : totals)
+        {
+            if (entry.first == name) return &entry.second;
+        }
+        return nullptr;
+    }
+}
+
+TEST(TestSimProfiler, TestProfileAggregation) {
+    const u32 outer = SimProfiler::GetFrameId("TestProfileOuter");
+    const u32 inner = SimProfiler::GetFrameId("TestProfileInner");
+    ASSERT_EQ(SimProfiler::GetFrameName(outer), "TestProfileOuter");
+    ASSERT_EQ(SimProfiler::GetFrameId("TestProfileOuter"), outer);
+
+    SimProfile profile;
+    ASSERT_TRUE(profile.IsEmpty());
+
+    //outer -> inner -> outer, the recursive call of outer must not be counted twice in its total
+    const u32 outerStack = profile.Push(SimProfile::ROOT_STACK, outer);
+    const u32 innerStack = profile.Push(outerStack, inner);
+    const u32 recursiveStack = profile.Push(innerStack, outer);
+    ASSERT_EQ(profile.Push(SimProfile::ROOT_STACK, outer), outerStack);
+    profile.Record(recursiveStack, 10, 0);
+    profile.Record(innerStack, 30, 10);
+    profile.Record(outerStack, 100, 30);
+    profile.Record(outerStack, 50, 0);
+
+    auto totals = profile.GetFrameTotals();
+    ASSERT_EQ(totals.size(), 2);
+    ASSERT_EQ(totals[0].first, "TestProfileOuter");
+    ASSERT_EQ(totals[0].second.calls, 3);
+    ASSERT_EQ(totals[0].second.totalNs, 150);
+    ASSERT_EQ(totals[0].second.selfNs, 130);
+    const SimProfileValue* innerTotal = FindFrame(totals, "TestProfileInner");
+    ASSERT_NE(innerTotal, nullptr);
+    ASSERT_EQ(innerTotal->calls, 1);
+    ASSERT_EQ(innerTotal->totalNs, 30);
+    ASSERT_EQ(innerTotal->selfNs, 20);
+
+    std::ostringstream collapsed;
+    profile.WriteCollapsedStacks(collapsed, "Node 1");
+    ASSERT_EQ(collapsed.str(),
+        "Node 1;TestProfileOuter 120\n"
+        "Node 1;TestProfileOuter;TestProfileInner 20\n"
+        "Node 1;TestProfileOuter;TestProfileInner;TestProfileOuter 10\n");
+
+    //Adding a profile sums up the values of identical stacks
+    SimProfile sum;
+    sum.Add(profile);
+    sum.Add(profile);
+    totals = sum.GetFrameTotals();
+    ASSERT_EQ(totals[0].second.calls, 6);
+    ASSERT_EQ(totals[0].second.totalNs, 300);
+
+    profile.Clear();
+    ASSERT_TRUE(profile.IsEmpty());
+}
+
+TEST(TestSimProfiler, TestFirmwareIsProfiledPerNode) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.enableProfiler = true;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        const auto totals = tester.sim->nodes[i].profile.GetFrameTotals();
+        const SimProfileValue* eventLooper = FindFrame(totals, "EventLooper");
+        ASSERT_NE(eventLooper, nullptr);
+        ASSERT_GT(eventLooper->calls, 0);
+        ASSERT_NE(FindFrame(totals, "TimerEventHandler"), nullptr);
+        ASSERT_NE(FindFrame(totals, "MeshMessageReceivedHandler"), nullptr);
+    }
+
+    std::ostringstream collapsed;
+    tester.sim->WriteProfileCollapsedStacks(collapsed);
+    ASSERT_NE(collapsed.str().find("Node 1;EventLooper;AppEvents;"), std::string::npos);
+    ASSERT_NE(collapsed.str().find("Node 3;EventLooper;"), std::string::npos);
+
+    //Profiles are only collected if enabled
+    tester.sim->simConfig.enableProfiler = false;
+    tester.SendTerminalCommand(1, "sim profile_clear");
+    tester.SimulateForGivenTime(1000);
+    ASSERT_TRUE(tester.sim->GetProfile(0).IsEmpty());
+}
@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <cstring>
+#include <vector>
+#include <fstream>
+#include "SparseFlash.h"
+#include "CherrySimTester.h"
+
+TEST(TestSparseFlash, TestReadWriteAndErase) {
+    constexpr u32 pageSize = 4096;
+    constexpr u32 flashSize = pageSize * 16;
+    SparseFlash flash(flashSize, pageSize);
+    flash.Reset(3);
+
+    for (u32 node = 0; node < 3; node++)
+    {
+        const u8* f = flash.GetFlash(node);
+        for (u32 i = 0; i < flashSize; i++) ASSERT_EQ(f[i], 0xFF);
+    }
+
+    //Writing to one node must not be visible on the others
+    flash.GetFlash(1)[pageSize * 2 + 5] = 0x12;
+    ASSERT_EQ(flash.GetFlash(0)[pageSize * 2 + 5], 0xFF);
+    ASSERT_EQ(flash.GetFlash(1)[pageSize * 2 + 5], 0x12);
+    ASSERT_EQ(flash.GetFlash(2)[pageSize * 2 + 5], 0xFF);
+
+    //Erasing a page only touches that page
+    flash.GetFlash(1)[pageSize * 3] = 0x34;
+    flash.Erase(flash.GetFlash(1) + pageSize * 2, pageSize);
+    ASSERT_EQ(flash.GetFlash(1)[pageSize * 2 + 5], 0xFF);
+    ASSERT_EQ(flash.GetFlash(1)[pageSize * 3], 0x34);
+
+    //Erasing less than a page behaves like writing 0xFF
+    flash.GetFlash(2)[10] = 0x00;
+    flash.GetFlash(2)[20] = 0x00;
+    flash.Erase(flash.GetFlash(2) + 8, 8);
+    ASSERT_EQ(flash.GetFlash(2)[10], 0xFF);
+    ASSERT_EQ(flash.GetFlash(2)[20], 0x00);
+
+    flash.EraseFlash(1);
+    ASSERT_EQ(flash.GetFlash(1)[pageSize * 3], 0xFF);
+}
+
+TEST(TestSparseFlash, TestShareIdenticalPages) {
+    constexpr u32 pageSize = 4096;
+    constexpr u32 flashSize = pageSize * 8;
+    constexpr u32 amountOfNodes = 10;
+    SparseFlash flash(flashSize, pageSize);
+    flash.Reset(amountOfNodes);
+
+    for (u32 node = 0; node < amountOfNodes; node++)
+    {
+        //The same on every node
+        memset(flash.GetFlash(node) + pageSize, 0xAB, pageSize);
+        //Different on every node
+        flash.GetFlash(node)[pageSize * 4] = (u8)node;
+    }
+
+    const u32 sharedPages = flash.ShareIdenticalPages();
+    if (flash.IsSparse())
+    {
+        ASSERT_EQ(sharedPages, amountOfNodes * 7);
+    }
+
+    //Sharing must not change the contents and the shared pages must still be copy on write
+    for (u32 node = 0; node < amountOfNodes; node++)
+    {
+        for (u32 i = 0; i < pageSize; i++) ASSERT_EQ(flash.GetFlash(node)[pageSize + i], 0xAB);
+        ASSERT_EQ(flash.GetFlash(node)[pageSize * 4], (u8)node);
+    }
+    flash.GetFlash(3)[pageSize + 1] = 0x00;
+    ASSERT_EQ(flash.GetFlash(3)[pageSize + 1], 0x00);
+    ASSERT_EQ(flash.GetFlash(4)[pageSize + 1], 0xAB);
+
+    //A second run does not need to share anything new
+    if (flash.IsSparse())
+    {
+        ASSERT_EQ(flash.ShareIdenticalPages(), amountOfNodes * 7 - 1);
+    }
+}
+
+//The flash of the simulated nodes must behave exactly like a plain memory block
+TEST(TestSparseFlash, TestSimulatedNodesUseSparseFlash) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.terminalId = 0;
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        ASSERT_EQ(tester.sim->nodes[i].flash, tester.sim->sparseFlash.GetFlash(i));
+    }
+
+    tester.SimulateUntilClusteringDone(100 * 1000);
+
+    //Sharing pages while the nodes are running must not change what the nodes see
+    std::vector<std::vector<u8>> flashContents;
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        flashContents.emplace_back(tester.sim->nodes[i].flash, tester.sim->nodes[i].flash + SIM_MAX_FLASH_SIZE);
+    }
+    tester.sim->sparseFlash.ShareIdenticalPages();
+    for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+    {
+        ASSERT_EQ(memcmp(flashContents[i].data(), tester.sim->nodes[i].flash, SIM_MAX_FLASH_SIZE), 0);
+    }
+
+    tester.SimulateForGivenTime(10 * 1000);
+    ASSERT_TRUE(tester.sim->IsClusteringDone());
+}
+
+static size_t GetFileSize(const char* path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return (size_t)file.tellg();
+}
+
+//Storing the flash must only write the pages that changed since the last store
+TEST(TestSparseFlash, TestIncrementalFlashFileStorage) {
+    const char* testFilePath = "TestIncrementalFlashStorageFile.bin";
+    remove(testFilePath);
+
+    std::vector<std::vector<u8>> flashContents;
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.terminalId = 0;
+        simConfig.storeFlashToFile = testFilePath;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        tester.sim->StoreFlashToFile();
+        const size_t sizeAfterFirstStore = GetFileSize(testFilePath);
+        ASSERT_EQ(sizeAfterFirstStore % SIM_FLASH_PAGE_SIZE, 0);
+
+        //Nothing changed, so nothing must be written
+        tester.sim->StoreFlashToFile();
+        ASSERT_EQ(GetFileSize(testFilePath), sizeAfterFirstStore);
+
+        //A single changed page is appended together with one batch header page
+        u8* page = tester.sim->nodes[2].flash + SIM_FLASH_PAGE_SIZE * 100;
+        page[7] = 0x42;
+        tester.sim->MarkFlashWritten((u32)page, 1);
+        tester.sim->StoreFlashToFile();
+        ASSERT_EQ(GetFileSize(testFilePath), sizeAfterFirstStore + 2 * SIM_FLASH_PAGE_SIZE);
+
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            flashContents.emplace_back(tester.sim->nodes[i].flash, tester.sim->nodes[i].flash + SIM_MAX_FLASH_SIZE);
+        }
+    }
+
+    //Loading the file must restore the exact flash contents of all nodes
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.terminalId = 0;
+        simConfig.storeFlashToFile = testFilePath;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 2 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+
+        ASSERT_EQ(flashContents.size(), tester.sim->GetTotalNodes());
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++)
+        {
+            ASSERT_EQ(memcmp(flashContents[i].data(), tester.sim->nodes[i].flash, SIM_MAX_FLASH_SIZE), 0);
+        }
+
+        tester.Start();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+    }
+
+    remove(testFilePath);
+}
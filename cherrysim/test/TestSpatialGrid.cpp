@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "SpatialGrid.h"
+#include "MersenneTwister.h"
+#include "CherrySimTester.h"
+
+namespace
+{
+    struct GridTestPosition
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    float DistanceInMeters(const GridTestPosition& a, const GridTestPosition& b, float width, float height, float elevation)
+    {
+        const float distX = (a.x - b.x) * width;
+        const float distY = (a.y - b.y) * height;
+        const float distZ = (a.z - b.z) * elevation;
+        return std::sqrt(distX * distX + distY * distY + distZ * distZ);
+    }
+}
+
+TEST(TestSpatialGrid, TestFindNodesInRangeMatchesBruteForce) {
+    constexpr u32 amountOfNodes = 300;
+    constexpr u32 width = 300;
+    constexpr u32 height = 200;
+    constexpr u32 elevation = 5;
+
+    MersenneTwister rnd(123);
+    std::vector<GridTestPosition> positions(amountOfNodes);
+    SpatialGrid grid;
+    grid.Reset(25.0f, width, height, elevation, amountOfNodes);
+    for (u32 i = 0; i < amountOfNodes; i++)
+    {
+        positions[i] = { (float)rnd.NextU32() / (float)0xFFFFFFFF, (float)rnd.NextU32() / (float)0xFFFFFFFF, (float)rnd.NextU32() / (float)0xFFFFFFFF };
+        grid.UpdateNode(i, positions[i].x, positions[i].y, positions[i].z);
+    }
+    ASSERT_TRUE(grid.IsValidFor(width, height, elevation, amountOfNodes));
+    ASSERT_FALSE(grid.IsValidFor(width + 1, height, elevation, amountOfNodes));
+
+    const float ranges[] = { 0.0f, 5.0f, 24.9f, 25.0f, 60.0f, 1000.0f, INFINITY };
+    std::vector<u32> result;
+    for (u32 sender = 0; sender < amountOfNodes; sender += 7)
+    {
+        for (float range : ranges)
+        {
+            grid.FindNodesInRange(positions[sender].x, positions[sender].y, positions[sender].z, range, result);
+            ASSERT_TRUE(std::is_sorted(result.begin(), result.end()));
+            ASSERT_TRUE(std::adjacent_find(result.begin(), result.end()) == result.end());
+            for (u32 i = 0; i < amountOfNodes; i++)
+            {
+                if (DistanceInMeters(positions[sender], positions[i], width, height, elevation) <= range)
+                {
+                    ASSERT_TRUE(std::binary_search(result.begin(), result.end(), i));
+                }
+            }
+        }
+    }
+
+    //A range that covers the whole map must return all nodes
+    grid.FindNodesInRange(0.5f, 0.5f, 0.5f, 10000.0f, result);
+    ASSERT_EQ(result.size(), amountOfNodes);
+}
+
+TEST(TestSpatialGrid, TestUpdateNode) {
+    SpatialGrid grid;
+    grid.Reset(10.0f, 1000, 1000, 1, 3);
+    grid.UpdateNode(0, 0.0f, 0.0f, 0.0f);
+    grid.UpdateNode(1, 0.005f, 0.0f, 0.0f);
+    grid.UpdateNode(2, 0.5f, 0.5f, 0.0f);
+
+    std::vector<u32> result;
+    grid.FindNodesInRange(0.0f, 0.0f, 0.0f, 10.0f, result);
+    ASSERT_EQ(result, std::vector<u32>({ 0, 1 }));
+
+    //Move node 1 far away and node 2 next to node 0
+    grid.UpdateNode(1, 0.9f, 0.9f, 0.0f);
+    grid.UpdateNode(2, 0.001f, 0.001f, 0.0f);
+    grid.FindNodesInRange(0.0f, 0.0f, 0.0f, 10.0f, result);
+    ASSERT_EQ(result, std::vector<u32>({ 0, 2 }));
+    grid.FindNodesInRange(0.9f, 0.9f, 0.0f, 10.0f, result);
+    ASSERT_EQ(result, std::vector<u32>({ 1 }));
+
+    //Positions far outside of the map are valid as well
+    grid.UpdateNode(0, -42.0f, 1337.0f, 0.0f);
+    grid.FindNodesInRange(-42.0f, 1337.0f, 0.0f, 1.0f, result);
+    ASSERT_EQ(result, std::vector<u32>({ 0 }));
+    grid.FindNodesInRange(0.0f, 0.0f, 0.0f, 10.0f, result);
+    ASSERT_EQ(result, std::vector<u32>({ 2 }));
+}
+
+TEST(TestSpatialGrid, TestGridFollowsSetPosition) {
+    CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+    SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+    simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+    simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+    CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+    tester.Start();
+
+    ASSERT_TRUE(tester.sim->spatialGrid.IsValidFor(simConfig.mapWidthInMeters, simConfig.mapHeightInMeters, simConfig.mapElevationInMeters, 5));
+
+    //Move the sink far out of the reception range of all other nodes
+    tester.sim->SetPosition(0, 100.0f, 100.0f, 0.0f);
+    std::vector<u32> result;
+    tester.sim->spatialGrid.FindNodesInRange(100.0f, 100.0f, 0.0f, tester.sim->GetMaxReceptionRangeInMeters(&tester.sim->nodes[0]), result);
+    ASSERT_EQ(result, std::vector<u32>({ 0 }));
+
+    //The other nodes must not receive any advertising packets from the sink anymore
+    tester.sim->SimulateStepForAllNodes();
+    ASSERT_EQ(tester.sim->CalculateReceptionProbability(&tester.sim->nodes[0], &tester.sim->nodes[1]), 0);
+}
+
+//Measures the steps per second depending on the amount of nodes. With a constant node density, each node has about
+//the same amount of neighbours, so the time per node and step must not grow with the size of the mesh like it did
+//when every broadcast was checked against every other node.
+TEST(TestSpatialGrid, TestSimulationSpeed_scheduled) {
+    const u32 amountOfNodesPerRun[] = { 100, 200, 400, 800 };
+    constexpr u32 simulatedSteps = 500;
+
+    std::vector<double> secondsPerNodeStep;
+    for (u32 amountOfNodes : amountOfNodesPerRun)
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        const u32 mapSize = (u32)(std::sqrt((float)amountOfNodes) * 12);
+        simConfig.mapWidthInMeters = mapSize;
+        simConfig.mapHeightInMeters = mapSize;
+        simConfig.terminalId = -1;
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", amountOfNodes - 1 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        auto startTime = std::chrono::steady_clock::now();
+        tester.SimulateGivenNumberOfSteps(simulatedSteps);
+        auto endTime = std::chrono::steady_clock::now();
+
+        const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+        printf("%u nodes: %.1f steps/sec" EOL, amountOfNodes, simulatedSteps / seconds);
+        secondsPerNodeStep.push_back(seconds / simulatedSteps / amountOfNodes);
+    }
+
+    //Eight times the nodes would take eight times as long per node if every node was checked against every other
+    ASSERT_LT(secondsPerNodeStep.back(), secondsPerNodeStep.front() * 3);
+}
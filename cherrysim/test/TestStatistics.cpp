@@ -54,14 +54,19 @@ TEST(TestStatistics, TestNumberClusteringMessagesSent) {
     //Therefore a shortcut has been taken to only simulate for some time so that an emergency disconnect will not happen
     tester.SimulateForGivenTime(30 * 1000);
 
-    //Calculate the statistic for all messages routed by all nodes summed up
-    PacketStat stat[PACKET_STAT_SIZE];
+    //The global statistic must match the statistics of all nodes summed up
+    PacketStatTable sum;
     for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
-        for (u32 j = 0; j < PACKET_STAT_SIZE; j++) {
-            tester.sim->AddPacketToStats(stat, tester.sim->nodes[i].routedPackets + j);
-        }
+        sum.Add(tester.sim->nodes[i].routedPackets);
+    }
+    ASSERT_EQ(sum.GetAmountOfEntries(), tester.sim->globalRoutedPackets.GetAmountOfEntries());
+    for (const PacketStat& entry : sum.GetEntries()) {
+        ASSERT_EQ(entry.count, tester.sim->globalRoutedPackets.GetCount(entry));
     }
 
+    //The statistic for all messages routed by all nodes summed up
+    std::vector<PacketStat> stat = tester.sim->globalRoutedPackets.GetEntries();
+
     //We check for all known message types with some min and max values
     CheckAndClearStat(stat, MessageType::CLUSTER_WELCOME, ModuleId::INVALID_MODULE, 10, 100); //This check surpasses 50 cases. See IOT-3997
     CheckAndClearStat(stat, MessageType::CLUSTER_ACK_1, ModuleId::INVALID_MODULE, 10, 50);
@@ -78,19 +83,230 @@ TEST(TestStatistics, TestNumberClusteringMessagesSent) {
     checkStatEmpty(stat);
 }
 
+//Sends unicast messages through a cluster once with flooding and once with learned routes and compares
+//how often the messages were written to a link
+TEST(TestStatistics, TestUnicastRoutingReducesRoutedPackets) {
+    auto countRoutedTriggerActions = [](bool enableUnicastRouting, u32* routeHits) {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+
+        simConfig.enableSimStatistics = true;
+        simConfig.seed = 7;
+
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 19});
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
+            tester.sim->nodes[i].gs.config.enableUnicastRouting = enableUnicastRouting;
+        }
+
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        //Every node answers to node 1 so that the routes between node 1 and all other nodes are learned
+        tester.SendTerminalCommand(1, "action 0 status get_device_info");
+        tester.SimulateForGivenTime(10 * 1000);
+
+        //Messages to a direct partner are never flooded, so we pick a node that is further away
+        const NodeId target = FindNodeThatIsNoPartnerOf(tester, 1);
+
+        tester.sim->globalRoutedPackets.Clear();
+
+        for (u32 i = 0; i < 5; i++) {
+            tester.SendTerminalCommand(1, "action %u status get_device_info", target);
+            tester.SimulateUntilMessageReceived(10 * 1000, 1, "{\"nodeId\":%u,\"type\":\"device_info\",\"module\":3,", target);
+        }
+
+        u32 routedTriggerActions = 0;
+        for (const PacketStat& entry : tester.sim->globalRoutedPackets.GetEntries()) {
+            if (entry.messageType == MessageType::MODULE_TRIGGER_ACTION) routedTriggerActions += entry.count;
+        }
+
+        *routeHits = tester.sim->FindNodeById(1)->gs.cm.meshRouteHits;
+
+        return routedTriggerActions;
+    };
+
+    u32 routeHitsWithoutRouting = 0;
+    u32 routeHitsWithRouting = 0;
+    const u32 flooded = countRoutedTriggerActions(false, &routeHitsWithoutRouting);
+    const u32 routed = countRoutedTriggerActions(true, &routeHitsWithRouting);
+
+    //A flooded message is written to each of the 19 links of the cluster
+    ASSERT_GE(flooded, 5 * 19);
+    ASSERT_EQ(routeHitsWithoutRouting, 0);
+
+    //A routed message is only written to the links on the path to its receiver
+    ASSERT_GT(routeHitsWithRouting, 0);
+    ASSERT_LT(routed, flooded);
+}
+
+//Requests split messages from a node that is several hops away, once with relays that reassemble each
+//message before forwarding it and once with relays that forward every split as soon as it arrives
+TEST(TestStatistics, TestCutThroughForwardingOfSplitMessages) {
+    auto measureResponseTime = [](bool enableCutThroughForwarding, u32* cutThroughForwardedMessages) {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+
+        simConfig.seed = 7;
+
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1});
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 19});
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
+            tester.sim->nodes[i].gs.config.enableCutThroughForwarding = enableCutThroughForwarding;
+        }
+
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        //Relays can only forward the splits of messages for which they know the route
+        tester.SendTerminalCommand(1, "action 0 status get_device_info");
+        tester.SimulateForGivenTime(10 * 1000);
+
+        const NodeId target = FindNodeThatIsNoPartnerOf(tester, 1);
+
+        const u32 startTimeMs = tester.sim->simState.simTimeMs;
+        tester.SendTerminalCommand(1, "action %u status get_connections_verbose", target);
+        tester.SimulateUntilRegexMessageReceived(10 * 1000, 1, "\\{\"type\":\"connections_verbose\",\"nodeId\":%u,\"module\":3,\"version\":1,\"connectionIndex\":0,", target);
+        const u32 responseTimeMs = tester.sim->simState.simTimeMs - startTimeMs;
+
+        *cutThroughForwardedMessages = 0;
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
+            *cutThroughForwardedMessages += tester.sim->nodes[i].gs.cm.cutThroughForwardedMessages;
+        }
+
+        return responseTimeMs;
+    };
+
+    //Both must deliver the complete message, the regex only matches if the message could be parsed
+    u32 forwardedWithoutCutThrough = 0;
+    u32 forwardedWithCutThrough = 0;
+    const u32 storeAndForwardMs = measureResponseTime(false, &forwardedWithoutCutThrough);
+    const u32 cutThroughMs = measureResponseTime(true, &forwardedWithCutThrough);
+
+    ASSERT_EQ(forwardedWithoutCutThrough, 0);
+    //At least the relays on the path of the response must have forwarded it split by split
+    ASSERT_GT(forwardedWithCutThrough, 0);
+    ASSERT_LT(cutThroughMs, storeAndForwardMs);
+}
+
+TEST(TestStatistics, TestPacketStatTable) {
+    PacketStatTable table;
+    ASSERT_EQ(table.GetAmountOfEntries(), 0);
+
+    //Enough different keys so that the table has to grow several times
+    for (u32 round = 0; round < 3; round++) {
+        for (u32 i = 0; i < 1000; i++) {
+            PacketStat packet;
+            packet.messageType = MessageType::MODULE_GENERAL;
+            packet.moduleId = i % 100;
+            packet.actionType = (u8)(i / 100);
+            packet.isSplit = i % 2;
+            packet.count = 1;
+            table.Add(packet);
+        }
+    }
+    ASSERT_EQ(table.GetAmountOfEntries(), 1000);
+
+    PacketStat packet;
+    packet.messageType = MessageType::MODULE_GENERAL;
+    packet.moduleId = 5;
+    packet.actionType = 3;
+    packet.isSplit = 1;
+    ASSERT_EQ(table.GetCount(packet), 3);
+    //Same key except for the request handle
+    packet.requestHandle = 1;
+    ASSERT_EQ(table.GetCount(packet), 0);
+
+    //Invalid packets are never counted
+    PacketStat invalidPacket;
+    invalidPacket.count = 1;
+    table.Add(invalidPacket);
+    ASSERT_EQ(table.GetAmountOfEntries(), 1000);
+
+    PacketStatTable sum;
+    sum.Add(table);
+    sum.Add(table);
+    packet.requestHandle = 0;
+    ASSERT_EQ(sum.GetAmountOfEntries(), 1000);
+    ASSERT_EQ(sum.GetCount(packet), 6);
+
+    u32 totalCount = 0;
+    for (const PacketStat& entry : sum.GetEntries()) totalCount += entry.count;
+    ASSERT_EQ(totalCount, 6000);
+
+    sum.Clear();
+    ASSERT_EQ(sum.GetAmountOfEntries(), 0);
+    ASSERT_EQ(sum.GetCount(packet), 0);
+}
+
+TEST(TestStatistics, TestSimStatistics) {
+    //Without a simulator, the statistics are collected in the table that is not bound to a node
+    sim_clear_statistics();
+    for (u32 i = 0; i < 10; i++) SIMSTATCOUNT("TestSimStatisticsCount");
+    for (i32 value : { 0, 1, 2, 3, 100 }) SIMSTATAVG("TestSimStatisticsAvg", value);
+    ASSERT_EQ(sim_get_statistics("TestSimStatisticsCount"), 10);
+    ASSERT_EQ(sim_get_statistics("TestSimStatisticsAvg"), 0);
+
+    const SimStatValue* value = GetSimStatisticsWithoutNode().Find(SimStatKeys::Intern("TestSimStatisticsAvg"));
+    ASSERT_NE(value, nullptr);
+    ASSERT_EQ(value->samples, 5);
+    ASSERT_EQ(value->GetAverage(), 21);
+    ASSERT_EQ(value->min, 0);
+    ASSERT_EQ(value->max, 100);
+    ASSERT_EQ(value->histogram[0], 1);
+    ASSERT_EQ(value->histogram[1], 1);
+    ASSERT_EQ(value->histogram[2], 2);
+    ASSERT_EQ(value->histogram[7], 1);
+    ASSERT_EQ(SimStatValue::GetHistogramBucket(INT32_MAX), 31);
+
+    const nlohmann::json json = GetSimStatisticsWithoutNode().ToJson();
+    ASSERT_EQ(json["TestSimStatisticsCount"]["count"], 10);
+    ASSERT_EQ(json["TestSimStatisticsAvg"]["histogram"].size(), 8);
+
+    //Nodes collect their own statistics, the global view sums them up
+    {
+        CherrySimTesterConfig testerConfig = CherrySimTester::CreateDefaultTesterConfiguration();
+        SimConfiguration simConfig = CherrySimTester::CreateDefaultSimConfiguration();
+        simConfig.nodeConfigName.insert({ "prod_sink_nrf52", 1 });
+        simConfig.nodeConfigName.insert({ "prod_mesh_nrf52", 4 });
+        CherrySimTester tester = CherrySimTester(testerConfig, simConfig);
+        tester.Start();
+        sim_clear_statistics();
+        tester.SimulateUntilClusteringDone(100 * 1000);
+
+        const u32 keyId = SimStatKeys::Intern("ClusterUpdateCount");
+        u32 sum = 0;
+        for (u32 i = 0; i < tester.sim->GetTotalNodes(); i++) {
+            const SimStatValue* nodeValue = tester.sim->nodes[i].statistics.Find(keyId);
+            if (nodeValue != nullptr) sum += nodeValue->count;
+        }
+        ASSERT_GT(sum, 0);
+        ASSERT_EQ(sim_get_statistics("ClusterUpdateCount"), (int)sum);
+    }
+
+    //The statistics of the nodes are kept after the simulator is gone
+    ASSERT_GT(sim_get_statistics("ClusterUpdateCount"), 0);
+    sim_clear_statistics();
+    ASSERT_EQ(sim_get_statistics("ClusterUpdateCount"), 0);
+}
+
 //#################################### Helpers for Statistic Tests #######################################
 
-void CheckAndClearStat(PacketStat* stat, MessageType mt, ModuleId moduleId, u32 minCount, u32 maxCount, u8 actionType, u8 requestHandle)
+void CheckAndClearStat(std::vector<PacketStat>& stat, MessageType mt, ModuleId moduleId, u32 minCount, u32 maxCount, u8 actionType, u8 requestHandle)
 {
     CheckAndClearStat(stat, mt, Utility::GetWrappedModuleId(moduleId), minCount, maxCount, actionType, requestHandle);
 }
 
 //Helper function that checks a given message type with its request handle for a maximum count and clears the message type for statistics it if it was ok
 //Used for VendorModuleId & WrappedModuleIdU32
-void CheckAndClearStat(PacketStat* stat, MessageType mt, ModuleIdWrapper moduleId, u32 minCount, u32 maxCount, u8 actionType, u8 requestHandle)
+void CheckAndClearStat(std::vector<PacketStat>& stat, MessageType mt, ModuleIdWrapper moduleId, u32 minCount, u32 maxCount, u8 actionType, u8 requestHandle)
 {
-    for (u32 i = 0; i < PACKET_STAT_SIZE; i++) {
-        PacketStat* entry = stat + i;
+    for (size_t i = 0; i < stat.size(); i++) {
+        PacketStat* entry = &stat[i];
         if (entry->messageType == mt) {
             if (moduleId == INVALID_WRAPPED_MODULE_ID || (moduleId == entry->moduleId && actionType == entry->actionType)) {
                 if (entry->count < minCount && entry->requestHandle == requestHandle) SIMEXCEPTION(IllegalStateException);
@@ -101,20 +317,34 @@ void CheckAndClearStat(PacketStat* stat, MessageType mt, ModuleIdWrapper moduleI
     }
 }
 
+//Returns the node with the highest id that is not directly connected to the given node, so that messages have to be relayed
+NodeId FindNodeThatIsNoPartnerOf(CherrySimTester& tester, NodeId nodeId)
+{
+    for (NodeId candidate = tester.sim->GetTotalNodes(); candidate > 0; candidate--) {
+        if (candidate == nodeId) continue;
+        bool isPartner = false;
+        for (BaseConnection* conn : tester.sim->FindNodeById(nodeId)->gs.cm.allConnections) {
+            if (conn != nullptr && conn->partnerId == candidate) isPartner = true;
+        }
+        if (!isPartner) return candidate;
+    }
+    return NODE_ID_INVALID;
+}
+
 //Useful for clearing a statistic e.g. after clustering to only check newly sent packets after some action
-void clearStat(PacketStat* stat)
+void clearStat(std::vector<PacketStat>& stat)
 {
-    for (u32 i = 0; i < PACKET_STAT_SIZE; i++) {
-        PacketStat* entry = stat + i;
+    for (size_t i = 0; i < stat.size(); i++) {
+        PacketStat* entry = &stat[i];
         entry->messageType = MessageType::INVALID;
     }
 }
 
 //After checking and clearing all stat entries we can check if it is empty with this function
-void checkStatEmpty(PacketStat* stat)
+void checkStatEmpty(std::vector<PacketStat>& stat)
 {
-    for (u32 i = 0; i < PACKET_STAT_SIZE; i++) {
-        PacketStat* entry = stat + i;
+    for (size_t i = 0; i < stat.size(); i++) {
+        PacketStat* entry = &stat[i];
         if (entry->messageType != MessageType::INVALID) SIMEXCEPTION(IllegalStateException);
     }
 }
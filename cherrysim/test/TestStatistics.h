@@ -31,11 +31,14 @@
 #include <CherrySimUtils.h>
 
 //Helper function that checks a given message type for a maximum count and clears it if it was ok
-void CheckAndClearStat(PacketStat* stat, MessageType mt, ModuleId moduleId, u32 minCount = 0, u32 maxCount = UINT32_MAX, u8 actionType = 0, u8 requestHandle = 0);
-void CheckAndClearStat(PacketStat* stat, MessageType mt, ModuleIdWrapper moduleId, u32 minCount = 0, u32 maxCount = UINT32_MAX, u8 actionType = 0, u8 requestHandle = 0);
+void CheckAndClearStat(std::vector<PacketStat>& stat, MessageType mt, ModuleId moduleId, u32 minCount = 0, u32 maxCount = UINT32_MAX, u8 actionType = 0, u8 requestHandle = 0);
+void CheckAndClearStat(std::vector<PacketStat>& stat, MessageType mt, ModuleIdWrapper moduleId, u32 minCount = 0, u32 maxCount = UINT32_MAX, u8 actionType = 0, u8 requestHandle = 0);
 
 //After checking and clearing all stat entries we can check if it is empty with this function
-void checkStatEmpty(PacketStat* stat);
+void checkStatEmpty(std::vector<PacketStat>& stat);
 
 //Useful for clearing a statistic e.g. after clustering to only check newly sent packets after some action
-void clearStat(PacketStat* stat);
\ No newline at end of file
+void clearStat(std::vector<PacketStat>& stat);
+
+//Returns a node that is not directly connected to the given node, so that messages have to be relayed
+NodeId FindNodeThatIsNoPartnerOf(CherrySimTester& tester, NodeId nodeId);
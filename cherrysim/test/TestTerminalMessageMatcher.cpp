@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "gtest/gtest.h"
+#include <vector>
+#include <random>
+#include "TerminalMessageMatcher.h"
+#include "CherrySimTester.h"
+
+//Marks the awaited messages in the same way as the tester did before the matcher existed
+static void ProcessLineNaive(std::vector<SimulationMessage>& awaited, NodeId nodeId, const std::string& line, bool useRegex)
+{
+    for (u32 i = 0; i < awaited.size(); i++)
+    {
+        if (!awaited[i].IsFound() && awaited[i].GetNodeId() == nodeId && awaited[i].CheckAndSet(line, useRegex)) break;
+    }
+}
+
+static void CompareWithNaiveMatching(bool useRegex, u32 seed)
+{
+    std::mt19937 rng(seed);
+    const std::vector<std::string> words = { "a", "ab", "abc", "bc", "c", "update", "clusterSize", "handshake", "done", "d" };
+    auto randomWord = [&]() { return words[rng() % words.size()]; };
+
+    std::vector<SimulationMessage> expected;
+    for (u32 i = 0; i < 40; i++)
+    {
+        std::string messagePart;
+        const u32 amountOfWords = rng() % 3;
+        for (u32 k = 0; k < amountOfWords; k++) messagePart += randomWord() + (useRegex && rng() % 4 == 0 ? ".*" : " ");
+        if (useRegex && rng() % 5 == 0) messagePart = "(" + randomWord() + "|" + randomWord() + ")";
+        expected.push_back(SimulationMessage((NodeId)(rng() % 4 + 1), messagePart));
+    }
+    std::vector<SimulationMessage> actual = expected;
+
+    TerminalMessageMatcher matcher;
+    matcher.Compile(actual, useRegex);
+
+    for (u32 i = 0; i < 500 && !matcher.AreAllMessagesFound(); i++)
+    {
+        std::string line;
+        const u32 amountOfWords = rng() % 5;
+        for (u32 k = 0; k < amountOfWords; k++) line += randomWord() + " ";
+        if (rng() % 3 == 0) line += " CRC: 1234";
+        const NodeId nodeId = (NodeId)(rng() % 4 + 1);
+
+        ProcessLineNaive(expected, nodeId, line, useRegex);
+        matcher.ProcessLine(nodeId, line);
+
+        u32 amountOfFoundMessages = 0;
+        for (u32 k = 0; k < expected.size(); k++)
+        {
+            ASSERT_EQ(expected[k].IsFound(), actual[k].IsFound());
+            if (expected[k].IsFound())
+            {
+                ASSERT_EQ(expected[k].GetCompleteMessage(), actual[k].GetCompleteMessage());
+                amountOfFoundMessages++;
+            }
+        }
+        ASSERT_EQ(matcher.GetAmountOfFoundMessages(), amountOfFoundMessages);
+    }
+}
+
+TEST(TestTerminalMessageMatcher, TestMatchesLikeNaiveSearch) {
+    for (u32 seed = 1; seed <= 20; seed++)
+    {
+        CompareWithNaiveMatching(false, seed);
+        CompareWithNaiveMatching(true, seed);
+    }
+}
+
+TEST(TestTerminalMessageMatcher, TestOneMessagePerLine) {
+    std::vector<SimulationMessage> messages;
+    messages.push_back(SimulationMessage(1, "clusterSize"));
+    messages.push_back(SimulationMessage(1, "clusterSize"));
+    messages.push_back(SimulationMessage(2, "clusterSize"));
+
+    TerminalMessageMatcher matcher;
+    matcher.Compile(messages, false);
+
+    ASSERT_TRUE(matcher.ProcessLine(1, "new clusterSize 3 CRC: 42"));
+    ASSERT_TRUE(messages[0].IsFound());
+    ASSERT_FALSE(messages[1].IsFound());
+    ASSERT_EQ(messages[0].GetCompleteMessage(), "new clusterSize 3");
+
+    ASSERT_FALSE(matcher.ProcessLine(3, "new clusterSize 3"));
+    ASSERT_TRUE(matcher.ProcessLine(1, "new clusterSize 4"));
+    ASSERT_FALSE(matcher.AreAllMessagesFound());
+    ASSERT_TRUE(matcher.ProcessLine(2, "clusterSize"));
+    ASSERT_TRUE(matcher.AreAllMessagesFound());
+}
+
+TEST(TestTerminalMessageMatcher, TestExtractRequiredLiteral) {
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("clusterSize"), "clusterSize");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("\\{\"type\":\"status\",\"nodeId\":\\d+"), "{\"type\":\"status\",\"nodeId\":");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("abc*defg"), "defg");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("abcd?ef"), "abc");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("abc+d"), "abc");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("x{2,3}yz"), "yz");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("a(bcdef)?g[hijkl]m"), "a");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("update.*done"), "update");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("ok|failed"), "");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("^\\d+$"), "");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("ab\\x41cd"), "ab");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("abc\\u0041de"), "abc");
+    ASSERT_EQ(TerminalMessageMatcher::ExtractRequiredLiteral("\\cJlineFeed"), "lineFeed");
+}
@@ -29379,23 +29379,102 @@ define("test/tests/mesh/testSimulatorMap", ["require", "exports", "src/app/relut
         startUpdatingDeviceModels(fruityMap, serverUrl, intervalDurationMs);
     }
     function startUpdatingDeviceModels(fruityMap, serverUrl, intervalDurationMs) {
-        let lastDevicesObject = "";
-        setInterval(function () {
-            HttpUtils_5.HttpUtils.getJson(serverUrl + "/devices", function (resultObject) {
+        // The full state is only fetched once (or if the server asks for it), afterwards only the
+        // changes since the last seen sequence number are requested with a long poll.
+        let devicesObject = null;
+        let epoch = 0;
+        let sequence = 0;
+        let applyDevicesObject = function () {
+            let deviceModels = RelutionMapModelLoader_5.RelutionMapModelLoader.loadModels(devicesObject, DeviceModel_9.DeviceModel, false);
+            fruityMap.getBuilding().getCurrentFloor().updateDevices(deviceModels);
+        };
+        let retryLater = function (callback) {
+            setTimeout(callback, intervalDurationMs);
+        };
+        let loadAllDevices = function () {
+            requestJson(serverUrl + "/devices", function (resultObject) {
                 if (resultObject["status"] === "success") {
-                    let devicesObject = resultObject.result;
-                    let stringifiedDevicesObject = JSON.stringify(devicesObject);
-                    if (stringifiedDevicesObject !== lastDevicesObject) {
-                        lastDevicesObject = stringifiedDevicesObject;
-                        let deviceModels = RelutionMapModelLoader_5.RelutionMapModelLoader.loadModels(devicesObject, DeviceModel_9.DeviceModel, false);
-                        fruityMap.getBuilding().getCurrentFloor().updateDevices(deviceModels);
-                    }
+                    devicesObject = resultObject.result;
+                    epoch = resultObject.epoch;
+                    sequence = resultObject.sequence;
+                    applyDevicesObject();
+                    pollChanges();
                 }
                 else {
                     Logger_13.Logger.logDebug("Updating device models not possible.");
+                    retryLater(loadAllDevices);
                 }
+            }, function () {
+                retryLater(loadAllDevices);
             });
-        }, intervalDurationMs);
+        };
+        let pollChanges = function () {
+            requestJson(serverUrl + "/changes?epoch=" + epoch + "&since=" + sequence, function (changesObject) {
+                if (changesObject.resync) {
+                    loadAllDevices();
+                    return;
+                }
+                sequence = changesObject.sequence;
+                let nodes = changesObject.nodes;
+                for (let i = 0; i < nodes.length; i++) {
+                    applyNodeChange(devicesObject[nodes[i].i], nodes[i]);
+                }
+                if (nodes.length > 0) {
+                    applyDevicesObject();
+                }
+                pollChanges();
+            }, function () {
+                retryLater(pollChanges);
+            });
+        };
+        loadAllDevices();
+    }
+    // Applies the compact change of a single node (see FruitySimServer::GenerateChangesJson) to its device object
+    function applyNodeChange(device, change) {
+        if (device === undefined) {
+            return;
+        }
+        if (change.p !== undefined) {
+            device.properties.x = change.p[0];
+            device.properties.y = change.p[1];
+        }
+        if (change.c !== undefined) {
+            device.details.clusterId = change.c[0];
+            device.details.clusterSize = change.c[1];
+            device.details.nodeId = change.c[2];
+        }
+        if (change.n !== undefined) {
+            device.details.connections = change.n.map(function (connection) {
+                return { handle: connection[0], rssi: 7, target: connection[1] };
+            });
+        }
+        if (change.s !== undefined) {
+            device.ledOn = change.s.led;
+            device.details.freeIn = change.s.in;
+            device.details.freeOut = change.s.out;
+            device.inConnectionPartner = change.s.partner;
+            device.inConnectionHasMasterBit = change.s.mb;
+            device.inConnectionPartnerHasMasterBit = change.s.partnerMb;
+            device.inConnectionRssi = change.s.rssi;
+            device.connectionLossCounter = change.s.loss;
+            device.details.lastSentAdvertisingMessage = change.s.adv;
+        }
+    }
+    // Unlike HttpUtils.getJson, failures are reported to the caller so that polling can be retried
+    function requestJson(path, success, failure) {
+        let xhr = new XMLHttpRequest();
+        xhr.onreadystatechange = function () {
+            if (xhr.readyState === XMLHttpRequest.DONE) {
+                if (xhr.status === 200) {
+                    success(JSON.parse(xhr.responseText));
+                }
+                else {
+                    failure();
+                }
+            }
+        };
+        xhr.open("GET", path, true);
+        xhr.send();
     }
 });
 define("test/tests/relution/testPortalDefault", ["require", "exports", "src/app/portal/PortalMap", "src/map/utils/Logger", "test/utils/HttpUtils", "src/app/relution/model/device/DeviceModel", "src/app/relution/model/floor/FloorModelLoader", "src/index", "src/app/relution/model/RelutionMapModelLoader"], function (require, exports, PortalMap_4, Logger_14, HttpUtils_6, DeviceModel_10, FloorModelLoader_6, fruitymap_1, RelutionMapModelLoader_6) {
@@ -129,6 +129,10 @@ void Conf::LoadDefaults(){
     terminalMode = TerminalMode::JSON;
 
     enableSinkRouting = true;
+    enableUnicastRouting = true;
+    enableCutThroughForwarding = true;
+    enableMessageAggregation = true;
+    messageAggregationHoldOffMs = 30; //Two mesh connection intervals
     //Check if the BLE stack supports the number of connections and correct if not
 #ifdef SIM_ENABLED
     totalInConnections = 3;
@@ -166,6 +166,17 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 #define CONNECTION_QUEUE_MEMORY_MAX_CHUNKS_PER_CONNECTION 25
 #endif
 
+// Each send queue keeps the positions of its first packets so that they can be accessed in constant time.
+// Every indexed packet uses 2 bytes, one slot of the index stays unused. Packets behind the indexed ones
+// are found by walking through the queue. See: ChunkedPacketQueue
+#ifndef CHUNKED_PACKET_QUEUE_INDEX_SIZE
+#ifdef SIM_ENABLED
+#define CHUNKED_PACKET_QUEUE_INDEX_SIZE 256
+#else
+#define CHUNKED_PACKET_QUEUE_INDEX_SIZE 32
+#endif
+#endif
+
 // Each connection does also have a buffer to assemble packets that were split into 20 byte chunks
 // This is the maximum size that these packets can have
 #ifndef PACKET_REASSEMBLY_BUFFER_SIZE
@@ -254,6 +265,18 @@ static_assert(false, "Featureset was not defined, which is mandatory!");
 #define ACTIVATE_TRACE 1
 #endif
 
+// Send logt output of the prompt mode in a binary format that is decoded on the host
+// This avoids formatting on the node and saves most of the transport bandwidth, see Logger.adoc
+#ifndef ACTIVATE_BINARY_LOGGING
+#define ACTIVATE_BINARY_LOGGING 0
+#endif
+
+//The simulator needs the text output of all nodes
+#ifdef SIM_ENABLED
+#undef ACTIVATE_BINARY_LOGGING
+#define ACTIVATE_BINARY_LOGGING 0
+#endif
+
 // ########### Log Transport ##########################################
 // Define which method for input and output should be used
 
@@ -434,6 +457,14 @@ class Conf
         TerminalMode terminalMode : 8;
 
         bool enableSinkRouting = false;
+        //Packets for a specific node are only sent through the connection that the node was last heard on
+        bool enableUnicastRouting = false;
+        //Relay nodes forward split messages split by split instead of reassembling them first
+        bool enableCutThroughForwarding = false;
+        //Small messages of the same priority are packed into a single write if the partner supports it
+        bool enableMessageAggregation = false;
+        //Maximum time that a partly filled aggregated write is held back while other writes are still in flight
+        u16 messageAggregationHoldOffMs = 0;
         // ########### TIMINGS ################################################
 
         //Mesh connection parameters (used when a connection is set up)
@@ -526,17 +557,19 @@ class Conf
 
 // Linker variables
 #if defined(SIM_ENABLED)
-    extern u32 __application_start_address;
-    extern u32 __application_end_address;
-    extern u32 __application_ram_start_address;
-    extern u32 __start_conn_type_resolvers;
-    extern u32 __stop_conn_type_resolvers;
+    //Set by the simulator for the node under simulation, see SystemTest.h
+    extern SIM_THREAD_LOCAL u32 __application_start_address;
+    extern SIM_THREAD_LOCAL u32 __application_end_address;
+    extern SIM_THREAD_LOCAL u32 __application_ram_start_address;
+    extern SIM_THREAD_LOCAL u32 __start_conn_type_resolvers;
+    extern SIM_THREAD_LOCAL u32 __stop_conn_type_resolvers;
 #else
     extern u32 __application_start_address[]; //Variable is set in the linker script
     extern u32 __application_end_address[]; //Variable is set in the linker script
     extern u32 __application_ram_start_address[]; //Variable is set in the linker script
     extern u32 __start_conn_type_resolvers[];
     extern u32 __stop_conn_type_resolvers[];
+    extern const char __start_binary_log_formats[]; //Variable is set in the linker script
 #endif
 
 //Alright, I know this is bad, but it's for readability....
@@ -510,6 +510,11 @@ void ProcessAppEvents()
     //Check if there is input on uart
     GS->terminal.CheckAndProcessLine();
 
+#if IS_ACTIVE(BINARY_LOGGING)
+    //Send the log output that was collected while processing the previous events
+    GS->logger.FlushBinaryLog();
+#endif
+
 #if IS_ACTIVE(BUTTONS)
     //Handle waiting button event
     if(GS->button1HoldTimeDs != 0){
@@ -535,15 +540,21 @@ void ProcessAppEvents()
 #if defined(SIM_ENABLED)
 void FruityHal::EventLooper()
 {
+    SIM_PROFILE_SCOPE("EventLooper");
+
     //TODO: We could execute this in a separate thread as this will typically be interrupted by interrupts
     //Call all main context handlers
     for (u32 i = 0; i < GS->numMainContextHandlers; i++)
     {
+        SIM_PROFILE_SCOPE("MainContextHandlers");
         GS->mainContextHandlers[i]();
     }
 
     //Check for waiting events from the application
-    ProcessAppEvents();
+    {
+        SIM_PROFILE_SCOPE("AppEvents");
+        ProcessAppEvents();
+    }
 
     while (true)
     {
@@ -558,6 +569,7 @@ void FruityHal::EventLooper()
         //Handle ble event event
         if (err == NRF_SUCCESS)
         {
+            SIM_PROFILE_SCOPE("BleEvents");
 #ifndef SIM_ENABLED
       FruityHal::DispatchBleEvents((void*)currentEventBuffer);
 #else
@@ -585,6 +597,7 @@ void FruityHal::EventLooper()
         if (err == NRF_ERROR_NOT_FOUND){
             break;
         } else {
+            SIM_PROFILE_SCOPE("SocEvents");
             ::DispatchSystemEvents(nrfSystemEventToGeneric(evt_id)); // Call handler
         }
     }
@@ -2460,6 +2473,7 @@ void FruityHal::GpioPinSet(u32 pin)
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led1Pin) cherrySimInstance->currentNode->led1On = true;
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led2Pin) cherrySimInstance->currentNode->led2On = true;
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led3Pin) cherrySimInstance->currentNode->led3On = true;
+    cherrySimInstance->NotifyMapStateChanged(cherrySimInstance->currentNode->index);
 #endif
 }
 
@@ -2471,6 +2485,7 @@ void FruityHal::GpioPinClear(u32 pin)
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led1Pin) cherrySimInstance->currentNode->led1On = false;
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led2Pin) cherrySimInstance->currentNode->led2On = false;
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led3Pin) cherrySimInstance->currentNode->led3On = false;
+    cherrySimInstance->NotifyMapStateChanged(cherrySimInstance->currentNode->index);
 #endif
 }
 
@@ -2488,6 +2503,7 @@ void FruityHal::GpioPinToggle(u32 pin)
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led1Pin) cherrySimInstance->currentNode->led1On = !cherrySimInstance->currentNode->led1On;
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led2Pin) cherrySimInstance->currentNode->led2On = !cherrySimInstance->currentNode->led2On;
     if ((int8_t)pin == cherrySimInstance->currentNode->gs.boardconf.configuration.led3Pin) cherrySimInstance->currentNode->led3On = !cherrySimInstance->currentNode->led2On;
+    cherrySimInstance->NotifyMapStateChanged(cherrySimInstance->currentNode->index);
 #endif
 }
 
@@ -162,21 +162,52 @@ void BaseConnection::FillTransmitBuffers()
             return;
         }
         //Check if there is important data from the subclass to be sent
-        if(queue.IsCurrentlySendingSplitMessage() == false){
+        if(queue.IsCurrentlySendingSplitMessage() == false || queue.IsWaitingForOpenSplitMessage()){
             QueueVitalPrioData();
         }
         //Next, select the correct Queue from which we should be transmitting
+        //The priority droplet is only consumed once we know that we transmit from this queue
         QueuePriorityPair queuePriorityPair = queue.GetSendQueue();
         ChunkedPacketQueue* activeQueue = queuePriorityPair.queue;
         if (!activeQueue) return;
 
         //Get the next packet from the packet queue that was not yet queued
-        DYNAMIC_ARRAY(queueBuffer, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
-        const u16 packetLength = activeQueue->PeekLookAhead(queueBuffer, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED) - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED;
+        //It is sent straight from the queue memory, which stays valid until the packet was sent
+        u8* queuedPacket = nullptr;
+        const u16 queuedLength = activeQueue->PeekLookAheadInPlace(&queuedPacket, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
+        if (queuedPacket == nullptr || queuedLength <= SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED) return;
+        u16 packetLength = queuedLength - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED;
 
         //Unpack data from sendQueue
-        BaseConnectionSendDataPacked* sendDataPacked = (BaseConnectionSendDataPacked*)queueBuffer;
-        u8* data = (queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
+        const BaseConnectionSendDataPacked* sendDataPacked = (const BaseConnectionSendDataPacked*)queuedPacket;
+        u8* data = (queuedPacket + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
+
+        //Small messages that follow in the same queue are sent together with this one if possible
+        //Vital messages are always sent on their own so that they are never held back
+        //The messages are only counted first so that a single message needs no buffer of its own
+        u8 amountOfMessages = 1;
+        bool hasSpaceLeft = false;
+        if (CanAggregateMessages() && queuePriorityPair.priority != DeliveryPriority::VITAL)
+        {
+            u16 aggregatedLength = packetLength;
+            amountOfMessages = AggregateMessages(activeQueue, sendDataPacked, &aggregatedLength, nullptr, &hasSpaceLeft);
+            if (hasSpaceLeft && ShouldHoldOffAggregation()) return;
+        }
+        queue.ConsumePriorityDroplet(queuePriorityPair.priority);
+
+        //Aggregated writes and packets that are modified before sending need a buffer of their own
+        const bool requiresTransmitBuffer = RequiresTransmitBuffer();
+        DYNAMIC_ARRAY(transmitBuffer, (amountOfMessages > 1 || requiresTransmitBuffer) ? connectionMtu : 1);
+        if (amountOfMessages > 1)
+        {
+            AggregateMessages(activeQueue, sendDataPacked, &packetLength, transmitBuffer, &hasSpaceLeft);
+            data = transmitBuffer;
+        }
+        else if (requiresTransmitBuffer)
+        {
+            CheckedMemcpy(transmitBuffer, data, packetLength);
+            data = transmitBuffer;
+        }
 
         //The subclass is allowed to modify the packet before it is sent, it will place the modified packet into the data buffer.
         //This could be encryption of the data.
@@ -222,8 +253,15 @@ void BaseConnection::FillTransmitBuffers()
             SizedData sizedData;
             sizedData.data = data;
             sizedData.length = processedMessageLength.GetRaw();
-            queueOrigins.Push(queuePriorityPair.priority);
-            activeQueue->IncrementLookAhead();
+            QueueOrigin queueOrigin;
+            queueOrigin.priority = queuePriorityPair.priority;
+            queueOrigin.amountOfMessages = amountOfMessages;
+            queueOrigins.Push(queueOrigin);
+            for (u32 i = 0; i < amountOfMessages; i++) {
+                activeQueue->IncrementLookAhead();
+            }
+            if (amountOfMessages > 1) aggregatedMessages += amountOfMessages;
+            isAggregationHeldOff = false;
             PacketSuccessfullyQueuedWithSoftdevice(&sizedData);
         }
         else if(err == ErrorType::BUSY)
@@ -257,6 +295,98 @@ void BaseConnection::FillTransmitBuffers()
     }
 }
 
+u8 BaseConnection::AggregateMessages(ChunkedPacketQueue* activeQueue, const BaseConnectionSendDataPacked* firstSendData, u16* packetLength, u8* frameBuffer, bool* hasSpaceLeft) const
+{
+    *hasSpaceLeft = false;
+
+    const u8* firstPacket = (const u8*)firstSendData;
+    const u16 bufferSize = connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED;
+    if (!IsAggregatableMessage(firstPacket, *packetLength, firstSendData)) return 1;
+
+    //The aggregated write starts with its header, followed by the length and content of each message
+    u16 frameLength = SIZEOF_CONN_PACKET_AGGREGATE_HEADER;
+    if (frameLength + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER + *packetLength > connectionPayloadSize) return 1;
+    if (frameBuffer != nullptr)
+    {
+        ((ConnPacketAggregateHeader*)frameBuffer)->aggregateMessageType = MessageType::AGGREGATED_WRITE_CMD;
+        ((ConnPacketAggregateEntryHeader*)(frameBuffer + frameLength))->messageLength = (u8)*packetLength;
+        CheckedMemcpy(frameBuffer + frameLength + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER, firstPacket + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, *packetLength);
+    }
+    frameLength += SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER + *packetLength;
+
+    u8 amountOfMessages = 1;
+    bool isQueueExhausted = false;
+    while (amountOfMessages < UINT8_MAX)
+    {
+        u8* nextPacket = nullptr;
+        const u16 nextLength = activeQueue->PeekLookAheadInPlace(&nextPacket, bufferSize, amountOfMessages);
+        if (nextLength == 0)
+        {
+            isQueueExhausted = true;
+            break;
+        }
+        const u16 nextPacketLength = nextLength - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED;
+        if (
+            !IsAggregatableMessage(nextPacket, nextPacketLength, firstSendData)
+            || frameLength + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER + nextPacketLength > connectionPayloadSize
+        ) {
+            break;
+        }
+        if (frameBuffer != nullptr)
+        {
+            ((ConnPacketAggregateEntryHeader*)(frameBuffer + frameLength))->messageLength = (u8)nextPacketLength;
+            CheckedMemcpy(frameBuffer + frameLength + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER, nextPacket + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, nextPacketLength);
+        }
+        frameLength += SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER + nextPacketLength;
+        amountOfMessages++;
+    }
+
+    //Waiting for more messages only makes sense if at least another message header would fit
+    *hasSpaceLeft = isQueueExhausted && frameLength + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER + SIZEOF_CONN_PACKET_HEADER <= connectionPayloadSize;
+
+    //A single message is sent as it is, straight from the queue
+    if (amountOfMessages > 1)
+    {
+        *packetLength = frameLength;
+    }
+
+    return amountOfMessages;
+}
+
+bool BaseConnection::IsAggregatableMessage(const u8* queueBuffer, u16 packetLength, const BaseConnectionSendDataPacked* firstSendData) const
+{
+    const BaseConnectionSendDataPacked* sendDataPacked = (const BaseConnectionSendDataPacked*)queueBuffer;
+    const MessageType messageType = ((const ConnPacketHeader*)(queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED))->messageType;
+
+    return sendDataPacked->deliveryOption == (u8)DeliveryOption::WRITE_CMD
+        && sendDataPacked->characteristicHandle == firstSendData->characteristicHandle
+        && messageType != MessageType::SPLIT_WRITE_CMD
+        && messageType != MessageType::SPLIT_WRITE_CMD_END
+        && messageType != MessageType::AGGREGATED_WRITE_CMD
+        && packetLength >= SIZEOF_CONN_PACKET_HEADER
+        && packetLength <= UINT8_MAX;
+}
+
+bool BaseConnection::ShouldHoldOffAggregation()
+{
+    //Only writes that are still in flight guarantee that we are called again once they are sent
+    if (queueOrigins.GetAmountOfElements() == 0 || GS->config.messageAggregationHoldOffMs == 0)
+    {
+        return false;
+    }
+
+    const u32 currentTimeMs = FruityHal::GetRtcMs();
+    if (!isAggregationHeldOff)
+    {
+        isAggregationHeldOff = true;
+        aggregationHoldOffStartMs = currentTimeMs;
+        return true;
+    }
+
+    //Once the budget is used up, the write is sent even if it is not full
+    return currentTimeMs - aggregationHoldOffStartMs < GS->config.messageAggregationHoldOffMs;
+}
+
 void BaseConnection::HandlePacketQueued()
 {
     packetFailedToQueueCounter = 0;
@@ -294,64 +424,76 @@ void BaseConnection::HandlePacketSent(u8 sentUnreliable, u8 sentReliable)
             return;
         }
 
-        const DeliveryPriority queueOrigin = queueOrigins.Peek();
+        const QueueOrigin queueOrigin = queueOrigins.Peek();
         queueOrigins.Pop();
         //Find the queue from which the packet was sent
-        ChunkedPacketQueue* activeQueue = queue.GetQueueByPriority(queueOrigin);
+        ChunkedPacketQueue* activeQueue = queue.GetQueueByPriority(queueOrigin.priority);
 
-        if(activeQueue->HasPackets() == false)
-        {
-            logt("ERROR", "!!!FATAL!!! Queue");
-            SIMEXCEPTION(IllegalStateException);
+        //An aggregated write carried multiple messages that are all removed from the queue
+        for (u32 k = 0; k < queueOrigin.amountOfMessages; k++) {
+            if(activeQueue->HasPackets() == false)
+            {
+                logt("ERROR", "!!!FATAL!!! Queue");
+                SIMEXCEPTION(IllegalStateException);
 
-            GS->logger.LogCustomError(CustomErrorTypes::FATAL_HANDLE_PACKET_SENT_ERROR, partnerId);
-            DisconnectAndRemove(AppDisconnectReason::HANDLE_PACKET_SENT_ERROR);
-            return;
-        }
-        DYNAMIC_ARRAY(queueBuffer, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
-        u32 messageHandle;
-        const u16 length = activeQueue->PeekPacket(queueBuffer, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, &messageHandle);
+                GS->logger.LogCustomError(CustomErrorTypes::FATAL_HANDLE_PACKET_SENT_ERROR, partnerId);
+                DisconnectAndRemove(AppDisconnectReason::HANDLE_PACKET_SENT_ERROR);
+                return;
+            }
+            DYNAMIC_ARRAY(queueBuffer, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
+            u32 messageHandle;
+            const u16 length = activeQueue->PeekPacket(queueBuffer, connectionMtu + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, &messageHandle);
 
-        BaseConnectionSendDataPacked* sendData = (BaseConnectionSendDataPacked*)queueBuffer;
+            BaseConnectionSendDataPacked* sendData = (BaseConnectionSendDataPacked*)queueBuffer;
 
 #ifdef SIM_ENABLED
-        //A quick check if a wrong packet was removed (not a 100% check, but helps)
-        if (sendData->deliveryOption == (u8)DeliveryOption::WRITE_REQ && !sentReliable) {
-            SIMEXCEPTION(IllegalStateException);
-        }
+            //A quick check if a wrong packet was removed (not a 100% check, but helps)
+            if (sendData->deliveryOption == (u8)DeliveryOption::WRITE_REQ && !sentReliable) {
+                SIMEXCEPTION(IllegalStateException);
+            }
 #endif
-        if (messageHandle == 0)
-        {
-            CheckedMemcpy(&dataSentBuffer[dataSentLength], queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
-            dataSentLength += (length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
-            activeQueue->PopPacket();
-            continue;
-        }
+            //Splits of a forwarded message that was abandoned before its end are never completed,
+            //so whatever was collected so far is discarded once the next message starts
+            const ConnPacketSplitHeader* splitHeader = (const ConnPacketSplitHeader*)(queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
+            const bool isSplitPacket = splitHeader->splitMessageType == MessageType::SPLIT_WRITE_CMD || splitHeader->splitMessageType == MessageType::SPLIT_WRITE_CMD_END;
+            if (!isSplitPacket || splitHeader->splitCounter == 0)
+            {
+                dataSentLength = 0;
+            }
 
-        if (dataSentLength != 0)
-        {
-            CheckedMemcpy(&dataSentBuffer[dataSentLength], queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
-            dataSentLength += (length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
-            DataSentHandler(dataSentBuffer, dataSentLength, messageHandle);
+            if (messageHandle == 0)
+            {
+                CheckedMemcpy(&dataSentBuffer[dataSentLength], queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
+                dataSentLength += (length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
+                activeQueue->PopPacket();
+                continue;
+            }
+
+            if (dataSentLength != 0)
+            {
+                CheckedMemcpy(&dataSentBuffer[dataSentLength], queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
+                dataSentLength += (length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED - SIZEOF_CONN_PACKET_SPLIT_HEADER);
+                DataSentHandler(dataSentBuffer, dataSentLength, messageHandle);
 #ifdef SIM_ENABLED
-            char stringBuffer[1000];
-            Logger::ConvertBufferToBase64String(dataSentBuffer, dataSentLength, stringBuffer, sizeof(stringBuffer));
-            logt("CONN", "DataSentHandler: %s", stringBuffer);
+                char stringBuffer[1000];
+                Logger::ConvertBufferToBase64String(dataSentBuffer, dataSentLength, stringBuffer, sizeof(stringBuffer));
+                logt("CONN", "DataSentHandler: %s", stringBuffer);
 #endif
-        }
-        else
-        {
-            DataSentHandler(queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, messageHandle);
+            }
+            else
+            {
+                DataSentHandler(queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, messageHandle);
 #ifdef SIM_ENABLED
-            char stringBuffer[1000];
-            Logger::ConvertBufferToBase64String(queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, stringBuffer, sizeof(stringBuffer));
-            logt("CONN", "DataSentHandler: %s", stringBuffer);
+                char stringBuffer[1000];
+                Logger::ConvertBufferToBase64String(queueBuffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, length - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, stringBuffer, sizeof(stringBuffer));
+                logt("CONN", "DataSentHandler: %s", stringBuffer);
 #endif
-        }
+            }
 
 
-        activeQueue->PopPacket();
-        dataSentLength = 0;
+            activeQueue->PopPacket();
+            dataSentLength = 0;
+        }
     }
 
     //Log how many packets have been sent
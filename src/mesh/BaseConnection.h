@@ -144,6 +144,13 @@ enum class EncryptionState : u8{
     ENCRYPTED=2
 };
 
+//Remembers from which queue a write was taken until the HAL reports it as sent
+struct QueueOrigin
+{
+    DeliveryPriority priority;
+    u8 amountOfMessages; //More than one if several messages were aggregated into a single write
+};
+
 /*
  * The BaseConnection is the root class for all BLE connections used within FruityMesh.
  * It includes some basic functionality for packet queuing, sending and receiving and also for state management.
@@ -153,6 +160,14 @@ class BaseConnection
 {
     private: 
         bool currentMessageIsMissingASplit = false;
+        bool isAggregationHeldOff = false;
+        u32 aggregationHoldOffStartMs = 0;
+
+        //Packs the messages that follow the looked ahead one into a single write as long as they fit
+        //Without a frameBuffer, the messages that would fit are only counted
+        u8 AggregateMessages(ChunkedPacketQueue* activeQueue, const BaseConnectionSendDataPacked* firstSendData, u16* packetLength, u8* frameBuffer, bool* hasSpaceLeft) const;
+        bool IsAggregatableMessage(const u8* queueBuffer, u16 packetLength, const BaseConnectionSendDataPacked* firstSendData) const;
+        bool ShouldHoldOffAggregation();
     protected:
         DeliveryPriority overwritePriority = DeliveryPriority::INVALID;
         u8 dataSentBuffer[MAX_MESH_PACKET_SIZE];
@@ -190,6 +205,10 @@ class BaseConnection
         virtual bool SendData(u8 const * data, MessageLength dataLength, bool reliable, u32 * messageHandle) = 0;
         //Allow a subclass to transmit data before the writeQueue is processed
         virtual bool QueueVitalPrioData() { return false; };
+        //Allows a subclass to send multiple small messages in a single AGGREGATED_WRITE_CMD write
+        virtual bool CanAggregateMessages() const { return false; };
+        //Must return true if ProcessDataBeforeTransmission modifies the data, which is then copied out of the queue first
+        virtual bool RequiresTransmitBuffer() const { return false; };
         //Allows a subclass to process data closely before sending it
         virtual MessageLength ProcessDataBeforeTransmission(u8* message, MessageLength messageLength, MessageLength bufferLength);
         //Called after data has been queued in the softdevice, pay attention that data points to the full packet in the queue
@@ -200,6 +219,7 @@ class BaseConnection
         //Gets passed the exact same data that was passed to the HAL. If that data was encrypted, the passed data
         //to this function is encrypted as well (e.g. in the MeshAccessConnection). This means that the data passed
         //to this function is the same as was returned by ProcessDataBeforeTransmission.
+        //Messages that were sent as part of an aggregated write are passed one by one.
         virtual void DataSentHandler(const u8* data, MessageLength length, u32 messageHandle) {};
 
         //Calls GetPriorityOfMessage of all modules to determine the priority of the message.
@@ -260,7 +280,7 @@ class BaseConnection
         bool bufferFull = false; //Set to true once the softdevice reports that all buffers are full
         u8 manualPacketsSent = 0; //Used to count the packets manually sent to the softdevice using BleWriteCharacteristic, will be decremented first before packets from the queue are removed. Packets must not be sent while the queue is working
 
-        SimpleQueue<DeliveryPriority, 32> queueOrigins;
+        SimpleQueue<QueueOrigin, 32> queueOrigins;
         ChunkedPriorityPacketQueue queue;
 
         u32 packetFailedToQueueCounter = 0;
@@ -283,6 +303,7 @@ class BaseConnection
         u16 droppedPackets = 0;
         u16 sentReliable = 0;
         u16 sentUnreliable = 0;
+        u16 aggregatedMessages = 0; //Messages that were sent as part of an aggregated write
 
         static u32 GetAmountOfRemovedConnections();
 };
@@ -491,6 +491,11 @@ ErrorType ConnectionManager::SendMeshMessageInternal(u8* data, u16 dataLength, b
             }
         }
 
+        //If the receiver is not our partner, we might have learned through which connection it can be reached
+        if (!receiverConn) {
+            receiverConn = GetMeshRoute(packetHeader->receiver, nullptr);
+        }
+
         //Send to receiver or broadcast if not directly connected to us
         if(receiverConn){
             bool result = receiverConn.SendData(data, dataLength, reliable);
@@ -547,6 +552,7 @@ void ConnectionManager::DispatchMeshMessage(BaseConnection* connection, BaseConn
                         connectionToSendToModules = nullptr;
                     }
                 }
+                SIM_PROFILE_MODULE_SCOPE(GS->activeModules[i]->moduleName, "MeshMessageReceivedHandler");
                 GS->activeModules[i]->MeshMessageReceivedHandler(connectionToSendToModules, sendData, packet);
             }
         }
@@ -764,6 +770,7 @@ void ConnectionManager::RouteMeshData(BaseConnection* connection, BaseConnection
     RoutingDecision routingDecision = 0;
     for (u32 i = 0; i < GS->amountOfModules; i++) {
         if (GS->activeModules[i]->configurationPointer->moduleActive) {
+            SIM_PROFILE_MODULE_SCOPE(GS->activeModules[i]->moduleName, "MessageRoutingInterceptor");
             routingDecision |= GS->activeModules[i]->MessageRoutingInterceptor(connection, sendData, packetHeader);
         }
     }
@@ -813,8 +820,27 @@ void ConnectionManager::RouteMeshData(BaseConnection* connection, BaseConnection
         if(packetHeader->messageType != MessageType::CLUSTER_INFO_UPDATE
             && packetHeader->messageType != MessageType::UPDATE_TIMESTAMP)
         {
-            //Send to all other connections
-            BroadcastMeshData(connection, sendData, (const u8*)packetHeader, routingDecision);
+            //Packets for a specific node are only sent through the connection that leads to it if we know it
+            MeshConnectionHandle route;
+            if (!(routingDecision & ROUTING_DECISION_BLOCK_TO_MESH))
+            {
+                route = GetMeshRoute(packetHeader->receiver, connection);
+            }
+
+            if (route)
+            {
+                MeshConnection* routeConnection = route.GetConnection();
+                sendData->characteristicHandle = routeConnection->partnerWriteCharacteristicHandle;
+                routeConnection->SendData(sendData, (const u8*)packetHeader);
+
+                //MeshAccess connections are still served as before
+                BroadcastMeshData(connection, sendData, (const u8*)packetHeader, routingDecision | ROUTING_DECISION_BLOCK_TO_MESH);
+            }
+            else
+            {
+                //Send to all other connections
+                BroadcastMeshData(connection, sendData, (const u8*)packetHeader, routingDecision);
+            }
         }
     }
 }
@@ -845,6 +871,141 @@ void ConnectionManager::BroadcastMeshData(const BaseConnection* ignoreConnection
     }
 }
 
+void ConnectionManager::LearnMeshRoute(const MeshConnection* connection, NodeId sender)
+{
+    if (
+        !GS->config.enableUnicastRouting
+        || connection == nullptr
+        || connection->connectionState < ConnectionState::HANDSHAKE_DONE
+        || sender < NODE_ID_DEVICE_BASE
+        || sender >= NODE_ID_DEVICE_BASE + NODE_ID_DEVICE_BASE_SIZE
+        || sender == GS->node.configuration.nodeId
+    ) {
+        return;
+    }
+
+    //Refresh the existing route, otherwise use an empty entry or replace the oldest one
+    MeshRoute* entry = &meshRoutes[0];
+    for (u32 i = 0; i < MESH_ROUTING_TABLE_SIZE; i++) {
+        if (meshRoutes[i].nodeId == sender) {
+            entry = &meshRoutes[i];
+            break;
+        }
+        if (entry->nodeId == NODE_ID_BROADCAST) continue;
+        if (meshRoutes[i].nodeId == NODE_ID_BROADCAST || meshRoutes[i].learnedTimestampDs < entry->learnedTimestampDs) {
+            entry = &meshRoutes[i];
+        }
+    }
+
+    entry->nodeId = sender;
+    entry->hops = sender == connection->partnerId ? 1 : MESH_ROUTE_HOPS_UNKNOWN;
+    entry->uniqueConnectionId = connection->uniqueConnectionId;
+    entry->learnedTimestampDs = GS->appTimerDs;
+}
+
+void ConnectionManager::InvalidateMeshRoutes(u32 uniqueConnectionId)
+{
+    for (u32 i = 0; i < MESH_ROUTING_TABLE_SIZE; i++) {
+        if (meshRoutes[i].uniqueConnectionId == uniqueConnectionId) {
+            meshRoutes[i] = MeshRoute();
+        }
+    }
+}
+
+void ConnectionManager::ClearMeshRoutes()
+{
+    for (u32 i = 0; i < MESH_ROUTING_TABLE_SIZE; i++) {
+        meshRoutes[i] = MeshRoute();
+    }
+}
+
+MeshConnectionHandle ConnectionManager::FindMeshRoute(NodeId nodeId, const BaseConnection* excludeConnection) const
+{
+    for (u32 i = 0; i < MESH_ROUTING_TABLE_SIZE; i++) {
+        const MeshRoute& route = meshRoutes[i];
+        if (route.nodeId != nodeId) continue;
+
+        if (GS->appTimerDs - route.learnedTimestampDs > MESH_ROUTE_MAX_AGE_DS) break;
+
+        //A route back to where the packet came from is outdated, the packet is broadcasted instead
+        MeshConnectionHandle conn(route.uniqueConnectionId);
+        if (conn && conn.IsHandshakeDone() && conn.GetConnection() != excludeConnection) {
+            return conn;
+        }
+        break;
+    }
+
+    return MeshConnectionHandle();
+}
+
+MeshConnectionHandle ConnectionManager::GetMeshRoute(NodeId nodeId, const BaseConnection* excludeConnection) const
+{
+    //Only nodes of our own mesh are learned, everything else is broadcasted
+    if (
+        !GS->config.enableUnicastRouting
+        || nodeId < NODE_ID_DEVICE_BASE
+        || nodeId >= NODE_ID_DEVICE_BASE + NODE_ID_DEVICE_BASE_SIZE
+    ) {
+        return MeshConnectionHandle();
+    }
+
+    MeshConnectionHandle conn = FindMeshRoute(nodeId, excludeConnection);
+    if (conn) {
+        meshRouteHits++;
+    }
+    else {
+        meshRouteMisses++;
+    }
+    return conn;
+}
+
+MeshConnectionHandle ConnectionManager::GetCutThroughConnection(BaseConnection* connection, ConnPacketHeader const * packetHeader) const
+{
+    //Receivers of the message and packets that are not routed must wait for the whole message
+    if (
+        !GS->config.enableCutThroughForwarding
+        || IsReceiverOfNodeId(packetHeader->receiver)
+        || packetHeader->messageType == MessageType::CLUSTER_INFO_UPDATE
+        || packetHeader->messageType == MessageType::UPDATE_TIMESTAMP
+    ) {
+        return MeshConnectionHandle();
+    }
+
+    //A forwarded message never passes the MessageRoutingInterceptor as a whole, so every module that
+    //intercepts routed messages must allow it, otherwise the message is stored and forwarded
+    for (u32 i = 0; i < GS->amountOfModules; i++) {
+        Module* module = GS->activeModules[i];
+        if (
+            module->configurationPointer->moduleActive
+            && module->HasMessageRoutingInterceptor()
+            && !module->AllowsCutThroughForwarding(connection, packetHeader)
+        ) {
+            return MeshConnectionHandle();
+        }
+    }
+
+    //Only messages that travel through a single connection can be forwarded before they are complete
+    MeshConnectionHandle conn;
+    if (packetHeader->receiver == NODE_ID_SHORTEST_SINK) {
+        if (GS->config.enableSinkRouting) conn = GetMeshConnectionToShortestSink(connection);
+    }
+    else if (
+        GS->config.enableUnicastRouting
+        && packetHeader->receiver >= NODE_ID_DEVICE_BASE
+        && packetHeader->receiver < NODE_ID_DEVICE_BASE + NODE_ID_DEVICE_BASE_SIZE
+    ) {
+        conn = FindMeshRoute(packetHeader->receiver, connection);
+    }
+
+    //Only one message at a time can be forwarded through a connection
+    if (!conn || conn.GetConnection()->queue.HasOpenSplitMessage()) {
+        return MeshConnectionHandle();
+    }
+
+    if (packetHeader->receiver != NODE_ID_SHORTEST_SINK) meshRouteHits++;
+    return conn;
+}
+
 bool ConnectionManager::IsReceiverOfNodeId(NodeId nodeId) const
 {
     //Check if we are part of the firmware group that should receive this image
@@ -887,6 +1048,8 @@ u32 ConnectionManager::MessageTypeToMinimumPacketSize(MessageType messageType)
         return SIZEOF_CONN_PACKET_SPLIT_HEADER;
     case MessageType::SPLIT_WRITE_CMD_END:
         return SIZEOF_CONN_PACKET_SPLIT_HEADER;
+    case MessageType::AGGREGATED_WRITE_CMD:
+        return SIZEOF_CONN_PACKET_AGGREGATE_HEADER;
     case MessageType::CLUSTER_WELCOME:
         return SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME;
     case MessageType::CLUSTER_ACK_1:
@@ -1515,6 +1678,11 @@ void ConnectionManager::TimerEventHandler(u16 passedTimeDs)
             //The average rssi is caluclated using a moving average with 5% influece per time step
             conn->rssiAverageTimes1000 = (95 * (i32)conn->rssiAverageTimes1000 + 5000 * (i32)conn->lastReportedRssi) / 100;
 
+            //A split message that is forwarded while being received blocks its outgoing connection until it is complete
+            if (conn->connectionType == ConnectionType::FRUITYMESH) {
+                ((MeshConnection*)conn)->CheckCutThroughTimeout();
+            }
+
             //Check if an implementation failure did not clear the pending connection
             //FIXME: Should use a timeout stored in the connection as we do not know what connectingTimout this connection has
             if (pendingConnection != nullptr)
@@ -57,6 +57,16 @@ struct MeshAccessConnections
     MeshAccessConnectionHandle handles[TOTAL_NUM_CONNECTIONS];
 };
 
+//A route to a node of our cluster that was learned from the sender of a received packet.
+//As a cluster is a tree, each node is only reachable through exactly one of our mesh connections.
+struct MeshRoute
+{
+    NodeId nodeId = NODE_ID_BROADCAST; //NODE_ID_BROADCAST marks an empty entry
+    u8 hops = 0; //1 for our direct partner, MESH_ROUTE_HOPS_UNKNOWN otherwise as packets carry no hop count
+    u32 uniqueConnectionId = 0;
+    u32 learnedTimestampDs = 0;
+};
+
 
 typedef BaseConnection* (*ConnTypeResolver)(BaseConnection* oldConnection, BaseConnectionSendData* sendData, u8 const * data);
 
@@ -91,9 +101,18 @@ private:
     BaseConnection* GetRawConnectionByUniqueId(u32 uniqueConnectionId) const;
     BaseConnection* GetRawConnectionFromHandle(u16 connectionHandle) const;
 
+    //Routes are refreshed with every packet from that node and forgotten if not refreshed in time
+    static constexpr u32 MESH_ROUTE_MAX_AGE_DS = SEC_TO_DS(60);
+
+    MeshConnectionHandle FindMeshRoute(NodeId nodeId, const BaseConnection* excludeConnection) const;
+
 TESTER_PUBLIC:
     BaseConnection* allConnections[TOTAL_NUM_CONNECTIONS];
 
+    static constexpr u8 MESH_ROUTING_TABLE_SIZE = 32;
+    static constexpr u8 MESH_ROUTE_HOPS_UNKNOWN = 0xFF;
+    MeshRoute meshRoutes[MESH_ROUTING_TABLE_SIZE];
+
 
 
 public:
@@ -113,6 +132,14 @@ public:
     u16 sentMeshPacketsUnreliable = 0;
     u16 sentMeshPacketsReliable = 0;
 
+    //Counts how often a packet for a specific node could be sent using a learned route
+    //and how often it had to be broadcasted because no route was known
+    mutable u16 meshRouteHits = 0;
+    mutable u16 meshRouteMisses = 0;
+
+    //Counts the split messages that were completely forwarded split by split without reassembling them first
+    u16 cutThroughForwardedMessages = 0;
+
     //ConnectionType Resolving
     void ResolveConnection(BaseConnection* oldConnection, BaseConnectionSendData* sendData, u8 const * data);
 
@@ -157,6 +184,17 @@ public:
     void RouteMeshData(BaseConnection* connection, BaseConnectionSendData* sendData, u8 const * data) const;
     void BroadcastMeshData(const BaseConnection* ignoreConnection, BaseConnectionSendData* sendData, u8 const * data, RoutingDecision routingDecision) const;
 
+    //Learned unicast routing, packets for a node are only sent through the connection that the node was last heard on
+    void LearnMeshRoute(const MeshConnection* connection, NodeId sender);
+    void InvalidateMeshRoutes(u32 uniqueConnectionId);
+    void ClearMeshRoutes();
+    //Returns the connection of a valid route to the given node or an invalid handle if the packet must be broadcasted
+    MeshConnectionHandle GetMeshRoute(NodeId nodeId, const BaseConnection* excludeConnection) const;
+
+    //Returns the only connection that a split message must be forwarded to if it can already be forwarded
+    //while it is being received, the packetHeader is taken from the first split
+    MeshConnectionHandle GetCutThroughConnection(BaseConnection* connection, ConnPacketHeader const * packetHeader) const;
+
     //Whether or not the node should receive and dispatch messages that are sent to the given nodeId
     bool IsReceiverOfNodeId(NodeId nodeId) const;
 
@@ -397,6 +397,7 @@ void DispatchTimerEvents(u16 passedTimeDs)
     //Dispatch event to all modules
     for(u32 i=0; i<GS->amountOfModules; i++){
         if(GS->activeModules[i]->configurationPointer->moduleActive){
+            SIM_PROFILE_MODULE_SCOPE(GS->activeModules[i]->moduleName, "TimerEventHandler");
             GS->activeModules[i]->TimerEventHandler(passedTimeDs);
         }
     }
@@ -412,6 +413,7 @@ void DispatchEvent(const FruityHal::GapAdvertisementReportEvent & e)
     ScanController::GetInstance().ScanEventHandler(e);
     for (u32 i = 0; i < GS->amountOfModules; i++) {
         if (GS->activeModules[i]->configurationPointer->moduleActive) {
+            SIM_PROFILE_MODULE_SCOPE(GS->activeModules[i]->moduleName, "GapAdvertisementReportEventHandler");
             GS->activeModules[i]->GapAdvertisementReportEventHandler(e);
         }
     }
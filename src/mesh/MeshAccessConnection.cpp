@@ -761,6 +761,12 @@ bool MeshAccessConnection::DecryptPacket(u8 const * data, u8 * decryptedOut, Mes
 
 #define ________________________SEND________________________
 
+//Encrypted packets are extended by the MIC and can't be encrypted inside the queue
+bool MeshAccessConnection::RequiresTransmitBuffer() const
+{
+    return encryptionState == EncryptionState::ENCRYPTED;
+}
+
 //This function might modify the packet, can also split bigger packets
 MessageLength MeshAccessConnection::ProcessDataBeforeTransmission(u8* message, MessageLength messageLength, MessageLength bufferLength)
 {
@@ -156,6 +156,7 @@ public:
 
 
     /*############### Sending ##################*/
+    bool RequiresTransmitBuffer() const override final;
     MessageLength ProcessDataBeforeTransmission(u8* message, MessageLength messageLength, MessageLength bufferLength) override final;
     bool SendData(BaseConnectionSendData* sendData, u8 const * data, u32 * messageHandle=nullptr);
     bool SendData(u8 const * data, MessageLength dataLength, bool reliable, u32 * messageHandle=nullptr) override final;
@@ -69,6 +69,8 @@ MeshConnection::MeshConnection(u8 id, ConnectionDirection direction, FruityHal::
 MeshConnection::~MeshConnection(){
     logt("CONN", "Deleted MeshConnection because %u", (u32)appDisconnectionReason);
 
+    AbandonCutThrough();
+
     if (direction == ConnectionDirection::DIRECTION_IN) {
         GS->cm.freeMeshInConnections++;
     }
@@ -139,6 +141,12 @@ void MeshConnection::DisconnectAndRemove(AppDisconnectReason reason)
         }
     }
 
+    //Nodes behind this connection are no longer reachable through it
+    GS->cm.InvalidateMeshRoutes(uniqueConnectionId);
+
+    //The rest of a message that we are forwarding will not arrive anymore
+    AbandonCutThrough();
+
     //WARNING: Make sure to not send packets before the connection was removed as this will result
     //in an infinite loop, causing a stack overflow
 
@@ -472,6 +480,13 @@ void MeshConnection::PacketSuccessfullyQueuedWithSoftdevice(SizedData* sentData)
     }
 }
 
+bool MeshConnection::CanAggregateMessages() const
+{
+    return GS->config.enableMessageAggregation
+        && partnerSupportsMessageAggregation
+        && connectionState == ConnectionState::HANDSHAKE_DONE;
+}
+
 void MeshConnection::DataSentHandler(const u8 * data, MessageLength length, u32 messageHandle)
 {
     const ConnPacketHeader* header = (const ConnPacketHeader*)data;
@@ -500,6 +515,13 @@ void MeshConnection::ReceiveDataHandler(BaseConnectionSendData* sendData, u8 con
         return;
     }
 
+    //Aggregated writes are unpacked first so that each message is routed and dispatched on its own
+    if (((ConnPacketAggregateHeader const *)data)->aggregateMessageType == MessageType::AGGREGATED_WRITE_CMD)
+    {
+        ReceiveAggregatedDataHandler(sendData, data);
+        return;
+    }
+
     ConnPacketHeader const * packetHeader = (ConnPacketHeader const *)data;
     if (packetHeader->sender == GS->sinkNodeId)
     {
@@ -511,17 +533,198 @@ void MeshConnection::ReceiveDataHandler(BaseConnectionSendData* sendData, u8 con
     logt("CONN_DATA", "Mesh RX %d,length:%d,deliv:%d,data:%s", (u32)packetHeader->messageType, sendData->dataLength.GetRaw(), (u32)sendData->deliveryOption, stringBuffer);
 
     //This will reassemble the data for us
+    const ConnPacketSplitHeader splitHeader = *(ConnPacketSplitHeader const *)data;
     data = ReassembleData(sendData, data);
 
+    //Relays forward split messages while they are still being received
+    const bool alreadyForwarded = HandleCutThrough(splitHeader, sendData, data);
+
     if(data != nullptr){
+        //Remember that the sender can be reached through this connection
+        GS->cm.LearnMeshRoute(this, ((ConnPacketHeader const *)data)->sender);
+
         //Route the packet to our other mesh connections
-        GS->cm.RouteMeshData(this, sendData, data);
+        if (!alreadyForwarded) {
+            GS->cm.RouteMeshData(this, sendData, data);
+        }
+        //Only MeshAccess connections are left for a message that was already forwarded to its next hop
+        else if (((ConnPacketHeader const *)data)->receiver != NODE_ID_SHORTEST_SINK) {
+            GS->cm.BroadcastMeshData(this, sendData, data, ROUTING_DECISION_BLOCK_TO_MESH);
+        }
 
         //Call our handler that dispatches the message throughout our application
         ReceiveMeshMessageHandler(sendData, data);
     }
 }
 
+void MeshConnection::ReceiveAggregatedDataHandler(BaseConnectionSendData* sendData, u8 const * data)
+{
+    //The handlers of a message might remove this connection
+    const u32 uniqueConnectionIdBackup = uniqueConnectionId;
+    const u16 dataLength = sendData->dataLength.GetRaw();
+
+    u16 position = SIZEOF_CONN_PACKET_AGGREGATE_HEADER;
+    while (position + SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER <= dataLength)
+    {
+        const u8 messageLength = ((ConnPacketAggregateEntryHeader const *)(data + position))->messageLength;
+        position += SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER;
+
+        //Only complete messages can be aggregated
+        if (
+            messageLength < SIZEOF_CONN_PACKET_HEADER
+            || position + messageLength > dataLength
+            || ((ConnPacketHeader const *)(data + position))->messageType == MessageType::SPLIT_WRITE_CMD
+            || ((ConnPacketHeader const *)(data + position))->messageType == MessageType::SPLIT_WRITE_CMD_END
+            || ((ConnPacketHeader const *)(data + position))->messageType == MessageType::AGGREGATED_WRITE_CMD
+        ) {
+            logt("ERROR", "Malformed aggregated write");
+            SIMEXCEPTION(MalformedPacketException);
+            return;
+        }
+
+        //Each message gets its own aligned copy, just like a message that was received on its own
+        DYNAMIC_ARRAY(messageBuffer, messageLength);
+        CheckedMemcpy(messageBuffer, data + position, messageLength);
+        BaseConnectionSendData messageSendData = *sendData;
+        messageSendData.dataLength = messageLength;
+        ReceiveDataHandler(&messageSendData, messageBuffer);
+
+        if (!GS->cm.GetConnectionByUniqueId(uniqueConnectionIdBackup).IsValid()) return;
+
+        position += messageLength;
+    }
+}
+
+//Returns true once a message was completely forwarded so that it must not be routed again
+bool MeshConnection::HandleCutThrough(ConnPacketSplitHeader splitHeader, BaseConnectionSendData* sendData, u8 const * reassembledData)
+{
+    const bool isSplit = splitHeader.splitMessageType == MessageType::SPLIT_WRITE_CMD || splitHeader.splitMessageType == MessageType::SPLIT_WRITE_CMD_END;
+
+    //Unsplit messages, e.g. vital packets, may be sent in between the splits and don't interrupt the reassembly
+    if (!isSplit) return false;
+
+    //Every new split message ends the forwarding of the previous one, the next hop discards the incomplete message
+    if (splitHeader.splitCounter == 0) {
+        AbandonCutThrough();
+        if (splitHeader.splitMessageType == MessageType::SPLIT_WRITE_CMD) StartCutThrough();
+    }
+    if (cutThroughConnectionUniqueId == 0) return false;
+
+    if (splitHeader.splitCounter != cutThroughNextSplitCounter) {
+        AbandonCutThrough();
+        return false;
+    }
+    cutThroughNextSplitCounter++;
+    cutThroughLastSplitDs = GS->appTimerDs;
+
+    if (splitHeader.splitMessageType == MessageType::SPLIT_WRITE_CMD) {
+        //The reassembly must have accepted this split, otherwise the message is incomplete
+        const u32 expectedReassemblyPosition = (splitHeader.splitCounter + 1) * (connectionPayloadSize - SIZEOF_CONN_PACKET_SPLIT_HEADER);
+        if (packetReassemblyPosition != expectedReassemblyPosition || !ForwardCutThrough(packetReassemblyBuffer.data(), packetReassemblyPosition, false)) {
+            AbandonCutThrough();
+        }
+        return false;
+    }
+
+    //The last split, the reassembled message is only routed again if forwarding the rest failed
+    if (reassembledData == nullptr || !ForwardCutThrough(reassembledData, sendData->dataLength.GetRaw(), true)) {
+        AbandonCutThrough();
+        return false;
+    }
+    cutThroughConnectionUniqueId = 0;
+    GS->cm.cutThroughForwardedMessages++;
+    return true;
+}
+
+void MeshConnection::StartCutThrough()
+{
+    if (!HandshakeDone() || packetReassemblyPosition < SIZEOF_CONN_PACKET_HEADER) return;
+
+    //The header of the message is part of the first split
+    ConnPacketHeader const * packetHeader = (ConnPacketHeader const *)packetReassemblyBuffer.data();
+
+    MeshConnectionHandle connection = GS->cm.GetCutThroughConnection(this, packetHeader);
+    if (!connection) return;
+    MeshConnection* outConnection = connection.GetConnection();
+
+    DeliveryPriority prio = outConnection->overwritePriority == DeliveryPriority::INVALID
+        ? outConnection->GetPriorityOfMessage(packetReassemblyBuffer.data(), packetReassemblyPosition)
+        : outConnection->overwritePriority;
+    //The vital queue never sends split messages
+    if (prio == DeliveryPriority::VITAL) prio = DeliveryPriority::HIGH;
+
+    outConnection->queue.GetQueueByPriority(prio)->OpenSplitMessage();
+
+    logt("CONN_DATA", "Cut-through of type %u to %u", (u32)packetHeader->messageType, outConnection->partnerId);
+
+    cutThroughConnectionUniqueId = outConnection->uniqueConnectionId;
+    cutThroughPriority = prio;
+    cutThroughNextSplitCounter = 0;
+    cutThroughForwardedSplits = 0;
+    cutThroughForwardedLength = 0;
+    cutThroughLastSplitDs = GS->appTimerDs;
+}
+
+//Queues all data of the message that fills a split of the outgoing connection, which might have a different MTU
+bool MeshConnection::ForwardCutThrough(u8 const * message, u16 availableLength, bool isLastSplit)
+{
+    MeshConnectionHandle connection(cutThroughConnectionUniqueId);
+    MeshConnection* outConnection = connection.GetConnection();
+    if (outConnection == nullptr || !outConnection->HandshakeDone()) return false;
+
+    ChunkedPacketQueue* outQueue = outConnection->queue.GetQueueByPriority(cutThroughPriority);
+    const u16 payloadSizePerSplit = outConnection->connectionPayloadSize - SIZEOF_CONN_PACKET_SPLIT_HEADER;
+
+    DYNAMIC_ARRAY(buffer, SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER + payloadSizePerSplit);
+    BaseConnectionSendDataPacked* sendDataPacked = (BaseConnectionSendDataPacked*)buffer;
+    sendDataPacked->characteristicHandle = outConnection->partnerWriteCharacteristicHandle;
+    sendDataPacked->deliveryOption = (u8)DeliveryOption::WRITE_CMD;
+    ConnPacketSplitHeader* splitHeader = (ConnPacketSplitHeader*)(buffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED);
+    u8* payload = buffer + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER;
+
+    //Intermediate splits must fill the MTU, so a rest is only sent once the message is complete
+    while (availableLength - cutThroughForwardedLength >= payloadSizePerSplit || (isLastSplit && availableLength > cutThroughForwardedLength)) {
+        const u16 size = availableLength - cutThroughForwardedLength < payloadSizePerSplit ? availableLength - cutThroughForwardedLength : payloadSizePerSplit;
+        const bool isLastPiece = isLastSplit && cutThroughForwardedLength + size == availableLength;
+
+        splitHeader->splitMessageType = isLastPiece ? MessageType::SPLIT_WRITE_CMD_END : MessageType::SPLIT_WRITE_CMD;
+        splitHeader->splitCounter = cutThroughForwardedSplits;
+        CheckedMemcpy(payload, message + cutThroughForwardedLength, size);
+
+        if (!outQueue->AddOpenSplitMessagePiece(buffer, SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED + SIZEOF_CONN_PACKET_SPLIT_HEADER + size, isLastPiece)) {
+            return false;
+        }
+        cutThroughForwardedSplits++;
+        cutThroughForwardedLength += size;
+    }
+
+    outConnection->FillTransmitBuffers();
+    return true;
+}
+
+void MeshConnection::AbandonCutThrough()
+{
+    if (cutThroughConnectionUniqueId == 0) return;
+
+    logt("CONN_DATA", "Cut-through abandoned after %u bytes", cutThroughForwardedLength);
+
+    MeshConnectionHandle connection(cutThroughConnectionUniqueId);
+    MeshConnection* outConnection = connection.GetConnection();
+    cutThroughConnectionUniqueId = 0;
+
+    if (outConnection != nullptr) {
+        outConnection->queue.GetQueueByPriority(cutThroughPriority)->AbandonOpenSplitMessage();
+        outConnection->FillTransmitBuffers();
+    }
+}
+
+void MeshConnection::CheckCutThroughTimeout()
+{
+    if (cutThroughConnectionUniqueId != 0 && cutThroughLastSplitDs + CUT_THROUGH_TIMEOUT_DS <= GS->appTimerDs) {
+        AbandonCutThrough();
+    }
+}
+
 void MeshConnection::ReceiveMeshMessageHandler(BaseConnectionSendData* sendData, u8 const * data)
 {
     ConnPacketHeader const * packetHeader = (ConnPacketHeader const *) data;
@@ -629,10 +832,12 @@ void MeshConnection::StartHandshakeAfterMtuExchange()
 
     packet.payload.preferredConnectionInterval = 0; //Unused at the moment
     packet.payload.networkId = GS->node.configuration.networkId;
+    packet.payload.supportsMessageAggregation = GS->config.enableMessageAggregation ? 1 : 0;
+    packet.payload.reservedFeatures = 0;
 
     logt("HANDSHAKE", "OUT => conn(%u) CLUSTER_WELCOME, cID:%x, cSize:%d, hops:%d", connectionId, packet.payload.clusterId, packet.payload.clusterSize, packet.payload.hopsToSink);
 
-    SendHandshakeMessage((u8*) &packet, SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_NETWORK_ID, true);
+    SendHandshakeMessage((u8*) &packet, SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_FEATURES, true);
 }
 
 void MeshConnection::ReceiveHandshakePacketHandler(BaseConnectionSendData* sendData, u8 const * data)
@@ -660,6 +865,10 @@ void MeshConnection::ReceiveHandshakePacketHandler(BaseConnectionSendData* sendD
             //Save mesh write handle
             partnerWriteCharacteristicHandle = packet->payload.meshWriteHandle;
 
+            //Older firmware does not append its features
+            partnerSupportsMessageAggregation = sendData->dataLength >= SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_FEATURES
+                && packet->payload.supportsMessageAggregation;
+
             connectionState = ConnectionState::HANDSHAKING;
 
             //Save a snapshot of the current clustering values, these are used in the handshake
@@ -734,10 +943,13 @@ void MeshConnection::ReceiveHandshakePacketHandler(BaseConnectionSendData* sendD
                 outPacket.header.receiver = this->partnerId;
 
                 outPacket.payload.hopsToSink = GET_DEVICE_TYPE() == DeviceType::SINK ? 0 : -1;
+                outPacket.payload.preferredConnectionInterval = 0; //Unused at the moment
+                outPacket.payload.supportsMessageAggregation = GS->config.enableMessageAggregation ? 1 : 0;
+                outPacket.payload.reservedFeatures = 0;
 
                 logt("HANDSHAKE", "OUT => %d CLUSTER_ACK_1, hops:%d", outPacket.header.receiver, outPacket.payload.hopsToSink);
 
-                SendHandshakeMessage((u8*) &outPacket, SIZEOF_CONN_PACKET_CLUSTER_ACK_1, true);
+                SendHandshakeMessage((u8*) &outPacket, SIZEOF_CONN_PACKET_CLUSTER_ACK_1_WITH_FEATURES, true);
                 
                 //Kill other Connections and check if this connection has been removed in the process
                 GS->cm.ForceDisconnectOtherMeshConnections(this, AppDisconnectReason::I_AM_SMALLER);
@@ -768,8 +980,10 @@ void MeshConnection::ReceiveHandshakePacketHandler(BaseConnectionSendData* sendD
                 GS->logger.LogCustomCount(CustomErrorTypes::COUNT_HANDSHAKE_ACK1_DUPLICATE);
             }
 
-            //Save ACK1 packet for later
-            CheckedMemcpy(&clusterAck1Packet, data, sizeof(ConnPacketClusterAck1));
+            //Save ACK1 packet for later, older firmware does not append its features
+            CheckedMemset(&clusterAck1Packet, 0x00, sizeof(ConnPacketClusterAck1));
+            CheckedMemcpy(&clusterAck1Packet, data, sendData->dataLength >= SIZEOF_CONN_PACKET_CLUSTER_ACK_1_WITH_FEATURES ? SIZEOF_CONN_PACKET_CLUSTER_ACK_1_WITH_FEATURES : SIZEOF_CONN_PACKET_CLUSTER_ACK_1);
+            partnerSupportsMessageAggregation = clusterAck1Packet.payload.supportsMessageAggregation;
 
             logt("HANDSHAKE", "IN <= %d  CLUSTER_ACK_1, hops:%d", clusterAck1Packet.header.sender, clusterAck1Packet.payload.hopsToSink);
 
@@ -933,6 +1147,7 @@ bool MeshConnection::IsValidMessageType(MessageType t)
     switch (t) {
         case(MessageType::SPLIT_WRITE_CMD):
         case(MessageType::SPLIT_WRITE_CMD_END):
+        case(MessageType::AGGREGATED_WRITE_CMD):
         case(MessageType::CLUSTER_WELCOME):
         case(MessageType::CLUSTER_ACK_1):
         case(MessageType::CLUSTER_ACK_2):
@@ -46,6 +46,7 @@ class MeshConnection
     friend class CherrySim;
     friend class FruitySimServer;
     friend class MultiStackFixture_TestSinkDetectionWithSingleSink_Test;
+    friend class TestMeshComponentSet_TestTreePropagationMatchesRecursion_Test;
 #endif
     friend class ConnectionManager;
     friend class Node;
@@ -78,6 +79,8 @@ class MeshConnection
         //Handshake
         ConnPacketClusterAck1 clusterAck1Packet;
         ConnPacketClusterAck2 clusterAck2Packet;
+        //Set during the handshake if the partner is able to unpack aggregated writes
+        bool partnerSupportsMessageAggregation = false;
 
         //Timing
         TimeSyncState timeSyncState = TimeSyncState::UNSYNCED;
@@ -106,6 +109,25 @@ class MeshConnection
         i16 validityClusterUpdatesReceived;
 #endif
 
+        //Cut-through forwarding: A split message that we are not a receiver of is forwarded split by split
+        //while it is being received. The reassembly buffer holds the data until it fills an outgoing split.
+        static constexpr u32 CUT_THROUGH_TIMEOUT_DS = SEC_TO_DS(2);
+        u32 cutThroughConnectionUniqueId = 0; //0 if no message is currently forwarded
+        DeliveryPriority cutThroughPriority = DeliveryPriority::INVALID;
+        u8 cutThroughNextSplitCounter = 0; //Split counter that is expected next from our partner
+        u8 cutThroughForwardedSplits = 0;
+        u16 cutThroughForwardedLength = 0;
+        u32 cutThroughLastSplitDs = 0;
+
+        bool HandleCutThrough(ConnPacketSplitHeader splitHeader, BaseConnectionSendData* sendData, u8 const * reassembledData);
+        void StartCutThrough();
+        bool ForwardCutThrough(u8 const * message, u16 availableLength, bool isLastSplit);
+        void AbandonCutThrough();
+        void CheckCutThroughTimeout();
+
+        //Unpacks the messages of an AGGREGATED_WRITE_CMD and handles each of them as if it was received on its own
+        void ReceiveAggregatedDataHandler(BaseConnectionSendData* sendData, u8 const * data);
+
     public:
         //Init + Destroy
         MeshConnection(u8 id, ConnectionDirection direction, FruityHal::BleGapAddr const * partnerAddress, u16 partnerWriteCharacteristicHandle);
@@ -137,6 +159,7 @@ class MeshConnection
         void ClearCurrentClusterInfoUpdatePacket();
         void PacketSuccessfullyQueuedWithSoftdevice(SizedData* sentData) override final;
         void DataSentHandler(const u8* data, MessageLength length, u32 messageHandle) override final;
+        bool CanAggregateMessages() const override final;
 
         bool SendData(BaseConnectionSendData* sendData, u8 const * data, u32 * messageHandle=nullptr);
         bool SendData(u8 const * data, MessageLength dataLength, bool reliable, u32 * messageHandle=nullptr) override final;
@@ -342,6 +342,9 @@ void Node::HandshakeDoneHandler(MeshConnection* connection, bool completedAsWinn
         }
     }
 
+    //Routes through this connection must be learned again for the new cluster
+    GS->cm.InvalidateMeshRoutes(connection->uniqueConnectionId);
+
     //Update our advertisement packet
     UpdateJoinMePacket();
 
@@ -536,6 +539,9 @@ void Node::ReceiveClusterInfoUpdate(MeshConnection* connection, ConnPacketCluste
         cluster += packet->payload.clusterSizeChange;
         SetClusterSize(cluster);
         connection->connectedClusterSize += packet->payload.clusterSizeChange;
+
+        //The topology behind this connection has changed so that our routes through it might be wrong
+        GS->cm.InvalidateMeshRoutes(connection->uniqueConnectionId);
     }
 
     //Update hops to sink
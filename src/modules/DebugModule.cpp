@@ -106,6 +106,8 @@ void DebugModule::SendStatistics(NodeId receiver) const
     infoMessage.sentPacketsReliable = GS->cm.sentMeshPacketsReliable;
     infoMessage.droppedPackets = GS->cm.droppedMeshPackets;
     infoMessage.connectionLossCounter = GS->node.connectionLossCounter;
+    infoMessage.meshRouteHits = GS->cm.meshRouteHits;
+    infoMessage.meshRouteMisses = GS->cm.meshRouteMisses;
 
     SendModuleActionMessage(
         MessageType::MODULE_ACTION_RESPONSE,
@@ -1235,7 +1237,12 @@ void DebugModule::MeshMessageReceivedHandler(BaseConnection* connection, BaseCon
 
                 logjson_partial("DEBUGMOD", "{\"nodeId\":%u,\"type\":\"debug_stats\", \"conLoss\":%u,", packet->header.sender, infoMessage->connectionLossCounter);
                 logjson_partial("DEBUGMOD", "\"dropped\":%u,", infoMessage->droppedPackets);
-                logjson("DEBUGMOD", "\"sentRel\":%u,\"sentUnr\":%u}" SEP, infoMessage->sentPacketsReliable, infoMessage->sentPacketsUnreliable);
+                logjson_partial("DEBUGMOD", "\"sentRel\":%u,\"sentUnr\":%u", infoMessage->sentPacketsReliable, infoMessage->sentPacketsUnreliable);
+                if (sendData->dataLength >= SIZEOF_CONN_PACKET_MODULE + SIZEOF_DEBUG_MODULE_INFO_MESSAGE)
+                {
+                    logjson_partial("DEBUGMOD", ",\"routeHits\":%u,\"routeMisses\":%u", infoMessage->meshRouteHits, infoMessage->meshRouteMisses);
+                }
+                logjson("DEBUGMOD", "}" SEP);
             }
             else if(actionType == DebugModuleActionResponseMessages::PING_RESPONSE){
                 //Calculate the time it took to ping the other node
@@ -198,6 +198,13 @@ public:
     //will definitely block the message
     virtual RoutingDecision MessageRoutingInterceptor(BaseConnection* connection, BaseConnectionSendData* sendData, ConnPacketHeader const * packetHeader) { return 0; };
 
+    //Relays may forward a split message split by split before it is complete, such a message never passes the
+    //MessageRoutingInterceptor. Modules that implement it must therefore return true in HasMessageRoutingInterceptor.
+    //Their messages are then stored and forwarded as a whole unless they allow it in AllowsCutThroughForwarding,
+    //which only gets the header of the first split.
+    virtual bool HasMessageRoutingInterceptor() const { return false; };
+    virtual bool AllowsCutThroughForwarding(BaseConnection* connection, ConnPacketHeader const * packetHeader) { return false; };
+
     //Gives a message an arbitrary DeliveryPriority. Can return DeliveryPriority::INVALID in which case the priority is not changed.
     //The most important priority returned by all modules wins. If all modules return DeliveryPriority::INVALID, DeliveryPriority::MEDIUM
     //is used.
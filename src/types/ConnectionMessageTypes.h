@@ -68,6 +68,7 @@ enum class MessageType : u8
 
     SPLIT_WRITE_CMD = 16, //Used if a WRITE_CMD message is split
     SPLIT_WRITE_CMD_END = 17, //Used if a WRITE_CMD message is split
+    AGGREGATED_WRITE_CMD = 18, //Used if multiple small WRITE_CMD messages are sent in a single write
 
     //Mesh clustering and handshake: Protocol defined
     CLUSTER_WELCOME = 20, //The initial message after a connection setup (Sent between two nodes)
@@ -154,6 +155,22 @@ typedef struct
 }ConnPacketSplitHeader;
 STATIC_ASSERT_SIZE(ConnPacketSplitHeader, SIZEOF_CONN_PACKET_SPLIT_HEADER);
 
+//CONN_PACKET_AGGREGATE_HEADER starts a write that carries multiple complete messages
+//Each message follows as a CONN_PACKET_AGGREGATE_ENTRY_HEADER and the message itself
+constexpr size_t SIZEOF_CONN_PACKET_AGGREGATE_HEADER = 1;
+typedef struct
+{
+    MessageType aggregateMessageType;
+}ConnPacketAggregateHeader;
+STATIC_ASSERT_SIZE(ConnPacketAggregateHeader, SIZEOF_CONN_PACKET_AGGREGATE_HEADER);
+
+constexpr size_t SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER = 1;
+typedef struct
+{
+    u8 messageLength;
+}ConnPacketAggregateEntryHeader;
+STATIC_ASSERT_SIZE(ConnPacketAggregateEntryHeader, SIZEOF_CONN_PACKET_AGGREGATE_ENTRY_HEADER);
+
 //################################################################################
 //########### Packets relevant for clustering and cluster handshaking ############
 //################################################################################
@@ -162,6 +179,7 @@ STATIC_ASSERT_SIZE(ConnPacketSplitHeader, SIZEOF_CONN_PACKET_SPLIT_HEADER);
 //potential partners set up a connection
 constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME = 11;
 constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME_WITH_NETWORK_ID = 13;
+constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME_WITH_FEATURES = 14;
 typedef struct
 {
     ClusterId clusterId;
@@ -170,34 +188,41 @@ typedef struct
     ClusterSize hopsToSink;
     u8 preferredConnectionInterval;
     NetworkId networkId;
+    u8 supportsMessageAggregation : 1; //Older firmware does not send this byte
+    u8 reservedFeatures : 7;
 }ConnPacketPayloadClusterWelcome;
-STATIC_ASSERT_SIZE(ConnPacketPayloadClusterWelcome, SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME_WITH_NETWORK_ID);
+STATIC_ASSERT_SIZE(ConnPacketPayloadClusterWelcome, SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME_WITH_FEATURES);
 
 constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_WELCOME = (SIZEOF_CONN_PACKET_HEADER + SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME);
 constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_NETWORK_ID = (SIZEOF_CONN_PACKET_HEADER + SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME_WITH_NETWORK_ID);
+constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_FEATURES = (SIZEOF_CONN_PACKET_HEADER + SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_WELCOME_WITH_FEATURES);
 typedef struct
 {
     ConnPacketHeader header;
     ConnPacketPayloadClusterWelcome payload;
 }ConnPacketClusterWelcome;
-STATIC_ASSERT_SIZE(ConnPacketClusterWelcome, SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_NETWORK_ID);
+STATIC_ASSERT_SIZE(ConnPacketClusterWelcome, SIZEOF_CONN_PACKET_CLUSTER_WELCOME_WITH_FEATURES);
 
 //CLUSTER_ACK_1 will be sent as a response to CLUSTER_WELCOME
 constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_1 = 3;
+constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_1_WITH_FEATURES = 4;
 typedef struct
 {
     ClusterSize hopsToSink;
     u8 preferredConnectionInterval;
+    u8 supportsMessageAggregation : 1; //Older firmware does not send this byte
+    u8 reservedFeatures : 7;
 }ConnPacketPayloadClusterAck1;
-STATIC_ASSERT_SIZE(ConnPacketPayloadClusterAck1, SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_1);
+STATIC_ASSERT_SIZE(ConnPacketPayloadClusterAck1, SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_1_WITH_FEATURES);
 
 constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_ACK_1 = (SIZEOF_CONN_PACKET_HEADER + SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_1);
+constexpr size_t SIZEOF_CONN_PACKET_CLUSTER_ACK_1_WITH_FEATURES = (SIZEOF_CONN_PACKET_HEADER + SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_1_WITH_FEATURES);
 typedef struct
 {
     ConnPacketHeader header;
     ConnPacketPayloadClusterAck1 payload;
 }ConnPacketClusterAck1;
-STATIC_ASSERT_SIZE(ConnPacketClusterAck1, SIZEOF_CONN_PACKET_CLUSTER_ACK_1);
+STATIC_ASSERT_SIZE(ConnPacketClusterAck1, SIZEOF_CONN_PACKET_CLUSTER_ACK_1_WITH_FEATURES);
 
 //CLUSTER_ACK_2 marks the final step of the clustering handshake
 constexpr size_t SIZEOF_CONN_PACKET_PAYLOAD_CLUSTER_ACK_2 = 8;
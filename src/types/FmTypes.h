@@ -78,6 +78,18 @@ extern "C" {
 #define START_OF_FUNCTION
 #endif
 
+#ifdef SIM_ENABLED
+#include "SimProfiler.h"
+#define SIM_PROFILE_CONCAT_INNER(a, b) a##b
+#define SIM_PROFILE_CONCAT(a, b) SIM_PROFILE_CONCAT_INNER(a, b)
+//Attributes the time until the end of the enclosing block to the given frame of the current node
+#define SIM_PROFILE_SCOPE(frameName) SimProfilerScope SIM_PROFILE_CONCAT(simProfilerScope, __LINE__)(frameName)
+#define SIM_PROFILE_MODULE_SCOPE(moduleName, handlerName) SIM_PROFILE_SCOPE(moduleName); SimProfilerScope SIM_PROFILE_CONCAT(simProfilerHandlerScope, __LINE__)(handlerName)
+#else
+#define SIM_PROFILE_SCOPE(frameName)
+#define SIM_PROFILE_MODULE_SCOPE(moduleName, handlerName)
+#endif
+
 #ifdef CHERRYSIM_TESTER_ENABLED
 #define TESTER_PUBLIC public
 #else
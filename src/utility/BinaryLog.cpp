@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#include "BinaryLog.h"
+#include "Utility.h"
+
+BinaryLogRecord::BinaryLogRecord(u32 formatId, u32 tagId)
+{
+    CheckedMemcpy(payload, &formatId, sizeof(formatId));
+    CheckedMemcpy(payload + 4, &tagId, sizeof(tagId));
+}
+
+bool BinaryLogRecord::AddArgument(BinaryLogArgumentType type, const u8* data, u32 dataLength)
+{
+    //Arguments that do not fit are dropped, the decoder prints a placeholder for them
+    const u32 typesSize = (amountOfArguments + 1 + 3) / 4;
+    if (amountOfArguments >= BINARY_LOG_MAX_ARGUMENTS || argumentsOffset + dataLength + typesSize > BINARY_LOG_MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+    argumentTypes[amountOfArguments / 4] |= (u8)((u8)type << ((amountOfArguments % 4) * 2));
+    amountOfArguments++;
+    CheckedMemcpy(payload + argumentsOffset, data, dataLength);
+    argumentsOffset += dataLength;
+    return true;
+}
+
+void BinaryLogRecord::AppendArgument(const char* value)
+{
+    if (value == nullptr) value = "(null)";
+    u8 buffer[BINARY_LOG_MAX_STRING_LENGTH + 1];
+    u32 length = 0;
+    while (length < BINARY_LOG_MAX_STRING_LENGTH && value[length] != '\0')
+    {
+        buffer[length] = (u8)value[length];
+        length++;
+    }
+    buffer[length] = '\0';
+    AddArgument(BinaryLogArgumentType::STRING, buffer, length + 1);
+}
+
+void BinaryLogRecord::AppendArgument(float value)
+{
+    AddArgument(BinaryLogArgumentType::FLOAT, (const u8*)&value, sizeof(value));
+}
+
+void BinaryLogRecord::AppendInteger(u32 value)
+{
+    AddArgument(BinaryLogArgumentType::INT32, (const u8*)&value, sizeof(value));
+}
+
+void BinaryLogRecord::AppendInteger64(uint64_t value)
+{
+    AddArgument(BinaryLogArgumentType::INT64, (const u8*)&value, sizeof(value));
+}
+
+u32 BinaryLogRecord::GetFrameSize() const
+{
+    const u32 typesSize = (amountOfArguments + 3) / 4;
+    return argumentsOffset + typesSize + BINARY_LOG_FRAME_OVERHEAD;
+}
+
+u32 BinaryLogRecord::SerializeFrame(u8* buffer, u32 bufferSize) const
+{
+    const u32 frameSize = GetFrameSize();
+    if (frameSize > bufferSize) return 0;
+
+    const u32 typesSize = (amountOfArguments + 3) / 4;
+    const u32 payloadSize = frameSize - BINARY_LOG_FRAME_OVERHEAD;
+    buffer[0] = BINARY_LOG_FRAME_START;
+    buffer[1] = (u8)payloadSize;
+    u8* out = buffer + 2;
+    CheckedMemcpy(out, payload, HEADER_SIZE - 1);
+    out[HEADER_SIZE - 1] = amountOfArguments;
+    CheckedMemcpy(out + HEADER_SIZE, argumentTypes, typesSize);
+    CheckedMemcpy(out + HEADER_SIZE + typesSize, payload + HEADER_SIZE, argumentsOffset - HEADER_SIZE);
+
+    u8 checksum = 0;
+    for (u32 i = 0; i < payloadSize; i++) checksum += out[i];
+    buffer[2 + payloadSize] = checksum;
+    return frameSize;
+}
@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////////////////////
+// /****************************************************************************
+// **
+// ** Copyright (C) 2015-2021 M-Way Solutions GmbH
+// ** Contact: https://www.blureange.io/licensing
+// **
+// ** This file is part of the Bluerange/FruityMesh implementation
+// **
+// ** $BR_BEGIN_LICENSE:GPL-EXCEPT$
+// ** Commercial License Usage
+// ** Licensees holding valid commercial Bluerange licenses may use this file in
+// ** accordance with the commercial license agreement provided with the
+// ** Software or, alternatively, in accordance with the terms contained in
+// ** a written agreement between them and M-Way Solutions GmbH. 
+// ** For licensing terms and conditions see https://www.bluerange.io/terms-conditions. For further
+// ** information use the contact form at https://www.bluerange.io/contact.
+// **
+// ** GNU General Public License Usage
+// ** Alternatively, this file may be used under the terms of the GNU
+// ** General Public License version 3 as published by the Free Software
+// ** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+// ** included in the packaging of this file. Please review the following
+// ** information to ensure the GNU General Public License requirements will
+// ** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+// **
+// ** $BR_END_LICENSE$
+// **
+// ****************************************************************************/
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "FmTypes.h"
+#include <type_traits>
+
+/*
+ * Binary logging replaces the formatting of logt on the node with copying the raw arguments
+ * into a buffer that is drained by the log transport later on. The format strings are not part
+ * of the firmware: every logt call site places its format in the BinaryLogFormats section which
+ * is not loaded into flash. The offset of the format in that section is its id. After a build,
+ * CMake/ExtractBinaryLogFormats.py extracts the formats into a table and
+ * util/binarylog/BinaryLogDecoder.py uses this table to print the log lines on the host.
+ *
+ * A frame on the transport looks like this and is never split by other output:
+ * [START][payload length][formatId u32][tagId u32][amount of arguments][argument types][arguments][checksum]
+ * Argument types are stored with two bits per argument. All values are little endian.
+ */
+
+constexpr u8 BINARY_LOG_FRAME_START = 0x02;
+constexpr u32 BINARY_LOG_MAX_ARGUMENTS = 16;
+constexpr u32 BINARY_LOG_MAX_PAYLOAD_SIZE = 200;
+//Longer strings are truncated
+constexpr u32 BINARY_LOG_MAX_STRING_LENGTH = 48;
+//Format id of the frame that reports records that were dropped because the buffer was full
+constexpr u32 BINARY_LOG_DROPPED_RECORDS_FORMAT_ID = 0xFFFFFFFF;
+//Start, payload length and checksum
+constexpr u32 BINARY_LOG_FRAME_OVERHEAD = 3;
+
+enum class BinaryLogArgumentType : u8
+{
+    INT32  = 0,
+    INT64  = 1,
+    FLOAT  = 2, //floats and doubles are both sent as 32 bit floats
+    STRING = 3, //null terminated
+};
+
+/*
+ * Collects the arguments of a single log call.
+ */
+class BinaryLogRecord
+{
+TESTER_PUBLIC:
+    static constexpr u32 HEADER_SIZE = 9;
+
+    u8 payload[BINARY_LOG_MAX_PAYLOAD_SIZE];
+    u8 argumentTypes[BINARY_LOG_MAX_ARGUMENTS / 4] = {};
+    u32 argumentsOffset = HEADER_SIZE;
+    u8 amountOfArguments = 0;
+
+    bool AddArgument(BinaryLogArgumentType type, const u8* data, u32 dataLength);
+
+public:
+    BinaryLogRecord(u32 formatId, u32 tagId);
+
+    void AppendArgument(const char* value);
+    void AppendArgument(char* value)      { AppendArgument((const char*)value); }
+    //Hex and base64 buffers of the TO_HEX and TO_BASE64 macros are u8 arrays
+    void AppendArgument(const u8* value)  { AppendArgument((const char*)value); }
+    void AppendArgument(u8* value)        { AppendArgument((const char*)value); }
+    void AppendArgument(float value);
+    void AppendArgument(double value)     { AppendArgument((float)value); }
+
+    template<typename T>
+    void AppendArgument(T* value)
+    {
+        AppendInteger((u32)(uintptr_t)value);
+    }
+
+    //Integers, bools and enums
+    template<typename T>
+    void AppendArgument(T value)
+    {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Unsupported binary log argument");
+        if (sizeof(T) > sizeof(u32)) AppendInteger64((uint64_t)value);
+        else AppendInteger((u32)value);
+    }
+
+    void AppendArguments() {}
+    template<typename T, typename... Args>
+    void AppendArguments(T value, Args... args)
+    {
+        AppendArgument(value);
+        AppendArguments(args...);
+    }
+
+    void AppendInteger(u32 value);
+    void AppendInteger64(uint64_t value);
+
+    //Writes the complete frame, returns the amount of bytes written or 0 if the frame did not fit
+    u32 SerializeFrame(u8* buffer, u32 bufferSize) const;
+    u32 GetFrameSize() const;
+};
+
+/*
+ * Byte ring buffer that holds complete frames until they are drained by the log transport.
+ */
+template<u32 N>
+class BinaryLogBuffer
+{
+TESTER_PUBLIC:
+    u8 data[N];
+    u32 readIndex = 0;
+    u32 usedBytes = 0;
+    u32 droppedRecords = 0;
+
+    bool PushFrame(const BinaryLogRecord& record)
+    {
+        u8 frame[BINARY_LOG_MAX_PAYLOAD_SIZE + BINARY_LOG_FRAME_OVERHEAD];
+        const u32 frameSize = record.SerializeFrame(frame, sizeof(frame));
+        if (frameSize == 0 || frameSize > N - usedBytes) return false;
+        for (u32 i = 0; i < frameSize; i++)
+        {
+            data[(readIndex + usedBytes + i) % N] = frame[i];
+        }
+        usedBytes += frameSize;
+        return true;
+    }
+
+public:
+    //Drops the record if it does not fit, the amount of dropped records is reported once there is space again
+    void Push(const BinaryLogRecord& record)
+    {
+        if (droppedRecords > 0)
+        {
+            BinaryLogRecord droppedRecord(BINARY_LOG_DROPPED_RECORDS_FORMAT_ID, 0);
+            droppedRecord.AppendInteger(droppedRecords);
+            if (!PushFrame(droppedRecord))
+            {
+                droppedRecords++;
+                return;
+            }
+            droppedRecords = 0;
+        }
+        if (!PushFrame(record)) droppedRecords++;
+    }
+
+    //Copies up to maxLength bytes of the buffered frames and removes them from the buffer
+    u32 Read(u8* buffer, u32 maxLength)
+    {
+        const u32 length = usedBytes < maxLength ? usedBytes : maxLength;
+        for (u32 i = 0; i < length; i++)
+        {
+            buffer[i] = data[(readIndex + i) % N];
+        }
+        readIndex = (readIndex + length) % N;
+        usedBytes -= length;
+        return length;
+    }
+
+    bool IsEmpty() const
+    {
+        return usedBytes == 0 && droppedRecords == 0;
+    }
+
+    u32 GetAmountOfDroppedRecords() const
+    {
+        return droppedRecords;
+    }
+};
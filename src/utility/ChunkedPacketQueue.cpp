@@ -36,71 +36,91 @@
 #include "ChunkedPacketQueue.h"
 
 // Adds a message. Private as the method does not check for size or nullptrs, the caller has to do this.
+// The caller must also have reserved enough space for the whole entry using ReserveEntry.
 void ChunkedPacketQueue::AddMessageRaw(u8* data, u16 size)
 {
+    if (writeChunk->amountOfByteInThisChunk + size > CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+    {
+        // Implementation error! Entries must never straddle two chunks.
+        SIMEXCEPTION(IllegalStateException);
+        return;
+    }
+    CheckedMemcpy(writeChunk->data.data() + writeChunk->amountOfByteInThisChunk, data, size);
+    writeChunk->amountOfByteInThisChunk += size;
     writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(u32));
-    const u32 sizeLeftInCurrentWriteChunk = CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > writeChunk->amountOfByteInThisChunk ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - writeChunk->amountOfByteInThisChunk : 0;
+}
 
-    if (sizeLeftInCurrentWriteChunk >= size)
+u16 ChunkedPacketQueue::GetSizeInQueue(u16 size, bool isSplit)
+{
+    // Split entries only use the short header, see AddMessage.
+    const u16 headerSize = isSplit ? sizeof(QueueEntryHeader) : sizeof(ExtendedQueueEntryHeader);
+    return headerSize + Utility::NextMultipleOf(size, sizeof(u32));
+}
+
+bool ChunkedPacketQueue::ReserveEntry(u16 sizeInQueue)
+{
+    if (writeChunk->amountOfByteInThisChunk + sizeInQueue <= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
     {
-        // The data fits completely in the current writeChunk
-        CheckedMemcpy(writeChunk->data.data() + writeChunk->amountOfByteInThisChunk, data, size);
-        writeChunk->amountOfByteInThisChunk += size;
-        writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(u32));
+        return true;
     }
-    else
+
+    // The entry does not fit into the rest of the writeChunk. Instead of splitting it, the rest
+    // of the writeChunk is left unused so that every entry can be read in place.
+    if (GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, 1 + (u32)prio) == false)
     {
-        // The data must be split between the current writeChunk and a new chunk
-        if (sizeLeftInCurrentWriteChunk > 0)
-        {
-            CheckedMemcpy(writeChunk->data.data() + writeChunk->amountOfByteInThisChunk, data, sizeLeftInCurrentWriteChunk);
-            writeChunk->amountOfByteInThisChunk += sizeLeftInCurrentWriteChunk;
-            writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(u32));
-        }
-        ConnectionQueueMemoryChunk* newChunk = GS->connectionQueueMemoryAllocator.Allocate();
-        if (!newChunk)
-        {
-            // Implementation error! The calling function should have made sure that there is a chunk available!
-            SIMEXCEPTION(IllegalStateException);
-            return;
-        }
-        writeChunk->nextChunk = newChunk;
-        writeChunk = newChunk;
-        CheckedMemcpy(writeChunk->data.data(), data + sizeLeftInCurrentWriteChunk, size - sizeLeftInCurrentWriteChunk);
-        writeChunk->amountOfByteInThisChunk += size - sizeLeftInCurrentWriteChunk;
-        writeChunk->amountOfByteInThisChunk = Utility::NextMultipleOf(writeChunk->amountOfByteInThisChunk, sizeof(u32));
+        // If there is no memory left for this message.
+        return false;
+    }
+    ConnectionQueueMemoryChunk* newChunk = GS->connectionQueueMemoryAllocator.Allocate();
+    if (!newChunk)
+    {
+        // Implementation error! IsChunkAvailable should have made sure that there is a chunk available!
+        SIMEXCEPTION(IllegalStateException);
+        return false;
+    }
+    writeChunk->nextChunk = newChunk;
+
+    if (lookAheadChunk == writeChunk && lookAheadChunk->currentLookAheadHead >= lookAheadChunk->amountOfByteInThisChunk)
+    {
+        // If we have looked ahead through all the available messages, the lookAhead has to
+        // continue in the new chunk as nothing will ever be added to the old one again.
+        lookAheadChunk = newChunk;
     }
+    writeChunk = newChunk;
+
+    return true;
 }
 
-u16 ChunkedPacketQueue::PeekPacketRaw(u8* outData, u16 outDataSize, const ConnectionQueueMemoryChunk* chunk, u32 head, u32* messageHandle) const
+u8* ChunkedPacketQueue::GetPacketRaw(ConnectionQueueMemoryChunk* chunk, u32 head, u16 maxSize, u16* outSize, u32* messageHandle) const
 {
     const QueueEntryHeader* header = (const QueueEntryHeader*)(chunk->data.data() + head);
     const u16 headerSize = header->isExtended ? sizeof(ExtendedQueueEntryHeader) : sizeof(QueueEntryHeader);
     if (header->reserved != 0)
     {
         SIMEXCEPTION(MemoryCorruptionException);
-        return 0;
+        return nullptr;
     }
-    if (outDataSize < header->size)
+    if (maxSize < header->size)
     {
         SIMEXCEPTION(IllegalStateException);
-        return 0;
+        return nullptr;
     }
     if (header->size == 0)
     {
         SIMEXCEPTION(MemoryCorruptionException);
-        return 0;
-    }
-    if (outData == nullptr)
-    {
-        SIMEXCEPTION(IllegalArgumentException);
-        return 0;
+        return nullptr;
     }
 
     // If the following static_assert failes, the messageStart calculation would be wrong.
     static_assert(sizeof(ExtendedQueueEntryHeader) % sizeof(u32) == 0, "Sizeof ExtendedQueueEntryHeader must be a multiple of 4!");
     static_assert(sizeof(QueueEntryHeader) % sizeof(u32) == 0, "Sizeof QueueEntryHeader must be a multiple of 4!");
     const u32 messageStartOffset = head + headerSize;
+    if (messageStartOffset + header->size > CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+    {
+        // Entries never straddle two chunks, so this can only be some MemoryCorruption.
+        SIMEXCEPTION(MemoryCorruptionException);
+        return nullptr;
+    }
     if (messageHandle != nullptr)
     {
         if (header->isExtended)
@@ -113,30 +133,61 @@ u16 ChunkedPacketQueue::PeekPacketRaw(u8* outData, u16 outDataSize, const Connec
             *messageHandle = 0;
         }
     }
-    
-    if (messageStartOffset + header->size < CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+
+    *outSize = header->size;
+    return chunk->data.data() + messageStartOffset;
+}
+
+u16 ChunkedPacketQueue::PeekPacketRaw(u8* outData, u16 outDataSize, ConnectionQueueMemoryChunk* chunk, u32 head, u32* messageHandle) const
+{
+    if (outData == nullptr)
     {
-        // The message can be read from a single chunk.
-        CheckedMemcpy(outData, chunk->data.data() + messageStartOffset, header->size);
+        SIMEXCEPTION(IllegalArgumentException);
+        return 0;
     }
-    else
+    u16 size = 0;
+    const u8* message = GetPacketRaw(chunk, head, outDataSize, &size, messageHandle);
+    if (message == nullptr) return 0;
+
+    CheckedMemcpy(outData, message, size);
+    return size;
+}
+
+void ChunkedPacketQueue::AdvanceChunkHeadPair(ChunkHeadPair* pair) const
+{
+    const QueueEntryHeader* header = (const QueueEntryHeader*)(pair->chunk->data.data() + pair->head);
+    const u16 headerSize = header->isExtended ? sizeof(ExtendedQueueEntryHeader) : sizeof(QueueEntryHeader);
+    pair->head += headerSize;
+    pair->head += header->size;
+    pair->head = Utility::NextMultipleOf(pair->head, sizeof(u32));
+    if (pair->head >= pair->chunk->amountOfByteInThisChunk && pair->chunk != writeChunk)
     {
-        // The message is split across two chunks.
-        const u32 amountOfDataInFirstChunk = CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > messageStartOffset ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - messageStartOffset : 0;
-        if (amountOfDataInFirstChunk > 0)
-        {
-            CheckedMemcpy(outData, chunk->data.data() + messageStartOffset, amountOfDataInFirstChunk);
-        }
-        const u32 amountOfDataInSecondChunk = header->size - amountOfDataInFirstChunk;
-        // In rare case it might happen that header is split among 2 packets. We need to read data from second chunk with proper offset.
-        const u32 secondChunkOffset = messageStartOffset > CONNECTION_QUEUE_MEMORY_CHUNK_SIZE ? (messageStartOffset % CONNECTION_QUEUE_MEMORY_CHUNK_SIZE) : 0;
-        if (amountOfDataInSecondChunk > 0)
-        {
-            CheckedMemcpy(outData + amountOfDataInFirstChunk, chunk->nextChunk->data.data() + secondChunkOffset, amountOfDataInSecondChunk);
-        }
+        // The next entry always starts at the beginning of the next chunk.
+        pair->chunk = pair->chunk->nextChunk;
+        pair->head = 0;
     }
+}
 
-    return header->size;
+ChunkedPacketQueue::PacketIndexEntry ChunkedPacketQueue::ToPacketIndexEntry(const ChunkHeadPair& pair) const
+{
+    PacketIndexEntry entry;
+    entry.chunkIndex = GS->connectionQueueMemoryAllocator.GetIndexOfChunk(pair.chunk);
+    entry.headInWords = (u8)(pair.head / sizeof(u32));
+    return entry;
+}
+
+ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::FromPacketIndexEntry(const PacketIndexEntry& entry) const
+{
+    return ChunkHeadPair{ GS->connectionQueueMemoryAllocator.GetChunkOfIndex(entry.chunkIndex), entry.headInWords * (u32)sizeof(u32) };
+}
+
+// Must be called after a packet was added. The index only ever covers the first packets of the queue.
+void ChunkedPacketQueue::AddToPacketIndex(const ChunkHeadPair& pair)
+{
+    if (packetIndex.GetAmountOfElements() + 1 == amountOfPackets && !packetIndex.IsFull())
+    {
+        packetIndex.Push(ToPacketIndexEntry(pair));
+    }
 }
 
 ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::GetChunkHeadPairOfIndex(u16 index) const
@@ -148,32 +199,50 @@ ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::GetChunkHeadPairOfIndex(u1
         return ChunkHeadPair{ nullptr, 0 };
     }
 
-    // Search for the chunk and the head
-    ConnectionQueueMemoryChunk* currentChunk = readChunk;
-    u32 currentHead = readChunk->currentReadHead;
-    for (u16 i = 0; i < index; i++)
+    const u32 amountOfIndexedPackets = packetIndex.GetAmountOfElements();
+    if (index < amountOfIndexedPackets)
     {
-        const QueueEntryHeader* header = (const QueueEntryHeader*)(currentChunk->data.data() + currentHead);
-        const u16 headerSize = header->isExtended ? sizeof(ExtendedQueueEntryHeader) : sizeof(QueueEntryHeader);
-        currentHead += headerSize;
-        currentHead += header->size;
-        currentHead = Utility::NextMultipleOf(currentHead, sizeof(u32));
-        if (currentHead >= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+        return FromPacketIndexEntry(packetIndex.PeekAt(index));
+    }
+    if (amountOfIndexedPackets == 0)
+    {
+        // Implementation error! The first packet is always indexed.
+        SIMEXCEPTION(IllegalStateException);
+        return ChunkHeadPair{ nullptr, 0 };
+    }
+
+    // Search for the chunk and the head, starting at the last indexed packet
+    ChunkHeadPair pair = FromPacketIndexEntry(packetIndex.PeekAt(amountOfIndexedPackets - 1));
+    for (u32 i = amountOfIndexedPackets - 1; i < index; i++)
+    {
+        AdvanceChunkHeadPair(&pair);
+        if (pair.chunk == nullptr)
         {
-            if (currentChunk->nextChunk == nullptr)
-            {
-                // (Probably) An implementation error! The random access peek reached the
-                // end of the chunk linked list, but did not yet reach the searched index.
-                // This may also be some MemoryCorruption.
-                SIMEXCEPTION(IllegalStateException);
-                return ChunkHeadPair{ nullptr, 0 };
-            }
-            currentChunk = currentChunk->nextChunk;
-            currentHead -= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE;
+            // (Probably) An implementation error! The random access peek reached the
+            // end of the chunk linked list, but did not yet reach the searched index.
+            // This may also be some MemoryCorruption.
+            SIMEXCEPTION(IllegalStateException);
+            return ChunkHeadPair{ nullptr, 0 };
         }
     }
 
-    return ChunkHeadPair{ currentChunk, currentHead };
+    return pair;
+}
+
+ChunkedPacketQueue::ChunkHeadPair ChunkedPacketQueue::GetChunkHeadPairOfLookAheadOffset(u16 offset) const
+{
+    const u32 index = amountOfLookedAheadPackets + offset;
+    if (index >= amountOfPackets)
+    {
+        // Not that many packets are left to look ahead.
+        return ChunkHeadPair{ nullptr, 0 };
+    }
+    if (offset == 0)
+    {
+        return ChunkHeadPair{ lookAheadChunk, lookAheadChunk->currentLookAheadHead };
+    }
+
+    return GetChunkHeadPairOfIndex(index);
 }
 
 ChunkedPacketQueue::ChunkedPacketQueue()
@@ -232,12 +301,23 @@ bool ChunkedPacketQueue::SplitAndAddMessage(u8* data, const u16 size, const u16
         return AddMessage(data, size, messageHandle, false);
     }
 
-    const u32 amountOfSplits = Utility::MessageLengthToAmountOfSplitPackets(size, payloadSizePerSplit);
-    const u32 sizeInQueueOfStartingSplits = Utility::NextMultipleOf(Utility::NextMultipleOf(payloadSizePerSplit - SIZEOF_CONN_PACKET_SPLIT_HEADER, sizeof(QueueEntryHeader)) + SIZEOF_CONN_PACKET_SPLIT_HEADER, sizeof(QueueEntryHeader)) + sizeof(QueueEntryHeader);
-    const u32 sizeInQueueOfLastSplit = Utility::NextMultipleOf(Utility::NextMultipleOf(size - (payloadSizePerSplit - SIZEOF_CONN_PACKET_SPLIT_HEADER) * (amountOfSplits - 1), sizeof(ExtendedQueueEntryHeader)) + SIZEOF_CONN_PACKET_SPLIT_HEADER, sizeof(ExtendedQueueEntryHeader)) + sizeof(ExtendedQueueEntryHeader);
-    const u32 sizeInQueue = sizeInQueueOfStartingSplits * (amountOfSplits - 1) + sizeInQueueOfLastSplit;
-    const u32 amountOfExtraChunks = (sizeInQueue - (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - readChunk->amountOfByteInThisChunk)) / CONNECTION_QUEUE_MEMORY_CHUNK_SIZE + 1;
-    if (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - readChunk->amountOfByteInThisChunk < sizeInQueue && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, amountOfExtraChunks + (u32)prio) == false)
+    // Entries never straddle two chunks, so the amount of required chunks is determined by placing the splits one after another.
+    u32 amountOfExtraChunks = 0;
+    u32 usedBytesInChunk = writeChunk->amountOfByteInThisChunk;
+    for (u16 sizeLeft = size - SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED; sizeLeft > 0;)
+    {
+        const bool isSplit = sizeLeft > payloadSizePerSplit - SIZEOF_CONN_PACKET_SPLIT_HEADER;
+        const u16 sizeOfThisSplit = isSplit ? payloadSizePerSplit - SIZEOF_CONN_PACKET_SPLIT_HEADER : sizeLeft;
+        sizeLeft -= sizeOfThisSplit;
+        const u16 sizeInQueue = GetSizeInQueue(sizeOfThisSplit + SIZEOF_CONN_PACKET_SPLIT_HEADER + SIZEOF_BASE_CONNECTION_SEND_DATA_PACKED, isSplit);
+        if (usedBytesInChunk + sizeInQueue > CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
+        {
+            amountOfExtraChunks++;
+            usedBytesInChunk = 0;
+        }
+        usedBytesInChunk += sizeInQueue;
+    }
+    if (amountOfExtraChunks > 0 && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, amountOfExtraChunks + (u32)prio) == false)
     {
         // If there is no memory left for this message.
         return false;
@@ -286,6 +366,57 @@ bool ChunkedPacketQueue::SplitAndAddMessage(u8* data, const u16 size, const u16
     return true;
 }
 
+void ChunkedPacketQueue::OpenSplitMessage()
+{
+    isOpenSplitMessage = true;
+    isOpenSplitMessageInterrupted = false;
+    hasOpenSplitMessagePieces = false;
+}
+
+bool ChunkedPacketQueue::AddOpenSplitMessagePiece(u8* data, u16 size, bool isLastPiece)
+{
+    //Once another message was queued in between, the receiver could no longer reassemble the open message
+    if (!isOpenSplitMessage || isOpenSplitMessageInterrupted) return false;
+
+    isOpenSplitMessage = false;
+    const bool successfullyAdded = AddMessage(data, size, nullptr, !isLastPiece);
+    isOpenSplitMessage = successfullyAdded && !isLastPiece;
+    if (successfullyAdded) hasOpenSplitMessagePieces = true;
+
+    return successfullyAdded;
+}
+
+void ChunkedPacketQueue::AbandonOpenSplitMessage()
+{
+    //If the last queued piece was not sent yet, it ends the split in this queue instead of a split end
+    //that will never be added. Its content stays unchanged, so the next hop discards the incomplete
+    //message once the next message starts. Pieces of an interrupted message are followed by another message.
+    if (isOpenSplitMessage && hasOpenSplitMessagePieces && !isOpenSplitMessageInterrupted && HasMoreToLookAhead())
+    {
+        const ChunkHeadPair pair = GetChunkHeadPairOfIndex(amountOfPackets - 1);
+        if (pair.chunk != nullptr)
+        {
+            QueueEntryHeader* header = (QueueEntryHeader*)(pair.chunk->data.data() + pair.head);
+            header->isSplit = 0;
+        }
+    }
+
+    isOpenSplitMessage = false;
+    isOpenSplitMessageInterrupted = false;
+    hasOpenSplitMessagePieces = false;
+
+    //If all pieces were already sent, no split end will follow that could finish the split state
+    if (isCurrentlySendingSplitMessage && !HasMoreToLookAhead())
+    {
+        isCurrentlySendingSplitMessage = false;
+    }
+}
+
+bool ChunkedPacketQueue::HasOpenSplitMessage() const
+{
+    return isOpenSplitMessage;
+}
+
 bool ChunkedPacketQueue::AddMessage(u8* data, u16 size, u32 * messageHandle, bool isSplit)
 {
     if (size > MAX_MESH_PACKET_SIZE)
@@ -299,21 +430,23 @@ bool ChunkedPacketQueue::AddMessage(u8* data, u16 size, u32 * messageHandle, boo
         return false;
     }
 
-    // The following assumption is because the implementation never splits data over mutliple chunks. Thus, if one
-    // chunk is completely full, the message must always be placable in a new chunk (as long as one is available).
+    // The implementation never splits an entry over mutliple chunks. Thus, if the rest of the current chunk is too
+    // small, the entry must always be placable in a new chunk (as long as one is available).
     // A "split" in this context means a split across multiple chunks, NOT across multiple packets.
     static_assert(MAX_MESH_PACKET_SIZE + sizeof(ExtendedQueueEntryHeader) <= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE,
         "The implementation of this class assumes that a maximum packet size plus the size of a header always fits in a freshly allocated chunk.");
 
+    if (isOpenSplitMessage) isOpenSplitMessageInterrupted = true;
+
     if (isSplit)
     {
-        const u16 sizeInQueue = Utility::NextMultipleOf(size + sizeof(ExtendedQueueEntryHeader), sizeof(ExtendedQueueEntryHeader));
-        if (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - writeChunk->amountOfByteInThisChunk < sizeInQueue && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, 1 + (u32)prio) == false)
+        if (!ReserveEntry(GetSizeInQueue(size, isSplit)))
         {
             // If there is no memory left for this message.
             return false;
         }
         if (messageHandle != nullptr) *messageHandle = 0;
+        const ChunkHeadPair entryPosition{ writeChunk, writeChunk->amountOfByteInThisChunk };
         QueueEntryHeader header;
         CheckedMemset(&header, 0, sizeof(header));
         header.size = size;
@@ -321,24 +454,18 @@ bool ChunkedPacketQueue::AddMessage(u8* data, u16 size, u32 * messageHandle, boo
         AddMessageRaw((u8*)&header, sizeof(header));
         AddMessageRaw(data, size);
         amountOfPackets++;
-
-        if (lookAheadChunk->currentLookAheadHead == CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
-        {
-            // Edge case! If we have looked ahead through all the available messages, hit exactly the end of
-            // the last chunk and then add a new message, the lookAhead is not moved to the new chunk.
-            lookAheadChunk = lookAheadChunk->nextChunk;
-        }
+        AddToPacketIndex(entryPosition);
     }
     else
     {
         this->messageHandle++;
-        const u16 sizeInQueue = Utility::NextMultipleOf(size + sizeof(ExtendedQueueEntryHeader), sizeof(ExtendedQueueEntryHeader));
-        if (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - writeChunk->amountOfByteInThisChunk < sizeInQueue && GS->connectionQueueMemoryAllocator.IsChunkAvailable(false, 1 + (u32)prio) == false)
+        if (!ReserveEntry(GetSizeInQueue(size, isSplit)))
         {
             // If there is no memory left for this message.
             return false;
         }
 
+        const ChunkHeadPair entryPosition{ writeChunk, writeChunk->amountOfByteInThisChunk };
         ExtendedQueueEntryHeader header;
         CheckedMemset(&header, 0, sizeof(header));
         header.header.size = size;
@@ -349,14 +476,7 @@ bool ChunkedPacketQueue::AddMessage(u8* data, u16 size, u32 * messageHandle, boo
         AddMessageRaw((u8*)&header, sizeof(header));
         AddMessageRaw(data, size);
         amountOfPackets++;
-
-        if (lookAheadChunk->currentLookAheadHead == CONNECTION_QUEUE_MEMORY_CHUNK_SIZE)
-        {
-            // Edge case! If we have looked ahead through all the available messages, hit exactly the end of
-            // the last chunk and then add a new message, the lookAhead is not moved to the new chunk.
-            lookAheadChunk = lookAheadChunk->nextChunk;
-        }
-        
+        AddToPacketIndex(entryPosition);
     }
 
     return true;
@@ -386,30 +506,18 @@ void ChunkedPacketQueue::PopPacket()
         return;
     }
     const bool needToMoveLookAhead = IsLookAheadAndReadSame(); // If the look ahead is the same as the read, we have to move the look ahead with the read as else the look ahead would point to invalid data.
-    const QueueEntryHeader* header = ((QueueEntryHeader*)(readChunk->data.data() + readChunk->currentReadHead));
-    const u16 size = header->size;
-    const u16 headerSize = header->isExtended ? sizeof(ExtendedQueueEntryHeader) : sizeof(QueueEntryHeader);
-    const u16 sizeToPop = size + headerSize;
-    const u16 oldReadHead = readChunk->currentReadHead;
-    readChunk->currentReadHead += sizeToPop;
-    readChunk->currentReadHead = Utility::NextMultipleOf(readChunk->currentReadHead, sizeof(u32));
-    if (needToMoveLookAhead) readChunk->currentLookAheadHead = readChunk->currentReadHead;
-    if (readChunk->currentReadHead >= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE && readChunk != writeChunk)
+    ChunkHeadPair pair{ readChunk, readChunk->currentReadHead };
+    AdvanceChunkHeadPair(&pair);
+    if (pair.chunk != readChunk)
     {
+        // Entries never straddle two chunks, so the whole readChunk was read.
         auto oldReadChunk = readChunk;
-        readChunk = readChunk->nextChunk;
+        readChunk = pair.chunk;
         if (needToMoveLookAhead) lookAheadChunk = readChunk;
         GS->connectionQueueMemoryAllocator.Deallocate(oldReadChunk);
-        const u16 sizeRemovedFromFirstChunk = (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > oldReadHead ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - oldReadHead : 0);
-        if (sizeToPop > sizeRemovedFromFirstChunk)
-        {
-            // If the end of the popped message reaches into the next chunk
-            const u16 sizeToPopFromSecondChunk = sizeToPop - sizeRemovedFromFirstChunk;
-            readChunk->currentReadHead += sizeToPopFromSecondChunk;
-            readChunk->currentReadHead = Utility::NextMultipleOf(readChunk->currentReadHead, sizeof(u32));
-            if (needToMoveLookAhead) readChunk->currentLookAheadHead = readChunk->currentReadHead;
-        }
     }
+    readChunk->currentReadHead = pair.head;
+    if (needToMoveLookAhead) readChunk->currentLookAheadHead = readChunk->currentReadHead;
 
     if (!HasPackets())
     {
@@ -418,6 +526,21 @@ void ChunkedPacketQueue::PopPacket()
         readChunk->Reset();
     }
     amountOfPackets--;
+    if (amountOfLookedAheadPackets > 0) amountOfLookedAheadPackets--;
+
+    // The next packet that is not indexed yet moves into the index.
+    packetIndex.Pop();
+    const u32 amountOfIndexedPackets = packetIndex.GetAmountOfElements();
+    if (amountOfIndexedPackets < amountOfPackets && !packetIndex.IsFull())
+    {
+        ChunkHeadPair pair{ readChunk, readChunk->currentReadHead };
+        if (amountOfIndexedPackets > 0)
+        {
+            pair = FromPacketIndexEntry(packetIndex.PeekAt(amountOfIndexedPackets - 1));
+            AdvanceChunkHeadPair(&pair);
+        }
+        packetIndex.Push(ToPacketIndexEntry(pair));
+    }
 }
 
 bool ChunkedPacketQueue::HasPackets() const
@@ -427,7 +550,7 @@ bool ChunkedPacketQueue::HasPackets() const
 
 bool ChunkedPacketQueue::IsCurrentlySendingSplitMessage() const
 {
-    if (isCurrentlySendingSplitMessage && !HasMoreToLookAhead())
+    if (isCurrentlySendingSplitMessage && !HasMoreToLookAhead() && !isOpenSplitMessage)
     {
         // Implementation error! If this is happening, we are currently thinking that:
         //    a) We are in the middle of sending splits
@@ -453,7 +576,7 @@ bool ChunkedPacketQueue::HasMoreToLookAhead() const
     return lookAheadChunk != writeChunk || lookAheadChunk->currentLookAheadHead != lookAheadChunk->amountOfByteInThisChunk;
 }
 
-u16 ChunkedPacketQueue::PeekLookAhead(u8* outData, u16 outDataSize) const
+u16 ChunkedPacketQueue::PeekLookAhead(u8* outData, u16 outDataSize, u16 offset) const
 {
     if (!HasMoreToLookAhead())
     {
@@ -461,7 +584,28 @@ u16 ChunkedPacketQueue::PeekLookAhead(u8* outData, u16 outDataSize) const
         return 0;
     }
 
-    return PeekPacketRaw(outData, outDataSize, lookAheadChunk, lookAheadChunk->currentLookAheadHead);
+    // Skip the given amount of packets after the lookAhead without moving it.
+    const ChunkHeadPair pair = GetChunkHeadPairOfLookAheadOffset(offset);
+    if (pair.chunk == nullptr) return 0;
+
+    return PeekPacketRaw(outData, outDataSize, pair.chunk, pair.head);
+}
+
+u16 ChunkedPacketQueue::PeekLookAheadInPlace(u8** outData, u16 maxSize, u16 offset)
+{
+    *outData = nullptr;
+    if (!HasMoreToLookAhead())
+    {
+        SIMEXCEPTION(IllegalStateException);
+        return 0;
+    }
+
+    const ChunkHeadPair pair = GetChunkHeadPairOfLookAheadOffset(offset);
+    if (pair.chunk == nullptr) return 0;
+
+    u16 size = 0;
+    *outData = GetPacketRaw(pair.chunk, pair.head, maxSize, &size);
+    return *outData != nullptr ? size : 0;
 }
 
 void ChunkedPacketQueue::IncrementLookAhead()
@@ -472,37 +616,20 @@ void ChunkedPacketQueue::IncrementLookAhead()
         return;
     }
     const QueueEntryHeader* header = ((const QueueEntryHeader*)(lookAheadChunk->data.data() + lookAheadChunk->currentLookAheadHead));
-    const u16 headerSize = header->isExtended ? sizeof(ExtendedQueueEntryHeader) : sizeof(QueueEntryHeader);
     isCurrentlySendingSplitMessage = header->isSplit == 1 ? true : false;
-    const u16 size = header->size;
-    const u16 sizeToJump = size + headerSize;
-    const u16 oldReadHead = lookAheadChunk->currentLookAheadHead;
-    lookAheadChunk->currentLookAheadHead += sizeToJump;
-    lookAheadChunk->currentLookAheadHead = Utility::NextMultipleOf(lookAheadChunk->currentLookAheadHead, sizeof(u32));
-    if (lookAheadChunk->currentLookAheadHead >= CONNECTION_QUEUE_MEMORY_CHUNK_SIZE && lookAheadChunk != writeChunk)
-    {
-        lookAheadChunk = lookAheadChunk->nextChunk;
-        const u16 sizeRemovedFromFirstChunk = (CONNECTION_QUEUE_MEMORY_CHUNK_SIZE > oldReadHead ? CONNECTION_QUEUE_MEMORY_CHUNK_SIZE - oldReadHead : 0);
-        if (sizeToJump > sizeRemovedFromFirstChunk)
-        {
-            // If the end of the popped message reaches into the next chunk
-            const u16 sizeToPopFromSecondChunk = sizeToJump - sizeRemovedFromFirstChunk;
-            lookAheadChunk->currentLookAheadHead += sizeToPopFromSecondChunk;
-            lookAheadChunk->currentLookAheadHead = Utility::NextMultipleOf(lookAheadChunk->currentLookAheadHead, sizeof(u32));
-        }
-    }
+    ChunkHeadPair pair{ lookAheadChunk, lookAheadChunk->currentLookAheadHead };
+    AdvanceChunkHeadPair(&pair);
+    lookAheadChunk = pair.chunk;
+    lookAheadChunk->currentLookAheadHead = pair.head;
+    amountOfLookedAheadPackets++;
 }
 
 void ChunkedPacketQueue::RollbackLookAhead()
 {
-    lookAheadChunk->currentLookAheadHead = lookAheadChunk->currentReadHead;
-    auto currentChunk = readChunk;
-    while (currentChunk != lookAheadChunk)
-    {
-        currentChunk->currentLookAheadHead = currentChunk->currentReadHead;
-        currentChunk = currentChunk->nextChunk;
-    }
+    // The lookAhead heads of the other chunks are set again once the lookAhead reaches them.
     lookAheadChunk = readChunk;
+    lookAheadChunk->currentLookAheadHead = lookAheadChunk->currentReadHead;
+    amountOfLookedAheadPackets = 0;
 
     //We must reevaluate if the queue is currently sending a split packet as this might have changed after the rollback
     //E.g. The node was previously sending a long split message from queue-A where all packets were already queued, so it was done sending a split message
@@ -517,21 +644,13 @@ void ChunkedPacketQueue::RollbackLookAhead()
 
 bool ChunkedPacketQueue::IsRandomAccessIndexLookedAhead(u16 index) const
 {
-    const ChunkHeadPair pair = GetChunkHeadPairOfIndex(index);
-
-    if (pair.chunk == lookAheadChunk)
-    {
-        return pair.head < lookAheadChunk->currentLookAheadHead;
-    }
-
-    ConnectionQueueMemoryChunk* currentChunk = readChunk;
-    while (currentChunk != lookAheadChunk)
+    if (index >= amountOfPackets)
     {
-        if (currentChunk == pair.chunk) return true;
-        currentChunk = currentChunk->nextChunk;
+        SIMEXCEPTION(IllegalArgumentException);
+        return false;
     }
 
-    return false;
+    return index < amountOfLookedAheadPackets;
 }
 
 u32 ChunkedPacketQueue::GetAmountOfPackets() const
@@ -601,5 +720,12 @@ void ChunkedPacketQueue::SimReset()
     readChunk = GS->connectionQueueMemoryAllocator.Allocate(true);
     writeChunk = readChunk;
     lookAheadChunk = readChunk;
+    amountOfPackets = 0;
+    amountOfLookedAheadPackets = 0;
+    packetIndex.Reset();
+    isCurrentlySendingSplitMessage = false;
+    isOpenSplitMessage = false;
+    isOpenSplitMessageInterrupted = false;
+    hasOpenSplitMessagePieces = false;
 }
 #endif
@@ -32,6 +32,7 @@
 
 #include "FmTypes.h"
 #include "ConnectionQueueMemoryAllocator.h"
+#include "SimpleQueue.h"
 
 /*
 * A specialized queue implementation for packets that are about to be sent through a connection.
@@ -41,6 +42,10 @@
 * the lookAhead is alway inbetween the start and end (both included). This feature is required for
 * resending data to the HAL in the case of a connection reestablishment because at this point the HAL
 * has removed the previous connection and thus forgot about all the data that was sent to it.
+* Entries never straddle two chunks. If an entry does not fit into the rest of the current chunk, it is
+* placed at the start of a new chunk. This allows to read every packet in place, without copying it.
+* The positions of the first CHUNKED_PACKET_QUEUE_INDEX_SIZE - 1 packets are kept in an index so that
+* random access and the lookAhead bookkeeping do not have to walk through the chunks.
  */
 class ChunkedPacketQueue
 {
@@ -51,6 +56,9 @@ private:
     u32 amountOfPackets = 0;
     u32 messageHandle = 0;
     bool isCurrentlySendingSplitMessage = false;
+    bool isOpenSplitMessage = false; //A split message is added piece by piece while it is already being sent
+    bool isOpenSplitMessageInterrupted = false; //Another message was added in between the pieces of the open split message
+    bool hasOpenSplitMessagePieces = false; //At least one piece of the open split message was added
 
     struct QueueEntryHeader
     {
@@ -73,9 +81,27 @@ private:
         u32 head;
     };
 
+    struct PacketIndexEntry
+    {
+        u8 chunkIndex;
+        u8 headInWords;
+    };
+    static_assert(CONNECTION_QUEUE_MEMORY_CHUNK_SIZE / sizeof(u32) <= UINT8_MAX + 1, "The head of a packet must fit into a PacketIndexEntry.");
+
+    SimpleQueue<PacketIndexEntry, CHUNKED_PACKET_QUEUE_INDEX_SIZE> packetIndex; //The positions of the first packets, starting with the one at the read head
+    u32 amountOfLookedAheadPackets = 0;
+
+    static u16 GetSizeInQueue(u16 size, bool isSplit);
+    bool ReserveEntry(u16 sizeInQueue);
     void AddMessageRaw(u8* data, u16 size);
-    u16 PeekPacketRaw(u8* outData, u16 outDataSize, const ConnectionQueueMemoryChunk* chunk, u32 head, u32* messageHandle=nullptr) const;
+    u8* GetPacketRaw(ConnectionQueueMemoryChunk* chunk, u32 head, u16 maxSize, u16* outSize, u32* messageHandle=nullptr) const;
+    u16 PeekPacketRaw(u8* outData, u16 outDataSize, ConnectionQueueMemoryChunk* chunk, u32 head, u32* messageHandle=nullptr) const;
+    void AdvanceChunkHeadPair(ChunkHeadPair* pair) const;
+    PacketIndexEntry ToPacketIndexEntry(const ChunkHeadPair& pair) const;
+    ChunkHeadPair FromPacketIndexEntry(const PacketIndexEntry& entry) const;
+    void AddToPacketIndex(const ChunkHeadPair& pair);
     ChunkHeadPair GetChunkHeadPairOfIndex(u16 index) const;
+    ChunkHeadPair GetChunkHeadPairOfLookAheadOffset(u16 offset) const; //Returns a nullptr chunk if less than offset + 1 packets are left to look ahead
 
     DeliveryPriority prio = DeliveryPriority::VITAL;
 
@@ -90,16 +116,24 @@ public:
     
     bool AddMessage(u8* data, u16 size, u32 * messageHandle, bool isSplit = false);
     u16 PeekPacket      (u8* outData, u16 outDataSize, u32* messageHandle=nullptr) const;
-    u16 RandomAccessPeek(u8* outData, u16 outDataSize, u16 index, u32* messageHandle=nullptr) const; //Careful, very expensive!
+    u16 RandomAccessPeek(u8* outData, u16 outDataSize, u16 index, u32* messageHandle=nullptr) const; //Careful, expensive for packets behind the index!
     void PopPacket();
     bool HasPackets() const;
     bool IsCurrentlySendingSplitMessage() const;
 
     bool SplitAndAddMessage(u8* data, u16 size, u16 payloadSizePerSplit, u32 * messageHandle);
 
+    //Split messages that are forwarded while they are still being received are added one split at a time.
+    //The queue will not send anything else while it waits for the next split of such an open message.
+    void OpenSplitMessage();
+    bool AddOpenSplitMessagePiece(u8* data, u16 size, bool isLastPiece);
+    void AbandonOpenSplitMessage();
+    bool HasOpenSplitMessage() const;
+
     bool IsLookAheadAndReadSame() const;
     bool HasMoreToLookAhead() const;
-    u16 PeekLookAhead(u8* outData, u16 outDataSize) const;
+    u16 PeekLookAhead(u8* outData, u16 outDataSize, u16 offset = 0) const; //Returns 0 if less than offset + 1 packets are left to look ahead
+    u16 PeekLookAheadInPlace(u8** outData, u16 maxSize, u16 offset = 0); //Same as PeekLookAhead, but points into the queue memory. Only valid until the packet is popped.
     void IncrementLookAhead();
     void RollbackLookAhead();
     bool IsRandomAccessIndexLookedAhead(u16 index) const;
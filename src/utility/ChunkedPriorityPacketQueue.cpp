@@ -122,12 +122,42 @@ bool ChunkedPriorityPacketQueue::IsCurrentlySendingSplitMessage() const
     return GetSplitQueue().queue != nullptr;
 }
 
+bool ChunkedPriorityPacketQueue::HasOpenSplitMessage() const
+{
+    for (u32 i = 0; i < queues.size(); i++)
+    {
+        if (queues[i].HasOpenSplitMessage()) return true;
+    }
+    return false;
+}
+
+bool ChunkedPriorityPacketQueue::IsWaitingForOpenSplitMessage() const
+{
+    const QueuePriorityPairConst splitQueue = GetSplitQueue();
+    return splitQueue.queue != nullptr && !splitQueue.queue->HasMoreToLookAhead();
+}
+
 QueuePriorityPair ChunkedPriorityPacketQueue::GetSendQueue()
 {
     // If we have a queue that is currently sending a split, it trumps
     // all priority levels.
     QueuePriorityPair retVal = GetSplitQueue();
-    if (retVal.queue) return retVal;
+    if (retVal.queue)
+    {
+        if (retVal.queue->HasMoreToLookAhead()) return retVal;
+
+        // An open split message that is still being received must not be interleaved
+        // with other packets, so we wait for its next split. Vital packets are never
+        // split and don't disturb the reassembly of the receiver, so they may go ahead.
+        retVal.queue = nullptr;
+        retVal.priority = DeliveryPriority::INVALID;
+        if (queues[(u32)DeliveryPriority::VITAL].HasMoreToLookAhead())
+        {
+            retVal.priority = DeliveryPriority::VITAL;
+            retVal.queue = &queues[(u32)DeliveryPriority::VITAL];
+        }
+        return retVal;
+    }
 
     // Next we check if the vital queue has some data. It bypasses
     // priority droplets.
@@ -138,31 +168,47 @@ QueuePriorityPair ChunkedPriorityPacketQueue::GetSendQueue()
         return retVal;
     }
 
-    //We have to iterate twice in case every queue has a priority droplet overflow.
-    //In such a case, all droplets are removed and we start again from the top.
-    for (u32 repeat = 0; repeat < 2; repeat++)
+    //The highest priority that has not yet used up its droplets is sent. If every queue
+    //has a priority droplet overflow, we start again from the top. The droplets are only
+    //changed by ConsumePriorityDroplet so that the selection can be repeated.
+    for (u32 i = 1; i < queues.size(); i++)
     {
-        for (u32 i = 1; i < queues.size(); i++)
+        if (queues[i].HasMoreToLookAhead())
         {
-            if (queues[i].HasMoreToLookAhead())
+            if (retVal.queue == nullptr)
+            {
+                retVal.priority = (DeliveryPriority)i;
+                retVal.queue = &queues[i];
+            }
+            if (priorityDroplets[i] < AMOUNT_OF_PRIORITY_DROPLETS_UNTIL_OVERFLOW)
             {
-                priorityDroplets[i]++;
-                if (priorityDroplets[i] > AMOUNT_OF_PRIORITY_DROPLETS_UNTIL_OVERFLOW)
-                {
-                    priorityDroplets[i] = 0;
-                }
-                else
-                {
-                    retVal.priority = (DeliveryPriority)i;
-                    retVal.queue = &queues[i];
-                    return retVal;
-                }
+                retVal.priority = (DeliveryPriority)i;
+                retVal.queue = &queues[i];
+                return retVal;
             }
         }
     }
     return retVal;
 }
 
+void ChunkedPriorityPacketQueue::ConsumePriorityDroplet(DeliveryPriority prio)
+{
+    //Split messages and vital packets bypass the priority droplets
+    if (prio == DeliveryPriority::VITAL || (u32)prio >= AMOUNT_OF_SEND_QUEUE_PRIORITIES || GetSplitQueue().queue != nullptr) return;
+
+    //All higher priorities that were skipped had a droplet overflow and start again. If the
+    //given priority itself had an overflow, every queue had one and all droplets are removed.
+    const bool isOverflow = priorityDroplets[(u32)prio] >= AMOUNT_OF_PRIORITY_DROPLETS_UNTIL_OVERFLOW;
+    for (u32 i = 1; i < queues.size(); i++)
+    {
+        if ((isOverflow || i < (u32)prio) && queues[i].HasMoreToLookAhead())
+        {
+            priorityDroplets[i] = 0;
+        }
+    }
+    priorityDroplets[(u32)prio]++;
+}
+
 ChunkedPacketQueue* ChunkedPriorityPacketQueue::GetQueueByPriority(DeliveryPriority prio)
 {
     if ((u32)prio >= AMOUNT_OF_SEND_QUEUE_PRIORITIES)
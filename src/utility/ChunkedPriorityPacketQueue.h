@@ -65,7 +65,10 @@ public:
     bool SplitAndAddMessage(DeliveryPriority prio, u8* data, u16 size, u16 payloadSizePerSplit, u32* messageHandle);
     u32 GetAmountOfPackets() const;
     bool IsCurrentlySendingSplitMessage() const;
+    bool HasOpenSplitMessage() const;
+    bool IsWaitingForOpenSplitMessage() const; //Only vital packets are sent until the next split of the open message is added
     QueuePriorityPair GetSendQueue();
+    void ConsumePriorityDroplet(DeliveryPriority prio); //Must be called once a packet of the queue returned by GetSendQueue is sent
     ChunkedPacketQueue* GetQueueByPriority(DeliveryPriority prio);
     void RollbackLookAhead();
 };
@@ -120,6 +120,28 @@ void ConnectionQueueMemoryAllocator::Deallocate(ConnectionQueueMemoryChunk* chun
     chunksLeft++;
 }
 
+u8 ConnectionQueueMemoryAllocator::GetIndexOfChunk(const ConnectionQueueMemoryChunk* chunk) const
+{
+    static_assert(CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT <= UINT8_MAX + 1, "Chunk indices must fit into a u8.");
+    if (chunk < chunks.data() || chunk >= chunks.data() + CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT)
+    {
+        // Where ever you got this chunk from, it is not from this allocator!
+        SIMEXCEPTION(NotFromThisAllocatorException);
+        return 0;
+    }
+    return (u8)(chunk - chunks.data());
+}
+
+ConnectionQueueMemoryChunk* ConnectionQueueMemoryAllocator::GetChunkOfIndex(u8 index)
+{
+    if (index >= CONNECTION_QUEUE_MEMORY_CHUNK_AMOUNT)
+    {
+        SIMEXCEPTION(IllegalArgumentException);
+        return nullptr;
+    }
+    return chunks.data() + index;
+}
+
 bool ConnectionQueueMemoryAllocator::IsChunkAvailable(bool isNewConnection, u32 amountOfChunks) const
 {
     //Make sure that there is always enough place for new connections.
@@ -77,4 +77,8 @@ public:
     ConnectionQueueMemoryChunk* Allocate(bool isNewConnection = false);
     void Deallocate(ConnectionQueueMemoryChunk* chunk);
     bool IsChunkAvailable(bool isNewConnection = false, u32 amountOfChunks = 1) const;
+
+    //Chunks can be referenced by their index, which is smaller than a pointer
+    u8 GetIndexOfChunk(const ConnectionQueueMemoryChunk* chunk) const;
+    ConnectionQueueMemoryChunk* GetChunkOfIndex(u8 index);
 };
@@ -125,15 +125,16 @@ void Logger::Log_f(bool printLine, bool isJson, bool isEndOfMessage, bool skipJs
 void Logger::LogTag_f(LogType logType, const char* file, i32 line, const char* tag, const char* message, ...) const
 {
 #if IS_ACTIVE(LOGGING) && defined(TERMINAL_ENABLED)
+    const u32 tagId = GetLogTagId(tag);
     if (
             //UART communication (json mode)
             (
                 Conf::GetInstance().terminalMode != TerminalMode::PROMPT
-                && (logEverything || logType == LogType::UART_COMMUNICATION || IsTagEnabled(tag))
+                && (logEverything || logType == LogType::UART_COMMUNICATION || IsTagIdEnabled(tagId))
             )
             //User interaction (prompt mode)
             || (Conf::GetInstance().terminalMode == TerminalMode::PROMPT
-                && (logEverything || logType == LogType::TRACE || IsTagEnabled(tag))
+                && (logEverything || logType == LogType::TRACE || IsTagIdEnabled(tagId))
             )
         )
     {
@@ -168,7 +169,7 @@ void Logger::LogTag_f(LogType logType, const char* file, i32 line, const char* t
         }
     }
 #ifdef SIM_ENABLED
-    if (strcmp(tag, "ERROR") == 0)
+    if (tagId == LOG_TAG_ID_ERROR)
     {
         //ERRORs are classified as severe enough that they should not happend
         //during normal execution. If they are logged, something went wrong
@@ -179,6 +180,26 @@ void Logger::LogTag_f(LogType logType, const char* file, i32 line, const char* t
 #endif
 }
 
+#if IS_ACTIVE(BINARY_LOGGING)
+u32 Logger::GetBinaryLogFormatId(const char* format)
+{
+    return (u32)(format - __start_binary_log_formats);
+}
+
+void Logger::FlushBinaryLog()
+{
+    u8 buffer[32];
+    u32 length;
+    while ((length = binaryLogBuffer.Read(buffer, sizeof(buffer))) > 0)
+    {
+        for (u32 i = 0; i < length; i++)
+        {
+            log_transport_put((char)buffer[i]);
+        }
+    }
+}
+#endif
+
 static const char* GetUartErrorString(Logger::UartErrorType uartError)
 {
     #if IS_ACTIVE(ENUM_TO_STRING)
@@ -251,7 +272,7 @@ void Logger::EnableTag(const char* tag)
     }
 
     if (!found && emptySpot >= 0) {
-        strcpy(&activeLogTags[emptySpot * MAX_LOG_TAG_LENGTH], tagUpper);
+        SetActiveLogTag(emptySpot, tagUpper);
     }
     else if (!found && emptySpot < 0)
     {
@@ -267,17 +288,10 @@ void Logger::EnableTag(const char* tag)
 bool Logger::IsTagEnabled(const char* tag) const
 {
 #if IS_ACTIVE(LOGGING) && defined(TERMINAL_ENABLED)
-
-    if (strcmp(tag, "ERROR") == 0 || strcmp(tag, "WARNING") == 0) {
-        return true;
-    }
-    for (u32 i = 0; i < MAX_ACTIVATE_LOG_TAG_NUM; i++)
-    {
-        if (strcmp(&activeLogTags[i * MAX_LOG_TAG_LENGTH], tag) == 0) return true;
-    }
-#endif
-
+    return IsTagIdEnabled(GetLogTagId(tag));
+#else
     return false;
+#endif
 }
 
 void Logger::DisableTag(const char* tag)
@@ -296,7 +310,7 @@ void Logger::DisableTag(const char* tag)
 
     for (u32 i = 0; i < MAX_ACTIVATE_LOG_TAG_NUM; i++) {
         if (strcmp(&activeLogTags[i * MAX_LOG_TAG_LENGTH], tagUpper) == 0) {
-            activeLogTags[i * MAX_LOG_TAG_LENGTH] = '\0';
+            ClearActiveLogTag(i);
             return;
         }
     }
@@ -324,7 +338,7 @@ void Logger::ToggleTag(const char* tag)
     for (u32 i = 0; i < MAX_ACTIVATE_LOG_TAG_NUM; i++) {
         if (activeLogTags[i * MAX_LOG_TAG_LENGTH] == '\0' && emptySpot < 0) emptySpot = i;
         if (strcmp(&activeLogTags[i * MAX_LOG_TAG_LENGTH], tagUpper) == 0) {
-            activeLogTags[i * MAX_LOG_TAG_LENGTH] = '\0';
+            ClearActiveLogTag(i);
             found = true;
             // => Do not return or break as we are still looking for an empty spot
         }
@@ -332,7 +346,7 @@ void Logger::ToggleTag(const char* tag)
 
     //If we haven't found it, we enable it by using the previously found empty spot
     if (!found && emptySpot >= 0) {
-        strcpy(&activeLogTags[emptySpot * MAX_LOG_TAG_LENGTH], tagUpper);
+        SetActiveLogTag(emptySpot, tagUpper);
         logt("WARNING", "Tag enabled");
     }
     else if (!found && emptySpot < 0) {
@@ -347,6 +361,33 @@ void Logger::ToggleTag(const char* tag)
 #endif
 }
 
+void Logger::SetActiveLogTag(u32 index, const char* tagUpper)
+{
+    strcpy(&activeLogTags[index * MAX_LOG_TAG_LENGTH], tagUpper);
+    activeLogTagIds[index] = GetLogTagId(tagUpper);
+    const u32 bit = activeLogTagIds[index] % LOG_TAG_FILTER_BITS;
+    activeLogTagBits[bit / 32] |= 1UL << (bit % 32);
+}
+
+void Logger::ClearActiveLogTag(u32 index)
+{
+    activeLogTags[index * MAX_LOG_TAG_LENGTH] = '\0';
+    activeLogTagIds[index] = 0;
+    //Other enabled tags might share the bit of the removed tag
+    RebuildActiveLogTagBits();
+}
+
+void Logger::RebuildActiveLogTagBits()
+{
+    activeLogTagBits = {};
+    for (u32 i = 0; i < MAX_ACTIVATE_LOG_TAG_NUM; i++)
+    {
+        if (activeLogTags[i * MAX_LOG_TAG_LENGTH] == '\0') continue;
+        const u32 bit = activeLogTagIds[i] % LOG_TAG_FILTER_BITS;
+        activeLogTagBits[bit / 32] |= 1UL << (bit % 32);
+    }
+}
+
 u32 Logger::GetAmountOfEnabledTags()
 {
 #if IS_ACTIVE(LOGGING) && defined(TERMINAL_ENABLED)
@@ -1143,6 +1184,8 @@ u32 Logger::ParseBase64StringToBuffer(const char * base64String, const u32 base6
 void Logger::DisableAll()
 {
     activeLogTags = {};
+    activeLogTagIds = {};
+    activeLogTagBits = {};
     logEverything = false;
 }
 
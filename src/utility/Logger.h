@@ -33,6 +33,7 @@
 #include <Config.h>
 #include <Boardconfig.h>
 #include <Terminal.h>
+#include <BinaryLog.h>
 #ifdef SIM_ENABLED
 #include <string>
 #endif
@@ -40,6 +41,19 @@
 
 constexpr int MAX_ACTIVATE_LOG_TAG_NUM = 40;
 constexpr int MAX_LOG_TAG_LENGTH = 11;
+//Size of the bit filter over the ids of the enabled log tags, must be a multiple of 32
+constexpr int LOG_TAG_FILTER_BITS = 256;
+//Holds the frames of the binary logging until they are drained by the log transport
+constexpr u32 BINARY_LOG_BUFFER_SIZE = 512;
+
+//Log tags are identified by the FNV-1a hash of their name. For string literals this is evaluated
+//by the compiler so that logt does not have to compare any strings for disabled tags.
+constexpr u32 GetLogTagId(const char* tag, u32 hash = 2166136261u)
+{
+    return *tag == '\0' ? hash : GetLogTagId(tag + 1, (hash ^ (u8)*tag) * 16777619u);
+}
+constexpr u32 LOG_TAG_ID_ERROR = GetLogTagId("ERROR");
+constexpr u32 LOG_TAG_ID_WARNING = GetLogTagId("WARNING");
 
 /*############ Error Types ################*/
 //Errors are saved in RAM and can be requested through the mesh
@@ -166,7 +180,15 @@ class Logger
 {
 private:
 
+    //Names of the enabled tags, the ids of these tags are stored at the same index in activeLogTagIds
     std::array<char, MAX_ACTIVATE_LOG_TAG_NUM * MAX_LOG_TAG_LENGTH> activeLogTags{};
+    std::array<u32, MAX_ACTIVATE_LOG_TAG_NUM> activeLogTagIds{};
+    //A bit is set if an enabled tag id maps to it, a cleared bit means that the tag is disabled
+    std::array<u32, LOG_TAG_FILTER_BITS / 32> activeLogTagBits{};
+
+    void SetActiveLogTag(u32 index, const char* tagUpper);
+    void ClearActiveLogTag(u32 index);
+    void RebuildActiveLogTagBits();
 
     u32 currentJsonCrc = 0;
 
@@ -174,6 +196,10 @@ private:
     std::string currentString = "";
 #endif
 
+#if IS_ACTIVE(BINARY_LOGGING)
+    BinaryLogBuffer<BINARY_LOG_BUFFER_SIZE> binaryLogBuffer;
+#endif
+
 public:
     Logger();
     static Logger& GetInstance();
@@ -226,12 +252,42 @@ public:
 
     void UartError_f(UartErrorType type) const;
 
+#if IS_ACTIVE(BINARY_LOGGING)
+    //Copies the arguments into the binary log buffer, the format is only used for its id
+    template<typename... Args>
+    void LogBinary(const char* format, u32 tagId, Args... args)
+    {
+        BinaryLogRecord record(GetBinaryLogFormatId(format), tagId);
+        record.AppendArguments(args...);
+        binaryLogBuffer.Push(record);
+    }
+    static u32 GetBinaryLogFormatId(const char* format);
+    //Passes all buffered frames to the log transport, called from the event loop
+    void FlushBinaryLog();
+#endif
+
     void DisableAll();
     void EnableAll();
 
     //These functions are used to enable/disable a debug tag, it will then be printed to the output
     void EnableTag(const char* tag);
     bool IsTagEnabled(const char* tag) const;
+    bool IsTagIdEnabled(u32 tagId) const
+    {
+        if (tagId == LOG_TAG_ID_ERROR || tagId == LOG_TAG_ID_WARNING) return true;
+        const u32 bit = tagId % LOG_TAG_FILTER_BITS;
+        if ((activeLogTagBits[bit / 32] & (1UL << (bit % 32))) == 0) return false;
+        for (u32 i = 0; i < MAX_ACTIVATE_LOG_TAG_NUM; i++)
+        {
+            if (activeLogTagIds[i] == tagId && activeLogTags[i * MAX_LOG_TAG_LENGTH] != '\0') return true;
+        }
+        return false;
+    }
+    //Used by logt to skip the call to LogTag_f for disabled tags
+    bool IsLogLineEnabled(u32 tagId) const
+    {
+        return logEverything || IsTagIdEnabled(tagId);
+    }
     void DisableTag(const char* tag);
     void ToggleTag(const char* tag);
 
@@ -295,7 +351,19 @@ private:
 
 #if IS_ACTIVE(LOGGING)
 #define logs(message, ...) Logger::GetInstance().Log_f(true, false, true, false, __FILE_S__, __LINE__, message, ##__VA_ARGS__)
-#define logt(tag, message, ...) Logger::GetInstance().LogTag_f(Logger::LogType::LOG_LINE, __FILE_S__, __LINE__, tag, message, ##__VA_ARGS__)
+#if IS_ACTIVE(BINARY_LOGGING)
+#define BINARY_LOG_STRINGIFY2(x) #x
+#define BINARY_LOG_STRINGIFY(x) BINARY_LOG_STRINGIFY2(x)
+//The format is placed in a section that is not loaded into flash, see BinaryLog.h. The json mode is still logged as text.
+#define logt(tag, message, ...) do{ \
+    if(Logger::GetInstance().IsLogLineEnabled(GetLogTagId(tag))) { \
+        static const char binaryLogFormat[] __attribute__((section("BinaryLogFormats"), used)) = __FILE__ "\x1f" BINARY_LOG_STRINGIFY(__LINE__) "\x1f" #tag "\x1f" message; \
+        if(Conf::GetInstance().terminalMode == TerminalMode::PROMPT) Logger::GetInstance().LogBinary(binaryLogFormat, GetLogTagId(tag), ##__VA_ARGS__); \
+        else Logger::GetInstance().LogTag_f(Logger::LogType::LOG_LINE, __FILE_S__, __LINE__, tag, message, ##__VA_ARGS__); \
+    } }while(0)
+#else
+#define logt(tag, message, ...) do{ if(Logger::GetInstance().IsLogLineEnabled(GetLogTagId(tag))) Logger::GetInstance().LogTag_f(Logger::LogType::LOG_LINE, __FILE_S__, __LINE__, tag, message, ##__VA_ARGS__); }while(0)
+#endif
 #define TO_BASE64(data, dataSize) DYNAMIC_ARRAY(data##Hex, (dataSize)*3+1); Logger::ConvertBufferToBase64String(data, (dataSize), (char*)data##Hex, (dataSize)*3+1)
 #define TO_BASE64_2(data, dataSize) Logger::ConvertBufferToBase64String(data, (dataSize), (char*)data##Hex, (dataSize)*3+1)
 #define TO_HEX(data, dataSize) DYNAMIC_ARRAY(data##Hex, (dataSize)*3+1); Logger::ConvertBufferToHexString(data, (dataSize), (char*)data##Hex, (dataSize)*3+1)
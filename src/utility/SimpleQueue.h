@@ -111,6 +111,19 @@ public:
         return data[readHead];
     }
 
+    //Returns the element at the given position, counted from the oldest element
+    T PeekAt(u32 index) const
+    {
+        if (index >= GetAmountOfElements())
+        {
+            SIMEXCEPTION(IllegalArgumentException);
+            return T();
+        }
+        u32 position = readHead + index;
+        if (position >= N) position -= N;
+        return data[position];
+    }
+
     void Reset()
     {
         readHead = 0;
@@ -425,7 +425,11 @@ void Terminal::ProcessLine(char* line)
 
     
     for(u32 i=0; i<GS->amountOfModules; i++){
-        TerminalCommandHandlerReturnType currentHandled = GS->activeModules[i]->TerminalCommandHandler(commandArgsPtr, (u8)commandArgsSize);
+        TerminalCommandHandlerReturnType currentHandled;
+        {
+            SIM_PROFILE_MODULE_SCOPE(GS->activeModules[i]->moduleName, "TerminalCommandHandler");
+            currentHandled = GS->activeModules[i]->TerminalCommandHandler(commandArgsPtr, (u8)commandArgsSize);
+        }
 
         if (          handled != TerminalCommandHandlerReturnType::UNKNOWN
             && currentHandled != TerminalCommandHandlerReturnType::UNKNOWN)
@@ -827,6 +831,12 @@ bool Terminal::GetNextTerminalQueueEntry(TerminalCommandQueueEntry & out)
     }
 }
 
+bool Terminal::IsTerminalCommandQueueEmpty()
+{
+    std::unique_lock<std::mutex> guard(terminalMutex);
+    return terminalCommandQueue.empty();
+}
+
 std::vector<std::string> tokenize(const std::string& message)
 {
     std::vector<std::string> retVal;
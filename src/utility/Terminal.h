@@ -194,6 +194,7 @@ private:
 public:
     void PutIntoTerminalCommandQueue(std::string &message, bool skipCrc);
     bool GetNextTerminalQueueEntry(TerminalCommandQueueEntry &out);
+    bool IsTerminalCommandQueueEmpty();
     void StdioPutString(const char* message);
 
 #endif
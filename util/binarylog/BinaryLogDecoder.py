@@ -0,0 +1,148 @@
+# Decodes the output of a node that uses binary logging (ACTIVATE_BINARY_LOGGING).
+# The format table is created next to the firmware during the build (<featureset>_log_formats.json).
+# Text output such as trace or the terminal prompt is passed through unchanged.
+#
+# Usage:
+#   python BinaryLogDecoder.py <formats.json> --port COM3 [--baudrate 1000000]   (requires pyserial)
+#   python BinaryLogDecoder.py <formats.json> --file capture.bin
+#   python BinaryLogDecoder.py <formats.json> < capture.bin
+import argparse
+import json
+import re
+import struct
+import sys
+
+FRAME_START = 0x02
+DROPPED_RECORDS_FORMAT_ID = 0xFFFFFFFF
+
+TYPE_INT32 = 0
+TYPE_INT64 = 1
+TYPE_FLOAT = 2
+TYPE_STRING = 3
+
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(?:hh|h|ll|l|z|j|t|L)?([diouxXcsfFeEgGp%])")
+
+def get_log_tag_id(tag):
+    # Must match GetLogTagId in Logger.h
+    hash = 2166136261
+    for c in tag.encode("utf-8"):
+        hash = ((hash ^ c) * 16777619) & 0xFFFFFFFF
+    return hash
+
+class Decoder:
+    def __init__(self, formats_path, output):
+        with open(formats_path) as f:
+            self.formats = {int(k): v for k, v in json.load(f)["formats"].items()}
+        self.tags = {get_log_tag_id(name): name for name in ["ERROR", "WARNING"]}
+        for entry in self.formats.values():
+            if entry["tag"]:
+                self.tags[get_log_tag_id(entry["tag"])] = entry["tag"]
+        self.output = output
+        self.pending = bytearray()
+
+    def feed(self, data):
+        self.pending += data
+        while self.pending:
+            start = self.pending.find(FRAME_START)
+            if start != 0:
+                text = self.pending if start < 0 else self.pending[:start]
+                self.output.write(text.decode("utf-8", "replace"))
+                del self.pending[:len(text)]
+                continue
+            if len(self.pending) < 2 or len(self.pending) < self.pending[1] + 3:
+                return
+            payload_length = self.pending[1]
+            payload = bytes(self.pending[2:2 + payload_length])
+            checksum = self.pending[2 + payload_length]
+            if sum(payload) & 0xFF != checksum:
+                # Not a frame or a corrupted one, resynchronize after the start byte
+                self.output.write("<corrupted binary log frame>\n")
+                del self.pending[:1]
+                continue
+            del self.pending[:payload_length + 3]
+            self.output.write(self.decode_frame(payload) + "\n")
+        self.output.flush()
+
+    def decode_frame(self, payload):
+        format_id, tag_id, amount = struct.unpack_from("<IIB", payload, 0)
+        offset = 9
+        types = []
+        for i in range(amount):
+            types.append((payload[offset + i // 4] >> ((i % 4) * 2)) & 0x3)
+        offset += (amount + 3) // 4
+        args = []
+        for t in types:
+            if t == TYPE_INT32:
+                args.append(struct.unpack_from("<I", payload, offset)[0])
+                offset += 4
+            elif t == TYPE_INT64:
+                args.append(struct.unpack_from("<Q", payload, offset)[0])
+                offset += 8
+            elif t == TYPE_FLOAT:
+                args.append(struct.unpack_from("<f", payload, offset)[0])
+                offset += 4
+            else:
+                end = payload.index(b"\0", offset)
+                args.append(payload[offset:end].decode("utf-8", "replace"))
+                offset = end + 1
+
+        if format_id == DROPPED_RECORDS_FORMAT_ID:
+            return "<" + str(args[0]) + " binary log records dropped>"
+        entry = self.formats.get(format_id)
+        if entry is None:
+            return "<unknown binary log format " + str(format_id) + " " + repr(args) + ">"
+        tag = self.tags.get(tag_id, "0x%08X" % tag_id)
+        return "[" + entry["file"] + "@" + str(entry["line"]) + " " + tag + "]: " + format_message(entry["format"], args)
+
+def format_message(fmt, args):
+    args = list(args)
+    def next_arg():
+        return args.pop(0) if args else "<missing>"
+    def replace(match):
+        flags, width, precision, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        if width == "*":
+            width = str(next_arg())
+        if precision == "*":
+            precision = str(next_arg())
+        spec = "%" + flags + (width or "") + ("." + precision if precision else "")
+        value = next_arg()
+        if isinstance(value, str) and conversion != "s":
+            return value
+        if conversion in "di":
+            value = value - (1 << 32) if isinstance(value, int) and 0x80000000 <= value <= 0xFFFFFFFF else value
+            return (spec + "d") % value
+        if conversion == "c":
+            return (spec + "c") % chr(value & 0xFF)
+        if conversion == "p":
+            return "0x%08x" % value
+        if conversion == "s":
+            return (spec + "s") % value
+        return (spec + conversion) % value
+    return CONVERSION.sub(replace, fmt)
+
+def main():
+    parser = argparse.ArgumentParser(description="Decodes the binary log output of a FruityMesh node")
+    parser.add_argument("formats", help="<featureset>_log_formats.json from the build directory")
+    parser.add_argument("--port", help="Serial port to read from")
+    parser.add_argument("--baudrate", type=int, default=1000000)
+    parser.add_argument("--file", help="File with captured output")
+    args = parser.parse_args()
+
+    decoder = Decoder(args.formats, sys.stdout)
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baudrate, timeout=0.1) as port:
+            while True:
+                decoder.feed(port.read(256))
+    else:
+        stream = open(args.file, "rb") if args.file else sys.stdin.buffer
+        while True:
+            data = stream.read(256)
+            if not data:
+                break
+            decoder.feed(data)
+
+if __name__ == "__main__":
+    main()